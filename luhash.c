@@ -1,4 +1,11 @@
 #include "luhash.h"
+#include "luhash_sync.h"
+#include "luhash_trace.h"
+
+#include <stdint.h>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
 
 /**
  * @file lu_hash.c
@@ -15,11 +22,12 @@
  */
 
 static int			 lu_convert_bucket_to_rbtree(lu_hash_bucket_t* bucket);
+static void			 lu_convert_bucket_to_list(lu_hash_bucket_t* bucket);
 static lu_rb_tree_t* lu_rb_tree_init();
-static void			 lu_rb_tree_insert(lu_rb_tree_t* tree, int key, void* value);
-static void			 lu_hash_rb_tree_delete(lu_hash_bucket_t* bucket, int key);
+static int			 lu_rb_tree_insert(lu_rb_tree_t* tree, int key, void* value, unsigned int expire, size_t* depth);
+static int			 lu_hash_rb_tree_delete(lu_hash_bucket_t* bucket, int key);
 
-static void lu_hash_list_delete(lu_hash_bucket_t* bucket, int key);
+static int  lu_hash_list_delete(lu_hash_bucket_t* bucket, int key);
 static lu_hash_bucket_node_t* lu_hash_list_find(lu_hash_bucket_t* bucket, int key);
 static lu_rb_tree_node_t* lu_hash_rb_tree_find(lu_rb_tree_t* tree, int key);
 
@@ -34,45 +42,383 @@ static void lu_rb_tree_delete_fixup(lu_rb_tree_t* tree, lu_rb_tree_node_t* node)
 static lu_rb_tree_node_t* lu_rb_tree_minimum(lu_rb_tree_t* tree, lu_rb_tree_node_t* node);
 static lu_rb_tree_node_t* lu_rb_tree_maximum(lu_rb_tree_t* tree, lu_rb_tree_node_t* node);
 
-static void lu_rb_tree_destroy_node(lu_rb_tree_t* tree, lu_rb_tree_node_t* node);
+static size_t lu_rb_tree_destroy_nodes(lu_rb_tree_t* tree, size_t budget);
 static void lu_hash_list_destory(lu_hash_bucket_t* bucket);
 static void lu_hash_rb_tree_destory(lu_hash_bucket_t* bucket);
 
 static lu_rb_tree_node_t* lu_rb_tree_successor(lu_rb_tree_t* tree, lu_rb_tree_node_t* node);
-static int	lu_hash_function(int key, size_t table_size);
+static int	lu_hash_function(lu_hash_func_t hash, int key, unsigned long long seed, size_t table_size);
+static unsigned long long lu_hash_mix(lu_hash_func_t hash, int key, unsigned long long seed);
+static int	lu_hash_reduce(unsigned long long hash, size_t table_size);
+static int	lu_hash_table_treeify_suspect(const lu_hash_table_t* table);
+static int	lu_hash_table_collisions_remain(const lu_hash_table_t* table);
+static int	lu_hash_func_ignores_seed(lu_hash_func_t hash);
+static int	lu_hash_table_auto_reseed(lu_hash_table_t* table);
+static double lu_hash_treeify_share(double load_factor, size_t treeify_threshold);
+
+/** The filter is made of cache-line sized blocks of 8 words; a key sets one bit in every word of its block */
+#define LU_HASH_FILTER_BLOCK_WORDS	8
+#define LU_HASH_FILTER_BLOCK_BYTES	(LU_HASH_FILTER_BLOCK_WORDS * sizeof(unsigned long long))
+
+static void lu_hash_filter_build(lu_hash_table_t* table);
+static void lu_hash_filter_add(lu_hash_table_t* table, unsigned long long hash);
+static int  lu_hash_filter_may_contain(const lu_hash_table_t* table, unsigned long long hash);
+static void lu_hash_filter_note_removal(lu_hash_table_t* table);
+static void lu_hash_table_notify_write(lu_hash_table_t* table, lu_hash_write_op_t op, int key, void* value, unsigned int expire);
+
+static void lu_hash_cow_preserve(lu_hash_table_t* table, size_t index);
+static void lu_hash_snapshot_detach(lu_hash_snapshot_t* snapshot);
+static lu_hash_bucket_t* lu_hash_snapshot_bucket(lu_hash_snapshot_t* snapshot, size_t index);
+static lu_rb_tree_node_t* lu_rb_tree_copy(const lu_rb_tree_t* source, const lu_rb_tree_node_t* node, lu_rb_tree_t* target, lu_rb_tree_node_t* parent);
+static void lu_hash_bucket_copy(const lu_hash_bucket_t* source, lu_hash_bucket_t* target);
+
+/** Bulk operations between two tables */
+typedef enum lu_hash_bulk_op_u {
+	LU_HASH_BULK_UNION,
+	LU_HASH_BULK_INTERSECT,
+	LU_HASH_BULK_DIFFERENCE,
+}lu_hash_bulk_op_t;
+
+/**
+ * A range of buckets processed by one worker of a bulk operation. Changes to the table-wide
+ * counters are collected here and applied once all workers have finished.
+ */
+typedef struct lu_hash_bulk_job_s {
+	lu_hash_table_t*	 dst;
+	lu_hash_table_t*	 src;
+	lu_hash_merge_func_t merge;
+	void*				 ctx;
+	lu_hash_bulk_op_t	 op;
+	int					 same_layout;	// Both tables have the same seed and size, bucket i matches bucket i
+	int					 concurrent;	// Other workers run at the same time, filter upkeep is deferred
+	size_t				 begin;			// First bucket of the range
+	size_t				 end;			// One past the last bucket of the range
+	unsigned int		 src_now;		// Current time on the source clock, 0 if the source has no TTLs
+	size_t				 added;			// Entries added to dst
+	size_t				 removed;		// Entries removed from dst
+	size_t				 value_bytes_added;		// Sum of value_size over values that entered dst
+	size_t				 value_bytes_removed;	// Sum of value_size over values that left dst
+	size_t				 treeified;		// dst buckets converted to trees
+}lu_hash_bulk_job_t;
+
+static void lu_hash_bulk_run(lu_hash_table_t* dst, lu_hash_table_t* src, lu_hash_bulk_op_t op, lu_hash_merge_func_t merge, void* ctx, size_t thread_count);
+static void lu_hash_bulk_worker(void* arg);
+static void lu_hash_bulk_union_bucket(lu_hash_bulk_job_t* job, size_t index);
+static void lu_hash_bulk_filter_bucket(lu_hash_bulk_job_t* job, size_t index);
+static void lu_hash_bulk_place(lu_hash_bulk_job_t* job, size_t index, lu_hash_bucket_node_t* node);
+static lu_hash_bucket_node_t* lu_hash_bucket_take(lu_hash_bucket_t* bucket);
+static void** lu_hash_bucket_value_slot(lu_hash_bucket_t* bucket, int key, unsigned int now);
+
+/**
+ * State of one lu_hash_table_remove_if sweep. Table-wide counters are collected here and applied
+ * once the sweep is over.
+ */
+typedef struct lu_hash_sweep_s {
+	lu_hash_pred_func_t pred;
+	void*				ctx;
+	unsigned int		now;		// Current table time, 0 if the table has no TTLs
+	size_t				removed;	// Entries the predicate removed
+	size_t				expired;	// Expired entries removed on the way
+}lu_hash_sweep_t;
+
+static int  lu_hash_sweep_match(lu_hash_table_t* table, lu_hash_sweep_t* sweep, int key, void* value, unsigned int expire);
+static void lu_hash_sweep_list(lu_hash_table_t* table, lu_hash_sweep_t* sweep, size_t index);
+static void lu_hash_sweep_tree(lu_hash_table_t* table, lu_hash_sweep_t* sweep, size_t index);
+static lu_rb_tree_node_t* lu_rb_tree_build(lu_rb_tree_t* tree, lu_rb_tree_node_t** nodes, size_t count, size_t depth, size_t red_depth, lu_rb_tree_node_t* parent);
+static void lu_hash_tree_rebuild(lu_hash_bucket_t* bucket, lu_rb_tree_node_t** nodes, size_t count);
+static int  lu_rb_tree_node_compare(const void* a, const void* b);
 
+/**
+ * Key of a batch operation with its hash and bucket, so that the batch can be sorted by bucket
+ * and applied one bucket at a time.
+ */
+typedef struct lu_hash_batch_item_s {
+	unsigned long long hash;
+	size_t			   index;		// Bucket of the key
+	size_t			   position;	// Position of the key in the caller's arrays
+	int				   key;
+}lu_hash_batch_item_t;
+
+static lu_hash_batch_item_t* lu_hash_batch_partition(const lu_hash_table_t* table, const int* keys, size_t count, lu_hash_batch_item_t* buffer);
+static int  lu_hash_batch_item_compare(const void* a, const void* b);
+static int  lu_hash_batch_insert_run(lu_hash_table_t* table, lu_hash_bucket_t* bucket, lu_hash_batch_item_t* run, size_t count, void* const* values);
+static void lu_hash_batch_merge_tree(lu_hash_table_t* table, lu_hash_bucket_t* bucket, lu_hash_batch_item_t* run, size_t count, void* const* values);
+static size_t lu_hash_batch_delete_run(lu_hash_table_t* table, lu_hash_bucket_t* bucket, lu_hash_batch_item_t* run, size_t count);
+
+/**
+ * Header of a compaction block. Nodes follow from `LU_HASH_COMPACT_HEADER_BYTES`; the block is
+ * aligned to `LU_HASH_COMPACT_BLOCK_BYTES`, so masking the address of a node gives its block.
+ * A block of a table with its own allocator is carved out of an allocation twice that size.
+ */
+typedef struct lu_hash_compact_block_s {
+	volatile size_t		live;		// Nodes in the block, plus one while a table is filling it
+	void*				memory;		// Allocation the block was carved out of
+	lu_hash_free_func_t free;		// The table's free function, NULL for the aligned system allocator
+	void*				alloc_ctx;	// Context passed to free
+}lu_hash_compact_block_t;
+
+#define LU_HASH_COMPACT_HEADER_BYTES	64	// Nodes start on the cache line after the header
+
+/** Frees a list or tree node, whether it has its own allocation or lives in a compaction block */
+#define LU_HASH_NODE_FREE(node)		lu_hash_node_free((node), (node)->compacted)
+
+static void  lu_hash_node_free(void* node, unsigned int compacted);
+static lu_hash_compact_block_t* lu_hash_compact_block_alloc(const lu_hash_table_config_t* config);
+static void* lu_hash_compact_slot(lu_hash_table_t* table, size_t bytes);
+static void  lu_hash_compact_release(lu_hash_table_t* table);
+static void  lu_hash_compact_reserve(lu_hash_table_t* table, size_t bytes);
+static int   lu_hash_compact_list(lu_hash_table_t* table, lu_hash_bucket_t* bucket, size_t* moved);
+static int   lu_hash_compact_tree(lu_hash_table_t* table, lu_hash_bucket_t* bucket, size_t* moved);
+
+static void lu_hash_table_insert_entry(lu_hash_table_t* table, int key, void* value, unsigned int expire);
+static int  lu_hash_list_upsert(lu_hash_table_t* table, lu_hash_bucket_t* bucket, int key, void* value, unsigned int expire);
+static int  lu_hash_tree_upsert(lu_hash_table_t* table, lu_hash_bucket_t* bucket, int key, void* value, unsigned int expire, size_t* depth);
+static unsigned int lu_hash_table_now(const lu_hash_table_t* table);
+static unsigned long long lu_hash_default_clock(void);
+static void lu_hash_table_drop(lu_hash_table_t* table, int key, void* value);
+static void lu_hash_bucket_untreeify_small(const lu_hash_table_t* table, lu_hash_bucket_t* bucket);
+static int lu_hash_table_over_capacity(const lu_hash_table_t* table);
+static int lu_hash_table_evict_one(lu_hash_table_t* table);
+
+static size_t lu_hash_table_grown_size(const lu_hash_table_t* table, size_t table_size);
 static void lu_hash_table_resize(lu_hash_table_t* table);
+static void lu_hash_table_shrink(lu_hash_table_t* table);
+static void lu_hash_table_rehash(lu_hash_table_t* table, size_t new_table_size);
+static void lu_hash_table_adapt(lu_hash_table_t* table);
+static lu_hash_bucket_t* lu_hash_buckets_alloc(const lu_hash_table_config_t* config, size_t table_size);
+static void lu_hash_buckets_free(const lu_hash_table_config_t* config, lu_hash_bucket_t* buckets);
 
-static void lu_rb_tree_rehash(lu_rb_tree_t* tree, lu_rb_tree_node_t* node, lu_hash_bucket_t* new_buckets, int new_table_size, lu_rb_tree_node_t* nil);
+static void lu_rb_tree_rehash(lu_rb_tree_t* tree, lu_rb_tree_node_t* node, lu_hash_bucket_t* new_buckets, int new_table_size, lu_hash_func_t hash, unsigned long long seed, lu_rb_tree_node_t* nil);
 
 /**
- * @brief Computes a hash value for a given key using the multiplication method.
+ * @brief Computes a seeded hash value for a given key.
  *
- * This function implements a hash function based on the multiplication method,
- * using the fractional part of the product between the key and the constant
- * A (the reciprocal of the golden ratio). If the table size is a power of two,
- * the modulo operation is optimized using bitwise operations. Otherwise, a
- * standard modulo operation is applied.
+ * The key is combined with the per-table random seed and passed through the 64-bit finalizer of
+ * MurmurHash3, which avalanches every input bit into every output bit. Which keys share a bucket
+ * therefore depends on the secret seed rather than on the keys alone, so clients that cannot
+ * observe the seed cannot choose keys that all land in one bucket. If the table size is a power
+ * of two, the modulo operation is optimized using bitwise operations. Otherwise, a standard
+ * modulo operation is applied.
  *
+ * @param hash The hash function of the table, NULL for the built-in one.
  * @param key The integer key to be hashed.
+ * @param seed The seed of the table the key is hashed for.
  * @param table_size The size of the hash table (number of buckets).
  * @return The computed hash value, ranging from 0 to table_size - 1.
  */
-static int lu_hash_function(int key, size_t table_size)
+static int lu_hash_function(lu_hash_func_t hash, int key, unsigned long long seed, size_t table_size)
 {
-	static const double golden_rate_reciprocal = 0.6180339887; // Reciprocal of the golden ratio
+	return lu_hash_reduce(lu_hash_mix(hash, key, seed), table_size);
+}
 
-	double temp = key * golden_rate_reciprocal;
-	double fractional_part = temp - (int)temp; // Extract fractional part
-	int hash = (int)(table_size * fractional_part);
+/**
+ * @brief Mixes a key with the table seed into a 64-bit hash (MurmurHash3 64-bit finalizer).
+ *
+ * The low bits select the bucket, the high bits select the block of the membership filter.
+ * A table configured with its own hash function uses that one instead.
+ */
+static unsigned long long lu_hash_mix(lu_hash_func_t hash, int key, unsigned long long seed)
+{
+	if (hash == NULL) {
+		return lu_hash_seeded_mix((unsigned int)key, seed);
+	}
+	return hash(key, seed);
+}
 
+/**
+ * @brief Reduces a mixed hash to a bucket index.
+ */
+static int lu_hash_reduce(unsigned long long hash, size_t table_size)
+{
 	// Optimize modulo operation if table_size is a power of two
 	if ((table_size & (table_size - 1)) == 0) {
-		return hash & (table_size - 1); // Use bitwise AND for power-of-two table sizes
+		return (int)(hash & (table_size - 1)); // Use bitwise AND for power-of-two table sizes
 	}
 
 	// Fallback to standard modulo operation
-	return hash % table_size;
+	return (int)(hash % table_size);
+}
+
+/**
+ * @brief Produces a random 64-bit seed for a hash table.
+ *
+ * The first call reads the operating system entropy pool where it is available as a file and mixes
+ * in the current time, the processor clock and a few addresses (which vary with ASLR). Later calls
+ * reuse that process-wide entropy, so that creating a table or a snapshot never opens a file, and
+ * only add an atomic call counter and the monotonic clock before the SplitMix64 finalizer. The result
+ * is unpredictable to remote clients but is not meant to be a cryptographic key.
+ *
+ * @return A random seed.
+ */
+unsigned long long lu_hash_random_seed(void)
+{
+	static volatile long long entropy = 0;	// 0 until the entropy pool has been read
+	static volatile long long counter = 0;
+
+	unsigned long long base = (unsigned long long)lu_atomic_load_i64(&entropy);
+	if (base == 0) {
+		FILE* urandom = fopen("/dev/urandom", "rb");
+		if (urandom != NULL) {
+			if (fread(&base, sizeof(base), 1, urandom) != 1) {
+				base = 0;
+			}
+			fclose(urandom);
+		}
+		base ^= (unsigned long long)time(NULL);
+		base ^= (unsigned long long)clock() << 20;
+		base ^= (unsigned long long)(size_t)&base << 7;
+		base ^= (unsigned long long)(size_t)&lu_hash_random_seed << 13;
+		base |= 1;
+
+		// Threads racing through the first call all use whichever entropy was published first
+		if (!lu_atomic_cas_i64(&entropy, 0, (long long)base)) {
+			base = (unsigned long long)lu_atomic_load_i64(&entropy);
+		}
+	}
+
+	unsigned long long seed = base + (unsigned long long)(lu_atomic_fetch_add_i64(&counter, 1) + 1) * 0x9e3779b97f4a7c15ULL;
+	seed ^= lu_clock_ns() << 11;
+
+	// SplitMix64 finalizer
+	seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebULL;
+	return seed ^ (seed >> 31);
+}
+
+/**
+ * @brief Returns the share of buckets that random keys push above `treeify_threshold` entries at
+ * `load_factor`.
+ *
+ * With a random seed the length of a bucket follows a Poisson distribution whose mean is the load
+ * factor: about 1e-7 of the buckets overflow a threshold of 8 at the default load, 2% at a load of 4.
+ */
+static double lu_hash_treeify_share(double load_factor, size_t treeify_threshold)
+{
+	if (load_factor >= (double)treeify_threshold) {
+		return 1.0;
+	}
+
+	// Poisson terms up to a common factor: P(length > t) / P(length <= t) needs no exp()
+	double term = 1.0;
+	double below = 1.0;
+	size_t k = 1;
+	for (; k <= treeify_threshold; k++) {
+		term *= load_factor / k;
+		below += term;
+	}
+	double above = 0.0;
+	for (; term > below * 1e-12; k++) {
+		term *= load_factor / k;
+		above += term;
+	}
+	return above / (below + above);
+}
+
+/**
+ * @brief Returns how many list-to-tree conversions a table may see between two resizes before it
+ * treats its keys as colliding on purpose.
+ *
+ * About `table_size * lu_hash_treeify_share(load_factor, treeify_threshold)` buckets convert
+ * naturally by the time the table reaches `load_factor`: none at the default load, thousands in a
+ * large table run at a load of 4. The limit allows twice that many, plus
+ * `LU_HASH_RESEED_TREEIFY_THRESHOLD`.
+ *
+ * @param table_size The number of buckets.
+ * @param load_factor The load factor the table grows at.
+ * @param treeify_threshold The list length above which a bucket is converted to a tree.
+ * @return The number of conversions above which the table reseeds.
+ */
+size_t lu_hash_reseed_treeify_limit(size_t table_size, double load_factor, size_t treeify_threshold)
+{
+	double expected = (double)table_size * lu_hash_treeify_share(load_factor, treeify_threshold);
+	return LU_HASH_RESEED_TREEIFY_THRESHOLD + (size_t)(2.0 * expected);
+}
+
+/**
+ * @brief Returns whether an insert into a table without tree buckets found a chain long enough to
+ * treat its keys as colliding on purpose.
+ *
+ * Such tables keep their load at or below `LU_HASH_TABLE_MAX_LOAD_FACTOR`, where a random seed
+ * puts `LU_HASH_RESEED_CHAIN_LENGTH` entries into one bucket with a probability far below one in
+ * 2^64 per bucket. The caller rehashes under a new seed when this returns nonzero.
+ *
+ * @param chain_length The number of entries the insert found in its bucket.
+ * @return Nonzero if the table should reseed.
+ */
+int lu_hash_reseed_chain_suspect(size_t chain_length)
+{
+	return chain_length >= LU_HASH_RESEED_CHAIN_LENGTH;
+}
+
+/**
+ * @brief Returns whether more buckets have converted to trees since the last resize than random
+ * keys explain at the configured load factor and treeify threshold.
+ */
+static int lu_hash_table_treeify_suspect(const lu_hash_table_t* table)
+{
+	return table->treeify_count > lu_hash_reseed_treeify_limit(table->table_size, table->config.max_load_factor, table->config.treeify_threshold);
+}
+
+/**
+ * @brief Returns whether the buckets of a table still show a collision pattern, checked right
+ * after a reseed.
+ *
+ * A red-black tree of n nodes is at most 2 * log2(n + 1) levels deep, so an insert can only
+ * descend past `LU_HASH_RESEED_TREE_HEIGHT` levels in a bucket of at least
+ * 2^(LU_HASH_RESEED_TREE_HEIGHT / 2) entries. Under a fresh seed, random keys fill no such bucket
+ * and convert no more buckets than lu_hash_reseed_treeify_limit allows.
+ */
+static int lu_hash_table_collisions_remain(const lu_hash_table_t* table)
+{
+	if (lu_hash_table_treeify_suspect(table)) {
+		return 1;
+	}
+	size_t deep_bucket = (size_t)1 << (LU_HASH_RESEED_TREE_HEIGHT / 2);
+	for (size_t i = 0; i < table->table_size; i++) {
+		if (table->buckets[i].esize_bucket >= deep_bucket) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Returns whether a configured hash function gives the same result under any seed.
+ *
+ * Such a hash leaves the bucket of every key unchanged across a reseed, so reseeding a table built
+ * on it only costs a full rehash. A few keys are hashed under two seeds; a hash that mixes in the
+ * seed changes at least one of them.
+ */
+static int lu_hash_func_ignores_seed(lu_hash_func_t hash)
+{
+	static const int probe_keys[] = { 0, 1, -1, 0x5bd1e995 };
+	for (size_t i = 0; i < sizeof(probe_keys) / sizeof(probe_keys[0]); i++) {
+		if (hash(probe_keys[i], 0) != hash(probe_keys[i], 0x9e3779b97f4a7c15ULL)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief Reseeds a table whose buckets look attacked, unless reseeding has stopped helping.
+ *
+ * Keys that collide under every seed trip the collision checks again right after a reseed, and
+ * each reseed rehashes the whole table. So when the buckets still look attacked after a reseed,
+ * automatic reseeds are held off until the element count has doubled. A table of n such keys
+ * reseeds O(log n) times instead of on nearly every insert.
+ *
+ * @param table A pointer to the hash table.
+ * @return 1 if the table was reseeded, 0 if reseeding is on hold.
+ */
+static int lu_hash_table_auto_reseed(lu_hash_table_t* table)
+{
+	if (table->element_count < table->reseed_hold) {
+		return 0;
+	}
+	lu_hash_table_reseed(table);
+	table->reseed_hold = lu_hash_table_collisions_remain(table) ? table->element_count * 2 : 0;
+	return 1;
 }
 
 /**
@@ -116,21 +462,211 @@ static lu_rb_tree_node_t* lu_rb_tree_successor(lu_rb_tree_t* tree, lu_rb_tree_no
  */
 lu_hash_table_t* lu_hash_table_init(size_t table_size)
 {
+	return lu_hash_table_init_with_config(table_size, NULL);
+}
+
+/**
+ * @brief Fills a configuration with the settings lu_hash_table_init uses.
+ *
+ * The load factor and tree threshold come from `LU_HASH_TABLE_MAX_LOAD_FACTOR` and
+ * `LU_HASH_BUCKET_LIST_THRESHOLD`; tables never shrink, tree buckets stay trees and the load
+ * factor is fixed.
+ *
+ * @param config The configuration to fill.
+ */
+void lu_hash_table_config_default(lu_hash_table_config_t* config)
+{
+	config->max_load_factor = LU_HASH_TABLE_MAX_LOAD_FACTOR;
+	config->min_load_factor = 0;
+	config->growth_factor = LU_HASH_TABLE_GROWTH_FACTOR;
+	config->treeify_threshold = LU_HASH_BUCKET_LIST_THRESHOLD;
+	config->untreeify_threshold = 0;
+	config->adaptive_chain_length = 0;
+	config->alloc = NULL;
+	config->free = NULL;
+	config->alloc_ctx = NULL;
+	config->hash = NULL;
+}
+
+/**
+ * Initializes a hash table with its own load factors, tree thresholds, allocator and hash.
+ *
+ * Different tables of one process can sit at different points of the memory/latency trade-off:
+ * a cache that must answer fast keeps a low load factor, a large index that must stay small a
+ * high one. Start from lu_hash_table_config_default and change what differs.
+ *
+ * With `adaptive_chain_length` set, the table watches the average number of entries in the
+ * buckets its lookups probe and moves `max_load_factor` towards the point where that average
+ * meets the target (see `LU_HASH_ADAPT_WINDOW`). A resize the new load factor calls for happens at
+ * the next insert.
+ *
+ * The allocator only serves the bucket array, the largest single allocation of a table; nodes
+ * are allocated with LU_MM_MALLOC because bulk operations and snapshots move them between tables.
+ *
+ * @param table_size The number of buckets in the hash table. If 0, default size is used.
+ * @param config The settings of the table, NULL for the defaults.
+ * @return A pointer to the new table, or NULL with LU_ERROR_INVALID_ARGUMENT if the settings are
+ *         inconsistent (a load factor or growth factor out of range, `min_load_factor` so close to
+ *         `max_load_factor` that a resize would undo itself, or `untreeify_threshold` not below
+ *         `treeify_threshold`). Exits the program if memory allocation fails.
+ *
+ * Usage example:
+ *     lu_hash_table_config_t config;
+ *     lu_hash_table_config_default(&config);
+ *     config.max_load_factor = 0.5;
+ *     config.min_load_factor = 0.1;
+ *     lu_hash_table_t* table = lu_hash_table_init_with_config(0, &config);
+ */
+lu_hash_table_t* lu_hash_table_init_with_config(size_t table_size, const lu_hash_table_config_t* config)
+{
+	lu_hash_table_config_t defaults;
+	if (config == NULL) {
+		lu_hash_table_config_default(&defaults);
+		config = &defaults;
+	}
+	if (!(config->max_load_factor > 0) || !(config->growth_factor > 1) || !(config->min_load_factor >= 0)
+		|| config->min_load_factor * config->growth_factor >= config->max_load_factor
+		|| config->treeify_threshold == 0 || config->untreeify_threshold >= config->treeify_threshold
+		|| !(config->adaptive_chain_length >= 0) || (config->alloc == NULL) != (config->free == NULL)) {
+		lu_hash_erron_global_ = LU_ERROR_INVALID_ARGUMENT;
+		return NULL;
+	}
+
 	if (table_size <= 0) {
 		table_size = LU_HASH_TABLE_DEFAULT_SIZE;
 	}
 	lu_hash_table_t* table = (lu_hash_table_t*)LU_MM_MALLOC(sizeof(lu_hash_table_t));
+	table->config = *config;
+	table->initial_size = table_size;
+	table->adapt_lookups = 0;
+	table->adapt_chain = 0;
 	table->element_count = 0;
-	table->buckets = (lu_hash_bucket_t*)LU_MM_CALLOC(table_size, sizeof(lu_hash_bucket_t));
+	table->seed = lu_hash_random_seed();
+	table->treeify_count = 0;
+	table->reseed_count = 0;
+	// A new seed cannot move the keys of a hash that ignores it: never reseed automatically
+	table->reseed_hold = config->hash != NULL && lu_hash_func_ignores_seed(config->hash) ? SIZE_MAX : 0;
+	table->clock = lu_hash_default_clock;
+	table->clock_base = table->clock();
+	table->ttl_in_use = 0;
+	table->expire_cursor = 0;
+	table->expired_count = 0;
+	table->max_entries = 0;
+	table->max_bytes = 0;
+	table->value_bytes = 0;
+	table->value_size = NULL;
+	table->on_evict = NULL;
+	table->evict_ctx = NULL;
+	table->on_write = NULL;
+	table->write_ctx = NULL;
+	table->clock_hand = 0;
+	table->evicted_count = 0;
+	table->filter = NULL;
+	table->filter_memory = NULL;
+	table->filter_blocks = 0;
+	table->filter_bits_per_key = 0;
+	table->filter_removed = 0;
+	table->filter_negatives = 0;
+	table->filter_false_positives = 0;
+	table->filter_expired = 0;
+	table->snapshot = NULL;
+	table->compact_block = NULL;
+	table->compact_used = 0;
+	table->compact_cursor = 0;
+	table->destroy_cursor = 0;
+	table->buckets = lu_hash_buckets_alloc(&table->config, table_size);
 	table->table_size = table_size;
 
+	return table;
+}
+
+/**
+ * @brief Allocates a bucket array with the allocator of a table, every bucket an empty list.
+ */
+static lu_hash_bucket_t* lu_hash_buckets_alloc(const lu_hash_table_config_t* config, size_t table_size)
+{
+	lu_hash_bucket_t* buckets;
+	if (config->alloc != NULL) {
+		buckets = (lu_hash_bucket_t*)config->alloc(table_size * sizeof(lu_hash_bucket_t), config->alloc_ctx);
+		if (buckets == NULL) {
+#ifdef LU_HASH_DEBUG
+			printf("Memory allocation failed!\n");
+#endif
+			lu_hash_erron_global_ = LU_ERROR_OUT_OF_MEMORY;
+			exit(LU_ERROR_OUT_OF_MEMORY);
+		}
+	}
+	else {
+		buckets = (lu_hash_bucket_t*)LU_MM_MALLOC(table_size * sizeof(lu_hash_bucket_t));
+	}
+
 	for (size_t i = 0; i < table_size; i++) {
-		table->buckets[i].type = LU_HASH_BUCKET_LIST;
-		table->buckets[i].data.list_head = NULL;
-		table->buckets[i].esize_bucket = 0;
+		buckets[i].type = LU_HASH_BUCKET_LIST;
+		buckets[i].data.list_head = NULL;
+		buckets[i].esize_bucket = 0;
 	}
+	return buckets;
+}
 
-	return table;
+/**
+ * @brief Releases a bucket array allocated by lu_hash_buckets_alloc.
+ */
+static void lu_hash_buckets_free(const lu_hash_table_config_t* config, lu_hash_bucket_t* buckets)
+{
+	if (config->free != NULL) {
+		if (buckets != NULL) {
+			config->free(buckets, config->alloc_ctx);
+		}
+	}
+	else {
+		LU_MM_FREE(buckets);
+	}
+}
+
+/**
+ * @brief Reads the table clock relative to the creation of the table.
+ *
+ * The result starts at 1, so that an expiry time computed from it is never 0, which marks
+ * entries without a TTL.
+ *
+ * @param table A pointer to the hash table.
+ * @return The current time in seconds on the table clock.
+ */
+static unsigned int lu_hash_table_now(const lu_hash_table_t* table)
+{
+	return (unsigned int)(table->clock() - table->clock_base) + 1;
+}
+
+/**
+ * @brief Default clock for entry expiry, based on time(NULL).
+ */
+static unsigned long long lu_hash_default_clock(void)
+{
+	return (unsigned long long)time(NULL);
+}
+
+/**
+ * @brief Checks whether an entry with the given expiry time has expired.
+ */
+static inline int lu_hash_expired(unsigned int expire, unsigned int now)
+{
+	return expire != 0 && expire <= now;
+}
+
+/**
+ * Replaces the clock used for entry expiry.
+ *
+ * Useful for callers that already keep a cached "now" (for example an event loop), or that need
+ * a controllable clock. Expiry times already stored are measured from the old clock, so the
+ * clock should be set before entries with a TTL are inserted.
+ *
+ * @param table A pointer to the hash table.
+ * @param clock The new clock, returning seconds. If NULL, the default clock is restored.
+ */
+void lu_hash_table_set_clock(lu_hash_table_t* table, lu_hash_clock_func_t clock)
+{
+	table->clock = clock ? clock : lu_hash_default_clock;
+	table->clock_base = table->clock();
 }
 
 /**
@@ -140,6 +676,7 @@ lu_hash_table_t* lu_hash_table_init(size_t table_size)
  * the key-value pair into the corresponding bucket. If the bucket is implemented
  * as a linked list, it checks for existing keys and updates their values if found;
  * otherwise, it creates a new node and inserts it at the head of the list.
+ * An entry inserted this way never expires; updating a key clears any TTL it had.
  *
  * @param table A pointer to the hash table.
  * @param key   The key to be inserted or updated in the hash table.
@@ -150,163 +687,2399 @@ lu_hash_table_t* lu_hash_table_init(size_t table_size)
  */
 void lu_hash_table_insert(lu_hash_table_t* table, int key, void* value)
 {
+	LU_HASH_TRACE_BEGIN();
+	lu_hash_table_insert_entry(table, key, value, 0);
+	LU_HASH_TRACE_END(LU_HASH_TRACE_INSERT, table, key, lu_hash_function(table->config.hash, key, table->seed, table->table_size));
+}
+
+/**
+ * Inserts a key-value pair that expires after the given number of seconds.
+ *
+ * Expired entries are invisible to lu_hash_table_find, which removes them lazily when it meets
+ * them. lu_hash_table_expire removes the ones that are never looked up again. Expiry has a
+ * resolution of one second on the table clock.
+ *
+ * @param table A pointer to the hash table.
+ * @param key   The key to be inserted or updated in the hash table.
+ * @param value A pointer to the value associated with the key.
+ * @param ttl_seconds Lifetime of the entry in seconds. 0 means the entry never expires.
+ *
+ * Usage:
+ *     lu_hash_table_insert_ttl(cache, 42, value_ptr, 30); // Gone 30 seconds from now
+ */
+void lu_hash_table_insert_ttl(lu_hash_table_t* table, int key, void* value, unsigned int ttl_seconds)
+{
+	unsigned int expire = 0;
+	if (ttl_seconds != 0) {
+		unsigned int now = lu_hash_table_now(table);
+		expire = ttl_seconds > LU_HASH_EXPIRE_MAX - now ? LU_HASH_EXPIRE_MAX : now + ttl_seconds;
+		table->ttl_in_use = 1;
+	}
+	LU_HASH_TRACE_BEGIN();
+	lu_hash_table_insert_entry(table, key, value, expire);
+	LU_HASH_TRACE_END(LU_HASH_TRACE_INSERT, table, key, lu_hash_function(table->config.hash, key, table->seed, table->table_size));
+}
+
+/**
+ * @brief Inserts or updates an entry with an absolute expiry time (0 for none).
+ *
+ * @param table A pointer to the hash table.
+ * @param key   The key to be inserted or updated in the hash table.
+ * @param value A pointer to the value associated with the key.
+ * @param expire Expiry time on the table clock, 0 if the entry never expires.
+ */
+static void lu_hash_table_insert_entry(lu_hash_table_t* table, int key, void* value, unsigned int expire)
+{
+	lu_hash_table_notify_write(table, LU_HASH_WRITE_INSERT, key, value, expire);
+
 	// Check if we need to resize the hash table
-	if ((double)table->element_count / table->table_size > LU_HASH_TABLE_MAX_LOAD_FACTOR) {
+	if (table->adapt_lookups >= LU_HASH_ADAPT_WINDOW) {
+		lu_hash_table_adapt(table);
+	}
+	if ((double)table->element_count / table->table_size > table->config.max_load_factor) {
 		lu_hash_table_resize(table);
 	}
-	int index = lu_hash_function(key, table->table_size);
+	unsigned long long hash = lu_hash_mix(table->config.hash, key, table->seed);
+	int index = lu_hash_reduce(hash, table->table_size);
+
+	// Updates are added too, so a key is never missing from the filter while it is stored
+	if (table->filter) {
+		lu_hash_filter_add(table, hash);
+	}
+
+	// Keep the pre-write contents of the bucket for an active snapshot
+	lu_hash_cow_preserve(table, index);
 
 	lu_hash_bucket_t* bucket = &table->buckets[index];
 	if (LU_HASH_BUCKET_LIST == bucket->type) {
-		lu_hash_bucket_node_ptr_t new_node = (lu_hash_bucket_node_ptr_t)LU_MM_MALLOC(sizeof(lu_hash_bucket_node_t));
-		if (!new_node) {
+		if (lu_hash_list_upsert(table, bucket, key, value, expire)) {
+			table->element_count++;
+		}
+
+		// Check if the bucket's linked list length exceeds the threshold
+		if (bucket->esize_bucket > table->config.treeify_threshold) {
+#ifdef LU_HASH_DEBUG
+			printf("Bucket[%d] size exceeded threshold. Converting to red-black tree...\n", index);
+#endif // LU_HASH_DEBUG
+			//Convert the internal structure of bucket from list to rb_tree
+			LU_HASH_TRACE_BEGIN();
+			if (lu_convert_bucket_to_rbtree(bucket) != 1) {
+#ifdef LU_HASH_DEBUG
+				printf("Error: Bucket[%d] failed to convert bucket to red-black tree.\n", index);
+#endif // LU_HASH_DEBUG
+			}
+			LU_HASH_TRACE_END_STEPS(LU_HASH_TRACE_TREEIFY, table, key, index, bucket->esize_bucket);
+
+			// With a random seed only a predictable share of buckets overflows, more indicate colliding keys
+			table->treeify_count++;
+			if (lu_hash_table_treeify_suspect(table)) {
+				lu_hash_table_auto_reseed(table);
+			}
+		}
+	}
+	else if (LU_HASH_BUCKET_RBTREE == bucket->type) {
+		/**Insert into the red-black tree*/
+
+		//Check the rb_tree and nil
+		if (NULL == bucket->data.rb_tree || NULL == bucket->data.rb_tree->nil) {
 #ifdef LU_HASH_DEBUG
-			printf("Memory allocation  failed for new code\n");
+			printf("Inserting key %d into red-black tree \n", key);
+			printf("Error: RB-tree or tree->nil is not initialized\n");
 #endif // LU_HASH_DEBUG
+			lu_hash_erron_global_ = LU_ERROR_TREE_OR_NIL_NOT_INIT;
 			return;
 		}
 
-		// Check if the key already exists and update the value
-		lu_hash_bucket_node_t* current = bucket->data.list_head;
-		while (current) {
-			if (current->key == key) {
-				current->value = value; // Update value if key exists
-				return;
-			}
-			current = current->next;
+		// Only count the key if it was not already present in the tree
+		size_t depth = 0;
+		if (lu_hash_tree_upsert(table, bucket, key, value, expire, &depth)) {
+			table->element_count++;
 		}
 
-		// Assign the value to the new node
-		new_node->value = value;
+		// A tree this deep means far more keys share the bucket than chance allows
+		if (depth > LU_HASH_RESEED_TREE_HEIGHT) {
+			lu_hash_table_auto_reseed(table);
+		}
+	}
 
-		// Assign the key to the new nod
-		new_node->key = key;
+	// Make room in a bounded table
+	while (lu_hash_table_over_capacity(table) && lu_hash_table_evict_one(table)) {
+	}
+}
 
-		// Link the new node to the existing linked list
-		new_node->next = bucket->data.list_head;
+/**
+ * @brief Updates the entry of a key in a list bucket, or adds one at the head of the list.
+ *
+ * Keeps the byte budget of the table up to date; the element count is left to the caller.
+ *
+ * @return 1 if a node was added, 0 if an existing entry was updated.
+ */
+static int lu_hash_list_upsert(lu_hash_table_t* table, lu_hash_bucket_t* bucket, int key, void* value, unsigned int expire)
+{
+	// Check if the key already exists and update the value
+	lu_hash_bucket_node_t* current = bucket->data.list_head;
+	while (current) {
+		LU_HASH_TRACE_STEP();
+		if (current->key == key) {
+			if (table->value_size) {
+				table->value_bytes += table->value_size(value) - table->value_size(current->value);
+			}
+			current->value = value; // Update value if key exists
+			current->expire = expire;
+			return 0;
+		}
+		current = current->next;
+	}
 
-		// Update the head of the linked list to the new node
-		bucket->data.list_head = new_node;
+	lu_hash_bucket_node_ptr_t new_node = (lu_hash_bucket_node_ptr_t)LU_MM_MALLOC(sizeof(lu_hash_bucket_node_t));
+	new_node->value = value;
+	new_node->key = key;
+	new_node->expire = expire;
+	new_node->referenced = 0;
+	new_node->compacted = 0;
+
+	// Link the new node at the head of the list
+	new_node->next = bucket->data.list_head;
+	bucket->data.list_head = new_node;
+	bucket->esize_bucket++;
+	if (table->value_size) {
+		table->value_bytes += table->value_size(value);
+	}
+	return 1;
+}
 
-		// Increment the global element count and local bucket size
-		//table->element_count++;
-		//bucket->esize_bucket++;
-		//increase teh element_count
-		table->element_count++;
+/**
+ * @brief Updates the entry of a key in a tree bucket, or adds one.
+ *
+ * Keeps the byte budget of the table up to date; the element count is left to the caller.
+ *
+ * @param depth Receives the number of levels descended.
+ * @return 1 if a node was added, 0 if an existing entry was updated.
+ */
+static int lu_hash_tree_upsert(lu_hash_table_t* table, lu_hash_bucket_t* bucket, int key, void* value, unsigned int expire, size_t* depth)
+{
+	if (table->value_size) {
+		lu_rb_tree_node_t* old = lu_hash_rb_tree_find(bucket->data.rb_tree, key);
+		if (old != NULL) {
+			table->value_bytes -= table->value_size(old->value);
+		}
+		table->value_bytes += table->value_size(value);
+	}
+	if (lu_rb_tree_insert(bucket->data.rb_tree, key, value, expire, depth) == 1) {
 		bucket->esize_bucket++;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Searches for a key in a hash table and returns the corresponding value or node.
+ *
+ * This function finds the appropriate bucket in the hash table by using the hash function
+ * on the given key. It then determines the type of the bucket (linked list or red-black tree)
+ * and delegates the search to the corresponding bucket-specific find function. If the key
+ * is found, the associated value or node is returned; otherwise, the function returns NULL.
+ *
+ * @param table A pointer to the hash table where the key will be searched.
+ * @param key The key to search for in the hash table.
+ * @return A pointer to the value or node associated with the key if found, or NULL if the key does not exist.
+ */
+void* lu_hash_table_find(lu_hash_table_t* table, int key)
+{
+	LU_HASH_TRACE_BEGIN();
+	unsigned long long hash = lu_hash_mix(table->config.hash, key, table->seed);
+
+	// A definite miss of the filter never touches the bucket array
+	if (table->filter && !lu_hash_filter_may_contain(table, hash)) {
+		table->filter_negatives++;
+		LU_HASH_TRACE_END(LU_HASH_TRACE_FIND, table, key, lu_hash_reduce(hash, table->table_size));
+		return NULL;
+	}
+
+	// Calculate the index of the bucket in the hash table using the hash function
+	int index = lu_hash_reduce(hash, table->table_size);
+
+	// Retrieve the hash bucket at the calculated index
+	lu_hash_bucket_t* bucket = &table->buckets[index];
+
+	// Chain lengths the adaptive load factor is tuned by
+	if (table->config.adaptive_chain_length > 0) {
+		table->adapt_lookups++;
+		table->adapt_chain += bucket->esize_bucket;
+	}
+
+	// Check the bucket type and call the corresponding find function
+	int expired = 0;
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		// Use linked list search if the bucket stores data as a list
+		lu_hash_bucket_node_ptr_t node = lu_hash_list_find(bucket, key);
+		if (NULL != node) {
+			if (!table->ttl_in_use || !lu_hash_expired(node->expire, lu_hash_table_now(table))) {
+				// Only write the reference bit when it changes, hits on hot keys stay read-only
+				if (!node->referenced) {
+					node->referenced = 1;
+				}
+				LU_HASH_TRACE_END(LU_HASH_TRACE_FIND, table, key, index);
+				return	node->value;
+			}
+			// Lazy expiry: drop the stale entry now that we have found it
+			void* value = node->value;
+			lu_hash_cow_preserve(table, index);
+			lu_hash_list_delete(bucket, key);
+			table->element_count--;
+			table->expired_count++;
+			lu_hash_table_drop(table, key, value);
+			expired = 1;
+		}
+	}
+	else if (bucket->type == LU_HASH_BUCKET_RBTREE) {
+		// Use red-black tree search if the bucket stores data as a tree
+		lu_rb_tree_node_t* rb_node = lu_hash_rb_tree_find(bucket->data.rb_tree, key);
+		if (NULL != rb_node) {
+			if (!table->ttl_in_use || !lu_hash_expired(rb_node->expire, lu_hash_table_now(table))) {
+				if (!rb_node->referenced) {
+					rb_node->referenced = 1;
+				}
+				LU_HASH_TRACE_END(LU_HASH_TRACE_FIND, table, key, index);
+				return rb_node->value;
+			}
+			void* value = rb_node->value;
+			lu_hash_cow_preserve(table, index);
+			lu_hash_rb_tree_delete(bucket, key);
+			lu_hash_bucket_untreeify_small(table, bucket);
+			table->element_count--;
+			table->expired_count++;
+			lu_hash_table_drop(table, key, value);
+			expired = 1;
+		}
+	}
+#ifdef LU_HASH_DEBUG
+	printf("Key not found in hash table\n");
+#endif // LU_HASH_DEBUG
+
+	// The filter was right to pass a key that was stored until it expired just now
+	if (table->filter) {
+		if (expired) {
+			table->filter_expired++;
+		}
+		else {
+			table->filter_false_positives++;
+		}
+	}
+
+	LU_HASH_TRACE_END(LU_HASH_TRACE_FIND, table, key, index);
+
+	// Return NULL if no matching key is found
+	return NULL;
+}
+
+/**
+ * @brief Deletes a key from the hash table.
+ *
+ * This function locates the appropriate bucket in the hash table using the hash function,
+ * identifies the type of the bucket (linked list or red-black tree), and delegates the
+ * deletion operation to the corresponding bucket-specific delete function. After the deletion,
+ * the element count in the hash table is decremented.
+ *
+ * @param table A pointer to the hash table from which the key will be deleted.
+ * @param key The key to delete from the hash table.
+ * @return void
+ */
+void lu_hash_table_delete(lu_hash_table_t* table, int key)
+{
+	LU_HASH_TRACE_BEGIN();
+
+	// Calculate the index of the bucket in the hash table using the hash function
+	int index = lu_hash_function(table->config.hash, key, table->seed, table->table_size);
+
+	// Retrieve the hash bucket at the calculated index
+	lu_hash_bucket_t* bucket = &table->buckets[index];
+
+	// A bounded table with a byte budget has to know the size of the value it gives up
+	if (table->value_size) {
+		void* value = NULL;
+		if (LU_HASH_BUCKET_LIST == bucket->type) {
+			lu_hash_bucket_node_ptr_t node = lu_hash_list_find(bucket, key);
+			value = node ? node->value : NULL;
+		}
+		else if (LU_HASH_BUCKET_RBTREE == bucket->type) {
+			lu_rb_tree_node_t* node = lu_hash_rb_tree_find(bucket->data.rb_tree, key);
+			value = node ? node->value : NULL;
+		}
+		if (value != NULL) {
+			table->value_bytes -= table->value_size(value);
+		}
+	}
+
+	lu_hash_cow_preserve(table, index);
+
+	// Check the bucket type and call the corresponding delete function
+	int removed = 0;
+	if (LU_HASH_BUCKET_LIST == bucket->type) {
+		// Delete the key from the linked list bucket
+		removed = lu_hash_list_delete(bucket, key);
+	}
+	else if (LU_HASH_BUCKET_RBTREE == bucket->type) {
+		// Delete the key from the red-black tree bucket
+		removed = lu_hash_rb_tree_delete(bucket, key);
+	}
+
+	// Decrement the total element count in the hash table only if the key was present
+	if (removed) {
+		table->element_count--;
+		lu_hash_filter_note_removal(table);
+		lu_hash_table_notify_write(table, LU_HASH_WRITE_DELETE, key, NULL, 0);
+		lu_hash_bucket_untreeify_small(table, bucket);
+		if ((double)table->element_count / table->table_size < table->config.min_load_factor) {
+			lu_hash_table_shrink(table);
+		}
+	}
+
+#ifdef LU_HASH_DEBUG
+	// Debug output to confirm deletion
+	printf("Delete %d in bucket[%p]", key, &bucket);
+#endif // LU_HASH_DEBUG
+
+	LU_HASH_TRACE_END(LU_HASH_TRACE_DELETE, table, key, index);
+}
+
+/**
+ * Removes every entry for which a predicate returns nonzero, in a single pass over the buckets.
+ *
+ * Collecting the keys and calling lu_hash_table_delete on each hashes every key and walks its
+ * bucket again, and rebalances a tree once per key. Here list nodes are unlinked as the sweep
+ * passes them, a tree bucket that loses at least one in `LU_HASH_TREE_REBUILD_FRACTION` of its
+ * nodes is rebuilt from the survivors in one go, and the element count, filter and shrinking are
+ * updated once at the end.
+ *
+ * Entries whose TTL has run out are removed on the way, as lu_hash_table_expire would, without
+ * being passed to the predicate. The predicate must not modify the table.
+ *
+ * @param table A pointer to the hash table.
+ * @param pred Returns nonzero for the entries to remove.
+ * @param ctx Context pointer passed to `pred`.
+ * @return The number of entries the predicate removed.
+ *
+ * Usage example:
+ *     size_t closed = lu_hash_table_remove_if(sessions, session_is_closed, NULL);
+ */
+size_t lu_hash_table_remove_if(lu_hash_table_t* table, lu_hash_pred_func_t pred, void* ctx)
+{
+	lu_hash_sweep_t sweep;
+	sweep.pred = pred;
+	sweep.ctx = ctx;
+	sweep.now = table->ttl_in_use ? lu_hash_table_now(table) : 0;
+	sweep.removed = 0;
+	sweep.expired = 0;
+
+	for (size_t i = 0; i < table->table_size; i++) {
+		if (table->buckets[i].type == LU_HASH_BUCKET_LIST) {
+			lu_hash_sweep_list(table, &sweep, i);
+		}
+		else if (table->buckets[i].type == LU_HASH_BUCKET_RBTREE && table->buckets[i].data.rb_tree != NULL) {
+			lu_hash_sweep_tree(table, &sweep, i);
+		}
+	}
+
+	size_t removed = sweep.removed + sweep.expired;
+	if (removed == 0) {
+		return 0;
+	}
+	table->element_count -= removed;
+	table->expired_count += sweep.expired;
+
+	if (table->filter != NULL) {
+		table->filter_removed += removed;
+		if (table->filter_removed > table->element_count / 2 + LU_HASH_BUCKET_LIST_THRESHOLD) {
+			lu_hash_filter_build(table);
+		}
+	}
+	if ((double)table->element_count / table->table_size < table->config.min_load_factor) {
+		lu_hash_table_shrink(table);
+	}
+
+#ifdef LU_HASH_DEBUG
+	printf("Removed %zu entries and %zu expired ones\n", sweep.removed, sweep.expired);
+#endif // LU_HASH_DEBUG
+	return sweep.removed;
+}
+
+/**
+ * @brief Decides whether the sweep removes an entry and, if so, accounts for it and reports it.
+ *
+ * Expired entries are removed without asking the predicate and handed to the evict callback, as
+ * lu_hash_table_expire does. The element count and the filter are left to the end of the sweep.
+ */
+static int lu_hash_sweep_match(lu_hash_table_t* table, lu_hash_sweep_t* sweep, int key, void* value, unsigned int expire)
+{
+	int expired = lu_hash_expired(expire, sweep->now);
+	if (!expired && !sweep->pred(key, value, sweep->ctx)) {
+		return 0;
+	}
+
+	if (table->value_size) {
+		table->value_bytes -= table->value_size(value);
+	}
+	if (expired) {
+		sweep->expired++;
+		if (table->on_evict) {
+			table->on_evict(key, value, table->evict_ctx);
+		}
+	}
+	else {
+		sweep->removed++;
+	}
+	lu_hash_table_notify_write(table, LU_HASH_WRITE_DELETE, key, NULL, 0);
+	return 1;
+}
+
+/**
+ * @brief Unlinks the matching nodes of list bucket `index` in place.
+ */
+static void lu_hash_sweep_list(lu_hash_table_t* table, lu_hash_sweep_t* sweep, size_t index)
+{
+	lu_hash_bucket_t* bucket = &table->buckets[index];
+	lu_hash_bucket_node_ptr_t* link = &bucket->data.list_head;
+	while (*link != NULL) {
+		lu_hash_bucket_node_ptr_t node = *link;
+		if (!lu_hash_sweep_match(table, sweep, node->key, node->value, node->expire)) {
+			link = &node->next;
+			continue;
+		}
+		lu_hash_cow_preserve(table, index);
+		*link = node->next;
+		bucket->esize_bucket--;
+		LU_HASH_NODE_FREE(node);
+	}
+}
+
+/**
+ * @brief Removes the matching nodes of tree bucket `index`.
+ *
+ * The nodes are sorted into survivors and victims during one in-order walk. A few victims are
+ * deleted one at a time; past `LU_HASH_TREE_REBUILD_FRACTION` of the bucket, the survivors are
+ * relinked into a new balanced tree instead, which costs one pass and no rebalancing. A tree left
+ * with `untreeify_threshold` entries or fewer becomes a list, as after lu_hash_table_delete.
+ */
+static void lu_hash_sweep_tree(lu_hash_table_t* table, lu_hash_sweep_t* sweep, size_t index)
+{
+	lu_hash_bucket_t* bucket = &table->buckets[index];
+	lu_rb_tree_t* tree = bucket->data.rb_tree;
+	if (tree->root == tree->nil) {
+		return;
+	}
+
+	// Survivors fill the array from the front in key order, victims from the back
+	size_t size = bucket->esize_bucket;
+	lu_rb_tree_node_t** nodes = (lu_rb_tree_node_t**)LU_MM_MALLOC(size * sizeof(lu_rb_tree_node_t*));
+	size_t kept = 0;
+	size_t dropped = 0;
+	for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+		if (lu_hash_sweep_match(table, sweep, node->key, node->value, node->expire)) {
+			nodes[size - 1 - dropped++] = node;
+		}
+		else {
+			nodes[kept++] = node;
+		}
+	}
+
+	if (dropped != 0) {
+		lu_hash_cow_preserve(table, index);
+		if (dropped * LU_HASH_TREE_REBUILD_FRACTION < size) {
+			for (size_t k = kept; k < size; k++) {
+				lu_hash_rb_tree_delete(bucket, nodes[k]->key);
+			}
+		}
+		else {
+			for (size_t k = kept; k < size; k++) {
+				LU_HASH_NODE_FREE(nodes[k]);
+			}
+			lu_hash_tree_rebuild(bucket, nodes, kept);
+		}
+		if (bucket->esize_bucket <= table->config.untreeify_threshold) {
+			lu_convert_bucket_to_list(bucket);
+		}
+	}
+	LU_MM_FREE(nodes);
+}
+
+/**
+ * @brief Links `count` nodes sorted by key into a balanced red-black subtree and returns its root.
+ *
+ * Each subtree takes the middle node as its root, so every level above the deepest one is
+ * complete; coloring the nodes at `red_depth`, the deepest level when it is not full, red and all
+ * others black gives every path the same number of black nodes.
+ */
+static lu_rb_tree_node_t* lu_rb_tree_build(lu_rb_tree_t* tree, lu_rb_tree_node_t** nodes, size_t count, size_t depth, size_t red_depth, lu_rb_tree_node_t* parent)
+{
+	if (count == 0) {
+		return tree->nil;
+	}
+	size_t middle = count / 2;
+	lu_rb_tree_node_t* node = nodes[middle];
+	node->parent = parent;
+	node->color = depth == red_depth ? RED : BLACK;
+	node->left = lu_rb_tree_build(tree, nodes, middle, depth + 1, red_depth, node);
+	node->right = lu_rb_tree_build(tree, nodes + middle + 1, count - middle - 1, depth + 1, red_depth, node);
+	return node;
+}
+
+/**
+ * @brief Replaces the tree of a tree bucket with a balanced one made of `count` nodes sorted by key.
+ */
+static void lu_hash_tree_rebuild(lu_hash_bucket_t* bucket, lu_rb_tree_node_t** nodes, size_t count)
+{
+	lu_rb_tree_t* tree = bucket->data.rb_tree;
+
+	// Levels above the last are complete, so the nodes of the last one are colored red
+	size_t red_depth = 0;
+	while (((size_t)2 << red_depth) <= count + 1) {
+		red_depth++;
+	}
+	tree->root = lu_rb_tree_build(tree, nodes, count, 0, red_depth, tree->nil);
+	bucket->esize_bucket = count;
+}
+
+/**
+ * @brief qsort comparison of two tree node pointers by key.
+ */
+static int lu_rb_tree_node_compare(const void* a, const void* b)
+{
+	int left = (*(lu_rb_tree_node_t* const*)a)->key;
+	int right = (*(lu_rb_tree_node_t* const*)b)->key;
+	return (left > right) - (left < right);
+}
+
+/**
+ * Inserts or updates many key-value pairs at once.
+ *
+ * Inserting the pairs one by one may resize the table several times on the way, and visits the
+ * buckets in random order, so that every key takes cache misses on its bucket and nodes. Here the
+ * table grows once, to the size it needs if every key is new, and the batch is radix-sorted by
+ * bucket index so that the keys of a bucket are applied together while the bucket is hot. A list
+ * bucket that outgrows `treeify_threshold` is converted once; a tree bucket that receives at
+ * least one key per `LU_HASH_TREE_REBUILD_FRACTION` of its nodes merges them in key order and is
+ * rebuilt in one pass, without per-key rebalancing. Eviction and reseeding are left to the end.
+ *
+ * The result is the same as calling lu_hash_table_insert for each pair in order: a key that occurs
+ * more than once ends up with its last value. The entries never expire. The write callback is
+ * called for every pair, grouped by bucket; pairs with the same key keep their order.
+ *
+ * @param table A pointer to the hash table.
+ * @param keys The keys to insert.
+ * @param values The value of each key.
+ * @param count The number of pairs.
+ *
+ * Usage example:
+ *     lu_hash_table_insert_batch(table, keys, values, 1000);
+ */
+void lu_hash_table_insert_batch(lu_hash_table_t* table, const int* keys, void* const* values, size_t count)
+{
+	if (count == 0) {
+		return;
+	}
+	if (table->adapt_lookups >= LU_HASH_ADAPT_WINDOW) {
+		lu_hash_table_adapt(table);
+	}
+
+	// Reserve room for the whole batch with a single rehash
+	size_t new_table_size = table->table_size;
+	while ((double)(table->element_count + count) / new_table_size > table->config.max_load_factor) {
+		new_table_size = lu_hash_table_grown_size(table, new_table_size);
+	}
+	if (new_table_size != table->table_size) {
+		lu_hash_table_rehash(table, new_table_size);
+	}
+
+	lu_hash_batch_item_t* buffer = (lu_hash_batch_item_t*)LU_MM_MALLOC(2 * count * sizeof(lu_hash_batch_item_t));
+	lu_hash_batch_item_t* items = lu_hash_batch_partition(table, keys, count, buffer);
+
+	int reseed = 0;
+	size_t start = 0;
+	while (start < count) {
+		size_t index = items[start].index;
+		size_t end = start + 1;
+		while (end < count && items[end].index == index) {
+			end++;
+		}
+
+		lu_hash_cow_preserve(table, index);
+		for (size_t k = start; k < end; k++) {
+			lu_hash_table_notify_write(table, LU_HASH_WRITE_INSERT, items[k].key, values[items[k].position], 0);
+			if (table->filter) {
+				lu_hash_filter_add(table, items[k].hash);
+			}
+		}
+		reseed |= lu_hash_batch_insert_run(table, &table->buckets[index], items + start, end - start, values);
+		start = end;
+	}
+	LU_MM_FREE(buffer);
+
+#ifdef LU_HASH_DEBUG
+	printf("Inserted a batch of %zu keys, %zu entries in %zu buckets\n", count, table->element_count, table->table_size);
+#endif // LU_HASH_DEBUG
+
+	// The same collision checks as lu_hash_table_insert, once for the whole batch
+	if (reseed || lu_hash_table_treeify_suspect(table)) {
+		lu_hash_table_auto_reseed(table);
+	}
+	while (lu_hash_table_over_capacity(table) && lu_hash_table_evict_one(table)) {
+	}
+}
+
+/**
+ * Deletes many keys at once.
+ *
+ * The batch is radix-sorted by bucket index like lu_hash_table_insert_batch, so each bucket is
+ * visited once. A tree bucket that loses at least one in `LU_HASH_TREE_REBUILD_FRACTION` of its
+ * nodes is rebuilt from the survivors, as in lu_hash_table_remove_if, and the element count,
+ * filter and shrinking are updated once at the end. Keys that are not present are skipped.
+ *
+ * @param table A pointer to the hash table.
+ * @param keys The keys to delete.
+ * @param count The number of keys.
+ * @return The number of entries removed.
+ *
+ * Usage example:
+ *     size_t removed = lu_hash_table_delete_batch(table, stale_keys, stale_count);
+ */
+size_t lu_hash_table_delete_batch(lu_hash_table_t* table, const int* keys, size_t count)
+{
+	if (count == 0 || table->element_count == 0) {
+		return 0;
+	}
+
+	lu_hash_batch_item_t* buffer = (lu_hash_batch_item_t*)LU_MM_MALLOC(2 * count * sizeof(lu_hash_batch_item_t));
+	lu_hash_batch_item_t* items = lu_hash_batch_partition(table, keys, count, buffer);
+
+	size_t removed = 0;
+	size_t start = 0;
+	while (start < count) {
+		size_t index = items[start].index;
+		size_t end = start + 1;
+		while (end < count && items[end].index == index) {
+			end++;
+		}
+
+		lu_hash_bucket_t* bucket = &table->buckets[index];
+		if (bucket->esize_bucket != 0) {
+			lu_hash_cow_preserve(table, index);
+			removed += lu_hash_batch_delete_run(table, bucket, items + start, end - start);
+			lu_hash_bucket_untreeify_small(table, bucket);
+		}
+		start = end;
+	}
+	LU_MM_FREE(buffer);
+
+	if (removed == 0) {
+		return 0;
+	}
+	table->element_count -= removed;
+	if (table->filter != NULL) {
+		table->filter_removed += removed;
+		if (table->filter_removed > table->element_count / 2 + LU_HASH_BUCKET_LIST_THRESHOLD) {
+			lu_hash_filter_build(table);
+		}
+	}
+	if ((double)table->element_count / table->table_size < table->config.min_load_factor) {
+		lu_hash_table_shrink(table);
+	}
+
+#ifdef LU_HASH_DEBUG
+	printf("Deleted %zu of a batch of %zu keys\n", removed, count);
+#endif // LU_HASH_DEBUG
+	return removed;
+}
+
+/**
+ * @brief Hashes a batch of keys and sorts them by bucket index.
+ *
+ * A least-significant-digit radix sort over the bits of the index, `LU_HASH_BATCH_RADIX_BITS` at
+ * a time, between the two halves of `buffer` (room for 2 * `count` items). The sort is stable,
+ * so the keys of a bucket stay in batch order.
+ *
+ * @return The half of `buffer` that holds the sorted items.
+ */
+static lu_hash_batch_item_t* lu_hash_batch_partition(const lu_hash_table_t* table, const int* keys, size_t count, lu_hash_batch_item_t* buffer)
+{
+	lu_hash_batch_item_t* items = buffer;
+	lu_hash_batch_item_t* scratch = buffer + count;
+	for (size_t i = 0; i < count; i++) {
+		items[i].hash = lu_hash_mix(table->config.hash, keys[i], table->seed);
+		items[i].index = (size_t)lu_hash_reduce(items[i].hash, table->table_size);
+		items[i].position = i;
+		items[i].key = keys[i];
+	}
+
+	size_t counts[(size_t)1 << LU_HASH_BATCH_RADIX_BITS];
+	const size_t mask = ((size_t)1 << LU_HASH_BATCH_RADIX_BITS) - 1;
+	for (size_t shift = 0; ((table->table_size - 1) >> shift) != 0; shift += LU_HASH_BATCH_RADIX_BITS) {
+		memset(counts, 0, sizeof(counts));
+		for (size_t i = 0; i < count; i++) {
+			counts[(items[i].index >> shift) & mask]++;
+		}
+		size_t offset = 0;
+		for (size_t d = 0; d <= mask; d++) {
+			size_t digit_count = counts[d];
+			counts[d] = offset;
+			offset += digit_count;
+		}
+		for (size_t i = 0; i < count; i++) {
+			scratch[counts[(items[i].index >> shift) & mask]++] = items[i];
+		}
+
+		lu_hash_batch_item_t* sorted = scratch;
+		scratch = items;
+		items = sorted;
+	}
+	return items;
+}
+
+/**
+ * @brief qsort comparison of two batch items by key, then by position in the batch.
+ */
+static int lu_hash_batch_item_compare(const void* a, const void* b)
+{
+	const lu_hash_batch_item_t* left = (const lu_hash_batch_item_t*)a;
+	const lu_hash_batch_item_t* right = (const lu_hash_batch_item_t*)b;
+	if (left->key != right->key) {
+		return left->key < right->key ? -1 : 1;
+	}
+	return (left->position > right->position) - (left->position < right->position);
+}
+
+/**
+ * @brief Applies the pairs of a batch that fall into one bucket.
+ *
+ * @return 1 if the bucket has grown deep enough to suggest colliding keys, 0 otherwise.
+ */
+static int lu_hash_batch_insert_run(lu_hash_table_t* table, lu_hash_bucket_t* bucket, lu_hash_batch_item_t* run, size_t count, void* const* values)
+{
+	// A list takes the keys one by one until it outgrows the treeify threshold
+	size_t k = 0;
+	while (k < count && LU_HASH_BUCKET_LIST == bucket->type) {
+		if (lu_hash_list_upsert(table, bucket, run[k].key, values[run[k].position], 0)) {
+			table->element_count++;
+		}
+		k++;
+		if (bucket->esize_bucket > table->config.treeify_threshold) {
+			LU_HASH_TRACE_BEGIN();
+			lu_convert_bucket_to_rbtree(bucket);
+			LU_HASH_TRACE_END_STEPS(LU_HASH_TRACE_TREEIFY, table, run[k - 1].key, run[k - 1].index, bucket->esize_bucket);
+			table->treeify_count++;
+		}
+	}
+	if (k == count) {
+		return 0;
+	}
+
+	size_t remaining = count - k;
+	if (remaining * LU_HASH_TREE_REBUILD_FRACTION < bucket->esize_bucket) {
+		size_t deepest = 0;
+		for (; k < count; k++) {
+			size_t depth = 0;
+			if (lu_hash_tree_upsert(table, bucket, run[k].key, values[run[k].position], 0, &depth)) {
+				table->element_count++;
+			}
+			if (depth > deepest) {
+				deepest = depth;
+			}
+		}
+		return deepest > LU_HASH_RESEED_TREE_HEIGHT;
+	}
+
+	lu_hash_batch_merge_tree(table, bucket, run + k, remaining, values);
+
+	// The rebuilt tree is balanced, an insert would descend one level per bit of its size
+	return (bucket->esize_bucket >> LU_HASH_RESEED_TREE_HEIGHT) != 0;
+}
+
+/**
+ * @brief Merges the pairs of a batch into a tree bucket and rebuilds the tree.
+ *
+ * The pairs are sorted by key, the last pair of each key wins, and they are merged with an
+ * in-order walk of the tree: matching nodes take the new value, other keys get new nodes, and
+ * the merged run is linked into a balanced tree.
+ */
+static void lu_hash_batch_merge_tree(lu_hash_table_t* table, lu_hash_bucket_t* bucket, lu_hash_batch_item_t* run, size_t count, void* const* values)
+{
+	lu_rb_tree_t* tree = bucket->data.rb_tree;
+	qsort(run, count, sizeof(lu_hash_batch_item_t), lu_hash_batch_item_compare);
+
+	lu_rb_tree_node_t** nodes = (lu_rb_tree_node_t**)LU_MM_MALLOC((bucket->esize_bucket + count) * sizeof(lu_rb_tree_node_t*));
+	size_t merged = 0;
+	lu_rb_tree_node_t* node = tree->root == tree->nil ? tree->nil : lu_rb_tree_minimum(tree, tree->root);
+	for (size_t k = 0; k < count; k++) {
+		if (k + 1 < count && run[k + 1].key == run[k].key) {
+			continue;
+		}
+		int key = run[k].key;
+		void* value = values[run[k].position];
+		while (node != tree->nil && node->key < key) {
+			nodes[merged++] = node;
+			node = lu_rb_tree_successor(tree, node);
+		}
+
+		if (node != tree->nil && node->key == key) {
+			if (table->value_size) {
+				table->value_bytes += table->value_size(value) - table->value_size(node->value);
+			}
+			node->value = value;
+			node->expire = 0;
+			nodes[merged++] = node;
+			node = lu_rb_tree_successor(tree, node);
+			continue;
+		}
+
+		lu_rb_tree_node_t* new_node = (lu_rb_tree_node_t*)LU_MM_MALLOC(sizeof(lu_rb_tree_node_t));
+		new_node->key = key;
+		new_node->value = value;
+		new_node->expire = 0;
+		new_node->referenced = 0;
+		new_node->compacted = 0;
+		nodes[merged++] = new_node;
+		table->element_count++;
+		if (table->value_size) {
+			table->value_bytes += table->value_size(value);
+		}
+	}
+	while (node != tree->nil) {
+		nodes[merged++] = node;
+		node = lu_rb_tree_successor(tree, node);
+	}
+
+	lu_hash_tree_rebuild(bucket, nodes, merged);
+	LU_MM_FREE(nodes);
+}
+
+/**
+ * @brief Removes the keys of a batch that fall into one bucket, reporting each one it finds.
+ *
+ * The element count is left to the caller.
+ *
+ * @return The number of entries removed.
+ */
+static size_t lu_hash_batch_delete_run(lu_hash_table_t* table, lu_hash_bucket_t* bucket, lu_hash_batch_item_t* run, size_t count)
+{
+	size_t removed = 0;
+	if (LU_HASH_BUCKET_LIST == bucket->type) {
+		for (size_t k = 0; k < count; k++) {
+			lu_hash_bucket_node_ptr_t* link = &bucket->data.list_head;
+			while (*link != NULL && (*link)->key != run[k].key) {
+				link = &(*link)->next;
+			}
+			if (*link == NULL) {
+				continue;
+			}
+			lu_hash_bucket_node_ptr_t node = *link;
+			if (table->value_size) {
+				table->value_bytes -= table->value_size(node->value);
+			}
+			*link = node->next;
+			bucket->esize_bucket--;
+			LU_HASH_NODE_FREE(node);
+			removed++;
+			lu_hash_table_notify_write(table, LU_HASH_WRITE_DELETE, run[k].key, NULL, 0);
+		}
+		return removed;
+	}
+
+	lu_rb_tree_t* tree = bucket->data.rb_tree;
+	if (count * LU_HASH_TREE_REBUILD_FRACTION < bucket->esize_bucket) {
+		for (size_t k = 0; k < count; k++) {
+			lu_rb_tree_node_t* node = lu_hash_rb_tree_find(tree, run[k].key);
+			if (node == NULL) {
+				continue;
+			}
+			if (table->value_size) {
+				table->value_bytes -= table->value_size(node->value);
+			}
+			lu_hash_rb_tree_delete(bucket, run[k].key);
+			removed++;
+			lu_hash_table_notify_write(table, LU_HASH_WRITE_DELETE, run[k].key, NULL, 0);
+		}
+		return removed;
+	}
+
+	// Collect the nodes in key order, then keep the ones whose key is not among the sorted keys
+	qsort(run, count, sizeof(lu_hash_batch_item_t), lu_hash_batch_item_compare);
+	size_t size = bucket->esize_bucket;
+	lu_rb_tree_node_t** nodes = (lu_rb_tree_node_t**)LU_MM_MALLOC(size * sizeof(lu_rb_tree_node_t*));
+	size_t kept = 0;
+	for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+		nodes[kept++] = node;
+	}
+	kept = 0;
+	size_t k = 0;
+	for (size_t i = 0; i < size; i++) {
+		lu_rb_tree_node_t* node = nodes[i];
+		while (k < count && run[k].key < node->key) {
+			k++;
+		}
+		if (k < count && run[k].key == node->key) {
+			if (table->value_size) {
+				table->value_bytes -= table->value_size(node->value);
+			}
+			lu_hash_table_notify_write(table, LU_HASH_WRITE_DELETE, node->key, NULL, 0);
+			LU_HASH_NODE_FREE(node);
+			removed++;
+		}
+		else {
+			nodes[kept++] = node;
+		}
+	}
+	if (removed != 0) {
+		lu_hash_tree_rebuild(bucket, nodes, kept);
+	}
+	LU_MM_FREE(nodes);
+	return removed;
+}
+
+/**
+ * @brief Relocates the nodes of a bounded number of buckets into contiguous memory.
+ *
+ * Nodes allocated one by one over a long run of inserts and deletes end up scattered over the
+ * heap, and a chain walk or tree descent takes a cache or TLB miss at nearly every hop. Each call
+ * examines at most `max_buckets` buckets, continuing where the previous call stopped like
+ * lu_hash_table_expire, and copies the nodes of each bucket next to each other into blocks of
+ * `LU_HASH_COMPACT_BLOCK_BYTES`: lists in list order, trees level by level so that the first
+ * steps of every descent share cache lines. A bucket is started in a new block rather than split
+ * if it does not fit in what is left of the current one. Buckets already laid out this way are
+ * skipped, so repeated passes converge.
+ *
+ * The old nodes are freed as they are copied. A block whose nodes have all been deleted is
+ * released as a whole, so memory fragmented by churn can go back to the system. Blocks come from
+ * the allocator configured with lu_hash_table_init_with_config, if any, which is asked for twice
+ * `LU_HASH_COMPACT_BLOCK_BYTES` per block to leave room for the alignment.
+ *
+ * Values, keys and the contents seen by an active snapshot do not change; pointers to nodes do.
+ *
+ * @param table A pointer to the hash table.
+ * @param max_buckets The maximum number of buckets to examine in this call.
+ * @return The number of nodes relocated. Stops early with lu_hash_erron_global_ set to
+ *         LU_ERROR_OUT_OF_MEMORY if no block can be allocated; the table stays consistent.
+ *
+ * Usage example:
+ *     lu_hash_table_compact(table, 64); // From an idle or timer callback
+ */
+size_t lu_hash_table_compact(lu_hash_table_t* table, size_t max_buckets)
+{
+	size_t moved = 0;
+	if (max_buckets > table->table_size) {
+		max_buckets = table->table_size;
+	}
+
+	for (size_t n = 0; n < max_buckets; n++) {
+		if (table->compact_cursor >= table->table_size) {
+			table->compact_cursor = 0;
+		}
+		lu_hash_bucket_t* bucket = &table->buckets[table->compact_cursor++];
+		if (bucket->esize_bucket == 0) {
+			continue;
+		}
+
+		int status = bucket->type == LU_HASH_BUCKET_LIST
+			? lu_hash_compact_list(table, bucket, &moved)
+			: lu_hash_compact_tree(table, bucket, &moved);
+		if (status != LU_OK) {
+			break;
+		}
+	}
+	return moved;
+}
+
+/**
+ * @brief Frees a list or tree node. A node in a compaction block releases its block once it was
+ * the last one there and no table is still filling the block.
+ */
+static void lu_hash_node_free(void* node, unsigned int compacted)
+{
+	if (!compacted) {
+		LU_MM_FREE(node);
+		return;
+	}
+	// Atomic: the workers of a bulk union may free nodes of the same block at the same time
+	lu_hash_compact_block_t* block = (lu_hash_compact_block_t*)((uintptr_t)node & ~(uintptr_t)(LU_HASH_COMPACT_BLOCK_BYTES - 1));
+	if (lu_atomic_fetch_add_size(&block->live, (size_t)-1) == 1) {
+		if (block->free != NULL) {
+			block->free(block->memory, block->alloc_ctx);
+			return;
+		}
+#if defined(_WIN32)
+		_aligned_free(block);
+#else
+		free(block);
+#endif
+	}
+}
+
+/**
+ * @brief Allocates a compaction block aligned to its size, with the table's allocator if it has
+ * one. Returns NULL if the memory cannot be allocated.
+ */
+static lu_hash_compact_block_t* lu_hash_compact_block_alloc(const lu_hash_table_config_t* config)
+{
+	void* memory = NULL;
+	lu_hash_compact_block_t* block;
+	if (config->alloc != NULL) {
+		// The allocator knows nothing of alignment, an aligned block always fits in twice its size
+		memory = config->alloc(2 * LU_HASH_COMPACT_BLOCK_BYTES, config->alloc_ctx);
+		if (memory == NULL) {
+			return NULL;
+		}
+		block = (lu_hash_compact_block_t*)(((uintptr_t)memory + LU_HASH_COMPACT_BLOCK_BYTES - 1) & ~(uintptr_t)(LU_HASH_COMPACT_BLOCK_BYTES - 1));
+		block->free = config->free;
+		block->alloc_ctx = config->alloc_ctx;
+	}
+	else {
+#if defined(_WIN32)
+		memory = _aligned_malloc(LU_HASH_COMPACT_BLOCK_BYTES, LU_HASH_COMPACT_BLOCK_BYTES);
+#else
+		if (posix_memalign(&memory, LU_HASH_COMPACT_BLOCK_BYTES, LU_HASH_COMPACT_BLOCK_BYTES) != 0) {
+			memory = NULL;
+		}
+#endif
+		if (memory == NULL) {
+			return NULL;
+		}
+		block = (lu_hash_compact_block_t*)memory;
+		block->free = NULL;
+		block->alloc_ctx = NULL;
+	}
+	block->memory = memory;
+	block->live = 1;
+	return block;
+}
+
+/**
+ * @brief Hands out `bytes` of the block the table is filling, starting a new block when it is
+ * full. Returns NULL if a new block cannot be allocated.
+ */
+static void* lu_hash_compact_slot(lu_hash_table_t* table, size_t bytes)
+{
+	if (table->compact_block == NULL || table->compact_used + bytes > LU_HASH_COMPACT_BLOCK_BYTES) {
+		lu_hash_compact_block_t* block = lu_hash_compact_block_alloc(&table->config);
+		if (block == NULL) {
+#ifdef LU_HASH_DEBUG
+			printf("Memory allocation failed for a compaction block\n");
+#endif // LU_HASH_DEBUG
+			lu_hash_erron_global_ = LU_ERROR_OUT_OF_MEMORY;
+			return NULL;
+		}
+		lu_hash_compact_release(table);
+		table->compact_block = block;
+		table->compact_used = LU_HASH_COMPACT_HEADER_BYTES;
+	}
+
+	void* slot = (unsigned char*)table->compact_block + table->compact_used;
+	table->compact_used += bytes;
+	lu_atomic_fetch_add_size(&((lu_hash_compact_block_t*)table->compact_block)->live, 1);
+	return slot;
+}
+
+/**
+ * @brief Starts a new block for a bucket of `bytes` that fits in a block but not in what is left
+ * of the current one, so that the bucket is not split.
+ */
+static void lu_hash_compact_reserve(lu_hash_table_t* table, size_t bytes)
+{
+	if (table->compact_block != NULL && table->compact_used + bytes > LU_HASH_COMPACT_BLOCK_BYTES
+		&& bytes <= LU_HASH_COMPACT_BLOCK_BYTES - LU_HASH_COMPACT_HEADER_BYTES) {
+		table->compact_used = LU_HASH_COMPACT_BLOCK_BYTES; // The next slot starts a new block
+	}
+}
+
+/**
+ * @brief Stops filling the current compaction block, freeing it if it holds no node.
+ */
+static void lu_hash_compact_release(lu_hash_table_t* table)
+{
+	if (table->compact_block != NULL) {
+		lu_hash_compact_block_t* block = (lu_hash_compact_block_t*)table->compact_block;
+		table->compact_block = NULL;
+		table->compact_used = 0;
+		lu_hash_node_free(block, 1);
+	}
+}
+
+/**
+ * @brief Copies the nodes of a list bucket into consecutive slots, in list order, adding the
+ * number of nodes moved to `moved`.
+ * @return LU_OK, or LU_ERROR_OUT_OF_MEMORY if a block could not be allocated.
+ */
+static int lu_hash_compact_list(lu_hash_table_t* table, lu_hash_bucket_t* bucket, size_t* moved)
+{
+	// Skip a list already laid out node after node in a block
+	lu_hash_bucket_node_ptr_t node = bucket->data.list_head;
+	while (node->compacted && node->next != NULL && node->next == node + 1) {
+		node = node->next;
+	}
+	if (node->compacted && node->next == NULL) {
+		return LU_OK;
+	}
+
+	lu_hash_compact_reserve(table, bucket->esize_bucket * sizeof(lu_hash_bucket_node_t));
+	lu_hash_bucket_node_ptr_t* link = &bucket->data.list_head;
+	while (*link != NULL) {
+		lu_hash_bucket_node_ptr_t old = *link;
+		lu_hash_bucket_node_ptr_t copy = (lu_hash_bucket_node_ptr_t)lu_hash_compact_slot(table, sizeof(lu_hash_bucket_node_t));
+		if (copy == NULL) {
+			return LU_ERROR_OUT_OF_MEMORY;
+		}
+		*copy = *old;
+		copy->compacted = 1;
+		*link = copy;
+		LU_HASH_NODE_FREE(old);
+		link = &copy->next;
+		(*moved)++;
+	}
+	return LU_OK;
+}
+
+/**
+ * @brief Copies the nodes of a tree bucket into consecutive slots, level by level from the root,
+ * adding the number of nodes moved to `moved`.
+ * @return LU_OK, or LU_ERROR_OUT_OF_MEMORY if a block could not be allocated.
+ */
+static int lu_hash_compact_tree(lu_hash_table_t* table, lu_hash_bucket_t* bucket, size_t* moved)
+{
+	lu_rb_tree_t* tree = bucket->data.rb_tree;
+	if (tree == NULL || tree->root == tree->nil) {
+		return LU_OK;
+	}
+
+	// Breadth-first order; skip a tree whose nodes already sit in that order in a block
+	lu_rb_tree_node_t** queue = (lu_rb_tree_node_t**)LU_MM_MALLOC(bucket->esize_bucket * sizeof(lu_rb_tree_node_t*));
+	size_t head = 0;
+	size_t tail = 0;
+	int in_place = 1;
+	queue[tail++] = tree->root;
+	while (head < tail) {
+		lu_rb_tree_node_t* node = queue[head++];
+		if (!node->compacted || (head > 1 && node != queue[head - 2] + 1)) {
+			in_place = 0;
+		}
+		if (node->left != tree->nil) {
+			queue[tail++] = node->left;
+		}
+		if (node->right != tree->nil) {
+			queue[tail++] = node->right;
+		}
+	}
+	if (in_place) {
+		LU_MM_FREE(queue);
+		return LU_OK;
+	}
+
+	// Parents move before their children: each copy is linked from its parent's copy and becomes
+	// the parent of its children, which still sit in the queue
+	lu_hash_compact_reserve(table, tail * sizeof(lu_rb_tree_node_t));
+	for (head = 0; head < tail; head++) {
+		lu_rb_tree_node_t* old = queue[head];
+		lu_rb_tree_node_t* copy = (lu_rb_tree_node_t*)lu_hash_compact_slot(table, sizeof(lu_rb_tree_node_t));
+		if (copy == NULL) {
+			LU_MM_FREE(queue);
+			return LU_ERROR_OUT_OF_MEMORY;
+		}
+		*copy = *old;
+		copy->compacted = 1;
+		if (old->parent == tree->nil) {
+			tree->root = copy;
+		}
+		else if (old->parent->left == old) {
+			old->parent->left = copy;
+		}
+		else {
+			old->parent->right = copy;
+		}
+		if (copy->left != tree->nil) {
+			copy->left->parent = copy;
+		}
+		if (copy->right != tree->nil) {
+			copy->right->parent = copy;
+		}
+		LU_HASH_NODE_FREE(old);
+		(*moved)++;
+	}
+	LU_MM_FREE(queue);
+	return LU_OK;
+}
+
+/**
+ * @brief Removes expired entries from a bounded number of buckets.
+ *
+ * Active expiry for entries that are never looked up again. Each call examines at most
+ * `max_buckets` buckets, continuing where the previous call stopped and wrapping around at the
+ * end of the bucket array, so calling it periodically with a small budget (for example from an
+ * event loop tick) keeps the pause per call bounded while every bucket is visited once per
+ * table_size / max_buckets calls. Returns immediately if no entry was ever inserted with a TTL.
+ *
+ * @param table A pointer to the hash table.
+ * @param max_buckets The maximum number of buckets to examine in this call.
+ * @return The number of expired entries removed.
+ */
+size_t lu_hash_table_expire(lu_hash_table_t* table, size_t max_buckets)
+{
+	if (!table->ttl_in_use) {
+		return 0;
+	}
+
+	unsigned int now = lu_hash_table_now(table);
+	size_t removed = 0;
+	if (max_buckets > table->table_size) {
+		max_buckets = table->table_size;
+	}
+
+	for (size_t n = 0; n < max_buckets; n++) {
+		if (table->expire_cursor >= table->table_size) {
+			table->expire_cursor = 0;
+		}
+		size_t index = table->expire_cursor++;
+		lu_hash_bucket_t* bucket = &table->buckets[index];
+
+		if (bucket->type == LU_HASH_BUCKET_LIST) {
+			// Unlink expired nodes in place
+			lu_hash_bucket_node_ptr_t* link = &bucket->data.list_head;
+			while (*link != NULL) {
+				lu_hash_bucket_node_ptr_t node = *link;
+				if (lu_hash_expired(node->expire, now)) {
+					lu_hash_cow_preserve(table, index);
+					*link = node->next;
+					bucket->esize_bucket--;
+					table->element_count--;
+					table->expired_count++;
+					removed++;
+					lu_hash_table_drop(table, node->key, node->value);
+					LU_HASH_NODE_FREE(node);
+				}
+				else {
+					link = &node->next;
+				}
+			}
+		}
+		else if (bucket->type == LU_HASH_BUCKET_RBTREE && bucket->data.rb_tree != NULL) {
+			// Collect the expired keys first, deleting while walking would invalidate the walk
+			lu_rb_tree_t* tree = bucket->data.rb_tree;
+			if (tree->root == tree->nil) {
+				continue;
+			}
+			int* expired_keys = (int*)LU_MM_MALLOC(bucket->esize_bucket * sizeof(int));
+			void** expired_values = (void**)LU_MM_MALLOC(bucket->esize_bucket * sizeof(void*));
+			size_t expired = 0;
+			for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+				if (lu_hash_expired(node->expire, now)) {
+					expired_keys[expired] = node->key;
+					expired_values[expired] = node->value;
+					expired++;
+				}
+			}
+			if (expired != 0) {
+				lu_hash_cow_preserve(table, index);
+			}
+			for (size_t k = 0; k < expired; k++) {
+				lu_hash_rb_tree_delete(bucket, expired_keys[k]);
+				table->element_count--;
+				table->expired_count++;
+				removed++;
+				lu_hash_table_drop(table, expired_keys[k], expired_values[k]);
+			}
+			lu_hash_bucket_untreeify_small(table, bucket);
+			LU_MM_FREE(expired_keys);
+			LU_MM_FREE(expired_values);
+		}
+	}
+
+	return removed;
+}
+
+/**
+ * Limits the size of the table, turning it into a bounded cache.
+ *
+ * Once an insert pushes the table over either budget, entries are evicted until it fits again.
+ * Victims are chosen by the CLOCK approximation of LRU: every node carries a reference bit that
+ * lu_hash_table_find sets, and an eviction hand sweeps the buckets, clearing set bits and evicting
+ * the first entry whose bit is already clear. A hit therefore costs at most one store into the
+ * node it already touched; there is no LRU list to splice and no extra pointers per entry.
+ *
+ * If the table is over budget when this is called, it is trimmed immediately.
+ *
+ * @param table A pointer to the hash table.
+ * @param max_entries The maximum number of entries, or 0 for no entry limit.
+ * @param max_bytes The maximum of lu_hash_table_memory_usage, or 0 for no byte limit.
+ * @param value_size Returns the bytes a value counts against `max_bytes`, or NULL to count the
+ *        table's own memory only. It must be set before values are inserted and always
+ *        return the same size for the same value.
+ *
+ * Usage example:
+ *     lu_hash_table_set_capacity(cache, 100000, 0, NULL); // At most 100000 entries
+ */
+void lu_hash_table_set_capacity(lu_hash_table_t* table, size_t max_entries, size_t max_bytes, lu_hash_value_size_func_t value_size)
+{
+	table->max_entries = max_entries;
+	table->max_bytes = max_bytes;
+	if (table->value_size != value_size) {
+		table->value_size = value_size;
+		table->value_bytes = 0;
+		if (value_size) {
+			for (size_t i = 0; i < table->table_size; i++) {
+				lu_hash_bucket_t* bucket = &table->buckets[i];
+				if (bucket->type == LU_HASH_BUCKET_LIST) {
+					for (lu_hash_bucket_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+						table->value_bytes += value_size(node->value);
+					}
+				}
+				else if (bucket->type == LU_HASH_BUCKET_RBTREE && bucket->data.rb_tree != NULL) {
+					lu_rb_tree_t* tree = bucket->data.rb_tree;
+					for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+						table->value_bytes += value_size(node->value);
+					}
+				}
+			}
+		}
+	}
+
+	while (lu_hash_table_over_capacity(table) && lu_hash_table_evict_one(table)) {
+	}
+}
+
+/**
+ * @brief Sets the callback invoked for entries that the table removes on its own.
+ *
+ * That is, entries evicted to stay within the capacity and entries removed because their TTL ran
+ * out, so that the caller can release the values. It is not invoked for lu_hash_table_delete or
+ * for lu_hash_table_destroy. The callback must not modify the table.
+ *
+ * @param table A pointer to the hash table.
+ * @param on_evict The callback, or NULL to remove it.
+ * @param ctx Context pointer passed to the callback.
+ */
+void lu_hash_table_set_evict_callback(lu_hash_table_t* table, lu_hash_visit_func_t on_evict, void* ctx)
+{
+	table->on_evict = on_evict;
+	table->evict_ctx = ctx;
+}
+
+/**
+ * @brief Sets the callback invoked for every change of the table.
+ *
+ * Inserts and updates are reported before the table applies them, removals (by
+ * lu_hash_table_delete, expiry, eviction or a bulk operation) after. Replaying the reported
+ * changes in order on a copy of the table at the time the callback was set reproduces the table,
+ * which is what a write-ahead log needs. The callback may read the table but must not modify it.
+ *
+ * @param table A pointer to the hash table.
+ * @param on_write The callback, or NULL to remove it.
+ * @param ctx Context pointer passed to the callback.
+ */
+void lu_hash_table_set_write_callback(lu_hash_table_t* table, lu_hash_write_func_t on_write, void* ctx)
+{
+	table->on_write = on_write;
+	table->write_ctx = ctx;
+}
+
+/**
+ * @brief Returns the bytes charged against the byte budget of the table.
+ *
+ * The bucket array plus one list node per entry (tree nodes are counted like list nodes), the
+ * membership filter, plus the value sizes reported by the value_size callback if one was set.
+ *
+ * @param table A pointer to the hash table.
+ * @return The memory usage in bytes.
+ */
+size_t lu_hash_table_memory_usage(const lu_hash_table_t* table)
+{
+	return sizeof(lu_hash_table_t)
+		+ table->table_size * sizeof(lu_hash_bucket_t)
+		+ table->element_count * sizeof(lu_hash_bucket_node_t)
+		+ table->filter_blocks * LU_HASH_FILTER_BLOCK_BYTES
+		+ table->value_bytes;
+}
+
+/**
+ * Puts a blocked Bloom filter in front of the buckets, for workloads where most lookups miss.
+ *
+ * Every key sets 8 bits inside one 64-byte block of the filter, so a lookup costs one cache line
+ * of filter and, for a definite miss, nothing else: lu_hash_table_find returns NULL without
+ * loading the bucket array. The filter is sized for the keys the table holds before its next
+ * resize, and it is rebuilt whenever the table resizes or reseeds. Because a Bloom filter cannot
+ * remove keys, removed keys keep their bits until the next rebuild, which also happens once the
+ * removed keys reach half of the stored ones. With the default 10 bits per key the false-positive
+ * rate is about 1%.
+ *
+ * @param table A pointer to the hash table.
+ * @param bits_per_key Filter bits per key of capacity, or 0 to remove the filter.
+ *
+ * Usage example:
+ *     lu_hash_table_set_filter(table, LU_HASH_FILTER_DEFAULT_BITS_PER_KEY);
+ */
+void lu_hash_table_set_filter(lu_hash_table_t* table, size_t bits_per_key)
+{
+	table->filter_bits_per_key = bits_per_key;
+	if (bits_per_key == 0) {
+		LU_MM_FREE(table->filter_memory);
+		table->filter_memory = NULL;
+		table->filter = NULL;
+		table->filter_blocks = 0;
+		return;
+	}
+	lu_hash_filter_build(table);
+}
+
+/**
+ * @brief Reports how well the membership filter is doing.
+ *
+ * @param table A pointer to the hash table.
+ * @param stats Receives the statistics. All fields are 0 if the table never had a filter.
+ */
+void lu_hash_table_filter_stats(const lu_hash_table_t* table, lu_hash_filter_stats_t* stats)
+{
+	size_t misses = table->filter_negatives + table->filter_false_positives;
+	stats->negatives = table->filter_negatives;
+	stats->false_positives = table->filter_false_positives;
+	stats->false_positive_rate = misses ? (double)table->filter_false_positives / misses : 0.0;
+	stats->expired = table->filter_expired;
+	stats->memory_bytes = table->filter_blocks * LU_HASH_FILTER_BLOCK_BYTES;
+}
+
+/**
+ * @brief Allocates the filter for the current table size and adds every stored key.
+ */
+static void lu_hash_filter_build(lu_hash_table_t* table)
+{
+	double capacity = table->table_size * table->config.max_load_factor;
+	size_t blocks = (size_t)(capacity * table->filter_bits_per_key / (LU_HASH_FILTER_BLOCK_BYTES * 8)) + 1;
+
+	// Blocks are aligned to cache lines so that a probe never straddles two of them
+	LU_MM_FREE(table->filter_memory);
+	table->filter_memory = LU_MM_CALLOC(blocks * LU_HASH_FILTER_BLOCK_BYTES + LU_HASH_FILTER_BLOCK_BYTES, 1);
+	table->filter = (unsigned long long*)(((size_t)table->filter_memory + LU_HASH_FILTER_BLOCK_BYTES - 1) & ~(size_t)(LU_HASH_FILTER_BLOCK_BYTES - 1));
+	table->filter_blocks = blocks;
+	table->filter_removed = 0;
+
+	for (size_t i = 0; i < table->table_size; i++) {
+		lu_hash_bucket_t* bucket = &table->buckets[i];
+		if (bucket->type == LU_HASH_BUCKET_LIST) {
+			for (lu_hash_bucket_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+				lu_hash_filter_add(table, lu_hash_mix(table->config.hash, node->key, table->seed));
+			}
+		}
+		else if (bucket->type == LU_HASH_BUCKET_RBTREE && bucket->data.rb_tree != NULL) {
+			lu_rb_tree_t* tree = bucket->data.rb_tree;
+			if (tree->root == tree->nil) {
+				continue;
+			}
+			for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+				lu_hash_filter_add(table, lu_hash_mix(table->config.hash, node->key, table->seed));
+			}
+		}
+	}
+}
+
+/** Odd multipliers that derive the bit of each block word from the low half of the key hash */
+static const unsigned int lu_hash_filter_salt[LU_HASH_FILTER_BLOCK_WORDS] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/**
+ * @brief Returns the filter block of a key hash. Uses the high half of the hash, the bucket
+ * index comes from the low bits.
+ */
+static inline unsigned long long* lu_hash_filter_block(const lu_hash_table_t* table, unsigned long long hash)
+{
+	size_t block = (size_t)(((hash >> 32) * (unsigned long long)table->filter_blocks) >> 32);
+	return table->filter + block * LU_HASH_FILTER_BLOCK_WORDS;
+}
+
+/**
+ * @brief Sets the bits of a key hash in the filter.
+ */
+static void lu_hash_filter_add(lu_hash_table_t* table, unsigned long long hash)
+{
+	unsigned long long* block = lu_hash_filter_block(table, hash);
+	unsigned int low = (unsigned int)hash;
+	for (int i = 0; i < LU_HASH_FILTER_BLOCK_WORDS; i++) {
+		block[i] |= 1ULL << ((low * lu_hash_filter_salt[i]) >> 26);
+	}
+}
+
+/**
+ * @brief Checks the bits of a key hash in the filter.
+ *
+ * @return 0 if the key is certainly absent, 1 if it may be present.
+ */
+static int lu_hash_filter_may_contain(const lu_hash_table_t* table, unsigned long long hash)
+{
+	const unsigned long long* block = lu_hash_filter_block(table, hash);
+	unsigned int low = (unsigned int)hash;
+	unsigned long long missing = 0;
+	for (int i = 0; i < LU_HASH_FILTER_BLOCK_WORDS; i++) {
+		missing |= ~block[i] & (1ULL << ((low * lu_hash_filter_salt[i]) >> 26));
+	}
+	return missing == 0;
+}
+
+/**
+ * @brief Records that a key left the table.
+ *
+ * A Bloom filter cannot forget keys, and the bits of removed keys turn into false positives.
+ * The filter is rebuilt once the removed keys reach half of the stored ones, which keeps the
+ * rebuild cost at a couple of key hashes per removal.
+ */
+static void lu_hash_filter_note_removal(lu_hash_table_t* table)
+{
+	if (table->filter && ++table->filter_removed > table->element_count / 2 + LU_HASH_BUCKET_LIST_THRESHOLD) {
+		lu_hash_filter_build(table);
+	}
+}
+
+/**
+ * @brief Accounts for an entry that the table removed on its own and notifies the caller.
+ *
+ * The node must already be unlinked and the element count updated.
+ */
+static void lu_hash_table_drop(lu_hash_table_t* table, int key, void* value)
+{
+	lu_hash_filter_note_removal(table);
+	if (table->value_size) {
+		table->value_bytes -= table->value_size(value);
+	}
+	if (table->on_evict) {
+		table->on_evict(key, value, table->evict_ctx);
+	}
+	lu_hash_table_notify_write(table, LU_HASH_WRITE_DELETE, key, NULL, 0);
+}
+
+/**
+ * @brief Turns a tree bucket that has shrunk to `untreeify_threshold` entries or fewer back into a list.
+ *
+ * Called after removals, whether by the caller, expiry or eviction: a tree left with a few
+ * entries is cheaper to walk as a list.
+ */
+static void lu_hash_bucket_untreeify_small(const lu_hash_table_t* table, lu_hash_bucket_t* bucket)
+{
+	if (LU_HASH_BUCKET_RBTREE == bucket->type && bucket->esize_bucket <= table->config.untreeify_threshold) {
+		lu_convert_bucket_to_list(bucket);
+	}
+}
+
+/**
+ * @brief Reports a change to the write callback of the table, if one is set.
+ *
+ * @param expire Expiry time of an inserted entry relative to the table clock base, 0 for none.
+ */
+static void lu_hash_table_notify_write(lu_hash_table_t* table, lu_hash_write_op_t op, int key, void* value, unsigned int expire)
+{
+	if (table->on_write) {
+		unsigned long long expire_at = expire ? table->clock_base + expire - 1 : 0;
+		table->on_write(op, key, value, expire_at, table->write_ctx);
+	}
+}
+
+/**
+ * @brief Checks whether the table exceeds its entry or byte budget.
+ */
+static int lu_hash_table_over_capacity(const lu_hash_table_t* table)
+{
+	return (table->max_entries != 0 && table->element_count > table->max_entries)
+		|| (table->max_bytes != 0 && lu_hash_table_memory_usage(table) > table->max_bytes);
+}
+
+/**
+ * @brief Evicts one entry chosen by the CLOCK hand.
+ *
+ * The hand examines one bucket at a time and moves past it after evicting at most one entry, so
+ * an entry whose bit was just cleared gets a full sweep to be referenced again. Two sweeps over
+ * the buckets always find a victim in a non-empty table, because the first one clears every
+ * reference bit it passes.
+ *
+ * @param table A pointer to the hash table.
+ * @return 1 if an entry was evicted, 0 if the table is empty.
+ */
+static int lu_hash_table_evict_one(lu_hash_table_t* table)
+{
+	if (table->element_count == 0) {
+		return 0;
+	}
+
+	for (size_t step = 0; step <= 2 * table->table_size; step++) {
+		if (table->clock_hand >= table->table_size) {
+			table->clock_hand = 0;
+		}
+		lu_hash_bucket_t* bucket = &table->buckets[table->clock_hand];
+
+		if (bucket->type == LU_HASH_BUCKET_LIST) {
+			lu_hash_bucket_node_ptr_t* link = &bucket->data.list_head;
+			while (*link != NULL) {
+				lu_hash_bucket_node_ptr_t node = *link;
+				if (node->referenced) {
+					node->referenced = 0; // Second chance
+					link = &node->next;
+					continue;
+				}
+				lu_hash_cow_preserve(table, table->clock_hand);
+				*link = node->next;
+				bucket->esize_bucket--;
+				table->element_count--;
+				table->evicted_count++;
+				table->clock_hand++;
+				lu_hash_table_drop(table, node->key, node->value);
+				LU_HASH_NODE_FREE(node);
+				return 1;
+			}
+		}
+		else if (bucket->type == LU_HASH_BUCKET_RBTREE && bucket->data.rb_tree != NULL) {
+			lu_rb_tree_t* tree = bucket->data.rb_tree;
+			if (tree->root != tree->nil) {
+				for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+					if (node->referenced) {
+						node->referenced = 0;
+						continue;
+					}
+					int key = node->key;
+					void* value = node->value;
+					lu_hash_cow_preserve(table, table->clock_hand);
+					lu_hash_rb_tree_delete(bucket, key);
+					lu_hash_bucket_untreeify_small(table, bucket);
+					table->element_count--;
+					table->evicted_count++;
+					table->clock_hand++;
+					lu_hash_table_drop(table, key, value);
+					return 1;
+				}
+			}
+		}
+		table->clock_hand++;
+	}
+	return 0;
+}
+
+/**
+ * Creates an independent copy of a hash table.
+ *
+ * The copy has the same seed and bucket count, so no key is hashed again: the bucket array is
+ * duplicated and every list is copied in order and every tree node for node, keeping its shape and
+ * colors. Settings (clock, capacity, filter) are copied too. Values are shared, not copied, so
+ * the evict callback is not: set one on the copy if it should release values as well. An active
+ * snapshot of the source is not carried over.
+ *
+ * @param table A pointer to the hash table to copy.
+ * @return A pointer to the new table, or exits the program if memory allocation fails.
+ *
+ * Usage example:
+ *     lu_hash_table_t* copy = lu_hash_table_clone(table);
+ */
+lu_hash_table_t* lu_hash_table_clone(const lu_hash_table_t* table)
+{
+	lu_hash_table_t* clone = (lu_hash_table_t*)LU_MM_MALLOC(sizeof(lu_hash_table_t));
+	memcpy(clone, table, sizeof(lu_hash_table_t));
+	clone->snapshot = NULL;
+	clone->on_evict = NULL;
+	clone->evict_ctx = NULL;
+	clone->on_write = NULL;
+	clone->write_ctx = NULL;
+	clone->compact_block = NULL; // Copied nodes have their own allocations
+	clone->compact_used = 0;
+
+	clone->buckets = lu_hash_buckets_alloc(&table->config, table->table_size);
+	for (size_t i = 0; i < table->table_size; i++) {
+		lu_hash_bucket_copy(&table->buckets[i], &clone->buckets[i]);
+	}
+
+	if (table->filter != NULL) {
+		size_t filter_bytes = table->filter_blocks * LU_HASH_FILTER_BLOCK_BYTES;
+		clone->filter_memory = LU_MM_MALLOC(filter_bytes + LU_HASH_FILTER_BLOCK_BYTES);
+		clone->filter = (unsigned long long*)(((size_t)clone->filter_memory + LU_HASH_FILTER_BLOCK_BYTES - 1) & ~(size_t)(LU_HASH_FILTER_BLOCK_BYTES - 1));
+		memcpy(clone->filter, table->filter, filter_bytes);
+	}
+	return clone;
+}
+
+/**
+ * @brief Copies the contents of a bucket, lists in order and trees node for node.
+ */
+static void lu_hash_bucket_copy(const lu_hash_bucket_t* source, lu_hash_bucket_t* target)
+{
+	target->type = source->type;
+	target->esize_bucket = source->esize_bucket;
+
+	if (source->type == LU_HASH_BUCKET_LIST) {
+		lu_hash_bucket_node_ptr_t* tail = &target->data.list_head;
+		for (lu_hash_bucket_node_t* node = source->data.list_head; node != NULL; node = node->next) {
+			lu_hash_bucket_node_ptr_t copy = (lu_hash_bucket_node_ptr_t)LU_MM_MALLOC(sizeof(lu_hash_bucket_node_t));
+			*copy = *node;
+			copy->compacted = 0;
+			*tail = copy;
+			tail = &copy->next;
+		}
+		*tail = NULL;
+	}
+	else if (source->data.rb_tree != NULL) {
+		lu_rb_tree_t* tree = lu_rb_tree_init();
+		tree->root = lu_rb_tree_copy(source->data.rb_tree, source->data.rb_tree->root, tree, tree->nil);
+		target->data.rb_tree = tree;
+	}
+	else {
+		target->data.rb_tree = NULL;
+	}
+}
+
+/**
+ * @brief Copies the subtree rooted at `node` into another tree.
+ *
+ * @param source The tree being copied.
+ * @param node The root of the subtree to copy.
+ * @param target The tree receiving the copy; its nil sentinel replaces the one of the source.
+ * @param parent The parent of the copied subtree in the target tree.
+ * @return The root of the copied subtree.
+ */
+static lu_rb_tree_node_t* lu_rb_tree_copy(const lu_rb_tree_t* source, const lu_rb_tree_node_t* node, lu_rb_tree_t* target, lu_rb_tree_node_t* parent)
+{
+	if (node == source->nil) {
+		return target->nil;
+	}
+	lu_rb_tree_node_t* copy = (lu_rb_tree_node_t*)LU_MM_MALLOC(sizeof(lu_rb_tree_node_t));
+	*copy = *node;
+	copy->compacted = 0;
+	copy->parent = parent;
+	copy->left = lu_rb_tree_copy(source, node->left, target, copy);
+	copy->right = lu_rb_tree_copy(source, node->right, target, copy);
+	return copy;
+}
+
+/**
+ * Takes a copy-on-write snapshot of a hash table.
+ *
+ * Taking the snapshot copies nothing: the snapshot reads the live bucket array, and the table
+ * copies a bucket into the snapshot right before it modifies that bucket for the first time. A
+ * snapshot of a large table is therefore created in constant time plus the allocation of one bit
+ * per bucket, and keeps costing only as many bucket copies as buckets are written while it lives.
+ * If the table resizes or reseeds while a snapshot is active, all buckets not copied yet are
+ * copied at once, because every node moves.
+ *
+ * A table has at most one active snapshot. The snapshot and its table are not synchronized with
+ * each other: when the snapshot is read on another thread, every snapshot call must be serialized
+ * with the writers of the table, for example under the same lock. Each call stays short, and the
+ * snapshot still shows the table as it was when it was taken.
+ *
+ * @param table A pointer to the hash table.
+ * @return A pointer to the snapshot, or NULL with LU_ERROR_BUSY if the table already has one.
+ *
+ * Usage example:
+ *     lu_hash_snapshot_t* snapshot = lu_hash_table_snapshot(table);
+ *     lu_hash_snapshot_foreach(snapshot, write_entry, file);
+ *     lu_hash_snapshot_release(snapshot);
+ */
+lu_hash_snapshot_t* lu_hash_table_snapshot(lu_hash_table_t* table)
+{
+	if (table->snapshot != NULL) {
+		lu_hash_erron_global_ = LU_ERROR_BUSY;
+		return NULL;
+	}
+
+	lu_hash_snapshot_t* snapshot = (lu_hash_snapshot_t*)LU_MM_MALLOC(sizeof(lu_hash_snapshot_t));
+	snapshot->table = table;
+	snapshot->buckets = table->buckets;
+	snapshot->table_size = table->table_size;
+	snapshot->element_count = table->element_count;
+	snapshot->seed = table->seed;
+	snapshot->hash = table->config.hash;
+	snapshot->now = table->ttl_in_use ? lu_hash_table_now(table) : 0;
+	snapshot->preserved = (unsigned char*)LU_MM_CALLOC(table->table_size / 8 + 1, 1);
+	snapshot->saved = lu_hash_table_init(LU_HASH_TABLE_DEFAULT_SIZE);
+
+	table->snapshot = snapshot;
+	return snapshot;
+}
+
+/**
+ * @brief Copies a bucket into the active snapshot before its first modification.
+ *
+ * Called by every operation that changes a bucket. Does nothing if the table has no snapshot or
+ * the bucket was already copied.
+ *
+ * @param table A pointer to the hash table.
+ * @param index The index of the bucket about to be modified.
+ */
+static void lu_hash_cow_preserve(lu_hash_table_t* table, size_t index)
+{
+	lu_hash_snapshot_t* snapshot = table->snapshot;
+	if (snapshot == NULL || (snapshot->preserved[index >> 3] & (1U << (index & 7)))) {
+		return;
+	}
+
+	lu_hash_bucket_t* saved = (lu_hash_bucket_t*)LU_MM_MALLOC(sizeof(lu_hash_bucket_t));
+	lu_hash_bucket_copy(&table->buckets[index], saved);
+	lu_hash_table_insert(snapshot->saved, (int)index, saved);
+	snapshot->preserved[index >> 3] |= (unsigned char)(1U << (index & 7));
+}
+
+/**
+ * @brief Copies every remaining bucket into the snapshot and separates it from its table.
+ */
+static void lu_hash_snapshot_detach(lu_hash_snapshot_t* snapshot)
+{
+	lu_hash_table_t* table = snapshot->table;
+	for (size_t i = 0; i < snapshot->table_size; i++) {
+		lu_hash_cow_preserve(table, i);
+	}
+	table->snapshot = NULL;
+	snapshot->table = NULL;
+	snapshot->buckets = NULL;
+}
+
+/**
+ * @brief Returns the bucket as the snapshot sees it: its saved copy, or the untouched live bucket.
+ */
+static lu_hash_bucket_t* lu_hash_snapshot_bucket(lu_hash_snapshot_t* snapshot, size_t index)
+{
+	if (snapshot->preserved[index >> 3] & (1U << (index & 7))) {
+		return (lu_hash_bucket_t*)lu_hash_table_find(snapshot->saved, (int)index);
+	}
+	return &snapshot->buckets[index];
+}
+
+/**
+ * @brief Searches for a key in a snapshot.
+ *
+ * @param snapshot A pointer to the snapshot.
+ * @param key The key to search for.
+ * @return The value the key had when the snapshot was taken, or NULL if it was not present.
+ */
+void* lu_hash_snapshot_find(lu_hash_snapshot_t* snapshot, int key)
+{
+	lu_hash_bucket_t* bucket = lu_hash_snapshot_bucket(snapshot, (size_t)lu_hash_function(snapshot->hash, key, snapshot->seed, snapshot->table_size));
+
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		lu_hash_bucket_node_t* node = lu_hash_list_find(bucket, key);
+		if (node != NULL && !lu_hash_expired(node->expire, snapshot->now)) {
+			return node->value;
+		}
+	}
+	else if (bucket->data.rb_tree != NULL) {
+		lu_rb_tree_node_t* node = lu_hash_rb_tree_find(bucket->data.rb_tree, key);
+		if (node != NULL && !lu_hash_expired(node->expire, snapshot->now)) {
+			return node->value;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Calls a function for every key-value pair of a snapshot.
+ *
+ * Buckets are visited in index order, like lu_hash_table_foreach.
+ *
+ * @param snapshot A pointer to the snapshot.
+ * @param visit The function called for each element.
+ * @param ctx   Opaque pointer passed through to the callback.
+ */
+void lu_hash_snapshot_foreach(lu_hash_snapshot_t* snapshot, lu_hash_visit_func_t visit, void* ctx)
+{
+	for (size_t i = 0; i < snapshot->table_size; i++) {
+		lu_hash_bucket_t* bucket = lu_hash_snapshot_bucket(snapshot, i);
+		if (bucket->type == LU_HASH_BUCKET_LIST) {
+			for (lu_hash_bucket_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+				if (!lu_hash_expired(node->expire, snapshot->now)) {
+					visit(node->key, node->value, ctx);
+				}
+			}
+		}
+		else if (bucket->data.rb_tree != NULL) {
+			lu_rb_tree_t* tree = bucket->data.rb_tree;
+			if (tree->root == tree->nil) {
+				continue;
+			}
+			for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+				if (!lu_hash_expired(node->expire, snapshot->now)) {
+					visit(node->key, node->value, ctx);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief lu_hash_table_foreach callback that frees a saved bucket copy.
+ */
+static void lu_hash_snapshot_free_bucket(int key, void* value, void* ctx)
+{
+	(void)key;
+	(void)ctx;
+	lu_hash_bucket_t* bucket = (lu_hash_bucket_t*)value;
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		lu_hash_list_destory(bucket);
+	}
+	else {
+		lu_hash_rb_tree_destory(bucket);
+	}
+	LU_MM_FREE(bucket);
+}
+
+/**
+ * @brief Releases a snapshot and the bucket copies it holds.
+ *
+ * The table stops copying buckets. The values the snapshot points to are not freed.
+ *
+ * @param snapshot A pointer to the snapshot. If NULL, the function does nothing.
+ */
+void lu_hash_snapshot_release(lu_hash_snapshot_t* snapshot)
+{
+	if (snapshot == NULL) {
+		return;
+	}
+	if (snapshot->table != NULL) {
+		snapshot->table->snapshot = NULL;
+	}
+
+	lu_hash_table_foreach(snapshot->saved, lu_hash_snapshot_free_bucket, NULL);
+	lu_hash_table_destroy(snapshot->saved);
+	LU_MM_FREE(snapshot->preserved);
+	LU_MM_FREE(snapshot);
+}
+
+/**
+ * Creates an empty table with the bucket count, seed and configuration of another table.
+ *
+ * Tables created this way hash every key to the same bucket index as the model, which lets
+ * lu_hash_table_union, lu_hash_table_intersect and lu_hash_table_difference work bucket against
+ * bucket. Typical use is one partial table per worker, all created like the global table.
+ * Settings such as capacity, filter or clock are not copied.
+ *
+ * @param model The table whose layout is copied.
+ * @return A pointer to the new table, or exits the program if memory allocation fails.
+ */
+lu_hash_table_t* lu_hash_table_init_like(const lu_hash_table_t* model)
+{
+	lu_hash_table_t* table = lu_hash_table_init_with_config(model->table_size, &model->config);
+	table->seed = model->seed;
+	return table;
+}
+
+/**
+ * Moves every entry of `src` into `dst`.
+ *
+ * For keys present in both tables, `merge` decides the value that `dst` keeps; without it the
+ * value of `src` wins. `src` is left empty. If both tables have the same seed and bucket count (see
+ * lu_hash_table_init_like), bucket i of `src` is merged into bucket i of `dst` and list nodes are
+ * relinked rather than reallocated. Otherwise every key is hashed for `dst`, and `dst` is grown to
+ * the final size first.
+ *
+ * With `thread_count` above 1, the same-layout case splits the buckets into ranges processed in
+ * parallel; `merge` must then be safe to call from several threads. Tables with an active snapshot
+ * are always processed by the calling thread.
+ *
+ * @param dst The table receiving the entries.
+ * @param src The table giving up its entries.
+ * @param merge Combines the values of keys present in both tables, may be NULL.
+ * @param ctx Context pointer passed to `merge`.
+ * @param thread_count The number of threads to use, 0 or 1 for the calling thread only.
+ */
+void lu_hash_table_union(lu_hash_table_t* dst, lu_hash_table_t* src, lu_hash_merge_func_t merge, void* ctx, size_t thread_count)
+{
+	lu_hash_bulk_run(dst, src, LU_HASH_BULK_UNION, merge, ctx, thread_count);
+}
+
+/**
+ * Removes from `dst` every key that is not in `src`.
+ *
+ * For the remaining keys, `merge` (if not NULL) decides the value that `dst` keeps. `src` is not
+ * modified. Values of removed entries are not released. Layout and threading work as for
+ * lu_hash_table_union.
+ *
+ * @param dst The table to narrow down.
+ * @param src The table whose keys are kept.
+ * @param merge Combines the values of keys present in both tables, may be NULL.
+ * @param ctx Context pointer passed to `merge`.
+ * @param thread_count The number of threads to use, 0 or 1 for the calling thread only.
+ */
+void lu_hash_table_intersect(lu_hash_table_t* dst, const lu_hash_table_t* src, lu_hash_merge_func_t merge, void* ctx, size_t thread_count)
+{
+	lu_hash_bulk_run(dst, (lu_hash_table_t*)src, LU_HASH_BULK_INTERSECT, merge, ctx, thread_count);
+}
+
+/**
+ * Removes from `dst` every key that is in `src`.
+ *
+ * `src` is not modified. Values of removed entries are not released. Layout and threading work
+ * as for lu_hash_table_union.
+ *
+ * @param dst The table to remove keys from.
+ * @param src The table whose keys are removed.
+ * @param thread_count The number of threads to use, 0 or 1 for the calling thread only.
+ */
+void lu_hash_table_difference(lu_hash_table_t* dst, const lu_hash_table_t* src, size_t thread_count)
+{
+	lu_hash_bulk_run(dst, (lu_hash_table_t*)src, LU_HASH_BULK_DIFFERENCE, NULL, NULL, thread_count);
+}
+
+/**
+ * @brief Runs a bulk operation over all buckets, on one or several threads, and settles the
+ * table-wide counters afterwards.
+ */
+static void lu_hash_bulk_run(lu_hash_table_t* dst, lu_hash_table_t* src, lu_hash_bulk_op_t op, lu_hash_merge_func_t merge, void* ctx, size_t thread_count)
+{
+	if (dst == src) {
+		if (op == LU_HASH_BULK_DIFFERENCE) {
+			lu_hash_table_t* copy = lu_hash_table_clone(src);
+			lu_hash_bulk_run(dst, copy, op, NULL, NULL, thread_count);
+			lu_hash_table_destroy(copy);
+		}
+		return;
+	}
+
+	int same_layout = dst->seed == src->seed && dst->table_size == src->table_size && dst->config.hash == src->config.hash;
+
+	// Grow dst once up front when keys are hashed anyway, instead of resizing while merging
+	if (op == LU_HASH_BULK_UNION && !same_layout) {
+		size_t new_size = dst->table_size;
+		while ((double)(dst->element_count + src->element_count) / new_size > dst->config.max_load_factor) {
+			new_size = lu_hash_table_grown_size(dst, new_size);
+		}
+		if (new_size != dst->table_size) {
+			lu_hash_table_rehash(dst, new_size);
+		}
+	}
+
+	// Buckets are independent only when they pair up; snapshots record copies in a shared table and
+	// write callbacks expect changes in a single order
+	size_t bucket_count = op == LU_HASH_BULK_UNION ? src->table_size : dst->table_size;
+	if (!same_layout || dst->snapshot != NULL || src->snapshot != NULL || thread_count < 1
+		|| dst->on_write != NULL || src->on_write != NULL) {
+		thread_count = 1;
+	}
+	if (thread_count > bucket_count) {
+		thread_count = bucket_count;
+	}
+
+	lu_hash_bulk_job_t* jobs = (lu_hash_bulk_job_t*)LU_MM_CALLOC(thread_count, sizeof(lu_hash_bulk_job_t));
+	for (size_t t = 0; t < thread_count; t++) {
+		jobs[t].dst = dst;
+		jobs[t].src = src;
+		jobs[t].merge = merge;
+		jobs[t].ctx = ctx;
+		jobs[t].op = op;
+		jobs[t].same_layout = same_layout;
+		jobs[t].concurrent = thread_count > 1;
+		jobs[t].begin = bucket_count * t / thread_count;
+		jobs[t].end = bucket_count * (t + 1) / thread_count;
+		jobs[t].src_now = src->ttl_in_use ? lu_hash_table_now(src) : 0;
+	}
+
+	if (thread_count == 1) {
+		lu_hash_bulk_worker(&jobs[0]);
+	}
+	else {
+		lu_thread_t* threads = (lu_thread_t*)LU_MM_MALLOC(thread_count * sizeof(lu_thread_t));
+		size_t started = 1;
+		while (started < thread_count && lu_thread_create(&threads[started], lu_hash_bulk_worker, &jobs[started]) == 0) {
+			started++;
+		}
+		lu_hash_bulk_worker(&jobs[0]);
+		for (size_t t = 1; t < started; t++) {
+			lu_thread_join(threads[t]);
+		}
+		// Ranges whose thread could not be started are processed here
+		for (size_t t = started; t < thread_count; t++) {
+			lu_hash_bulk_worker(&jobs[t]);
+		}
+		LU_MM_FREE(threads);
+	}
+
+	size_t added = 0, removed = 0, treeified = 0;
+	for (size_t t = 0; t < thread_count; t++) {
+		added += jobs[t].added;
+		removed += jobs[t].removed;
+		treeified += jobs[t].treeified;
+		dst->value_bytes += jobs[t].value_bytes_added - jobs[t].value_bytes_removed;
+	}
+	LU_MM_FREE(jobs);
+
+	dst->element_count += added;
+	dst->element_count -= removed;
+	if (op == LU_HASH_BULK_UNION) {
+		src->element_count = 0;
+		src->value_bytes = 0;
+		if (src->ttl_in_use) {
+			dst->ttl_in_use = 1;
+		}
+		if (src->filter != NULL) {
+			lu_hash_filter_build(src);
+		}
+	}
+
+	// Threads could not share the filter words, rebuild it from the final contents instead
+	if (dst->filter != NULL) {
+		dst->filter_removed += removed;
+		if (thread_count > 1 || dst->filter_removed > dst->element_count / 2 + LU_HASH_BUCKET_LIST_THRESHOLD) {
+			lu_hash_filter_build(dst);
+		}
+	}
+
+	dst->treeify_count += treeified;
+	int reseeded = lu_hash_table_treeify_suspect(dst) && lu_hash_table_auto_reseed(dst);
+	if (!reseeded && (double)dst->element_count / dst->table_size > dst->config.max_load_factor) {
+		size_t new_size = dst->table_size;
+		while ((double)dst->element_count / new_size > dst->config.max_load_factor) {
+			new_size = lu_hash_table_grown_size(dst, new_size);
+		}
+		lu_hash_table_rehash(dst, new_size);
+	}
+
+	while (lu_hash_table_over_capacity(dst) && lu_hash_table_evict_one(dst)) {
+	}
+}
+
+/**
+ * @brief Processes the bucket range of one bulk job.
+ */
+static void lu_hash_bulk_worker(void* arg)
+{
+	lu_hash_bulk_job_t* job = (lu_hash_bulk_job_t*)arg;
+	for (size_t i = job->begin; i < job->end; i++) {
+		if (job->op == LU_HASH_BULK_UNION) {
+			lu_hash_bulk_union_bucket(job, i);
+		}
+		else {
+			lu_hash_bulk_filter_bucket(job, i);
+		}
+	}
+}
+
+/**
+ * @brief Moves the entries of bucket `index` of the source table into the destination table.
+ */
+static void lu_hash_bulk_union_bucket(lu_hash_bulk_job_t* job, size_t index)
+{
+	lu_hash_bucket_t* from = &job->src->buckets[index];
+	if (from->type == LU_HASH_BUCKET_LIST && from->data.list_head == NULL) {
+		return;
+	}
+
+	lu_hash_cow_preserve(job->src, index);
+	lu_hash_bucket_node_t* node = lu_hash_bucket_take(from);
+	while (node != NULL) {
+		lu_hash_bucket_node_t* next = node->next;
+		lu_hash_table_notify_write(job->src, LU_HASH_WRITE_DELETE, node->key, NULL, 0);
+		size_t target = job->same_layout ? index : (size_t)lu_hash_function(job->dst->config.hash, node->key, job->dst->seed, job->dst->table_size);
+		lu_hash_bulk_place(job, target, node);
+		node = next;
+	}
+}
+
+/**
+ * @brief Merges one source node into bucket `index` of the destination table.
+ *
+ * The node is relinked into a list bucket, or its entry is inserted into a tree bucket and the
+ * node freed. If the key is already present, the values are merged and the node freed.
+ */
+static void lu_hash_bulk_place(lu_hash_bulk_job_t* job, size_t index, lu_hash_bucket_node_t* node)
+{
+	lu_hash_table_t* dst = job->dst;
+	lu_hash_bucket_t* bucket = &dst->buckets[index];
+	lu_hash_cow_preserve(dst, index);
+
+	// Expiry times are relative to the creation of each table
+	if (node->expire != 0 && job->src->clock_base != dst->clock_base) {
+		long long expire = (long long)node->expire + (long long)(job->src->clock_base - dst->clock_base);
+		node->expire = expire < 1 ? 1 : expire > (long long)LU_HASH_EXPIRE_MAX ? LU_HASH_EXPIRE_MAX : (unsigned int)expire;
+	}
+
+	// Look for the key in dst; an entry that has expired there is replaced rather than merged
+	lu_hash_bucket_node_t* list_node = NULL;
+	lu_rb_tree_node_t* tree_node = NULL;
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		list_node = lu_hash_list_find(bucket, node->key);
+	}
+	else if (bucket->data.rb_tree != NULL) {
+		tree_node = lu_hash_rb_tree_find(bucket->data.rb_tree, node->key);
+	}
+	if (list_node != NULL || tree_node != NULL) {
+		void** slot = list_node ? &list_node->value : &tree_node->value;
+		unsigned int old_expire = list_node ? list_node->expire : tree_node->expire;
+		int live = old_expire == 0 || !lu_hash_expired(old_expire, lu_hash_table_now(dst));
+		void* value = live && job->merge ? job->merge(node->key, *slot, node->value, job->ctx) : node->value;
+		lu_hash_table_notify_write(dst, LU_HASH_WRITE_INSERT, node->key, value, node->expire);
+		if (dst->value_size) {
+			job->value_bytes_removed += dst->value_size(*slot);
+			job->value_bytes_added += dst->value_size(value);
+		}
+		*slot = value;
+		if (list_node) {
+			list_node->expire = node->expire;
+		}
+		else {
+			tree_node->expire = node->expire;
+		}
+		LU_HASH_NODE_FREE(node);
+		return;
+	}
+
+	lu_hash_table_notify_write(dst, LU_HASH_WRITE_INSERT, node->key, node->value, node->expire);
+	if (dst->value_size) {
+		job->value_bytes_added += dst->value_size(node->value);
+	}
+	if (dst->filter != NULL && !job->concurrent) {
+		lu_hash_filter_add(dst, lu_hash_mix(dst->config.hash, node->key, dst->seed));
+	}
+	job->added++;
+	bucket->esize_bucket++;
+
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		node->next = bucket->data.list_head;
+		bucket->data.list_head = node;
+		if (bucket->esize_bucket > dst->config.treeify_threshold) {
+			LU_HASH_TRACE_BEGIN();
+			lu_convert_bucket_to_rbtree(bucket);
+			LU_HASH_TRACE_END_STEPS(LU_HASH_TRACE_TREEIFY, dst, node->key, index, bucket->esize_bucket);
+			job->treeified++;
+		}
+	}
+	else {
+		lu_rb_tree_insert(bucket->data.rb_tree, node->key, node->value, node->expire, NULL);
+		LU_HASH_NODE_FREE(node);
+	}
+}
+
+/**
+ * @brief Keeps or drops the entries of bucket `index` of the destination table depending on
+ * whether the source table holds their keys (intersection keeps them, difference drops them).
+ */
+static void lu_hash_bulk_filter_bucket(lu_hash_bulk_job_t* job, size_t index)
+{
+	lu_hash_table_t* dst = job->dst;
+	lu_hash_table_t* src = job->src;
+	lu_hash_bucket_t* bucket = &dst->buckets[index];
+	int keep_common = job->op == LU_HASH_BULK_INTERSECT;
 
-		// Check if the bucket's linked list length exceeds the threshold
-		if (bucket->esize_bucket > LU_HASH_BUCKET_LIST_THRESHOLD) {
-#ifdef LU_HASH_DEBUG
-			printf("Bucket[%d] size exceeded threshold. Converting to red-black tree...\n", index);
-#endif // LU_HASH_DEBUG
-			//Convert the internal structure of bucket from list to rb_tree
-			if (lu_convert_bucket_to_rbtree(bucket) != 1) {
-#ifdef LU_HASH_DEBUG
-				printf("Error: Bucket[%d] failed to convert bucket to red-black tree.\n", index);
-#endif // LU_HASH_DEBUG
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		lu_hash_bucket_node_ptr_t* link = &bucket->data.list_head;
+		while (*link != NULL) {
+			lu_hash_bucket_node_ptr_t node = *link;
+			size_t source = job->same_layout ? index : (size_t)lu_hash_function(src->config.hash, node->key, src->seed, src->table_size);
+			void** slot = lu_hash_bucket_value_slot(&src->buckets[source], node->key, job->src_now);
+
+			if ((slot != NULL) == keep_common) {
+				if (slot != NULL && job->merge) {
+					lu_hash_cow_preserve(dst, index);
+					void* value = job->merge(node->key, node->value, *slot, job->ctx);
+					lu_hash_table_notify_write(dst, LU_HASH_WRITE_INSERT, node->key, value, node->expire);
+					if (dst->value_size) {
+						job->value_bytes_removed += dst->value_size(node->value);
+						job->value_bytes_added += dst->value_size(value);
+					}
+					node->value = value;
+				}
+				link = &node->next;
+				continue;
+			}
+
+			lu_hash_cow_preserve(dst, index);
+			*link = node->next;
+			bucket->esize_bucket--;
+			job->removed++;
+			if (dst->value_size) {
+				job->value_bytes_removed += dst->value_size(node->value);
 			}
+			lu_hash_table_notify_write(dst, LU_HASH_WRITE_DELETE, node->key, NULL, 0);
+			LU_HASH_NODE_FREE(node);
 		}
 	}
-	else if (LU_HASH_BUCKET_RBTREE == bucket->type) {
-		/**Insert into the red-black tree*/
-
-		//Check the rb_tree and nil
-		if (NULL == bucket->data.rb_tree || NULL == bucket->data.rb_tree->nil) {
-#ifdef LU_HASH_DEBUG
-			printf("Inserting key %d into red-black tree \n", key);
-			printf("Error: RB-tree or tree->nil is not initialized\n");
-#endif // LU_HASH_DEBUG
-			lu_hash_erron_global_ = LU_ERROR_TREE_OR_NIL_NOT_INIT;
+	else if (bucket->data.rb_tree != NULL) {
+		lu_rb_tree_t* tree = bucket->data.rb_tree;
+		if (tree->root == tree->nil) {
 			return;
 		}
 
-		lu_rb_tree_insert(bucket->data.rb_tree, key, value);
-		bucket->esize_bucket++;
-		table->element_count++;
+		// Collect the keys to drop first, deleting while walking would invalidate the walk
+		int* dropped = (int*)LU_MM_MALLOC(bucket->esize_bucket * sizeof(int));
+		size_t drop_count = 0;
+		for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+			size_t source = job->same_layout ? index : (size_t)lu_hash_function(src->config.hash, node->key, src->seed, src->table_size);
+			void** slot = lu_hash_bucket_value_slot(&src->buckets[source], node->key, job->src_now);
+
+			if ((slot != NULL) != keep_common) {
+				dropped[drop_count++] = node->key;
+				if (dst->value_size) {
+					job->value_bytes_removed += dst->value_size(node->value);
+				}
+			}
+			else if (slot != NULL && job->merge) {
+				lu_hash_cow_preserve(dst, index);
+				void* value = job->merge(node->key, node->value, *slot, job->ctx);
+				lu_hash_table_notify_write(dst, LU_HASH_WRITE_INSERT, node->key, value, node->expire);
+				if (dst->value_size) {
+					job->value_bytes_removed += dst->value_size(node->value);
+					job->value_bytes_added += dst->value_size(value);
+				}
+				node->value = value;
+			}
+		}
+
+		if (drop_count != 0) {
+			lu_hash_cow_preserve(dst, index);
+		}
+		for (size_t k = 0; k < drop_count; k++) {
+			lu_hash_rb_tree_delete(bucket, dropped[k]);
+			lu_hash_table_notify_write(dst, LU_HASH_WRITE_DELETE, dropped[k], NULL, 0);
+			job->removed++;
+		}
+		LU_MM_FREE(dropped);
 	}
 }
 
 /**
- * @brief Searches for a key in a hash table and returns the corresponding value or node.
- *
- * This function finds the appropriate bucket in the hash table by using the hash function
- * on the given key. It then determines the type of the bucket (linked list or red-black tree)
- * and delegates the search to the corresponding bucket-specific find function. If the key
- * is found, the associated value or node is returned; otherwise, the function returns NULL.
+ * @brief Empties a bucket and returns its entries as a list of bucket nodes.
  *
- * @param table A pointer to the hash table where the key will be searched.
- * @param key The key to search for in the hash table.
- * @return A pointer to the value or node associated with the key if found, or NULL if the key does not exist.
+ * List nodes are handed over as they are; a tree is flattened into newly allocated list nodes
+ * and released.
  */
-void* lu_hash_table_find(lu_hash_table_t* table, int key)
+static lu_hash_bucket_node_t* lu_hash_bucket_take(lu_hash_bucket_t* bucket)
 {
-	// Calculate the index of the bucket in the hash table using the hash function
-	int index = lu_hash_function(key, table->table_size);
+	lu_hash_bucket_node_t* head = NULL;
 
-	// Retrieve the hash bucket at the calculated index
-	lu_hash_bucket_t* bucket = &table->buckets[index];
-
-	// Check the bucket type and call the corresponding find function
 	if (bucket->type == LU_HASH_BUCKET_LIST) {
-		// Use linked list search if the bucket stores data as a list
-		lu_hash_bucket_node_ptr_t node = lu_hash_list_find(bucket, key);
-		if (NULL != node) {
-			return	node->value;
-		}
+		head = bucket->data.list_head;
 	}
-	else if (bucket->type == LU_HASH_BUCKET_RBTREE) {
-		// Use red-black tree search if the bucket stores data as a tree
-		lu_rb_tree_node_t* rb_node = lu_hash_rb_tree_find(bucket->data.rb_tree, key);
-		if (NULL != rb_node) {
-			return rb_node->value;
+	else if (bucket->data.rb_tree != NULL) {
+		lu_rb_tree_t* tree = bucket->data.rb_tree;
+		if (tree->root != tree->nil) {
+			for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+				lu_hash_bucket_node_ptr_t copy = (lu_hash_bucket_node_ptr_t)LU_MM_MALLOC(sizeof(lu_hash_bucket_node_t));
+				copy->key = node->key;
+				copy->value = node->value;
+				copy->expire = node->expire;
+				copy->referenced = node->referenced;
+				copy->compacted = 0;
+				copy->next = head;
+				head = copy;
+			}
 		}
+		lu_hash_rb_tree_destory(bucket);
 	}
-#ifdef LU_HASH_DEBUG
-	printf("Key not found in hash table\n");
-#endif // LU_HASH_DEBUG
 
-	// Return NULL if no matching key is found
-	return NULL;
+	bucket->type = LU_HASH_BUCKET_LIST;
+	bucket->data.list_head = NULL;
+	bucket->esize_bucket = 0;
+	return head;
 }
 
 /**
- * @brief Deletes a key from the hash table.
- *
- * This function locates the appropriate bucket in the hash table using the hash function,
- * identifies the type of the bucket (linked list or red-black tree), and delegates the
- * deletion operation to the corresponding bucket-specific delete function. After the deletion,
- * the element count in the hash table is decremented.
- *
- * @param table A pointer to the hash table from which the key will be deleted.
- * @param key The key to delete from the hash table.
- * @return void
+ * @brief Returns the address of the value stored for a key in a bucket, or NULL if the key is
+ * not in the bucket or its entry has expired at `now` (0 to ignore expiry). Has no side effects,
+ * unlike lu_hash_table_find, so several threads may look up the same table.
  */
-void lu_hash_table_delete(lu_hash_table_t* table, int key)
+static void** lu_hash_bucket_value_slot(lu_hash_bucket_t* bucket, int key, unsigned int now)
 {
-	// Calculate the index of the bucket in the hash table using the hash function
-	int index = lu_hash_function(key, table->table_size);
-
-	// Retrieve the hash bucket at the calculated index
-	lu_hash_bucket_t* bucket = &table->buckets[index];
-
-	// Check the bucket type and call the corresponding delete function
-	if (LU_HASH_BUCKET_LIST == bucket->type) {
-		// Delete the key from the linked list bucket
-		lu_hash_list_delete(bucket, key);
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		lu_hash_bucket_node_t* node = lu_hash_list_find(bucket, key);
+		return node && !lu_hash_expired(node->expire, now) ? &node->value : NULL;
 	}
-	else if (LU_HASH_BUCKET_RBTREE == bucket->type) {
-		// Delete the key from the red-black tree bucket
-		lu_hash_rb_tree_delete(bucket, key);
+	if (bucket->data.rb_tree == NULL) {
+		return NULL;
 	}
-
-	// Decrement the total element count in the hash table
-	table->element_count--;
-
-#ifdef LU_HASH_DEBUG
-	// Debug output to confirm deletion
-	printf("Delete %d in bucket[%p]", key, &bucket);
-#endif // LU_HASH_DEBUG
+	lu_rb_tree_node_t* node = lu_hash_rb_tree_find(bucket->data.rb_tree, key);
+	return node && !lu_hash_expired(node->expire, now) ? &node->value : NULL;
 }
 
 /**
@@ -314,7 +3087,7 @@ void lu_hash_table_delete(lu_hash_table_t* table, int key)
  *
  * This function deallocates all resources associated with the given hash table, including its buckets
  * and their underlying data structures. Depending on the type of each bucket (linked list or red-black tree),
- * the corresponding destruction function is called. Finally, the memory allocated for the buckets and
+ * the corresponding nodes are freed. Finally, the memory allocated for the buckets and
  * the hash table itself is freed.
  *
  * @param table A pointer to the hash table to be destroyed. If the pointer is NULL, the function does nothing.
@@ -327,27 +3100,157 @@ void lu_hash_table_destroy(lu_hash_table_t* table)
 		return;
 	}
 
-	// Iterate through each bucket in the hash table
-	for (int i = 0; i < table->table_size; i++) {
-		lu_hash_bucket_t* bucket = &table->buckets[i];
+	lu_hash_table_destroy_step(table, (size_t)-1);
+}
+
+/**
+ * Destroys a hash table a bounded amount of work at a time.
+ *
+ * Each call does at most `budget` units of work, one per node freed and one per bucket passed,
+ * and remembers where it stopped, so that tearing down a large table can be spread over many short
+ * calls. Any nonzero budget makes progress, even a budget of 1. Once a call has been made the table may no longer be used for anything but further
+ * calls; the last one frees the bucket array and the table itself and returns 1.
+ *
+ * The first call gives an active snapshot its own copy of the buckets, which takes time
+ * proportional to the table and must happen on the thread that owns the table. A call with a
+ * budget of 0 does just that; later calls may then run on any thread, for example a background
+ * reclaimer (luhash_reclaim.h).
+ *
+ * @param table A pointer to the hash table to be destroyed.
+ * @param budget The maximum units of work of this call.
+ * @return 1 if the table has been freed, 0 if more calls are needed.
+ *
+ * Usage example:
+ *     while (!lu_hash_table_destroy_step(table, 4096)) {
+ *         serve_pending_requests();
+ *     }
+ */
+int lu_hash_table_destroy_step(lu_hash_table_t* table, size_t budget)
+{
+	// A snapshot may outlive its table, give it its own copy of the buckets
+	if (table->snapshot != NULL) {
+		lu_hash_snapshot_detach(table->snapshot);
+	}
+
+	// Nodes are freed before the bucket that held them is charged, so every call with a nonzero
+	// budget frees a node or moves past a bucket
+	size_t work = 0;
+	while (table->destroy_cursor < table->table_size) {
+		lu_hash_bucket_t* bucket = &table->buckets[table->destroy_cursor];
 
-		// Destroy the bucket if it uses a linked list for storage
 		if (bucket->type == LU_HASH_BUCKET_LIST) {
-			lu_hash_list_destory(bucket);
+			while (bucket->data.list_head != NULL) {
+				if (work >= budget) {
+					return 0;
+				}
+				lu_hash_bucket_node_ptr_t node = bucket->data.list_head;
+				bucket->data.list_head = node->next;
+				LU_HASH_NODE_FREE(node);
+				work++;
+			}
 		}
-		// Destroy the bucket if it uses a red-black tree for storage
-		else if (bucket->type == LU_HASH_BUCKET_RBTREE) {
-			if (bucket->data.rb_tree != NULL) {
-				lu_hash_rb_tree_destory(bucket);
+		else if (bucket->type == LU_HASH_BUCKET_RBTREE && bucket->data.rb_tree != NULL) {
+			lu_rb_tree_t* tree = bucket->data.rb_tree;
+			work += lu_rb_tree_destroy_nodes(tree, budget - work);
+			if (tree->root != tree->nil) {
+				return 0;
 			}
+			lu_hash_rb_tree_destory(bucket);
+			bucket->data.rb_tree = NULL;
+		}
+
+		if (work >= budget) {
+			return 0;
 		}
+		work++;
+		table->destroy_cursor++;
 	}
 
 	// Free the memory allocated for the buckets array
-	LU_MM_FREE(table->buckets);
+	lu_hash_buckets_free(&table->config, table->buckets);
+	LU_MM_FREE(table->filter_memory);
+	lu_hash_compact_release(table);
 
 	// Free the memory allocated for the hash table structure itself
 	LU_MM_FREE(table);
+	return 1;
+}
+
+/**
+ * @brief Calls a function for every key-value pair stored in the hash table.
+ *
+ * Buckets are visited in index order; list buckets in list order and tree buckets in key order.
+ * Entries whose TTL has run out are skipped. The callback must not modify the table.
+ *
+ * @param table A pointer to the hash table.
+ * @param visit The function called for each element.
+ * @param ctx   Opaque pointer passed through to the callback.
+ */
+void lu_hash_table_foreach(const lu_hash_table_t* table, lu_hash_visit_func_t visit, void* ctx)
+{
+	// Expired entries that have not been removed yet are skipped
+	unsigned int now = table->ttl_in_use ? lu_hash_table_now(table) : 0;
+
+	for (size_t i = 0; i < table->table_size; i++) {
+		lu_hash_bucket_t* bucket = &table->buckets[i];
+		if (bucket->type == LU_HASH_BUCKET_LIST) {
+			for (lu_hash_bucket_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+				if (!lu_hash_expired(node->expire, now)) {
+					visit(node->key, node->value, ctx);
+				}
+			}
+		}
+		else if (bucket->type == LU_HASH_BUCKET_RBTREE && bucket->data.rb_tree != NULL) {
+			lu_rb_tree_t* tree = bucket->data.rb_tree;
+			if (tree->root == tree->nil) {
+				continue;
+			}
+			// In-order walk without recursion
+			for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+				if (!lu_hash_expired(node->expire, now)) {
+					visit(node->key, node->value, ctx);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief Calls a function for every entry of the hash table, with its expiry time.
+ *
+ * Visits the same entries in the same order as lu_hash_table_foreach, and also passes the
+ * expiry time of each entry as a reading of the table clock (0 if it never expires), so that
+ * entries can be written out and restored later with the TTL they have left.
+ *
+ * @param table A pointer to the hash table.
+ * @param visit The function called for each element.
+ * @param ctx   Opaque pointer passed through to the callback.
+ */
+void lu_hash_table_foreach_entry(const lu_hash_table_t* table, lu_hash_entry_func_t visit, void* ctx)
+{
+	unsigned int now = table->ttl_in_use ? lu_hash_table_now(table) : 0;
+
+	for (size_t i = 0; i < table->table_size; i++) {
+		lu_hash_bucket_t* bucket = &table->buckets[i];
+		if (bucket->type == LU_HASH_BUCKET_LIST) {
+			for (lu_hash_bucket_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+				if (!lu_hash_expired(node->expire, now)) {
+					visit(node->key, node->value, node->expire ? table->clock_base + node->expire - 1 : 0, ctx);
+				}
+			}
+		}
+		else if (bucket->type == LU_HASH_BUCKET_RBTREE && bucket->data.rb_tree != NULL) {
+			lu_rb_tree_t* tree = bucket->data.rb_tree;
+			if (tree->root == tree->nil) {
+				continue;
+			}
+			for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+				if (!lu_hash_expired(node->expire, now)) {
+					visit(node->key, node->value, node->expire ? table->clock_base + node->expire - 1 : 0, ctx);
+				}
+			}
+		}
+	}
 }
 
 /**
@@ -355,8 +3258,9 @@ void lu_hash_table_destroy(lu_hash_table_t* table)
  *
  * This function takes a hash bucket that is implemented as a linked list,
  * initializes a new red-black tree, and transfers all elements from the linked
- * list to the red-black tree. Once the transfer is complete, it updates the bucket
- * to use the red-black tree as its underlying data structure.
+ * list to the red-black tree, sorted by key and linked into a balanced tree in one
+ * pass. Once the transfer is complete, it updates the bucket to use the red-black
+ * tree as its underlying data structure.
  *
  * @param bucket Pointer to the hash bucket to be converted.
  * @return 1 on success, -1 on failure (e.g., memory allocation error or invalid bucket).
@@ -380,28 +3284,73 @@ static int lu_convert_bucket_to_rbtree(lu_hash_bucket_t* bucket)
 		return -1;// Return error if memory allocation for the red-black tree fails
 	}
 
-	// Transfer elements from the linked list to the red-black tree
-	lu_hash_bucket_node_ptr_t node = bucket->data.list_head;// Start with the head of the list
-
-	// Transfer all elements from the linked list to the red-black tree
-	while (node)
-	{
-		lu_rb_tree_insert(new_tree, node->key, node->value); // Insert key-value pair into the red-black tree
-		lu_hash_bucket_node_ptr_t temp = node; // Save current node pointer
-		node = node->next; // Move to the next node
-		LU_MM_FREE(temp); // Free the memory of the linked list node
+	// Copy the list into tree nodes and sort them, so that the tree is linked in one pass instead of
+	// being rebalanced once per key
+	size_t count = 0;
+	for (lu_hash_bucket_node_ptr_t node = bucket->data.list_head; node != NULL; node = node->next) {
+		count++;
+	}
+	lu_rb_tree_node_t** nodes = (lu_rb_tree_node_t**)LU_MM_MALLOC((count ? count : 1) * sizeof(lu_rb_tree_node_t*));
+	lu_hash_bucket_node_ptr_t node = bucket->data.list_head;
+	for (size_t i = 0; i < count; i++) {
+		lu_rb_tree_node_t* tree_node = (lu_rb_tree_node_t*)LU_MM_MALLOC(sizeof(lu_rb_tree_node_t));
+		tree_node->key = node->key;
+		tree_node->value = node->value;
+		tree_node->expire = node->expire;
+		tree_node->referenced = node->referenced;
+		tree_node->compacted = 0;
+		nodes[i] = tree_node;
+
+		lu_hash_bucket_node_ptr_t temp = node;
+		node = node->next;
+		LU_HASH_NODE_FREE(temp); // Free the memory of the linked list node
 	}
+	qsort(nodes, count, sizeof(lu_rb_tree_node_t*), lu_rb_tree_node_compare);
 
 	// Update the bucket to use the red-black tree
 	bucket->data.list_head = NULL;			// Clear the linked list head
 	bucket->type = LU_HASH_BUCKET_RBTREE;	// Update the bucket type
 	bucket->data.rb_tree = new_tree;		// Point to the new red-black tree
+	lu_hash_tree_rebuild(bucket, nodes, count);
+	LU_MM_FREE(nodes);
 #ifdef LU_HASH_DEBUG
 	printf("Bucket[%p] successfully converted to red-black tree.\n", &bucket);
 #endif
 	return 1; // Indicate successful conversion
 }
 
+/**
+ * @brief Converts a red-black tree bucket back into a linked list.
+ *
+ * The nodes are copied into list nodes in key order, keeping their expiry and reference bits, and
+ * the tree is released.
+ *
+ * @param bucket Pointer to the hash bucket to be converted.
+ */
+static void lu_convert_bucket_to_list(lu_hash_bucket_t* bucket)
+{
+	lu_rb_tree_t* tree = bucket->data.rb_tree;
+	lu_hash_bucket_node_ptr_t head = NULL;
+	lu_hash_bucket_node_ptr_t* tail = &head;
+	if (tree->root != tree->nil) {
+		for (lu_rb_tree_node_t* node = lu_rb_tree_minimum(tree, tree->root); node != tree->nil; node = lu_rb_tree_successor(tree, node)) {
+			lu_hash_bucket_node_ptr_t list_node = (lu_hash_bucket_node_ptr_t)LU_MM_MALLOC(sizeof(lu_hash_bucket_node_t));
+			list_node->key = node->key;
+			list_node->value = node->value;
+			list_node->expire = node->expire;
+			list_node->referenced = node->referenced;
+			list_node->compacted = 0;
+			list_node->next = NULL;
+			*tail = list_node;
+			tail = &list_node->next;
+		}
+	}
+	lu_hash_rb_tree_destory(bucket);
+
+	bucket->type = LU_HASH_BUCKET_LIST;
+	bucket->data.list_head = head;
+}
+
 /**
  * Initializes a red-black tree.
  * Allocates memory for the tree and its sentinel node (`nil`), and sets
@@ -454,73 +3403,84 @@ static lu_rb_tree_t* lu_rb_tree_init()
  * red-black tree. If the tree or its nil sentinel node is uninitialized, or if memory allocation
  * for the new node fails, the function will exit early with an error message (if debugging is enabled).
  *
+ * If a node with the same key already exists, its value is updated in place and no new
+ * node is allocated.
+ *
  * @param tree Pointer to the red-black tree.
  * @param key The key for the new node.
  * @param value The value associated with the key in the new node.
+ * @param expire Expiry time of the entry on the table clock, 0 if it never expires.
+ * @param depth If not NULL, receives the number of nodes passed on the way down from the root.
+ * @return 1 if a new node was inserted, 0 if an existing key was updated, -1 on error.
  */
-static void lu_rb_tree_insert(lu_rb_tree_t* tree, int key, void* value)
+static int lu_rb_tree_insert(lu_rb_tree_t* tree, int key, void* value, unsigned int expire, size_t* depth)
 {
 	if (NULL == tree || NULL == tree->nil) {
 #ifdef LU_HASH_DEBUG
 		printf("Error: RB-tree or tree->nil is not initialized\n");
 #endif // LU_HASH_DEBUG
 		lu_hash_erron_global_ = LU_ERROR_TREE_OR_NIL_NOT_INIT;
-		return;
+		return -1;
+	}
+
+	// Find the insertion point, updating the value in place if the key is already present
+	lu_rb_tree_node_t* parent = tree->nil;	// Pointer to track the parent of the new node.
+	lu_rb_tree_node_t* current = tree->root;// Pointer to traverse the tree.
+	size_t steps = 0;
+	while (current != tree->nil) {
+		parent = current;
+		steps++;
+		LU_HASH_TRACE_STEP();
+		if (key == current->key) {
+			current->value = value;
+			current->expire = expire;
+			if (depth) {
+				*depth = steps;
+			}
+			return 0;
+		}
+		current = key < current->key ? current->left : current->right;
+	}
+	if (depth) {
+		*depth = steps;
 	}
+
 	lu_rb_tree_node_t* new_node = (lu_rb_tree_node_t*)LU_MM_MALLOC(sizeof(lu_rb_tree_node_t));
 	if (NULL == new_node) {
 #ifdef LU_HASH_DEBUG
 		printf("Error: Memory allocation failed in not initialized!(lu_rb_tree_node_t)\n");
 #endif // LU_HASH_DEBUG
-		return;
+		return -1;
 	}
 
 	// Initialize the new node with the given key and value.
 	new_node->key = key;
 	new_node->value = value;
+	new_node->expire = expire;
+	new_node->referenced = 0;
+	new_node->compacted = 0;
 	new_node->color = RED;
-	new_node->left = new_node->right = new_node->parent = tree->nil;
+	new_node->left = new_node->right = tree->nil;
+	new_node->parent = parent;
 
-	if (tree->root == tree->nil) {
+	if (parent == tree->nil) {
 		// Case 1:The tree is empty, so the new node becomes the root.
 		tree->root = new_node;
 		new_node->color = BLACK; // Root is always black.
 	}
 	else {
-		// Case 2: Find the correct position for the new node.
-		lu_rb_tree_node_t* parent = tree->root;// Pointer to track the parent of the new node.
-		lu_rb_tree_node_t* current = tree->root;// Pointer to traverse the tree.
-
-		// Traverse the tree to find the insertion point.
-		while (current != tree->nil) {
-			parent = current;
-			if (key < current->key) {
-				current = current->left;
-			}
-			else {
-				current = current->right;
-			}
-		}
-
-		// Set the parent of the new node and attach it as a child of the parent.
-		new_node->parent = parent;
+		// Case 2: Attach the new node as a child of the parent.
 		if (key < parent->key) {
 			parent->left = new_node;
 		}
 		else {
 			parent->right = new_node;
 		}
-		// Sanity check: Ensure new node and tree are valid before fixing violations.
-		if (new_node == NULL || tree == NULL) {
-#ifdef LU_HASH_DEBUG
-			printf("Error: Invalid node or tree during fixup\n");
-#endif
-			return;
-		}
 
 		// Fix any violations of the red-black tree properties.
 		lu_rb_tree_insert_fixup(tree, new_node);
 	}
+	return 1;
 }
 
 /**
@@ -541,6 +3501,7 @@ static lu_hash_bucket_node_t* lu_hash_list_find(lu_hash_bucket_t* bucket, int ke
 	lu_hash_bucket_node_ptr_t node = bucket->data.list_head;
 	while (node != NULL)
 	{
+		LU_HASH_TRACE_STEP();
 		if (node->key == key) {
 			return node;
 		}
@@ -571,6 +3532,7 @@ static lu_rb_tree_node_t* lu_hash_rb_tree_find(lu_rb_tree_t* tree, int key)
 {
 	lu_rb_tree_node_t* current = tree->root;
 	while (current != tree->nil) {
+		LU_HASH_TRACE_STEP();
 		if (key == current->key) {
 			return current;
 		}
@@ -597,9 +3559,9 @@ static lu_rb_tree_node_t* lu_hash_rb_tree_find(lu_rb_tree_t* tree, int key)
  *
  * @param bucket A pointer to the hash bucket containing the linked list.
  * @param key A pointer to the key of the node to delete from the linked list.
- * @return void
+ * @return 1 if a node was removed, 0 if the key was not found.
  */
-static void lu_hash_list_delete(lu_hash_bucket_t* bucket, int key)
+static int lu_hash_list_delete(lu_hash_bucket_t* bucket, int key)
 {
 	// Pointers to track the current node and its previous node
 	lu_hash_bucket_node_ptr_t prev = NULL;
@@ -607,6 +3569,7 @@ static void lu_hash_list_delete(lu_hash_bucket_t* bucket, int key)
 
 	// Iterate through the linked list to find the node with the matching key
 	while (node != NULL) {
+		LU_HASH_TRACE_STEP();
 		// If the key matches the current node's key
 		if (node->key == (key)) {
 			// If the node to delete is the head of the list
@@ -618,16 +3581,18 @@ static void lu_hash_list_delete(lu_hash_bucket_t* bucket, int key)
 				prev->next = node->next;
 			}
 			// Free the memory allocated for the node
-			LU_MM_FREE(node);
-			return;
+			LU_HASH_NODE_FREE(node);
+
+			// Decrement the bucket's element count after deletion
+			bucket->esize_bucket--;
+			return 1;
 		}
 		// Move to the next node in the list, updating the previous node pointer
 		prev = node;
 		node = node->next;
 	}
 
-	// Decrement the bucket's element count after deletion
-	bucket->esize_bucket--;
+	return 0;
 }
 
 /**
@@ -640,14 +3605,14 @@ static void lu_hash_list_delete(lu_hash_bucket_t* bucket, int key)
  *
  * @param bucket A pointer to the hash bucket containing the red-black tree.
  * @param key A pointer to the key of the node to be deleted from the red-black tree.
- * @return void
+ * @return 1 if a node was removed, 0 if the key was not found.
  */
-static void lu_hash_rb_tree_delete(lu_hash_bucket_t* bucket, int key)
+static int lu_hash_rb_tree_delete(lu_hash_bucket_t* bucket, int key)
 {
 	// Find the node with the given key in the red-black tree
 	lu_rb_tree_node_t* node = lu_hash_rb_tree_find(bucket->data.rb_tree, key);
 	if (node == NULL) {
-		return; // Key not found, no action needed
+		return 0; // Key not found, no action needed
 	}
 
 	// Temporary variables for node manipulation
@@ -672,7 +3637,10 @@ static void lu_hash_rb_tree_delete(lu_hash_bucket_t* bucket, int key)
 		x = y->right;
 
 		// If successor is not the direct child of the node
-		if (y->parent != node) {
+		if (y->parent == node) {
+			x->parent = y; // x may be the sentinel, make its parent valid for the fixup
+		}
+		else {
 			lu_rb_tree_transplant(bucket->data.rb_tree, y, y->right);
 			y->right = node->right;
 			y->right->parent = y;
@@ -691,10 +3659,11 @@ static void lu_hash_rb_tree_delete(lu_hash_bucket_t* bucket, int key)
 	}
 
 	// Free the memory allocated for the deleted node
-	LU_MM_FREE(node);
+	LU_HASH_NODE_FREE(node);
 
 	// Decrement the bucket's element count
 	bucket->esize_bucket--;
+	return 1;
 }
 
 /**
@@ -733,6 +3702,7 @@ static void lu_rb_tree_insert_fixup(lu_rb_tree_t* tree, lu_rb_tree_node_t* node)
 				if (node == parent->right) {
 					node = parent;// Move node up to parent
 					lu_rb_tree_left_rotate(tree, node); // Ensure node is valid
+					parent = node->parent; // The rotated-up node is the new parent
 				}
 				parent->color = BLACK;
 				grandparent->color = RED;
@@ -760,6 +3730,7 @@ static void lu_rb_tree_insert_fixup(lu_rb_tree_t* tree, lu_rb_tree_node_t* node)
 				if (node == parent->left) {
 					node = parent;
 					lu_rb_tree_right_rotate(tree, node); // Ensure node is valid
+					parent = node->parent; // The rotated-up node is the new parent
 				}
 				parent->color = BLACK;
 				grandparent->color = RED;
@@ -1003,10 +3974,9 @@ static void lu_rb_tree_transplant(lu_rb_tree_t* tree, lu_rb_tree_node_t* u, lu_r
 		u->parent->right = v;
 	}
 
-	// If `v` is not a sentinel (nil) node, update its parent to `u`'s parent
-	if (v != tree->nil) {
-		v->parent = u->parent;
-	}
+	// Update `v`'s parent to `u`'s parent, even for the sentinel: the delete fixup starts
+	// from `v` and walks up through its parent pointer
+	v->parent = u->parent;
 }
 
 /**
@@ -1142,16 +4112,39 @@ static lu_rb_tree_node_t* lu_rb_tree_maximum(lu_rb_tree_t* tree, lu_rb_tree_node
 	return node;
 }
 
-static void lu_rb_tree_destroy_node(lu_rb_tree_t* tree, lu_rb_tree_node_t* node)
+/**
+ * @brief Frees up to `budget` nodes of a red-black tree without recursion.
+ *
+ * A node with a left child is rotated right until the subtree root has none; it is then freed and
+ * its right subtree takes its place. Every node is rotated at most once over the whole teardown,
+ * no stack is needed however deep the tree is, and the remaining nodes stay reachable from
+ * `tree->root`, so the teardown can continue in a later call. Parent links and colors are not
+ * maintained: the tree is only good for further teardown afterwards.
+ *
+ * @param tree The tree to tear down.
+ * @param budget The maximum number of nodes to free.
+ * @return The number of nodes freed; the tree is empty once `tree->root` is `tree->nil`.
+ */
+static size_t lu_rb_tree_destroy_nodes(lu_rb_tree_t* tree, size_t budget)
 {
-	if (node == tree->nil) {
-		return;
+	lu_rb_tree_node_t* node = tree->root;
+	size_t freed = 0;
+	while (node != tree->nil && freed < budget) {
+		if (node->left != tree->nil) {
+			lu_rb_tree_node_t* left = node->left;
+			node->left = left->right;
+			left->right = node;
+			node = left;
+		}
+		else {
+			lu_rb_tree_node_t* right = node->right;
+			LU_HASH_NODE_FREE(node);
+			freed++;
+			node = right;
+		}
 	}
-
-	lu_rb_tree_destroy_node(tree, node->left);
-	lu_rb_tree_destroy_node(tree, node->right);
-
-	LU_MM_FREE(node);
+	tree->root = node;
+	return freed;
 }
 
 /**
@@ -1173,7 +4166,7 @@ static void lu_hash_list_destory(lu_hash_bucket_t* bucket)
 	while (node != NULL) {
 		lu_hash_bucket_node_ptr_t temp = node; // Store the current node
 		node = node->next;                    // Move to the next node
-		LU_MM_FREE(temp);                     // Free the current node
+		LU_HASH_NODE_FREE(temp);              // Free the current node
 	}
 
 	// Set the list head to NULL to indicate the list is empty
@@ -1184,7 +4177,7 @@ static void lu_hash_list_destory(lu_hash_bucket_t* bucket)
  * @brief Destroys a red-black tree stored in a hash bucket and frees all its memory.
  *
  * This function deallocates all memory associated with a red-black tree stored in the given
- * hash bucket. It first recursively frees all nodes in the tree, then deallocates the sentinel
+ * hash bucket. It first frees all nodes in the tree, then deallocates the sentinel
  * `nil` node, and finally frees the tree structure itself.
  *
  * @param bucket A pointer to the hash bucket containing the red-black tree to be destroyed.
@@ -1197,8 +4190,8 @@ static void lu_hash_rb_tree_destory(lu_hash_bucket_t* bucket)
 		return;
 	}
 
-	// Recursively destroy all nodes in the red-black tree starting from the root
-	lu_rb_tree_destroy_node(bucket->data.rb_tree, bucket->data.rb_tree->root);
+	// Free all nodes of the red-black tree
+	lu_rb_tree_destroy_nodes(bucket->data.rb_tree, (size_t)-1);
 
 	// Free the sentinel nil node if it is not NULL
 	if (bucket->data.rb_tree->nil != NULL) {
@@ -1209,67 +4202,202 @@ static void lu_hash_rb_tree_destory(lu_hash_bucket_t* bucket)
 	LU_MM_FREE(bucket->data.rb_tree);
 }
 
-static void lu_rb_tree_rehash(lu_rb_tree_t* tree, lu_rb_tree_node_t* node, lu_hash_bucket_t* new_buckets, int new_table_size, lu_rb_tree_node_t* nil)
+static void lu_rb_tree_rehash(lu_rb_tree_t* tree, lu_rb_tree_node_t* node, lu_hash_bucket_t* new_buckets, int new_table_size, lu_hash_func_t hash, unsigned long long seed, lu_rb_tree_node_t* nil)
 {
 	if (node != nil) {
-		lu_rb_tree_rehash(tree, node->left, new_buckets, new_table_size, nil);
-		lu_rb_tree_rehash(tree, node->right, new_buckets, new_table_size, nil);
+		lu_rb_tree_rehash(tree, node->left, new_buckets, new_table_size, hash, seed, nil);
+		lu_rb_tree_rehash(tree, node->right, new_buckets, new_table_size, hash, seed, nil);
 
-		int new_index = lu_hash_function(node->key, new_table_size);
+		int new_index = lu_hash_function(hash, node->key, seed, new_table_size);
 		lu_hash_bucket_t* new_bucket = &new_buckets[new_index];
 
 		if (new_bucket->type == LU_HASH_BUCKET_LIST) {
 			lu_hash_bucket_node_ptr_t new_node = (lu_hash_bucket_node_ptr_t)LU_MM_MALLOC(sizeof(lu_hash_bucket_node_t));
 			new_node->key = node->key;
 			new_node->value = node->value;
+			new_node->expire = node->expire;
+			new_node->referenced = node->referenced;
+			new_node->compacted = 0;
 			new_node->next = new_bucket->data.list_head;
 			new_bucket->data.list_head = new_node;
 			new_bucket->esize_bucket++;
 		}
 		else if (new_bucket->type == LU_HASH_BUCKET_RBTREE) {
-			lu_rb_tree_insert(new_bucket->data.rb_tree, node->key, node->value);
+			lu_rb_tree_insert(new_bucket->data.rb_tree, node->key, node->value, node->expire, NULL);
 			new_bucket->esize_bucket++;
 		}
 	}
 }
 
+/**
+ * @brief Returns the bucket count after growing a table of `table_size` buckets once.
+ */
+static size_t lu_hash_table_grown_size(const lu_hash_table_t* table, size_t table_size)
+{
+	size_t new_table_size = (size_t)(table_size * table->config.growth_factor);
+	return new_table_size > table_size ? new_table_size : table_size + 1;
+}
+
 static void lu_hash_table_resize(lu_hash_table_t* table)
 {
-	int new_table_size = table->table_size * 2;
-	lu_hash_bucket_t* new_buckets = (lu_hash_bucket_t*)LU_MM_CALLOC(new_table_size, sizeof(lu_hash_bucket_t));
+	lu_hash_table_rehash(table, lu_hash_table_grown_size(table, table->table_size));
+}
+
+/**
+ * @brief Shrinks a table by its growth factor, as many times as its load stays below the minimum,
+ * but never below the bucket count it was created with.
+ */
+static void lu_hash_table_shrink(lu_hash_table_t* table)
+{
+	// A bulk removal may leave the table several steps too large, shrink it in one rehash
+	size_t new_table_size = table->table_size;
+	do {
+		new_table_size = (size_t)(new_table_size / table->config.growth_factor);
+	} while (new_table_size > table->initial_size && (double)table->element_count / new_table_size < table->config.min_load_factor);
+	if (new_table_size < table->initial_size) {
+		new_table_size = table->initial_size;
+	}
+	if (new_table_size < table->table_size) {
+		lu_hash_table_rehash(table, new_table_size);
+	}
+}
+
+/**
+ * @brief Moves the maximum load factor towards the target chain length after a window of lookups.
+ *
+ * Longer chains than the target mean lookups walk too far, so the table should grow earlier;
+ * shorter ones mean buckets are wasted, so it may fill up more before it grows. The factor moves
+ * one `LU_HASH_ADAPT_STEP` per window, within `LU_HASH_ADAPT_MIN_LOAD_FACTOR` and
+ * `LU_HASH_ADAPT_MAX_LOAD_FACTOR`, and always far enough above `min_load_factor` that a resize
+ * cannot trigger a shrink. It also stays below the load at which more than
+ * `LU_HASH_ADAPT_MAX_TREEIFY_SHARE` of the buckets would outgrow the treeify threshold: from there
+ * on, random keys alone keep converting buckets to trees.
+ */
+static void lu_hash_table_adapt(lu_hash_table_t* table)
+{
+	double average = (double)table->adapt_chain / table->adapt_lookups;
+	double target = table->config.adaptive_chain_length;
+	double load_factor = table->config.max_load_factor;
+	table->adapt_lookups = 0;
+	table->adapt_chain = 0;
+
+	if (average > target) {
+		load_factor /= LU_HASH_ADAPT_STEP;
+	}
+	else if (average * LU_HASH_ADAPT_STEP < target) {
+		load_factor *= LU_HASH_ADAPT_STEP;
+	}
+
+	double lowest = table->config.min_load_factor * table->config.growth_factor * LU_HASH_ADAPT_STEP;
+	if (lowest < LU_HASH_ADAPT_MIN_LOAD_FACTOR) {
+		lowest = LU_HASH_ADAPT_MIN_LOAD_FACTOR;
+	}
+	if (load_factor > LU_HASH_ADAPT_MAX_LOAD_FACTOR) {
+		load_factor = LU_HASH_ADAPT_MAX_LOAD_FACTOR;
+	}
+	// Past this load ordinary buckets start turning into trees, which longer chains do not pay for
+	while (load_factor > lowest && lu_hash_treeify_share(load_factor, table->config.treeify_threshold) > LU_HASH_ADAPT_MAX_TREEIFY_SHARE) {
+		load_factor /= LU_HASH_ADAPT_STEP;
+	}
+	if (load_factor < lowest) {
+		load_factor = lowest;
+	}
+#ifdef LU_HASH_DEBUG
+	if (load_factor != table->config.max_load_factor) {
+		printf("Average chain length %.2f, target %.2f. Maximum load factor %.3f -> %.3f\n", average, target, table->config.max_load_factor, load_factor);
+	}
+#endif // LU_HASH_DEBUG
+	table->config.max_load_factor = load_factor;
+}
+
+/**
+ * @brief Replaces the seed of a hash table and redistributes all elements.
+ *
+ * Called automatically when the number of list-to-tree conversions since the last resize exceeds
+ * lu_hash_reseed_treeify_limit for the table's size and configuration, or when an insert has to
+ * descend more than `LU_HASH_RESEED_TREE_HEIGHT` levels into a bucket tree. Both only happen when
+ * many keys collide, which a random seed makes vanishingly unlikely unless the keys were chosen
+ * against the old seed. Picking a new seed scatters such keys again and brings operations back to
+ * O(1). Automatic reseeds back off when a new seed leaves the collisions in place (see
+ * lu_hash_table_auto_reseed); a call to this function always reseeds.
+ *
+ * @param table A pointer to the hash table.
+ */
+void lu_hash_table_reseed(lu_hash_table_t* table)
+{
+#ifdef LU_HASH_DEBUG
+	printf("Collision pattern detected (%zu tree conversions). Reseeding hash table...\n", table->treeify_count);
+#endif // LU_HASH_DEBUG
+	table->seed = lu_hash_random_seed();
+	table->treeify_count = 0;
+	table->reseed_count++;
+	lu_hash_table_rehash(table, table->table_size);
+}
+
+/**
+ * @brief Redistributes all elements into a new bucket array using the current seed.
+ *
+ * List nodes are relinked into their new buckets, tree buckets are flattened into list nodes and
+ * their trees released. Buckets that end up above the treeify threshold of the table are converted
+ * to red-black trees afterwards.
+ *
+ * @param table A pointer to the hash table.
+ * @param new_table_size The number of buckets after the rehash.
+ */
+static void lu_hash_table_rehash(lu_hash_table_t* table, size_t new_table_size)
+{
+	LU_HASH_TRACE_BEGIN();
 
-	for (int i = 0; i < new_table_size; i++) {
-		new_buckets[i].type = LU_HASH_BUCKET_LIST;
-		new_buckets[i].data.list_head = NULL;
-		new_buckets[i].esize_bucket = 0;
+	// Every node is about to move, an active snapshot has to take its own copy of everything now
+	if (table->snapshot != NULL) {
+		lu_hash_snapshot_detach(table->snapshot);
 	}
 
-	for (int i = 0; i < table->table_size; i++) {
+	lu_hash_bucket_t* new_buckets = lu_hash_buckets_alloc(&table->config, new_table_size);
+
+	for (size_t i = 0; i < table->table_size; i++) {
 		lu_hash_bucket_t* old_bucket = &table->buckets[i];
 		if (old_bucket->type == LU_HASH_BUCKET_LIST) {
+			// Relink the existing list nodes into the new buckets instead of copying them
 			lu_hash_bucket_node_t* node = old_bucket->data.list_head;
 			while (node) {
-				int new_index = lu_hash_function(node->key, new_table_size);
+				lu_hash_bucket_node_t* next = node->next;
+				int new_index = lu_hash_function(table->config.hash, node->key, table->seed, new_table_size);
 				lu_hash_bucket_t* new_bucket = &new_buckets[new_index];
 
-				lu_hash_bucket_node_ptr_t new_node = (lu_hash_bucket_node_ptr_t)LU_MM_MALLOC(sizeof(lu_hash_bucket_node_t));
-				new_node->key = node->key;
-				new_node->value = node->value;
-				new_node->next = new_bucket->data.list_head;
-				new_bucket->data.list_head = new_node;
+				node->next = new_bucket->data.list_head;
+				new_bucket->data.list_head = node;
 				new_bucket->esize_bucket++;
 
-				node = node->next;
+				node = next;
 			}
+			old_bucket->data.list_head = NULL;
 		}
 		else if (old_bucket->type == LU_HASH_BUCKET_RBTREE) {
-			// Handle red-black tree bucket rehashing
+			// Handle red-black tree bucket rehashing, then release the old tree
+			lu_rb_tree_rehash(old_bucket->data.rb_tree, old_bucket->data.rb_tree->root, new_buckets, (int)new_table_size, table->config.hash, table->seed, old_bucket->data.rb_tree->nil);
+			lu_hash_rb_tree_destory(old_bucket);
+		}
+	}
 
-			lu_rb_tree_rehash(old_bucket->data.rb_tree, old_bucket->data.rb_tree->root, new_buckets, new_table_size, old_bucket->data.rb_tree->nil);
+	// Buckets that still collect too many keys go back to red-black trees, and start the count of
+	// conversions for the new bucket array
+	table->treeify_count = 0;
+	for (size_t i = 0; i < new_table_size; i++) {
+		if (new_buckets[i].esize_bucket > table->config.treeify_threshold) {
+			lu_convert_bucket_to_rbtree(&new_buckets[i]);
+			table->treeify_count++;
 		}
 	}
 
-	LU_MM_FREE(table->buckets);
+	lu_hash_buckets_free(&table->config, table->buckets);
 	table->buckets = new_buckets;
 	table->table_size = new_table_size;
+
+	// The filter is sized for the bucket count and keyed by the seed, both may have changed
+	if (table->filter) {
+		lu_hash_filter_build(table);
+	}
+
+	LU_HASH_TRACE_END_STEPS(LU_HASH_TRACE_RESIZE, table, 0, new_table_size, table->element_count);
 }
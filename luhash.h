@@ -26,9 +26,18 @@
  * configurable.
  */
 
+// Strict ISO C (-std=c99/c11) hides the POSIX clocks, sleeps and aligned allocation used by the library
+#if !defined(_WIN32) && defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,9 +47,16 @@ extern "C" {
 
 #define LU_ERROR_OUT_OF_MEMORY			0x10B	 // Error code for hash table memory allocation
 #define LU_ERROR_TREE_OR_NIL_NOT_INIT   0x10C    // Error code for RB-tree or tree->nil isn't initialized
+#define LU_ERROR_INVALID_ARGUMENT		0x10D	 // Error code for an invalid argument passed to an API
+#define LU_ERROR_BUSY					0x10E	 // Error code for a resource already held by another owner
+#define LU_ERROR_PERFECT_HASH_FAILED	0x10F	 // Error code for a perfect hash that could not be constructed
+#define LU_ERROR_IO						0x110	 // Error code for a failed file read, write or sync
+#define LU_ERROR_FULL					0x111	 // Error code for an insert into a table that has no room left
+#define LU_OK							0		 // Success code returned by status-returning APIs
 #define LU_HASH_TABLE_DEFAULT_SIZE		16		 // Default size for hash tables
 #define LU_HASH_TABLE_MAX_LOAD_FACTOR	0.75	 // Maximum allowed load factor
 #define LU_HASH_TABLE_SHRINK_THRESHOLD	0.25     // Shink
+#define LU_HASH_TABLE_GROWTH_FACTOR		2.0		 // Bucket count multiplier of a resize
 
 	/**
 	* Threshold for converting a hash bucket from a linked list to a red-black tree.
@@ -54,11 +70,76 @@ extern "C" {
 	*/
 #define LU_HASH_BUCKET_LIST_THRESHOLD 8
 
+	/**
+	 * Thresholds for automatic reseeding under a collision attack.
+	 * With a random per-table seed, only the share of buckets that the load factor predicts overflows
+	 * into red-black trees. When more buckets than lu_hash_reseed_treeify_limit allows have been
+	 * converted since the last resize, or an insert descends more than `LU_HASH_RESEED_TREE_HEIGHT`
+	 * levels into a bucket tree, the keys were most likely chosen to collide: the table picks a new
+	 * seed and rehashes. `LU_HASH_RESEED_TREEIFY_THRESHOLD` is the allowance on top of the prediction.
+	 * Keys that collide under every seed look the same after the rehash; the table then holds off
+	 * automatic reseeds until its element count has doubled.
+	 */
+#define LU_HASH_RESEED_TREEIFY_THRESHOLD	4
+#define LU_HASH_RESEED_TREE_HEIGHT			12
+
+	/**
+	 * Tables whose buckets stay lists (lu_hash_fixed_t, lu_hash_intrusive_t) reseed when an insert
+	 * finds this many entries in its bucket, see lu_hash_reseed_chain_suspect.
+	 */
+#define LU_HASH_RESEED_CHAIN_LENGTH			32
+
+	/**
+	 * Adaptive load factor (see lu_hash_table_config_t::adaptive_chain_length).
+	 * Every `LU_HASH_ADAPT_WINDOW` lookups, the next insert compares the average number of entries
+	 * in the probed buckets with the target and scales the maximum load factor down or up by
+	 * `LU_HASH_ADAPT_STEP`, keeping it between the two bounds and below the load at which more than
+	 * `LU_HASH_ADAPT_MAX_TREEIFY_SHARE` of the buckets are expected to outgrow the treeify threshold.
+	 */
+#define LU_HASH_ADAPT_WINDOW				1024
+#define LU_HASH_ADAPT_STEP					1.25
+#define LU_HASH_ADAPT_MIN_LOAD_FACTOR		0.25
+#define LU_HASH_ADAPT_MAX_LOAD_FACTOR		4.0
+#define LU_HASH_ADAPT_MAX_TREEIFY_SHARE		1e-5
+
+	/**
+	 * lu_hash_table_remove_if and the batch operations rebuild a tree bucket from a sorted run of
+	 * nodes once a change touches at least one in `LU_HASH_TREE_REBUILD_FRACTION` of its nodes;
+	 * smaller changes are applied one key at a time.
+	 */
+#define LU_HASH_TREE_REBUILD_FRACTION		4
+
+	/** Bits of the bucket index sorted per pass when a batch is partitioned into buckets */
+#define LU_HASH_BATCH_RADIX_BITS			11
+
+	/** Default size of the membership filter in bits per key the table can hold before it grows */
+#define LU_HASH_FILTER_DEFAULT_BITS_PER_KEY	10
+
+	/** Largest expiry time a node can hold (the field shares its word with the CLOCK reference and compaction bits) */
+#define LU_HASH_EXPIRE_MAX					0x3fffffffU
+
+	/**
+	 * Size and alignment of the blocks lu_hash_table_compact relocates nodes into. A node knows it
+	 * lives in a block from its `compacted` bit and finds the block by masking its address; a block
+	 * is freed, and its pages returned to the system, once its last node is gone.
+	 */
+#define LU_HASH_COMPACT_BLOCK_BYTES			(64 * 1024)
+
 #define LU_MM_MALLOC(size)			lu_mm_malloc(size)
 #define LU_MM_CALLOC(nmemb,size)	lu_mm_calloc(nmemb,size)
 #define LU_MM_FREE(ptr)				lu_mm_free(ptr)
 
+	/** Hint to start loading a cache line that is about to be read. Expands to nothing where no hint exists */
+#if defined(__GNUC__) || defined(__clang__)
+#define LU_PREFETCH(addr)			__builtin_prefetch(addr)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define LU_PREFETCH(addr)			_mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#define LU_PREFETCH(addr)			((void)(addr))
+#endif
+
 	//#define  LU_HASH_DEBUG
+	//#define  LU_HASH_TRACE	// Per-operation tracing, see luhash_trace.h
 
 		/** Two types of hash buckets: linked list and red-black tree */
 	typedef enum lu_hash_bucket_type_u {
@@ -72,6 +153,9 @@ extern "C" {
 	typedef struct lu_hash_bucket_node_s {
 		struct lu_hash_bucket_node_s* next; // Pointer to the next node in the bucket
 		int		key;                        // Key of the node
+		unsigned int expire : 30;           // Expiry time on the table clock, 0 if the entry never expires
+		unsigned int referenced : 1;        // CLOCK reference bit, set when the entry is found
+		unsigned int compacted : 1;         // Set if the node lives in a compaction block rather than its own allocation
 		void* value;                        // Pointer to the value associated with the key
 	} lu_hash_bucket_node_t;
 
@@ -95,6 +179,9 @@ extern "C" {
 		struct lu_rb_tree_node_s* parent;
 		lu_node_color_t			  color;
 		int						  key;
+		unsigned int			  expire : 30;	// Expiry time on the table clock, 0 if the entry never expires
+		unsigned int			  referenced : 1;	// CLOCK reference bit, set when the entry is found
+		unsigned int			  compacted : 1;	// Set if the node lives in a compaction block
 		void* value;
 	}lu_rb_tree_node_t;
 
@@ -124,6 +211,76 @@ extern "C" {
 		size_t esize_bucket; // Number of elements in the bucket
 	}lu_hash_bucket_t;
 
+	/** Callback invoked for every key-value pair by lu_hash_table_foreach */
+	typedef void (*lu_hash_visit_func_t)(int key, void* value, void* ctx);
+
+	/** Decides whether lu_hash_table_remove_if removes an entry: nonzero to remove it */
+	typedef int (*lu_hash_pred_func_t)(int key, void* value, void* ctx);
+
+	/**
+	 * Combines the values of a key present in both tables of a bulk operation. Returns the value to
+	 * keep; it may release the value it does not return.
+	 */
+	typedef void* (*lu_hash_merge_func_t)(int key, void* dst_value, void* src_value, void* ctx);
+
+	/** Returns the number of bytes a value counts against the byte budget of a bounded table */
+	typedef size_t(*lu_hash_value_size_func_t)(const void* value);
+
+	/** Kinds of changes reported to the write callback of a table */
+	typedef enum lu_hash_write_op_u {
+		LU_HASH_WRITE_INSERT,	// A key was inserted or its value replaced
+		LU_HASH_WRITE_DELETE,	// A key was removed, by the caller or by expiry or eviction
+	}lu_hash_write_op_t;
+
+	/**
+	 * Callback invoked for every change of a table. `expire_at` is the expiry time of an inserted
+	 * entry as a reading of the table clock, 0 if it never expires.
+	 */
+	typedef void (*lu_hash_write_func_t)(lu_hash_write_op_t op, int key, void* value, unsigned long long expire_at, void* ctx);
+
+	/** Callback invoked for every entry by lu_hash_table_foreach_entry, with expire_at as above */
+	typedef void (*lu_hash_entry_func_t)(int key, void* value, unsigned long long expire_at, void* ctx);
+
+	/**
+	 * Clock used for entry expiry. Returns the current time in seconds; only differences between
+	 * two readings matter. The default reads time(NULL).
+	 */
+	typedef unsigned long long (*lu_hash_clock_func_t)(void);
+
+	/** Allocates memory for the bucket array of a table; returning NULL is treated as out of memory */
+	typedef void* (*lu_hash_alloc_func_t)(size_t size, void* ctx);
+
+	/** Releases memory returned by the matching lu_hash_alloc_func_t */
+	typedef void (*lu_hash_free_func_t)(void* ptr, void* ctx);
+
+	/**
+	 * Seeded 64-bit hash of a key. The low bits select the bucket and the high bits the block of the
+	 * membership filter, so all 64 bits should be well mixed. The default is the 64-bit finalizer of
+	 * MurmurHash3 applied to the key combined with the seed.
+	 *
+	 * `seed` is the table's random seed and must be mixed into the result: reseeding a table under
+	 * attack only helps if a new seed moves the keys. lu_hash_table_init_with_config probes the
+	 * function with two seeds, and a table whose hash ignores the seed never reseeds automatically.
+	 */
+	typedef unsigned long long (*lu_hash_func_t)(int key, unsigned long long seed);
+
+	/**
+	 * Per-table settings, see lu_hash_table_init_with_config. lu_hash_table_config_default fills in
+	 * the values lu_hash_table_init uses.
+	 */
+	typedef struct lu_hash_table_config_s {
+		double			  max_load_factor;	// Grow once element_count / table_size exceeds this
+		double			  min_load_factor;	// Shrink on delete once the load falls below this, 0 to never shrink
+		double			  growth_factor;	// Bucket count multiplier of a resize, above 1
+		size_t			  treeify_threshold;	// A list bucket with more entries turns into a red-black tree
+		size_t			  untreeify_threshold;	// A tree bucket shrinking to this many entries turns back into a list, 0 to keep trees
+		double			  adaptive_chain_length;	// Target average entries per probed bucket, 0 for a fixed max_load_factor
+		lu_hash_alloc_func_t alloc;		// Allocator of the bucket array and compaction blocks, NULL for the system heap
+		lu_hash_free_func_t  free;		// Releases what alloc returned, NULL for the system heap
+		void*			  alloc_ctx;		// Context passed to alloc and free
+		lu_hash_func_t	  hash;			// Key hash, NULL for the built-in seeded hash
+	}lu_hash_table_config_t;
+
 	/**
 	*  Structure representing a hash table
 	*/
@@ -131,8 +288,74 @@ extern "C" {
 		lu_hash_bucket_t* buckets;
 		size_t				  table_size;
 		size_t		      element_count; // Current number of elements in the hash table
+		unsigned long long seed;          // Random seed mixed into every hash
+		size_t			  treeify_count;  // List-to-tree conversions since the last resize or reseed
+		size_t			  reseed_count;   // Number of automatic or manual reseeds
+		size_t			  reseed_hold;    // Automatic reseeds wait until the table holds this many elements
+		lu_hash_clock_func_t clock;       // Time source for entry expiry
+		unsigned long long clock_base;    // Clock reading at creation, expiry times are relative to it
+		int				  ttl_in_use;     // Set once an entry with a TTL has been inserted
+		size_t			  expire_cursor;  // Next bucket examined by lu_hash_table_expire
+		size_t			  expired_count;  // Entries removed because their TTL ran out
+		size_t			  max_entries;    // Entry budget, 0 if unbounded
+		size_t			  max_bytes;      // Byte budget, 0 if unbounded
+		size_t			  value_bytes;    // Sum of value_size over all entries
+		lu_hash_value_size_func_t value_size; // Byte size charged for a value, may be NULL
+		lu_hash_visit_func_t on_evict;    // Called for entries the table drops on its own, may be NULL
+		void*			  evict_ctx;      // Context passed to on_evict
+		size_t			  clock_hand;     // Bucket the CLOCK eviction sweep continues from
+		size_t			  evicted_count;  // Entries evicted to stay within the budget
+		unsigned long long* filter;       // Blocked Bloom filter over the keys, NULL if disabled
+		void*			  filter_memory;  // Allocation holding the cache-line aligned filter
+		size_t			  filter_blocks;  // Number of 512-bit blocks in the filter
+		size_t			  filter_bits_per_key; // Filter bits per key of the table capacity
+		size_t			  filter_removed; // Keys removed from the table since the filter was last built
+		size_t			  filter_negatives;       // Lookups answered by the filter alone
+		size_t			  filter_false_positives; // Lookups the filter let through for absent keys
+		size_t			  filter_expired; // Lookups the filter let through for entries that had just expired
+		struct lu_hash_snapshot_s* snapshot; // Active copy-on-write snapshot, NULL if none
+		lu_hash_write_func_t on_write;    // Called for every change of the table, may be NULL
+		void*			  write_ctx;      // Context passed to on_write
+		lu_hash_table_config_t config;    // Load factors, thresholds, allocator and hash of the table
+		size_t			  initial_size;   // Bucket count at creation, the table never shrinks below it
+		size_t			  adapt_lookups;  // Lookups in the current adaptive window
+		size_t			  adapt_chain;    // Sum of the entries in the buckets those lookups probed
+		void*			  compact_block;  // Block lu_hash_table_compact is filling, NULL if none
+		size_t			  compact_used;   // Bytes of compact_block handed out, including its header
+		size_t			  compact_cursor; // Next bucket examined by lu_hash_table_compact
+		size_t			  destroy_cursor; // Next bucket freed by lu_hash_table_destroy_step
 	}lu_hash_table_t;
 
+	/**
+	 * Structure representing a copy-on-write snapshot of a hash table.
+	 *
+	 * The snapshot reads the bucket array of its table directly. Before the table modifies a bucket
+	 * for the first time, it copies that bucket into the snapshot, so the snapshot keeps seeing the
+	 * contents at the time it was taken.
+	 */
+	typedef struct lu_hash_snapshot_s {
+		lu_hash_table_t*  table;		// Table the snapshot shares buckets with, NULL once detached
+		lu_hash_bucket_t* buckets;		// Bucket array of the table when the snapshot was taken
+		size_t			  table_size;
+		size_t			  element_count;
+		unsigned long long seed;
+		lu_hash_func_t	  hash;			// Key hash of the table
+		unsigned int	  now;			// Table clock when the snapshot was taken, expired entries are hidden
+		unsigned char*	  preserved;	// One bit per bucket, set once the bucket was copied into `saved`
+		lu_hash_table_t*  saved;		// Copies of preserved buckets (lu_hash_bucket_t*), keyed by bucket index
+	}lu_hash_snapshot_t;
+
+	/**
+	 * Statistics of the membership filter of a table.
+	 */
+	typedef struct lu_hash_filter_stats_s {
+		size_t negatives;		// Lookups rejected by the filter without touching the buckets
+		size_t false_positives;	// Lookups the filter passed although the key was absent
+		double false_positive_rate; // false_positives / (false_positives + negatives), 0 if no miss was seen
+		size_t expired;			// Lookups the filter passed for an entry that turned out to have expired, not false positives
+		size_t memory_bytes;	// Size of the filter
+	}lu_hash_filter_stats_t;
+
 	static inline void* lu_mm_malloc(size_t size) {
 		void* ptr = malloc(size);
 		if (ptr == NULL) {
@@ -164,15 +387,63 @@ extern "C" {
 		return ptr;
 	}
 
+	/**
+	 * @brief Mixes a key hash with a table seed into a 64-bit hash (fmix64 of MurmurHash3).
+	 *
+	 * The seeded hash of every table in the library; an `int` key is passed as `(unsigned int)key`.
+	 * The mix is a bijection, so distinct hashes stay distinct for any seed.
+	 */
+	static inline unsigned long long lu_hash_seeded_mix(unsigned long long hash, unsigned long long seed) {
+		unsigned long long h = hash ^ seed;
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
 	/**Function definition*/
 	void* lu_hash_table_find(lu_hash_table_t* table, int key);
 	lu_hash_table_t* lu_hash_table_init(size_t table_size);
+	void lu_hash_table_config_default(lu_hash_table_config_t* config);
+	lu_hash_table_t* lu_hash_table_init_with_config(size_t table_size, const lu_hash_table_config_t* config);
 	void lu_hash_table_insert(lu_hash_table_t* table, int key, void* value);
+	void lu_hash_table_insert_ttl(lu_hash_table_t* table, int key, void* value, unsigned int ttl_seconds);
+	size_t lu_hash_table_expire(lu_hash_table_t* table, size_t max_buckets);
+	void lu_hash_table_set_clock(lu_hash_table_t* table, lu_hash_clock_func_t clock);
+	void lu_hash_table_set_capacity(lu_hash_table_t* table, size_t max_entries, size_t max_bytes, lu_hash_value_size_func_t value_size);
+	void lu_hash_table_set_evict_callback(lu_hash_table_t* table, lu_hash_visit_func_t on_evict, void* ctx);
+	void lu_hash_table_set_write_callback(lu_hash_table_t* table, lu_hash_write_func_t on_write, void* ctx);
+	size_t lu_hash_table_memory_usage(const lu_hash_table_t* table);
+	void lu_hash_table_set_filter(lu_hash_table_t* table, size_t bits_per_key);
+	void lu_hash_table_filter_stats(const lu_hash_table_t* table, lu_hash_filter_stats_t* stats);
+	lu_hash_table_t* lu_hash_table_clone(const lu_hash_table_t* table);
+	lu_hash_table_t* lu_hash_table_init_like(const lu_hash_table_t* model);
+	void lu_hash_table_union(lu_hash_table_t* dst, lu_hash_table_t* src, lu_hash_merge_func_t merge, void* ctx, size_t thread_count);
+	void lu_hash_table_intersect(lu_hash_table_t* dst, const lu_hash_table_t* src, lu_hash_merge_func_t merge, void* ctx, size_t thread_count);
+	void lu_hash_table_difference(lu_hash_table_t* dst, const lu_hash_table_t* src, size_t thread_count);
+	lu_hash_snapshot_t* lu_hash_table_snapshot(lu_hash_table_t* table);
+	void* lu_hash_snapshot_find(lu_hash_snapshot_t* snapshot, int key);
+	void lu_hash_snapshot_foreach(lu_hash_snapshot_t* snapshot, lu_hash_visit_func_t visit, void* ctx);
+	void lu_hash_snapshot_release(lu_hash_snapshot_t* snapshot);
+	void lu_hash_table_insert_batch(lu_hash_table_t* table, const int* keys, void* const* values, size_t count);
 	void lu_hash_table_delete(lu_hash_table_t* table, int key);
+	size_t lu_hash_table_delete_batch(lu_hash_table_t* table, const int* keys, size_t count);
+	size_t lu_hash_table_remove_if(lu_hash_table_t* table, lu_hash_pred_func_t pred, void* ctx);
+	size_t lu_hash_table_compact(lu_hash_table_t* table, size_t max_buckets);
 	void lu_hash_table_destroy(lu_hash_table_t* table);
+	int lu_hash_table_destroy_step(lu_hash_table_t* table, size_t budget);
+	void lu_hash_table_reseed(lu_hash_table_t* table);
+	void lu_hash_table_foreach(const lu_hash_table_t* table, lu_hash_visit_func_t visit, void* ctx);
+	void lu_hash_table_foreach_entry(const lu_hash_table_t* table, lu_hash_entry_func_t visit, void* ctx);
+	unsigned long long lu_hash_random_seed(void);
+	size_t lu_hash_reseed_treeify_limit(size_t table_size, double load_factor, size_t treeify_threshold);
+	int lu_hash_reseed_chain_suspect(size_t chain_length);
 
 #define LU_HASH_TABLE_INIT(size)				lu_hash_table_init(size)
 #define LU_HASH_TABLE_INSERT(table,key,value)	lu_hash_table_insert(table,key,value)
+#define LU_HASH_TABLE_INSERT_TTL(table,key,value,ttl)	lu_hash_table_insert_ttl(table,key,value,ttl)
 #define LU_HASH_TABLE_FIND(table,key)			lu_hash_table_find(table,key)
 #define LU_HASH_TABLE_DELETE(table,key)			lu_hash_table_delete(table,key)
 #define LU_HASH_TABLE_DESTROY(table)			lu_hash_table_destroy(table)
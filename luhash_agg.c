@@ -0,0 +1,520 @@
+#include "luhash_agg.h"
+
+/**
+ * @file luhash_agg.c
+ * @brief Windowed, prefetching group-by aggregation with per-thread partial tables.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+/**
+ * Rows of lu_hash_agg_update_parallel handled by one thread, and the table they go into.
+ */
+typedef struct lu_hash_agg_job_s {
+	lu_hash_agg_t*	 agg;
+	const int*		 keys;
+	const long long* values;	// NULL to count only
+	size_t			 count;
+}lu_hash_agg_job_t;
+
+/**
+ * State of lu_hash_agg_top_k while it walks the groups: a min-heap of the best `k` so far.
+ */
+typedef struct lu_hash_agg_top_s {
+	lu_hash_agg_entry_t* heap;
+	size_t				 size;
+	size_t				 k;
+	lu_hash_agg_field_t	 field;
+}lu_hash_agg_top_t;
+
+/**
+ * Groups of the source of lu_hash_agg_merge collected into a window.
+ */
+typedef struct lu_hash_agg_merge_s {
+	lu_hash_agg_map_t*		 map;
+	int						 keys[LU_HASH_AGG_BATCH_WINDOW];
+	const lu_hash_agg_acc_t* accs[LU_HASH_AGG_BATCH_WINDOW];
+	size_t					 size;
+}lu_hash_agg_merge_t;
+
+/**
+ * Caller's callback of lu_hash_agg_foreach, passed through the generated foreach.
+ */
+typedef struct lu_hash_agg_visit_s {
+	lu_hash_agg_visit_func_t visit;
+	void*					 ctx;
+}lu_hash_agg_visit_t;
+
+static size_t lu_hash_agg_locate(lu_hash_agg_map_t* map, const int* keys, size_t count, lu_hash_agg_acc_t** accs);
+static void lu_hash_agg_settle(lu_hash_agg_map_t* map, size_t deepest);
+static lu_hash_agg_acc_t* lu_hash_agg_slot(lu_hash_agg_map_t* map, lu_hash_agg_map_bucket_t* bucket, int key, size_t* deepest);
+static void lu_hash_agg_merge_flush(lu_hash_agg_merge_t* merge);
+static void lu_hash_agg_worker(void* arg);
+static void lu_hash_agg_merge_visit(int key, lu_hash_agg_acc_t* acc, void* ctx);
+static void lu_hash_agg_foreach_visit(int key, lu_hash_agg_acc_t* acc, void* ctx);
+static void lu_hash_agg_top_visit(int key, lu_hash_agg_acc_t* acc, void* ctx);
+static long long lu_hash_agg_field(const lu_hash_agg_acc_t* acc, lu_hash_agg_field_t field);
+static int  lu_hash_agg_ranks_below(const lu_hash_agg_entry_t* a, const lu_hash_agg_entry_t* b, lu_hash_agg_field_t field);
+static void lu_hash_agg_sift_down(lu_hash_agg_entry_t* heap, size_t size, size_t index, lu_hash_agg_field_t field);
+
+/**
+ * Creates an empty aggregation.
+ *
+ * @param table_size The initial number of buckets, LU_HASH_TABLE_DEFAULT_SIZE if 0. Passing the
+ *        expected number of groups divided by the load factor avoids resizing along the way.
+ * @return A pointer to the new aggregation.
+ *
+ * Usage example:
+ *     lu_hash_agg_t* agg = lu_hash_agg_init(0);
+ */
+lu_hash_agg_t* lu_hash_agg_init(size_t table_size)
+{
+	lu_hash_agg_t* agg = (lu_hash_agg_t*)LU_MM_MALLOC(sizeof(lu_hash_agg_t));
+	agg->map = lu_hash_agg_map_init(table_size);
+	agg->rows = 0;
+	return agg;
+}
+
+/**
+ * Adds rows to their groups.
+ *
+ * Row i adds `values[i]` to the accumulator of group `keys[i]`: one to its count, the value to its
+ * sum, and the value to its minimum and maximum. The rows are processed in windows of
+ * `LU_HASH_AGG_BATCH_WINDOW`: the table is grown first if the window could overfill it, then all
+ * buckets of the window are located and prefetched, then the first node of every list bucket, and
+ * only then are the rows applied.
+ *
+ * @param agg A pointer to the aggregation.
+ * @param keys The group key of every row.
+ * @param values The value of every row, or NULL to count rows only. Minimum and maximum are
+ *        meaningful for groups whose rows all came with values.
+ * @param count The number of rows.
+ *
+ * Usage example:
+ *     lu_hash_agg_update(agg, user_ids, bytes_sent, row_count);
+ */
+void lu_hash_agg_update(lu_hash_agg_t* agg, const int* keys, const long long* values, size_t count)
+{
+	lu_hash_agg_acc_t* accs[LU_HASH_AGG_BATCH_WINDOW];
+	for (size_t base = 0; base < count; base += LU_HASH_AGG_BATCH_WINDOW) {
+		size_t n = count - base < LU_HASH_AGG_BATCH_WINDOW ? count - base : LU_HASH_AGG_BATCH_WINDOW;
+		size_t deepest = lu_hash_agg_locate(agg->map, keys + base, n, accs);
+		for (size_t i = 0; i < n; i++) {
+			lu_hash_agg_acc_t* acc = accs[i];
+			if (values != NULL) {
+				long long value = values[base + i];
+				if (acc->count == 0 || value < acc->min) {
+					acc->min = value;
+				}
+				if (acc->count == 0 || value > acc->max) {
+					acc->max = value;
+				}
+				acc->sum += value;
+			}
+			acc->count++;
+		}
+		lu_hash_agg_settle(agg->map, deepest);
+	}
+	agg->rows += count;
+}
+
+/**
+ * Adds rows to their groups using several threads.
+ *
+ * The rows are split into `thread_count` contiguous ranges. The calling thread aggregates the
+ * first range into `agg` while each other thread aggregates its range into a partial table of its
+ * own, so the threads share nothing; the partial tables are then merged into `agg` and freed.
+ * The merge takes time in proportion to the number of groups per thread, so this pays off when
+ * there are far fewer groups than rows.
+ * Fewer threads are used when there are less than `LU_HASH_AGG_MIN_ROWS_PER_THREAD` rows per
+ * thread, and ranges whose thread cannot be started are aggregated by the calling thread.
+ *
+ * @param agg A pointer to the aggregation.
+ * @param keys The group key of every row.
+ * @param values The value of every row, or NULL to count rows only.
+ * @param count The number of rows.
+ * @param thread_count The number of threads, including the calling one.
+ *
+ * Usage example:
+ *     lu_hash_agg_update_parallel(agg, keys, values, row_count, 8);
+ */
+void lu_hash_agg_update_parallel(lu_hash_agg_t* agg, const int* keys, const long long* values, size_t count, size_t thread_count)
+{
+	if (thread_count > count / LU_HASH_AGG_MIN_ROWS_PER_THREAD) {
+		thread_count = count / LU_HASH_AGG_MIN_ROWS_PER_THREAD;
+	}
+	if (thread_count <= 1) {
+		lu_hash_agg_update(agg, keys, values, count);
+		return;
+	}
+
+	lu_hash_agg_job_t* jobs = (lu_hash_agg_job_t*)LU_MM_CALLOC(thread_count, sizeof(lu_hash_agg_job_t));
+	for (size_t t = 0; t < thread_count; t++) {
+		size_t begin = count * t / thread_count;
+		size_t end = count * (t + 1) / thread_count;
+		jobs[t].agg = t == 0 ? agg : lu_hash_agg_init(agg->map->table_size);
+		jobs[t].keys = keys + begin;
+		jobs[t].values = values != NULL ? values + begin : NULL;
+		jobs[t].count = end - begin;
+	}
+
+	lu_thread_t* threads = (lu_thread_t*)LU_MM_MALLOC(thread_count * sizeof(lu_thread_t));
+	size_t started = 1;
+	while (started < thread_count && lu_thread_create(&threads[started], lu_hash_agg_worker, &jobs[started]) == 0) {
+		started++;
+	}
+	lu_hash_agg_worker(&jobs[0]);
+	for (size_t t = 1; t < started; t++) {
+		lu_thread_join(threads[t]);
+	}
+	// Ranges whose thread could not be started are processed here
+	for (size_t t = started; t < thread_count; t++) {
+		lu_hash_agg_worker(&jobs[t]);
+	}
+	LU_MM_FREE(threads);
+
+	for (size_t t = 1; t < thread_count; t++) {
+		lu_hash_agg_merge(agg, jobs[t].agg);
+		lu_hash_agg_destroy(jobs[t].agg);
+	}
+	LU_MM_FREE(jobs);
+
+#ifdef LU_HASH_DEBUG
+	printf("Aggregated %zu rows on %zu threads into %zu groups\n", count, thread_count, agg->map->element_count);
+#endif // LU_HASH_DEBUG
+}
+
+/**
+ * Folds the groups of one aggregation into another, as if `dst` had also seen the rows of `src`.
+ *
+ * The groups of `src` are applied in prefetched windows like the rows of lu_hash_agg_update.
+ *
+ * @param dst The aggregation that receives the groups.
+ * @param src The aggregation to fold in, left unchanged.
+ */
+void lu_hash_agg_merge(lu_hash_agg_t* dst, const lu_hash_agg_t* src)
+{
+	lu_hash_agg_merge_t merge;
+	merge.map = dst->map;
+	merge.size = 0;
+	lu_hash_agg_map_foreach(src->map, lu_hash_agg_merge_visit, &merge);
+	lu_hash_agg_merge_flush(&merge);
+	dst->rows += src->rows;
+}
+
+/**
+ * @brief Returns the accumulator of a group, or NULL if no row had that key.
+ *
+ * The pointer stays valid until the next update or merge.
+ */
+const lu_hash_agg_acc_t* lu_hash_agg_find(const lu_hash_agg_t* agg, int key)
+{
+	return lu_hash_agg_map_find(agg->map, key);
+}
+
+/**
+ * @brief Returns the number of groups.
+ */
+size_t lu_hash_agg_groups(const lu_hash_agg_t* agg)
+{
+	return agg->map->element_count;
+}
+
+/**
+ * @brief Calls a function for every group, in no particular order.
+ */
+void lu_hash_agg_foreach(const lu_hash_agg_t* agg, lu_hash_agg_visit_func_t visit, void* ctx)
+{
+	lu_hash_agg_visit_t adapter;
+	adapter.visit = visit;
+	adapter.ctx = ctx;
+	lu_hash_agg_map_foreach(agg->map, lu_hash_agg_foreach_visit, &adapter);
+}
+
+/**
+ * Finds the heavy hitters: the `k` groups with the largest value of an accumulator field.
+ *
+ * One pass over the groups with a min-heap of `k` entries, O(groups log k). Groups with equal
+ * values are ranked by ascending key, so the result does not depend on the table layout.
+ *
+ * @param agg A pointer to the aggregation.
+ * @param field The field to rank by.
+ * @param k The number of groups wanted.
+ * @param out Receives up to `k` groups, largest first.
+ * @return The number of groups stored in `out`, the smaller of `k` and the number of groups.
+ *
+ * Usage example:
+ *     lu_hash_agg_entry_t top[10];
+ *     size_t n = lu_hash_agg_top_k(agg, LU_HASH_AGG_COUNT, 10, top);
+ */
+size_t lu_hash_agg_top_k(const lu_hash_agg_t* agg, lu_hash_agg_field_t field, size_t k, lu_hash_agg_entry_t* out)
+{
+	if (k == 0) {
+		return 0;
+	}
+	lu_hash_agg_top_t top;
+	top.heap = out;
+	top.size = 0;
+	top.k = k;
+	top.field = field;
+	lu_hash_agg_map_foreach(agg->map, lu_hash_agg_top_visit, &top);
+
+	// Take the lowest-ranked entry off the heap into the last free slot until the heap is empty
+	for (size_t size = top.size; size > 1; size--) {
+		lu_hash_agg_entry_t lowest = out[0];
+		out[0] = out[size - 1];
+		out[size - 1] = lowest;
+		lu_hash_agg_sift_down(out, size - 1, 0, field);
+	}
+	return top.size;
+}
+
+/**
+ * @brief Frees an aggregation and all of its groups.
+ */
+void lu_hash_agg_destroy(lu_hash_agg_t* agg)
+{
+	if (agg == NULL) {
+		return;
+	}
+	lu_hash_agg_map_destroy(agg->map);
+	LU_MM_FREE(agg);
+}
+
+/**
+ * @brief Finds or creates the accumulators of a window of keys.
+ *
+ * The table is grown first if the window could overfill it, then all buckets of the window are
+ * located and prefetched, then the first node of every list bucket, and only then are the keys
+ * looked up. The accumulators stay valid until lu_hash_agg_settle.
+ *
+ * @return The deepest descent into a tree bucket, for lu_hash_agg_settle.
+ */
+static size_t lu_hash_agg_locate(lu_hash_agg_map_t* map, const int* keys, size_t count, lu_hash_agg_acc_t** accs)
+{
+	lu_hash_agg_map_bucket_t* window[LU_HASH_AGG_BATCH_WINDOW];
+
+	// Grow before the window, so that the bucket pointers stay valid while it is applied
+	while ((double)(map->element_count + count) / map->table_size > LU_HASH_TABLE_MAX_LOAD_FACTOR) {
+		lu_hash_agg_map_rehash(map, map->table_size * 2);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		window[i] = &map->buckets[lu_hash_agg_map_index(map->seed, map->table_size, keys[i])];
+		LU_PREFETCH(window[i]);
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (window[i]->type == LU_HASH_BUCKET_LIST && window[i]->data.list_head != NULL) {
+			LU_PREFETCH(window[i]->data.list_head);
+		}
+	}
+
+	size_t deepest = 0;
+	size_t treeify_count = map->treeify_count;
+	for (size_t i = 0; i < count; i++) {
+		accs[i] = lu_hash_agg_slot(map, window[i], keys[i], &deepest);
+	}
+	// A list converted to a tree moved the accumulators found in it earlier in the window
+	if (map->treeify_count != treeify_count) {
+		for (size_t i = 0; i < count; i++) {
+			accs[i] = lu_hash_agg_slot(map, window[i], keys[i], &deepest);
+		}
+	}
+	return deepest;
+}
+
+/**
+ * @brief Reseeds the table after a window if its buckets suggest colliding keys, as
+ * lu_hash_agg_map_insert would have done on the way.
+ */
+static void lu_hash_agg_settle(lu_hash_agg_map_t* map, size_t deepest)
+{
+	if (deepest > LU_HASH_RESEED_TREE_HEIGHT || map->treeify_count > lu_hash_reseed_treeify_limit(map->table_size, LU_HASH_TABLE_MAX_LOAD_FACTOR, LU_HASH_BUCKET_LIST_THRESHOLD)) {
+		lu_hash_agg_map_reseed(map);
+	}
+}
+
+/**
+ * @brief Returns the accumulator of a key in a bucket located beforehand, adding a zeroed one if
+ * the key is new.
+ *
+ * Unlike lu_hash_agg_map_insert this never resizes or reseeds, which would move the buckets
+ * located for the rest of the window; a list that overflows is converted to a tree in place and
+ * the depth of tree inserts is reported in `deepest` for lu_hash_agg_settle.
+ */
+static lu_hash_agg_acc_t* lu_hash_agg_slot(lu_hash_agg_map_t* map, lu_hash_agg_map_bucket_t* bucket, int key, size_t* deepest)
+{
+	static const lu_hash_agg_acc_t empty = { 0, 0, 0, 0 };
+
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		for (lu_hash_agg_map_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+			if (node->key == key) {
+				return &node->value;
+			}
+		}
+		lu_hash_agg_map_node_t* node = (lu_hash_agg_map_node_t*)LU_MM_MALLOC(sizeof(lu_hash_agg_map_node_t));
+		node->key = key;
+		node->value = empty;
+		node->next = bucket->data.list_head;
+		bucket->data.list_head = node;
+		bucket->esize_bucket++;
+		map->element_count++;
+		if (bucket->esize_bucket <= LU_HASH_BUCKET_LIST_THRESHOLD) {
+			return &node->value;
+		}
+		lu_hash_agg_map_treeify(bucket);
+		map->treeify_count++;
+		return &lu_hash_agg_map_tree_find(bucket->data.rb_tree, key)->value;
+	}
+
+	lu_hash_agg_map_tree_node_t* tree_node = lu_hash_agg_map_tree_find(bucket->data.rb_tree, key);
+	if (tree_node == NULL) {
+		size_t depth = 0;
+		lu_hash_agg_map_tree_insert(bucket->data.rb_tree, key, empty, &depth);
+		bucket->esize_bucket++;
+		map->element_count++;
+		if (depth > *deepest) {
+			*deepest = depth;
+		}
+		tree_node = lu_hash_agg_map_tree_find(bucket->data.rb_tree, key);
+	}
+	return &tree_node->value;
+}
+
+/**
+ * @brief Thread entry of lu_hash_agg_update_parallel.
+ */
+static void lu_hash_agg_worker(void* arg)
+{
+	lu_hash_agg_job_t* job = (lu_hash_agg_job_t*)arg;
+	lu_hash_agg_update(job->agg, job->keys, job->values, job->count);
+}
+
+/**
+ * @brief Adds one group of the source of lu_hash_agg_merge to the window.
+ */
+static void lu_hash_agg_merge_visit(int key, lu_hash_agg_acc_t* acc, void* ctx)
+{
+	lu_hash_agg_merge_t* merge = (lu_hash_agg_merge_t*)ctx;
+	merge->keys[merge->size] = key;
+	merge->accs[merge->size] = acc;
+	if (++merge->size == LU_HASH_AGG_BATCH_WINDOW) {
+		lu_hash_agg_merge_flush(merge);
+	}
+}
+
+/**
+ * @brief Folds the groups in the window of lu_hash_agg_merge into the destination.
+ */
+static void lu_hash_agg_merge_flush(lu_hash_agg_merge_t* merge)
+{
+	lu_hash_agg_acc_t* targets[LU_HASH_AGG_BATCH_WINDOW];
+	size_t deepest = lu_hash_agg_locate(merge->map, merge->keys, merge->size, targets);
+	for (size_t i = 0; i < merge->size; i++) {
+		lu_hash_agg_acc_t* target = targets[i];
+		const lu_hash_agg_acc_t* acc = merge->accs[i];
+		if (target->count == 0) {
+			*target = *acc;
+		}
+		else {
+			target->min = acc->min < target->min ? acc->min : target->min;
+			target->max = acc->max > target->max ? acc->max : target->max;
+			target->sum += acc->sum;
+			target->count += acc->count;
+		}
+	}
+	lu_hash_agg_settle(merge->map, deepest);
+	merge->size = 0;
+}
+
+/**
+ * @brief Passes a group to the callback of lu_hash_agg_foreach.
+ */
+static void lu_hash_agg_foreach_visit(int key, lu_hash_agg_acc_t* acc, void* ctx)
+{
+	lu_hash_agg_visit_t* adapter = (lu_hash_agg_visit_t*)ctx;
+	adapter->visit(key, acc, adapter->ctx);
+}
+
+/**
+ * @brief Offers a group to the heap of lu_hash_agg_top_k.
+ */
+static void lu_hash_agg_top_visit(int key, lu_hash_agg_acc_t* acc, void* ctx)
+{
+	lu_hash_agg_top_t* top = (lu_hash_agg_top_t*)ctx;
+	lu_hash_agg_entry_t entry;
+	entry.key = key;
+	entry.acc = *acc;
+
+	if (top->size < top->k) {
+		// Sift the new entry up from the end of the heap
+		size_t index = top->size++;
+		while (index > 0) {
+			size_t parent = (index - 1) / 2;
+			if (!lu_hash_agg_ranks_below(&entry, &top->heap[parent], top->field)) {
+				break;
+			}
+			top->heap[index] = top->heap[parent];
+			index = parent;
+		}
+		top->heap[index] = entry;
+	}
+	else if (lu_hash_agg_ranks_below(&top->heap[0], &entry, top->field)) {
+		top->heap[0] = entry;
+		lu_hash_agg_sift_down(top->heap, top->size, 0, top->field);
+	}
+}
+
+/**
+ * @brief Returns the value of an accumulator field.
+ */
+static long long lu_hash_agg_field(const lu_hash_agg_acc_t* acc, lu_hash_agg_field_t field)
+{
+	switch (field) {
+	case LU_HASH_AGG_COUNT:	return acc->count;
+	case LU_HASH_AGG_SUM:	return acc->sum;
+	case LU_HASH_AGG_MIN:	return acc->min;
+	case LU_HASH_AGG_MAX:	return acc->max;
+	}
+	return 0;
+}
+
+/**
+ * @brief Tells whether entry `a` ranks below entry `b`: a smaller field value, or the same value
+ * and a larger key.
+ */
+static int lu_hash_agg_ranks_below(const lu_hash_agg_entry_t* a, const lu_hash_agg_entry_t* b, lu_hash_agg_field_t field)
+{
+	long long value_a = lu_hash_agg_field(&a->acc, field);
+	long long value_b = lu_hash_agg_field(&b->acc, field);
+	if (value_a != value_b) {
+		return value_a < value_b;
+	}
+	return a->key > b->key;
+}
+
+/**
+ * @brief Restores the min-heap order below `index` after its entry was replaced.
+ */
+static void lu_hash_agg_sift_down(lu_hash_agg_entry_t* heap, size_t size, size_t index, lu_hash_agg_field_t field)
+{
+	lu_hash_agg_entry_t entry = heap[index];
+	for (;;) {
+		size_t child = 2 * index + 1;
+		if (child >= size) {
+			break;
+		}
+		if (child + 1 < size && lu_hash_agg_ranks_below(&heap[child + 1], &heap[child], field)) {
+			child++;
+		}
+		if (!lu_hash_agg_ranks_below(&heap[child], &entry, field)) {
+			break;
+		}
+		heap[index] = heap[child];
+		index = child;
+	}
+	heap[index] = entry;
+}
@@ -0,0 +1,105 @@
+#ifndef LU_LU_HASH_AGG_INCLUDE_H_
+#define LU_LU_HASH_AGG_INCLUDE_H_
+
+/**
+ * @file luhash_agg.h
+ * @brief Group-by aggregation of integer key streams into count, sum, min and max per key.
+ *
+ * Aggregating with lu_hash_table_t takes a find, an insert for keys seen for the first time and
+ * an update through a `void*` value per row, so every row hashes twice and follows a pointer to a
+ * separately allocated accumulator. lu_hash_agg_t keeps the accumulators inline in the nodes of a
+ * type-specialized table (luhash_define.h) and consumes columns of keys and values: each window
+ * of `LU_HASH_AGG_BATCH_WINDOW` rows is hashed and its buckets prefetched before any row is
+ * applied, so that the cache misses of independent rows overlap, and each row finds or creates
+ * its accumulator in a single bucket walk.
+ *
+ * lu_hash_agg_update_parallel splits the rows over threads that each aggregate into a table of
+ * their own, then merges the partial tables into the result; lu_hash_agg_top_k returns the groups
+ * with the largest count, sum, minimum or maximum.
+ *
+ * Not thread-safe: one thread at a time per aggregation, apart from the workers that
+ * lu_hash_agg_update_parallel manages itself.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include "luhash_define.h"
+#include "luhash_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_AGG_BATCH_WINDOW		16		// Rows hashed and prefetched ahead of being applied
+#define LU_HASH_AGG_MIN_ROWS_PER_THREAD	65536	// Smaller inputs are not worth a thread
+
+	/**
+	 * Accumulator of one group. `min` and `max` are those of the values seen, 0 while only counts
+	 * were added.
+	 */
+	typedef struct lu_hash_agg_acc_s {
+		long long count;
+		long long sum;
+		long long min;
+		long long max;
+	}lu_hash_agg_acc_t;
+
+	/** Hash of an `int` group key for the generated table */
+#define lu_hash_agg_key_hash(key)		((unsigned long long)(unsigned int)(key))
+
+	LU_HASH_DEFINE(lu_hash_agg_map, int, lu_hash_agg_acc_t, lu_hash_agg_key_hash, lu_hash_int64_eq, lu_hash_int64_less)
+
+	/**
+	 * Structure representing an aggregation.
+	 */
+	typedef struct lu_hash_agg_s {
+		lu_hash_agg_map_t* map;		// Accumulator of every group, stored by value
+		size_t			   rows;	// Number of rows aggregated
+	}lu_hash_agg_t;
+
+	/**
+	 * Accumulator field that lu_hash_agg_top_k ranks groups by.
+	 */
+	typedef enum lu_hash_agg_field_u {
+		LU_HASH_AGG_COUNT,
+		LU_HASH_AGG_SUM,
+		LU_HASH_AGG_MIN,
+		LU_HASH_AGG_MAX,
+	}lu_hash_agg_field_t;
+
+	/**
+	 * A group and its accumulator, as returned by lu_hash_agg_top_k.
+	 */
+	typedef struct lu_hash_agg_entry_s {
+		int				  key;
+		lu_hash_agg_acc_t acc;
+	}lu_hash_agg_entry_t;
+
+	/** Callback invoked for every group by lu_hash_agg_foreach */
+	typedef void (*lu_hash_agg_visit_func_t)(int key, const lu_hash_agg_acc_t* acc, void* ctx);
+
+	/**Function definition*/
+	lu_hash_agg_t* lu_hash_agg_init(size_t table_size);
+	void lu_hash_agg_update(lu_hash_agg_t* agg, const int* keys, const long long* values, size_t count);
+	void lu_hash_agg_update_parallel(lu_hash_agg_t* agg, const int* keys, const long long* values, size_t count, size_t thread_count);
+	void lu_hash_agg_merge(lu_hash_agg_t* dst, const lu_hash_agg_t* src);
+	const lu_hash_agg_acc_t* lu_hash_agg_find(const lu_hash_agg_t* agg, int key);
+	size_t lu_hash_agg_groups(const lu_hash_agg_t* agg);
+	void lu_hash_agg_foreach(const lu_hash_agg_t* agg, lu_hash_agg_visit_func_t visit, void* ctx);
+	size_t lu_hash_agg_top_k(const lu_hash_agg_t* agg, lu_hash_agg_field_t field, size_t k, lu_hash_agg_entry_t* out);
+	void lu_hash_agg_destroy(lu_hash_agg_t* agg);
+
+#define LU_HASH_AGG_INIT()							lu_hash_agg_init(0)
+#define LU_HASH_AGG_UPDATE(agg,keys,values,count)	lu_hash_agg_update(agg,keys,values,count)
+#define LU_HASH_AGG_FIND(agg,key)					lu_hash_agg_find(agg,key)
+#define LU_HASH_AGG_DESTROY(agg)					lu_hash_agg_destroy(agg)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_AGG_INCLUDE_H_*/
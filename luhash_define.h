@@ -0,0 +1,673 @@
+#ifndef LU_LU_HASH_DEFINE_INCLUDE_H_
+#define LU_LU_HASH_DEFINE_INCLUDE_H_
+
+/**
+ * @file luhash_define.h
+ * @brief Type-specialized hash tables generated by a macro, in the style of khash.
+ *
+ * lu_hash_table_t stores `int` keys and `void*` values and calls its hash through a function, so
+ * a table of 64-bit keys or of small structs needs a cast or an extra allocation per value, and
+ * every lookup pays for a call the compiler cannot see through.
+ *
+ *     LU_HASH_DEFINE(name, key_t, value_t, hash_fn, eq_fn, less_fn)
+ *
+ * expands to a table type `name_t` and static inline functions `name_init`, `name_insert`,
+ * `name_find`, `name_delete`, `name_foreach`, `name_reseed` and `name_destroy` that store `key_t`
+ * and `value_t` by value in the nodes. `hash_fn(key)` returns an integer hash of a key (it is mixed
+ * with the per-table seed, so an identity hash is fine), `eq_fn(a, b)` tests two keys for equality
+ * and `less_fn(a, b)` orders them. All three may be macros and are inlined at every call site. Keys
+ * and values are copied with plain assignment, so both must be POD types.
+ *
+ * The generated table has the same layout policy as lu_hash_table_t: chained buckets that turn
+ * into red-black trees past LU_HASH_BUCKET_LIST_THRESHOLD entries (hence `less_fn`), doubling past
+ * LU_HASH_TABLE_MAX_LOAD_FACTOR, and a random seed that is replaced when collisions pile up, with
+ * the same back-off when a new seed leaves them in place. It is the core table only: expiry,
+ * capacity limits, filters, snapshots and write callbacks are not generated.
+ *
+ * Usage example:
+ *     LU_HASH_DEFINE_INT64(counts, size_t)
+ *
+ *     counts_t* table = counts_init(0);
+ *     counts_insert(table, 1ll << 40, 1);
+ *     size_t* count = counts_find(table, 1ll << 40);
+ *     counts_destroy(table);
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/** Key functions for 64-bit integer keys */
+#define lu_hash_int64_hash(key)			((unsigned long long)(key))
+#define lu_hash_int64_eq(a,b)			((a) == (b))
+#define lu_hash_int64_less(a,b)			((a) < (b))
+
+	/**
+	 * @brief Defines the red-black tree functions of the buckets of a table type `name`.
+	 *
+	 * Expects `name##_tree_node_t` with the members left, right, parent, color and key, and
+	 * `name##_tree_t` with a root pointer and an inline sentinel `nil`. LU_HASH_DEFINE uses it for its
+	 * generated tables; lu_hash_set_t uses it for tree nodes that carry no value.
+	 */
+#define LU_HASH_DEFINE_TREE(name,key_t,eq_fn,less_fn)															\
+	static inline name##_tree_t* name##_tree_new(void) {														\
+		name##_tree_t* tree = (name##_tree_t*)LU_MM_MALLOC(sizeof(name##_tree_t));								\
+		tree->nil.left = &tree->nil;																			\
+		tree->nil.right = &tree->nil;																			\
+		tree->nil.parent = &tree->nil;																			\
+		tree->nil.color = BLACK;																				\
+		tree->root = &tree->nil;																				\
+		return tree;																							\
+	}																											\
+																												\
+	static inline void name##_tree_rotate_left(name##_tree_t* tree, name##_tree_node_t* x) {					\
+		name##_tree_node_t* y = x->right;																		\
+		x->right = y->left;																						\
+		if (y->left != &tree->nil) {																			\
+			y->left->parent = x;																				\
+		}																										\
+		y->parent = x->parent;																					\
+		if (x->parent == &tree->nil) {																			\
+			tree->root = y;																						\
+		}																										\
+		else if (x == x->parent->left) {																		\
+			x->parent->left = y;																				\
+		}																										\
+		else {																									\
+			x->parent->right = y;																				\
+		}																										\
+		y->left = x;																							\
+		x->parent = y;																							\
+	}																											\
+																												\
+	static inline void name##_tree_rotate_right(name##_tree_t* tree, name##_tree_node_t* x) {					\
+		name##_tree_node_t* y = x->left;																		\
+		x->left = y->right;																						\
+		if (y->right != &tree->nil) {																			\
+			y->right->parent = x;																				\
+		}																										\
+		y->parent = x->parent;																					\
+		if (x->parent == &tree->nil) {																			\
+			tree->root = y;																						\
+		}																										\
+		else if (x == x->parent->right) {																		\
+			x->parent->right = y;																				\
+		}																										\
+		else {																									\
+			x->parent->left = y;																				\
+		}																										\
+		y->right = x;																							\
+		x->parent = y;																							\
+	}																											\
+																												\
+	static inline name##_tree_node_t* name##_tree_minimum(name##_tree_t* tree, name##_tree_node_t* node) {		\
+		while (node->left != &tree->nil) {																		\
+			node = node->left;																					\
+		}																										\
+		return node;																							\
+	}																											\
+																												\
+	static inline name##_tree_node_t* name##_tree_successor(name##_tree_t* tree, name##_tree_node_t* node) {	\
+		if (node->right != &tree->nil) {																		\
+			return name##_tree_minimum(tree, node->right);														\
+		}																										\
+		name##_tree_node_t* parent = node->parent;																\
+		while (parent != &tree->nil && node == parent->right) {													\
+			node = parent;																						\
+			parent = parent->parent;																			\
+		}																										\
+		return parent;																							\
+	}																											\
+																												\
+	static inline name##_tree_node_t* name##_tree_find(name##_tree_t* tree, key_t key) {						\
+		name##_tree_node_t* current = tree->root;																\
+		while (current != &tree->nil) {																			\
+			if (eq_fn(key, current->key)) {																		\
+				return current;																					\
+			}																									\
+			current = less_fn(key, current->key) ? current->left : current->right;								\
+		}																										\
+		return NULL;																							\
+	}																											\
+																												\
+	/* Finds the node of a key or adds one; *added is 1 for a new node, whose other fields the caller sets */	\
+	static inline name##_tree_node_t* name##_tree_insert_key(name##_tree_t* tree, key_t key, size_t* depth, int* added) { \
+		name##_tree_node_t* nil = &tree->nil;																	\
+		name##_tree_node_t* parent = nil;																		\
+		name##_tree_node_t* current = tree->root;																\
+		size_t steps = 0;																						\
+		while (current != nil) {																				\
+			parent = current;																					\
+			steps++;																							\
+			if (eq_fn(key, current->key)) {																		\
+				*depth = steps;																					\
+				*added = 0;																						\
+				return current;																					\
+			}																									\
+			current = less_fn(key, current->key) ? current->left : current->right;								\
+		}																										\
+		*depth = steps;																							\
+																												\
+		name##_tree_node_t* z = (name##_tree_node_t*)LU_MM_MALLOC(sizeof(name##_tree_node_t));					\
+		name##_tree_node_t* node = z;																			\
+		z->key = key;																							\
+		z->left = nil;																							\
+		z->right = nil;																							\
+		z->parent = parent;																						\
+		z->color = RED;																							\
+		if (parent == nil) {																					\
+			tree->root = z;																						\
+		}																										\
+		else if (less_fn(key, parent->key)) {																	\
+			parent->left = z;																					\
+		}																										\
+		else {																									\
+			parent->right = z;																					\
+		}																										\
+																												\
+		while (z->parent->color == RED) {																		\
+			name##_tree_node_t* grandparent = z->parent->parent;												\
+			if (z->parent == grandparent->left) {																\
+				name##_tree_node_t* uncle = grandparent->right;													\
+				if (uncle->color == RED) {																		\
+					z->parent->color = BLACK;																	\
+					uncle->color = BLACK;																		\
+					grandparent->color = RED;																	\
+					z = grandparent;																			\
+				}																								\
+				else {																							\
+					if (z == z->parent->right) {																\
+						z = z->parent;																			\
+						name##_tree_rotate_left(tree, z);														\
+					}																							\
+					z->parent->color = BLACK;																	\
+					z->parent->parent->color = RED;																\
+					name##_tree_rotate_right(tree, z->parent->parent);											\
+				}																								\
+			}																									\
+			else {																								\
+				name##_tree_node_t* uncle = grandparent->left;													\
+				if (uncle->color == RED) {																		\
+					z->parent->color = BLACK;																	\
+					uncle->color = BLACK;																		\
+					grandparent->color = RED;																	\
+					z = grandparent;																			\
+				}																								\
+				else {																							\
+					if (z == z->parent->left) {																	\
+						z = z->parent;																			\
+						name##_tree_rotate_right(tree, z);														\
+					}																							\
+					z->parent->color = BLACK;																	\
+					z->parent->parent->color = RED;																\
+					name##_tree_rotate_left(tree, z->parent->parent);											\
+				}																								\
+			}																									\
+		}																										\
+		tree->root->color = BLACK;																				\
+		*added = 1;																								\
+		return node;																							\
+	}																											\
+																												\
+	static inline void name##_tree_transplant(name##_tree_t* tree, name##_tree_node_t* u, name##_tree_node_t* v) { \
+		if (u->parent == &tree->nil) {																			\
+			tree->root = v;																						\
+		}																										\
+		else if (u == u->parent->left) {																		\
+			u->parent->left = v;																				\
+		}																										\
+		else {																									\
+			u->parent->right = v;																				\
+		}																										\
+		v->parent = u->parent;																					\
+	}																											\
+																												\
+	static inline int name##_tree_delete(name##_tree_t* tree, key_t key) {										\
+		name##_tree_node_t* nil = &tree->nil;																	\
+		name##_tree_node_t* z = name##_tree_find(tree, key);													\
+		if (z == NULL) {																						\
+			return 0;																							\
+		}																										\
+																												\
+		name##_tree_node_t* y = z;																				\
+		name##_tree_node_t* x;																					\
+		lu_node_color_t original_color = y->color;																\
+		if (z->left == nil) {																					\
+			x = z->right;																						\
+			name##_tree_transplant(tree, z, z->right);															\
+		}																										\
+		else if (z->right == nil) {																				\
+			x = z->left;																						\
+			name##_tree_transplant(tree, z, z->left);															\
+		}																										\
+		else {																									\
+			y = name##_tree_minimum(tree, z->right);															\
+			original_color = y->color;																			\
+			x = y->right;																						\
+			if (y->parent == z) {																				\
+				x->parent = y;																					\
+			}																									\
+			else {																								\
+				name##_tree_transplant(tree, y, y->right);														\
+				y->right = z->right;																			\
+				y->right->parent = y;																			\
+			}																									\
+			name##_tree_transplant(tree, z, y);																	\
+			y->left = z->left;																					\
+			y->left->parent = y;																				\
+			y->color = z->color;																				\
+		}																										\
+		LU_MM_FREE(z);																							\
+																												\
+		if (original_color == BLACK) {																			\
+			while (x != tree->root && x->color == BLACK) {														\
+				if (x == x->parent->left) {																		\
+					name##_tree_node_t* w = x->parent->right;													\
+					if (w->color == RED) {																		\
+						w->color = BLACK;																		\
+						x->parent->color = RED;																	\
+						name##_tree_rotate_left(tree, x->parent);												\
+						w = x->parent->right;																	\
+					}																							\
+					if (w->left->color == BLACK && w->right->color == BLACK) {									\
+						w->color = RED;																			\
+						x = x->parent;																			\
+					}																							\
+					else {																						\
+						if (w->right->color == BLACK) {															\
+							w->left->color = BLACK;																\
+							w->color = RED;																		\
+							name##_tree_rotate_right(tree, w);													\
+							w = x->parent->right;																\
+						}																						\
+						w->color = x->parent->color;															\
+						x->parent->color = BLACK;																\
+						w->right->color = BLACK;																\
+						name##_tree_rotate_left(tree, x->parent);												\
+						x = tree->root;																			\
+					}																							\
+				}																								\
+				else {																							\
+					name##_tree_node_t* w = x->parent->left;													\
+					if (w->color == RED) {																		\
+						w->color = BLACK;																		\
+						x->parent->color = RED;																	\
+						name##_tree_rotate_right(tree, x->parent);												\
+						w = x->parent->left;																	\
+					}																							\
+					if (w->right->color == BLACK && w->left->color == BLACK) {									\
+						w->color = RED;																			\
+						x = x->parent;																			\
+					}																							\
+					else {																						\
+						if (w->left->color == BLACK) {															\
+							w->right->color = BLACK;															\
+							w->color = RED;																		\
+							name##_tree_rotate_left(tree, w);													\
+							w = x->parent->left;																\
+						}																						\
+						w->color = x->parent->color;															\
+						x->parent->color = BLACK;																\
+						w->left->color = BLACK;																	\
+						name##_tree_rotate_right(tree, x->parent);												\
+						x = tree->root;																			\
+					}																							\
+				}																								\
+			}																									\
+			x->color = BLACK;																					\
+		}																										\
+		return 1;																								\
+	}																											\
+																												\
+	/* Frees all nodes without recursion by rotating left children up to the root */							\
+	static inline void name##_tree_free(name##_tree_t* tree) {													\
+		name##_tree_node_t* node = tree->root;																	\
+		while (node != &tree->nil) {																			\
+			if (node->left != &tree->nil) {																		\
+				name##_tree_node_t* left = node->left;															\
+				node->left = left->right;																		\
+				left->right = node;																				\
+				node = left;																					\
+			}																									\
+			else {																								\
+				name##_tree_node_t* right = node->right;														\
+				LU_MM_FREE(node);																				\
+				node = right;																					\
+			}																									\
+		}																										\
+		LU_MM_FREE(tree);																						\
+	}
+
+	/**
+	 * @brief Defines a hash table type `name_t` from `key_t` to `value_t` and its functions.
+	 *
+	 * Use it once per table type at file scope; see the file comment for the parameters.
+	 */
+#define LU_HASH_DEFINE(name,key_t,value_t,hash_fn,eq_fn,less_fn)												\
+	/** List node of name##_t */																				\
+	typedef struct name##_node_s {																				\
+		struct name##_node_s* next;																				\
+		key_t	key;																							\
+		value_t	value;																							\
+	}name##_node_t;																								\
+																												\
+	/** Red-black tree node of name##_t */																		\
+	typedef struct name##_tree_node_s {																			\
+		struct name##_tree_node_s* left;																		\
+		struct name##_tree_node_s* right;																		\
+		struct name##_tree_node_s* parent;																		\
+		lu_node_color_t	color;																					\
+		key_t	key;																							\
+		value_t	value;																							\
+	}name##_tree_node_t;																						\
+																												\
+	/** Red-black tree of a bucket, with the sentinel stored inline */											\
+	typedef struct name##_tree_s {																				\
+		name##_tree_node_t* root;																				\
+		name##_tree_node_t	nil;																				\
+	}name##_tree_t;																								\
+																												\
+	/** Bucket of name##_t, a linked list or a red-black tree */												\
+	typedef struct name##_bucket_s {																			\
+		lu_hash_bucket_type_t type;																				\
+		union																									\
+		{																										\
+			name##_node_t* list_head;																			\
+			name##_tree_t* rb_tree;																				\
+		}data;																									\
+		size_t esize_bucket;																					\
+	}name##_bucket_t;																							\
+																												\
+	/** Hash table from key_t to value_t */																		\
+	typedef struct name##_s {																					\
+		name##_bucket_t*   buckets;																				\
+		size_t			   table_size;																			\
+		size_t			   element_count;																		\
+		unsigned long long seed;																				\
+		size_t			   treeify_count;																		\
+		size_t			   reseed_count;																		\
+		size_t			   reseed_hold;																			\
+	}name##_t;																									\
+																												\
+	/** Callback invoked for every entry by name##_foreach; the value may be modified in place */				\
+	typedef void (*name##_visit_func_t)(key_t key, value_t* value, void* ctx);									\
+																												\
+	static inline size_t name##_index(unsigned long long seed, size_t table_size, key_t key) {					\
+		unsigned long long hash = lu_hash_seeded_mix((unsigned long long)(hash_fn(key)), seed);					\
+		return (table_size & (table_size - 1)) == 0 ? (size_t)(hash & (table_size - 1)) : (size_t)(hash % table_size); \
+	}																											\
+																												\
+	LU_HASH_DEFINE_TREE(name,key_t,eq_fn,less_fn)																\
+																												\
+	/* Inserts or updates a key; returns 1 if a node was added, 0 if the value was replaced */					\
+	static inline int name##_tree_insert(name##_tree_t* tree, key_t key, value_t value, size_t* depth) {		\
+		int added;																								\
+		name##_tree_insert_key(tree, key, depth, &added)->value = value;										\
+		return added;																							\
+	}																											\
+																												\
+	static inline void name##_treeify(name##_bucket_t* bucket) {												\
+		name##_tree_t* tree = name##_tree_new();																\
+		name##_node_t* node = bucket->data.list_head;															\
+		while (node != NULL) {																					\
+			name##_node_t* next = node->next;																	\
+			size_t depth;																						\
+			name##_tree_insert(tree, node->key, node->value, &depth);											\
+			LU_MM_FREE(node);																					\
+			node = next;																						\
+		}																										\
+		bucket->type = LU_HASH_BUCKET_RBTREE;																	\
+		bucket->data.rb_tree = tree;																			\
+	}																											\
+																												\
+	static inline void name##_rehash(name##_t* table, size_t new_table_size) {									\
+		name##_bucket_t* new_buckets = (name##_bucket_t*)LU_MM_MALLOC(new_table_size * sizeof(name##_bucket_t)); \
+		for (size_t i = 0; i < new_table_size; i++) {															\
+			new_buckets[i].type = LU_HASH_BUCKET_LIST;															\
+			new_buckets[i].data.list_head = NULL;																\
+			new_buckets[i].esize_bucket = 0;																	\
+		}																										\
+																												\
+		for (size_t i = 0; i < table->table_size; i++) {														\
+			name##_bucket_t* old_bucket = &table->buckets[i];													\
+			if (old_bucket->type == LU_HASH_BUCKET_LIST) {														\
+				name##_node_t* node = old_bucket->data.list_head;												\
+				while (node != NULL) {																			\
+					name##_node_t* next = node->next;															\
+					name##_bucket_t* new_bucket = &new_buckets[name##_index(table->seed, new_table_size, node->key)]; \
+					node->next = new_bucket->data.list_head;													\
+					new_bucket->data.list_head = node;															\
+					new_bucket->esize_bucket++;																	\
+					node = next;																				\
+				}																								\
+			}																									\
+			else {																								\
+				name##_tree_t* tree = old_bucket->data.rb_tree;													\
+				if (tree->root != &tree->nil) {																	\
+					for (name##_tree_node_t* tree_node = name##_tree_minimum(tree, tree->root); tree_node != &tree->nil; tree_node = name##_tree_successor(tree, tree_node)) { \
+						name##_bucket_t* new_bucket = &new_buckets[name##_index(table->seed, new_table_size, tree_node->key)]; \
+						name##_node_t* node = (name##_node_t*)LU_MM_MALLOC(sizeof(name##_node_t));				\
+						node->key = tree_node->key;																\
+						node->value = tree_node->value;															\
+						node->next = new_bucket->data.list_head;												\
+						new_bucket->data.list_head = node;														\
+						new_bucket->esize_bucket++;																\
+					}																							\
+				}																								\
+				name##_tree_free(tree);																			\
+			}																									\
+		}																										\
+																												\
+		table->treeify_count = 0;																				\
+		for (size_t i = 0; i < new_table_size; i++) {															\
+			if (new_buckets[i].esize_bucket > LU_HASH_BUCKET_LIST_THRESHOLD) {									\
+				name##_treeify(&new_buckets[i]);																\
+				table->treeify_count++;																			\
+			}																									\
+		}																										\
+																												\
+		LU_MM_FREE(table->buckets);																				\
+		table->buckets = new_buckets;																			\
+		table->table_size = new_table_size;																		\
+	}																											\
+																												\
+	/** Creates an empty table with the given number of buckets, LU_HASH_TABLE_DEFAULT_SIZE if 0 */				\
+	static inline name##_t* name##_init(size_t table_size) {													\
+		if (table_size == 0) {																					\
+			table_size = LU_HASH_TABLE_DEFAULT_SIZE;															\
+		}																										\
+		name##_t* table = (name##_t*)LU_MM_MALLOC(sizeof(name##_t));											\
+		table->buckets = (name##_bucket_t*)LU_MM_MALLOC(table_size * sizeof(name##_bucket_t));					\
+		for (size_t i = 0; i < table_size; i++) {																\
+			table->buckets[i].type = LU_HASH_BUCKET_LIST;														\
+			table->buckets[i].data.list_head = NULL;															\
+			table->buckets[i].esize_bucket = 0;																	\
+		}																										\
+		table->table_size = table_size;																			\
+		table->element_count = 0;																				\
+		table->seed = lu_hash_random_seed();																	\
+		table->treeify_count = 0;																				\
+		table->reseed_count = 0;																				\
+		table->reseed_hold = 0;																					\
+		return table;																							\
+	}																											\
+																												\
+	/** Picks a new seed and rehashes, see lu_hash_table_reseed */												\
+	static inline void name##_reseed(name##_t* table) {															\
+		table->seed = lu_hash_random_seed();																	\
+		table->treeify_count = 0;																				\
+		table->reseed_count++;																					\
+		name##_rehash(table, table->table_size);																\
+	}																											\
+																												\
+	/* Whether the buckets still look attacked right after a reseed, see lu_hash_table_collisions_remain */		\
+	static inline int name##_collisions_remain(const name##_t* table) {											\
+		if (table->treeify_count > lu_hash_reseed_treeify_limit(table->table_size, LU_HASH_TABLE_MAX_LOAD_FACTOR, LU_HASH_BUCKET_LIST_THRESHOLD)) { \
+			return 1;																							\
+		}																										\
+		for (size_t i = 0; i < table->table_size; i++) {														\
+			if (table->buckets[i].esize_bucket >= ((size_t)1 << (LU_HASH_RESEED_TREE_HEIGHT / 2))) {			\
+				return 1;																						\
+			}																									\
+		}																										\
+		return 0;																								\
+	}																											\
+																												\
+	/* Reseeds unless a reseed has stopped scattering the keys, see lu_hash_table_auto_reseed */				\
+	static inline void name##_auto_reseed(name##_t* table) {													\
+		if (table->element_count < table->reseed_hold) {														\
+			return;																								\
+		}																										\
+		name##_reseed(table);																					\
+		table->reseed_hold = name##_collisions_remain(table) ? table->element_count * 2 : 0;					\
+	}																											\
+																												\
+	/** Inserts or updates a key; returns 1 if the key was added, 0 if its value was replaced */				\
+	static inline int name##_insert(name##_t* table, key_t key, value_t value) {								\
+		if ((double)table->element_count / table->table_size > LU_HASH_TABLE_MAX_LOAD_FACTOR) {					\
+			name##_rehash(table, table->table_size * 2);														\
+		}																										\
+		name##_bucket_t* bucket = &table->buckets[name##_index(table->seed, table->table_size, key)];			\
+																												\
+		if (bucket->type == LU_HASH_BUCKET_LIST) {																\
+			for (name##_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {				\
+				if (eq_fn(node->key, key)) {																	\
+					node->value = value;																		\
+					return 0;																					\
+				}																								\
+			}																									\
+			name##_node_t* node = (name##_node_t*)LU_MM_MALLOC(sizeof(name##_node_t));							\
+			node->key = key;																					\
+			node->value = value;																				\
+			node->next = bucket->data.list_head;																\
+			bucket->data.list_head = node;																		\
+			bucket->esize_bucket++;																				\
+			table->element_count++;																				\
+			if (bucket->esize_bucket > LU_HASH_BUCKET_LIST_THRESHOLD) {											\
+				name##_treeify(bucket);																			\
+				table->treeify_count++;																			\
+				if (table->treeify_count > lu_hash_reseed_treeify_limit(table->table_size, LU_HASH_TABLE_MAX_LOAD_FACTOR, LU_HASH_BUCKET_LIST_THRESHOLD)) { \
+					name##_auto_reseed(table);																	\
+				}																								\
+			}																									\
+			return 1;																							\
+		}																										\
+																												\
+		size_t depth = 0;																						\
+		int added = name##_tree_insert(bucket->data.rb_tree, key, value, &depth);								\
+		if (added) {																							\
+			bucket->esize_bucket++;																				\
+			table->element_count++;																				\
+		}																										\
+		if (depth > LU_HASH_RESEED_TREE_HEIGHT) {																\
+			name##_auto_reseed(table);																			\
+		}																										\
+		return added;																							\
+	}																											\
+																												\
+	/** Returns a pointer to the value stored for a key, or NULL if the key is absent */						\
+	static inline value_t* name##_find(const name##_t* table, key_t key) {										\
+		name##_bucket_t* bucket = &table->buckets[name##_index(table->seed, table->table_size, key)];			\
+		if (bucket->type == LU_HASH_BUCKET_LIST) {																\
+			for (name##_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {				\
+				if (eq_fn(node->key, key)) {																	\
+					return &node->value;																		\
+				}																								\
+			}																									\
+			return NULL;																						\
+		}																										\
+		name##_tree_node_t* tree_node = name##_tree_find(bucket->data.rb_tree, key);							\
+		return tree_node ? &tree_node->value : NULL;															\
+	}																											\
+																												\
+	/** Removes a key; returns 1 if it was present */															\
+	static inline int name##_delete(name##_t* table, key_t key) {												\
+		name##_bucket_t* bucket = &table->buckets[name##_index(table->seed, table->table_size, key)];			\
+		int removed = 0;																						\
+		if (bucket->type == LU_HASH_BUCKET_LIST) {																\
+			name##_node_t** link = &bucket->data.list_head;														\
+			while (*link != NULL) {																				\
+				name##_node_t* node = *link;																	\
+				if (eq_fn(node->key, key)) {																	\
+					*link = node->next;																			\
+					LU_MM_FREE(node);																			\
+					removed = 1;																				\
+					break;																						\
+				}																								\
+				link = &node->next;																				\
+			}																									\
+		}																										\
+		else {																									\
+			removed = name##_tree_delete(bucket->data.rb_tree, key);											\
+		}																										\
+		if (removed) {																							\
+			bucket->esize_bucket--;																				\
+			table->element_count--;																				\
+		}																										\
+		return removed;																							\
+	}																											\
+																												\
+	/** Calls a function for every entry; buckets in index order, trees in key order */							\
+	static inline void name##_foreach(const name##_t* table, name##_visit_func_t visit, void* ctx) {			\
+		for (size_t i = 0; i < table->table_size; i++) {														\
+			name##_bucket_t* bucket = &table->buckets[i];														\
+			if (bucket->type == LU_HASH_BUCKET_LIST) {															\
+				for (name##_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {			\
+					visit(node->key, &node->value, ctx);														\
+				}																								\
+			}																									\
+			else {																								\
+				name##_tree_t* tree = bucket->data.rb_tree;														\
+				if (tree->root == &tree->nil) {																	\
+					continue;																					\
+				}																								\
+				for (name##_tree_node_t* node = name##_tree_minimum(tree, tree->root); node != &tree->nil; node = name##_tree_successor(tree, node)) { \
+					visit(node->key, &node->value, ctx);														\
+				}																								\
+			}																									\
+		}																										\
+	}																											\
+																												\
+	/** Frees the table and all of its nodes */																	\
+	static inline void name##_destroy(name##_t* table) {														\
+		if (table == NULL) {																					\
+			return;																								\
+		}																										\
+		for (size_t i = 0; i < table->table_size; i++) {														\
+			name##_bucket_t* bucket = &table->buckets[i];														\
+			if (bucket->type == LU_HASH_BUCKET_LIST) {															\
+				name##_node_t* node = bucket->data.list_head;													\
+				while (node != NULL) {																			\
+					name##_node_t* next = node->next;															\
+					LU_MM_FREE(node);																			\
+					node = next;																				\
+				}																								\
+			}																									\
+			else {																								\
+				name##_tree_free(bucket->data.rb_tree);															\
+			}																									\
+		}																										\
+		LU_MM_FREE(table->buckets);																				\
+		LU_MM_FREE(table);																						\
+	}
+
+	/** Table with `long long` keys */
+#define LU_HASH_DEFINE_INT64(name,value_t)	\
+	LU_HASH_DEFINE(name, long long, value_t, lu_hash_int64_hash, lu_hash_int64_eq, lu_hash_int64_less)
+
+	/** Table with `unsigned long long` keys */
+#define LU_HASH_DEFINE_UINT64(name,value_t)	\
+	LU_HASH_DEFINE(name, unsigned long long, value_t, lu_hash_int64_hash, lu_hash_int64_eq, lu_hash_int64_less)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_DEFINE_INCLUDE_H_*/
@@ -0,0 +1,388 @@
+#include "luhash_fixed.h"
+
+/**
+ * @file luhash_fixed.c
+ * @brief Fixed-capacity hash table over a caller-provided region, without heap allocation.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#define LU_HASH_FIXED_MAGIC		"LUHFIX01"
+#define LU_HASH_FIXED_NIL		0xFFFFFFFFu		// Index of no node
+
+/**
+ * Node of a fixed table, followed by `value_size` bytes of value padded to 8 bytes.
+ */
+typedef struct lu_hash_fixed_node_s {
+	unsigned int next;		// Next node of a bucket or of the free list
+	int			 key;
+}lu_hash_fixed_node_t;
+
+static size_t lu_hash_fixed_layout(size_t capacity, size_t value_size, unsigned int* table_size, unsigned int* node_bytes);
+static unsigned long long lu_hash_fixed_new_seed(const lu_hash_fixed_t* table);
+static void lu_hash_fixed_rehash(lu_hash_fixed_t* table, unsigned long long new_seed);
+
+/** @brief Returns the bucket array, which follows the header. */
+static inline unsigned int* lu_hash_fixed_buckets(const lu_hash_fixed_t* table)
+{
+	return (unsigned int*)((unsigned char*)table + sizeof(lu_hash_fixed_t));
+}
+
+/** @brief Returns the head of the bucket a key belongs to. */
+static inline unsigned int* lu_hash_fixed_bucket(const lu_hash_fixed_t* table, int key)
+{
+	return &lu_hash_fixed_buckets(table)[lu_hash_seeded_mix((unsigned int)key, table->seed) & (table->table_size - 1)];
+}
+
+/** @brief Returns a node of the pool, which follows the bucket array padded to 8 bytes. */
+static inline lu_hash_fixed_node_t* lu_hash_fixed_node(const lu_hash_fixed_t* table, unsigned int index)
+{
+	size_t pool = sizeof(lu_hash_fixed_t) + (((size_t)table->table_size * sizeof(unsigned int) + 7) & ~(size_t)7);
+	return (lu_hash_fixed_node_t*)((unsigned char*)table + pool + (size_t)index * table->node_bytes);
+}
+
+/** @brief Returns the value bytes that follow a node. */
+static inline void* lu_hash_fixed_value(lu_hash_fixed_node_t* node)
+{
+	return node + 1;
+}
+
+/**
+ * @brief Computes the layout of a table.
+ *
+ * @param capacity The number of entries, at least 1.
+ * @param value_size The number of bytes of every value.
+ * @param table_size Receives the number of buckets: the smallest power of two that keeps the load
+ *        factor at full capacity at or below 0.75.
+ * @param node_bytes Receives the bytes per node.
+ * @return The bytes of the region used by the table.
+ */
+static size_t lu_hash_fixed_layout(size_t capacity, size_t value_size, unsigned int* table_size, unsigned int* node_bytes)
+{
+	size_t size = 1;
+	while (size * 3 < capacity * 4) {
+		size <<= 1;
+	}
+	size_t node = sizeof(lu_hash_fixed_node_t) + ((value_size + 7) & ~(size_t)7);
+	*table_size = (unsigned int)size;
+	*node_bytes = (unsigned int)node;
+	return sizeof(lu_hash_fixed_t) + ((size * sizeof(unsigned int) + 7) & ~(size_t)7) + capacity * node;
+}
+
+/**
+ * @brief Returns the bytes a table of `capacity` entries of `value_size` bytes uses.
+ *
+ * @return The exact size of the region needed, 0 if `capacity` is 0 or the capacity or value size
+ *         exceed `LU_HASH_FIXED_MAX_CAPACITY` or `LU_HASH_FIXED_MAX_VALUE`.
+ */
+size_t lu_hash_fixed_required_bytes(size_t capacity, size_t value_size)
+{
+	if (capacity == 0 || capacity > LU_HASH_FIXED_MAX_CAPACITY || value_size > LU_HASH_FIXED_MAX_VALUE) {
+		return 0;
+	}
+	unsigned int table_size, node_bytes;
+	return lu_hash_fixed_layout(capacity, value_size, &table_size, &node_bytes);
+}
+
+/**
+ * Builds an empty fixed table inside a memory region.
+ *
+ * Nothing is allocated: the header, bucket array and node pool all live in the region, which the
+ * caller keeps alive and unchanged for as long as the table is used and releases afterwards.
+ * There is no destroy function. Initialization costs one pass over the bucket array; nodes are
+ * handed out from the pool as they are needed.
+ *
+ * @param memory The region, aligned to 8 bytes.
+ * @param bytes The size of the region.
+ * @param capacity The maximum number of entries, or 0 for as many as fit into the region.
+ * @param value_size The number of bytes of every value.
+ * @return The table, which starts at `memory`, or NULL with lu_hash_erron_global_ set to
+ *         LU_ERROR_INVALID_ARGUMENT if the region is misaligned or too small for `capacity`, or
+ *         the capacity or value size exceed their limits.
+ */
+lu_hash_fixed_t* lu_hash_fixed_init(void* memory, size_t bytes, size_t capacity, size_t value_size)
+{
+	if (memory == NULL || ((size_t)memory & 7) != 0 || value_size > LU_HASH_FIXED_MAX_VALUE || capacity > LU_HASH_FIXED_MAX_CAPACITY) {
+		lu_hash_erron_global_ = LU_ERROR_INVALID_ARGUMENT;
+		return NULL;
+	}
+
+	unsigned int table_size, node_bytes;
+	if (capacity == 0) {
+		// The largest capacity whose layout fits; the size grows with the capacity
+		size_t low = 0;
+		size_t high = bytes / (sizeof(lu_hash_fixed_node_t) + ((value_size + 7) & ~(size_t)7));
+		if (high > LU_HASH_FIXED_MAX_CAPACITY) {
+			high = LU_HASH_FIXED_MAX_CAPACITY;
+		}
+		while (low < high) {
+			size_t mid = low + (high - low + 1) / 2;
+			if (lu_hash_fixed_layout(mid, value_size, &table_size, &node_bytes) <= bytes) {
+				low = mid;
+			}
+			else {
+				high = mid - 1;
+			}
+		}
+		capacity = low;
+	}
+	if (capacity == 0 || lu_hash_fixed_layout(capacity, value_size, &table_size, &node_bytes) > bytes) {
+#ifdef LU_HASH_DEBUG
+		printf("A region of %zu bytes is too small for a fixed table of %zu entries\n", bytes, capacity);
+#endif // LU_HASH_DEBUG
+		lu_hash_erron_global_ = LU_ERROR_INVALID_ARGUMENT;
+		return NULL;
+	}
+
+	lu_hash_fixed_t* table = (lu_hash_fixed_t*)memory;
+	memcpy(table->magic, LU_HASH_FIXED_MAGIC, sizeof(table->magic));
+	table->value_size = (unsigned int)value_size;
+	table->node_bytes = node_bytes;
+	table->capacity = (unsigned int)capacity;
+	table->table_size = table_size;
+	table->reserved = 0;
+	table->seed = 0;
+	table->reseed_count = 0;
+	table->region_bytes = lu_hash_fixed_layout(capacity, value_size, &table_size, &node_bytes);
+	table->seed = lu_hash_fixed_new_seed(table);
+	lu_hash_fixed_clear(table);
+	return table;
+}
+
+/**
+ * @brief Opens a table that lu_hash_fixed_init built in a region now seen at another address.
+ *
+ * For a region of shared memory mapped by another process, or a region copied or loaded as a
+ * whole. The header is validated; the entries are used as they are.
+ *
+ * @param memory The region, aligned to 8 bytes.
+ * @param bytes The size of the region.
+ * @return The table, or NULL with lu_hash_erron_global_ set to LU_ERROR_INVALID_ARGUMENT if the
+ *         region does not hold a fixed table.
+ */
+lu_hash_fixed_t* lu_hash_fixed_attach(void* memory, size_t bytes)
+{
+	lu_hash_fixed_t* table = (lu_hash_fixed_t*)memory;
+	unsigned int table_size, node_bytes;
+	if (memory == NULL || ((size_t)memory & 7) != 0 || bytes < sizeof(lu_hash_fixed_t)
+		|| memcmp(table->magic, LU_HASH_FIXED_MAGIC, sizeof(table->magic)) != 0
+		|| table->capacity == 0 || table->capacity > LU_HASH_FIXED_MAX_CAPACITY || table->value_size > LU_HASH_FIXED_MAX_VALUE
+		|| table->region_bytes != lu_hash_fixed_layout(table->capacity, table->value_size, &table_size, &node_bytes)
+		|| table->table_size != table_size || table->node_bytes != node_bytes || table->region_bytes > bytes
+		|| table->element_count > table->capacity || table->unused_nodes > table->capacity) {
+		lu_hash_erron_global_ = LU_ERROR_INVALID_ARGUMENT;
+		return NULL;
+	}
+	return table;
+}
+
+/**
+ * Inserts a key with a copy of its value, or overwrites the value of an existing key.
+ *
+ * Never allocates: the node comes from the pool. An insert that finds more than
+ * `LU_HASH_RESEED_CHAIN_LENGTH` entries in its bucket rehashes the table in place under a new
+ * seed, which only moves links and takes time proportional to the number of entries.
+ *
+ * @param table The fixed table.
+ * @param key The key to insert or update.
+ * @param value Points to `value_size` bytes that are copied into the table, may be NULL if `value_size` is 0.
+ * @return LU_OK, or LU_ERROR_FULL if the key is new and the table holds `capacity` entries (the
+ *         table is unchanged).
+ */
+int lu_hash_fixed_insert(lu_hash_fixed_t* table, int key, const void* value)
+{
+	unsigned int* bucket = lu_hash_fixed_bucket(table, key);
+	size_t length = 0;
+	for (unsigned int index = *bucket; index != LU_HASH_FIXED_NIL; length++) {
+		lu_hash_fixed_node_t* node = lu_hash_fixed_node(table, index);
+		if (node->key == key) {
+			if (table->value_size != 0) {
+				memcpy(lu_hash_fixed_value(node), value, table->value_size);
+			}
+			return LU_OK;
+		}
+		index = node->next;
+	}
+
+	if (table->element_count == table->capacity) {
+#ifdef LU_HASH_DEBUG
+		printf("Fixed table full at %u entries, key %d not inserted\n", table->capacity, key);
+#endif // LU_HASH_DEBUG
+		lu_hash_erron_global_ = LU_ERROR_FULL;
+		return LU_ERROR_FULL;
+	}
+
+	unsigned int index = table->free_nodes;
+	lu_hash_fixed_node_t* node;
+	if (index != LU_HASH_FIXED_NIL) {
+		node = lu_hash_fixed_node(table, index);
+		table->free_nodes = node->next;
+	}
+	else {
+		index = table->unused_nodes++;
+		node = lu_hash_fixed_node(table, index);
+	}
+	node->key = key;
+	if (table->value_size != 0) {
+		memcpy(lu_hash_fixed_value(node), value, table->value_size);
+	}
+	node->next = *bucket;
+	*bucket = index;
+	table->element_count++;
+
+	if (lu_hash_reseed_chain_suspect(length)) {
+		table->reseed_count++;
+		lu_hash_fixed_rehash(table, lu_hash_fixed_new_seed(table));
+	}
+	return LU_OK;
+}
+
+/**
+ * @brief Searches for a key.
+ *
+ * @param table The fixed table.
+ * @param key The key to search for.
+ * @return A pointer to the value bytes of the key inside the region, valid until the key is
+ *         deleted, or NULL if the key does not exist.
+ */
+void* lu_hash_fixed_find(lu_hash_fixed_t* table, int key)
+{
+	unsigned int index = *lu_hash_fixed_bucket(table, key);
+	while (index != LU_HASH_FIXED_NIL) {
+		lu_hash_fixed_node_t* node = lu_hash_fixed_node(table, index);
+		if (node->key == key) {
+			return lu_hash_fixed_value(node);
+		}
+		index = node->next;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Deletes a key and returns its node to the pool.
+ *
+ * @param table The fixed table.
+ * @param key The key to delete.
+ */
+void lu_hash_fixed_delete(lu_hash_fixed_t* table, int key)
+{
+	unsigned int* link = lu_hash_fixed_bucket(table, key);
+	while (*link != LU_HASH_FIXED_NIL) {
+		unsigned int index = *link;
+		lu_hash_fixed_node_t* node = lu_hash_fixed_node(table, index);
+		if (node->key == key) {
+			*link = node->next;
+			node->next = table->free_nodes;
+			table->free_nodes = index;
+			table->element_count--;
+			return;
+		}
+		link = &node->next;
+	}
+}
+
+/**
+ * @brief Calls `visit` for every entry, in bucket order.
+ *
+ * The visitor may modify the value bytes but must not insert or delete.
+ *
+ * @param table The fixed table.
+ * @param visit The callback, receives the key, a pointer to the value bytes and `ctx`.
+ * @param ctx Passed to every call of `visit`.
+ */
+void lu_hash_fixed_foreach(lu_hash_fixed_t* table, lu_hash_visit_func_t visit, void* ctx)
+{
+	unsigned int* buckets = lu_hash_fixed_buckets(table);
+	for (unsigned int i = 0; i < table->table_size; i++) {
+		for (unsigned int index = buckets[i]; index != LU_HASH_FIXED_NIL;) {
+			lu_hash_fixed_node_t* node = lu_hash_fixed_node(table, index);
+			visit(node->key, lu_hash_fixed_value(node), ctx);
+			index = node->next;
+		}
+	}
+}
+
+/**
+ * @brief Removes every entry, in time proportional to the number of buckets.
+ */
+void lu_hash_fixed_clear(lu_hash_fixed_t* table)
+{
+	memset(lu_hash_fixed_buckets(table), 0xFF, (size_t)table->table_size * sizeof(unsigned int));
+	table->element_count = 0;
+	table->free_nodes = LU_HASH_FIXED_NIL;
+	table->unused_nodes = 0;
+}
+
+/**
+ * @brief Returns the current number of entries.
+ */
+size_t lu_hash_fixed_count(const lu_hash_fixed_t* table)
+{
+	return table->element_count;
+}
+
+/**
+ * @brief Returns the maximum number of entries.
+ */
+size_t lu_hash_fixed_capacity(const lu_hash_fixed_t* table)
+{
+	return table->capacity;
+}
+
+/**
+ * @brief Derives a new seed without calling the heap.
+ *
+ * lu_hash_random_seed reads /dev/urandom through stdio on its first call, which allocates; the
+ * clock, the address of the region and the previous seed are mixed instead.
+ */
+static unsigned long long lu_hash_fixed_new_seed(const lu_hash_fixed_t* table)
+{
+	unsigned long long seed = lu_clock_ns();
+	seed ^= (unsigned long long)(size_t)table << 16;
+	seed ^= table->seed * 0x9e3779b97f4a7c15ULL;
+	seed += table->reseed_count;
+
+	// SplitMix64 finalizer
+	seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebULL;
+	return seed ^ (seed >> 31);
+}
+
+/**
+ * @brief Rehashes every entry under a new seed, in place.
+ *
+ * All nodes are first gathered into one chain through their `next` links, which empties the
+ * buckets, and then linked into the bucket of their new hash.
+ *
+ * @param table The fixed table.
+ * @param new_seed The seed to hash with from now on.
+ */
+static void lu_hash_fixed_rehash(lu_hash_fixed_t* table, unsigned long long new_seed)
+{
+	unsigned int* buckets = lu_hash_fixed_buckets(table);
+	unsigned int chain = LU_HASH_FIXED_NIL;
+	for (unsigned int i = 0; i < table->table_size; i++) {
+		unsigned int index = buckets[i];
+		while (index != LU_HASH_FIXED_NIL) {
+			lu_hash_fixed_node_t* node = lu_hash_fixed_node(table, index);
+			unsigned int next = node->next;
+			node->next = chain;
+			chain = index;
+			index = next;
+		}
+		buckets[i] = LU_HASH_FIXED_NIL;
+	}
+
+	table->seed = new_seed;
+	while (chain != LU_HASH_FIXED_NIL) {
+		lu_hash_fixed_node_t* node = lu_hash_fixed_node(table, chain);
+		unsigned int next = node->next;
+		unsigned int* bucket = lu_hash_fixed_bucket(table, node->key);
+		node->next = *bucket;
+		*bucket = chain;
+		chain = next;
+	}
+}
@@ -0,0 +1,99 @@
+#ifndef LU_LU_HASH_FIXED_INCLUDE_H_
+#define LU_LU_HASH_FIXED_INCLUDE_H_
+
+/**
+ * @file luhash_fixed.h
+ * @brief Fixed-capacity hash table built inside a memory region supplied by the caller.
+ *
+ * lu_hash_table_t allocates a node per insert and a new bucket array per resize, and LU_MM_MALLOC
+ * exits the process when memory runs out. A fixed table instead carves its header, bucket array
+ * and node pool out of one region that the caller provides: a static array, a stack buffer, a
+ * block of shared memory. It never calls the heap and never resizes, so every operation has a
+ * bounded cost without allocator jitter, and an insert into a full table returns LU_ERROR_FULL
+ * instead of failing the process.
+ *
+ * The table is the region: lu_hash_fixed_t is its header, and buckets and nodes are linked by
+ * 32-bit indices rather than pointers. A region that another process maps at a different
+ * address, or that is copied elsewhere as a whole, is opened with lu_hash_fixed_attach. Values
+ * are a fixed number of bytes chosen at init and copied into their node.
+ *
+ * Buckets are lists hashed with a random seed, sized for a load factor of at most 0.75 at full
+ * capacity. Instead of turning long buckets into trees, which would need memory of its own, an
+ * insert that finds more than `LU_HASH_RESEED_CHAIN_LENGTH` entries in its bucket rehashes the
+ * table in place under a new seed.
+ *
+ * Usage example:
+ *     static unsigned long long region[LU_HASH_FIXED_BYTES(1024, sizeof(order_t)) / 8];
+ *     lu_hash_fixed_t* orders = lu_hash_fixed_init(region, sizeof(region), 1024, sizeof(order_t));
+ *     if (lu_hash_fixed_insert(orders, order.id, &order) == LU_ERROR_FULL) {
+ *         // Reject the order
+ *     }
+ *     order_t* found = (order_t*)lu_hash_fixed_find(orders, order.id);
+ *
+ * Not thread-safe: one thread at a time, and in shared memory one process at a time.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include "luhash_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_FIXED_MAX_CAPACITY		0x60000000u			// Largest number of entries of a fixed table
+#define LU_HASH_FIXED_MAX_VALUE			0x40000000u			// Largest value size in bytes
+
+	/**
+	 * Header at the start of the region, followed by the bucket array and the node pool. A node
+	 * is a `next` index and a key, followed by `value_size` bytes of value padded to 8 bytes.
+	 */
+	typedef struct lu_hash_fixed_s {
+		char			   magic[8];		// "LUHFIX01"
+		unsigned int	   value_size;		// Bytes of value per entry
+		unsigned int	   node_bytes;		// Bytes per node including the padded value
+		unsigned int	   capacity;		// Number of nodes in the pool
+		unsigned int	   table_size;		// Number of buckets, a power of two
+		unsigned int	   element_count;	// Current number of entries
+		unsigned int	   free_nodes;		// Deleted nodes, linked by `next`
+		unsigned int	   unused_nodes;	// Nodes from here to `capacity` were never handed out
+		unsigned int	   reserved;
+		unsigned long long seed;
+		unsigned long long reseed_count;
+		unsigned long long region_bytes;	// Bytes of the region used by the table
+	}lu_hash_fixed_t;
+
+	/**
+	 * Bytes that are always enough for a table of `capacity` entries of `value_size` bytes, as a
+	 * constant expression for sizing static or stack regions. lu_hash_fixed_required_bytes
+	 * returns the exact size, which may be smaller.
+	 */
+#define LU_HASH_FIXED_BYTES(capacity, value_size) \
+	(sizeof(lu_hash_fixed_t) + ((size_t)(capacity) * 8 / 3 + 2) * 4 + 8 + (size_t)(capacity) * (8 + (((size_t)(value_size) + 7) / 8) * 8))
+
+	/**Function definition*/
+	size_t lu_hash_fixed_required_bytes(size_t capacity, size_t value_size);
+	lu_hash_fixed_t* lu_hash_fixed_init(void* memory, size_t bytes, size_t capacity, size_t value_size);
+	lu_hash_fixed_t* lu_hash_fixed_attach(void* memory, size_t bytes);
+	int lu_hash_fixed_insert(lu_hash_fixed_t* table, int key, const void* value);
+	void* lu_hash_fixed_find(lu_hash_fixed_t* table, int key);
+	void lu_hash_fixed_delete(lu_hash_fixed_t* table, int key);
+	void lu_hash_fixed_foreach(lu_hash_fixed_t* table, lu_hash_visit_func_t visit, void* ctx);
+	void lu_hash_fixed_clear(lu_hash_fixed_t* table);
+	size_t lu_hash_fixed_count(const lu_hash_fixed_t* table);
+	size_t lu_hash_fixed_capacity(const lu_hash_fixed_t* table);
+
+#define LU_HASH_FIXED_INIT(memory,bytes,value_size)	lu_hash_fixed_init(memory,bytes,0,value_size)
+#define LU_HASH_FIXED_INSERT(table,key,value)		lu_hash_fixed_insert(table,key,value)
+#define LU_HASH_FIXED_FIND(table,key)				lu_hash_fixed_find(table,key)
+#define LU_HASH_FIXED_DELETE(table,key)				lu_hash_fixed_delete(table,key)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_FIXED_INCLUDE_H_*/
@@ -0,0 +1,267 @@
+#include "luhash_frozen.h"
+
+/**
+ * @file luhash_frozen.c
+ * @brief Construction and lookup of frozen hash tables (hash-and-displace minimal perfect hashing).
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+/** Temporary storage used while collecting the elements of the source table */
+typedef struct lu_hash_frozen_input_s {
+	int*	keys;
+	void**	values;
+	size_t	count;
+}lu_hash_frozen_input_t;
+
+static void lu_hash_frozen_collect(int key, void* value, void* ctx);
+static int lu_hash_frozen_build(lu_hash_frozen_t* frozen, const lu_hash_frozen_input_t* input);
+
+/**
+ * @brief Returns the bucket (pilot index) of a key hash. Uses the high half of the hash.
+ */
+static inline size_t lu_hash_frozen_bucket(unsigned long long hash, size_t bucket_count)
+{
+	return (size_t)((hash >> 32) % bucket_count);
+}
+
+/**
+ * @brief Returns the slot of a key hash displaced by a pilot.
+ *
+ * The pilot is spread by an odd multiplier and XORed into the key hash, and the result is mixed
+ * once more so that keys whose hashes differ only in a few bits still move independently.
+ */
+static inline size_t lu_hash_frozen_slot(unsigned long long hash, unsigned int pilot, size_t slot_count)
+{
+	unsigned long long x = (hash ^ (((unsigned long long)pilot + 1) * 0xc2b2ae3d27d4eb4fULL)) * 0x9e3779b97f4a7c15ULL;
+	return (size_t)((x ^ (x >> 29)) % slot_count);
+}
+
+/**
+ * @brief lu_hash_table_foreach callback that copies an element into the input arrays.
+ */
+static void lu_hash_frozen_collect(int key, void* value, void* ctx)
+{
+	lu_hash_frozen_input_t* input = (lu_hash_frozen_input_t*)ctx;
+	input->keys[input->count] = key;
+	input->values[input->count] = value;
+	input->count++;
+}
+
+/**
+ * Freezes a hash table into an immutable minimal-perfect-hash structure.
+ *
+ * The source table is not modified and stays usable; the frozen copy shares the value pointers
+ * with it but not the nodes. Later changes to the source table are not reflected.
+ *
+ * Construction is expected linear time: the keys are grouped into buckets, the buckets are
+ * processed from largest to smallest, and for each bucket the pilots 0, 1, 2, ... are tried until
+ * one places all of its keys into free, distinct slots. If some bucket cannot be placed within a
+ * bounded number of pilots, the whole construction restarts with a new seed.
+ *
+ * @param table A pointer to the hash table to freeze.
+ * @return A pointer to the frozen table, or NULL if no perfect hash could be built.
+ *
+ * Usage example:
+ *     lu_hash_frozen_t* frozen = lu_hash_table_freeze(table);
+ *     void* value = lu_hash_frozen_find(frozen, 42);
+ */
+lu_hash_frozen_t* lu_hash_table_freeze(const lu_hash_table_t* table)
+{
+	size_t count = table->element_count;
+
+	lu_hash_frozen_input_t input;
+	input.keys = (int*)LU_MM_MALLOC((count ? count : 1) * sizeof(int));
+	input.values = (void**)LU_MM_MALLOC((count ? count : 1) * sizeof(void*));
+	input.count = 0;
+	lu_hash_table_foreach(table, lu_hash_frozen_collect, &input);
+
+	lu_hash_frozen_t* frozen = (lu_hash_frozen_t*)LU_MM_MALLOC(sizeof(lu_hash_frozen_t));
+	frozen->element_count = input.count;
+	frozen->bucket_count = input.count / LU_HASH_FROZEN_BUCKET_LOAD + 1;
+	frozen->pilots = (unsigned int*)LU_MM_CALLOC(frozen->bucket_count, sizeof(unsigned int));
+	frozen->keys = (int*)LU_MM_MALLOC((input.count ? input.count : 1) * sizeof(int));
+	frozen->values = (void**)LU_MM_MALLOC((input.count ? input.count : 1) * sizeof(void*));
+
+	int built = input.count == 0;
+	for (int attempt = 0; !built && attempt < LU_HASH_FROZEN_MAX_ATTEMPTS; attempt++) {
+		frozen->seed = lu_hash_random_seed();
+		built = lu_hash_frozen_build(frozen, &input);
+	}
+
+	LU_MM_FREE(input.keys);
+	LU_MM_FREE(input.values);
+
+	if (!built) {
+#ifdef LU_HASH_DEBUG
+		printf("Error: failed to build a perfect hash for %zu keys\n", frozen->element_count);
+#endif // LU_HASH_DEBUG
+		lu_hash_erron_global_ = LU_ERROR_PERFECT_HASH_FAILED;
+		lu_hash_frozen_destroy(frozen);
+		return NULL;
+	}
+	return frozen;
+}
+
+/**
+ * @brief Searches the pilots for one seed.
+ *
+ * @param frozen The frozen table being built; seed, bucket_count and element_count are set.
+ * @param input The collected elements.
+ * @return 1 if every bucket was placed, 0 if the seed has to be changed.
+ */
+static int lu_hash_frozen_build(lu_hash_frozen_t* frozen, const lu_hash_frozen_input_t* input)
+{
+	size_t count = input->count;
+	size_t bucket_count = frozen->bucket_count;
+
+	unsigned long long* hashes = (unsigned long long*)LU_MM_MALLOC(count * sizeof(unsigned long long));
+	size_t* bucket_start = (size_t*)LU_MM_CALLOC(bucket_count + 1, sizeof(size_t));
+	size_t* members = (size_t*)LU_MM_MALLOC(count * sizeof(size_t));
+	unsigned char* taken = (unsigned char*)LU_MM_CALLOC(count, 1);
+
+	// Group the elements by bucket with a counting sort. The seeded mix is a bijection, so distinct
+	// keys get distinct hashes and can always be separated by some pilot value.
+	size_t max_bucket = 0;
+	for (size_t i = 0; i < count; i++) {
+		hashes[i] = lu_hash_seeded_mix((unsigned int)input->keys[i], frozen->seed);
+		bucket_start[lu_hash_frozen_bucket(hashes[i], bucket_count) + 1]++;
+	}
+	for (size_t b = 0; b < bucket_count; b++) {
+		if (bucket_start[b + 1] > max_bucket) {
+			max_bucket = bucket_start[b + 1];
+		}
+		bucket_start[b + 1] += bucket_start[b];
+	}
+	size_t* fill = (size_t*)LU_MM_MALLOC((bucket_count + 1) * sizeof(size_t));
+	memcpy(fill, bucket_start, (bucket_count + 1) * sizeof(size_t));
+	for (size_t i = 0; i < count; i++) {
+		members[fill[lu_hash_frozen_bucket(hashes[i], bucket_count)]++] = i;
+	}
+
+	// Order the buckets from largest to smallest, large buckets are hardest to place
+	size_t* size_start = (size_t*)LU_MM_CALLOC(max_bucket + 2, sizeof(size_t));
+	size_t* order = (size_t*)LU_MM_MALLOC(bucket_count * sizeof(size_t));
+	for (size_t b = 0; b < bucket_count; b++) {
+		size_start[max_bucket - (bucket_start[b + 1] - bucket_start[b]) + 1]++;
+	}
+	for (size_t k = 0; k <= max_bucket; k++) {
+		size_start[k + 1] += size_start[k];
+	}
+	for (size_t b = 0; b < bucket_count; b++) {
+		order[size_start[max_bucket - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+	}
+
+	// A singleton bucket needs about count / free_slots tries, so this bound is rarely reached
+	unsigned long long pilot_limit = (unsigned long long)count * 16 + 1024;
+	if (pilot_limit > 0xffffffffULL) {
+		pilot_limit = 0xffffffffULL;
+	}
+
+	size_t* slots = (size_t*)LU_MM_MALLOC((max_bucket ? max_bucket : 1) * sizeof(size_t));
+	int success = 1;
+	for (size_t o = 0; o < bucket_count && success; o++) {
+		size_t b = order[o];
+		size_t first = bucket_start[b];
+		size_t size = bucket_start[b + 1] - first;
+		if (size == 0) {
+			break; // Buckets are sorted by size, the rest are empty too
+		}
+
+		unsigned long long pilot;
+		for (pilot = 0; pilot < pilot_limit; pilot++) {
+			size_t placed = 0;
+			for (; placed < size; placed++) {
+				size_t slot = lu_hash_frozen_slot(hashes[members[first + placed]], (unsigned int)pilot, count);
+				if (taken[slot]) {
+					break;
+				}
+				size_t j = 0;
+				while (j < placed && slots[j] != slot) {
+					j++;
+				}
+				if (j < placed) {
+					break; // Two keys of this bucket collide with each other
+				}
+				slots[placed] = slot;
+			}
+			if (placed == size) {
+				break;
+			}
+		}
+		if (pilot == pilot_limit) {
+			success = 0;
+			break;
+		}
+
+		frozen->pilots[b] = (unsigned int)pilot;
+		for (size_t k = 0; k < size; k++) {
+			size_t element = members[first + k];
+			taken[slots[k]] = 1;
+			frozen->keys[slots[k]] = input->keys[element];
+			frozen->values[slots[k]] = input->values[element];
+		}
+	}
+
+	LU_MM_FREE(slots);
+	LU_MM_FREE(order);
+	LU_MM_FREE(size_start);
+	LU_MM_FREE(fill);
+	LU_MM_FREE(taken);
+	LU_MM_FREE(members);
+	LU_MM_FREE(bucket_start);
+	LU_MM_FREE(hashes);
+	return success;
+}
+
+/**
+ * @brief Searches for a key in a frozen table.
+ *
+ * One hash, one pilot load and one slot probe. The probed key is compared because keys that were
+ * not in the source table also map to some slot.
+ *
+ * @param frozen A pointer to the frozen table.
+ * @param key The key to search for.
+ * @return A pointer to the value associated with the key if found, or NULL if the key does not exist.
+ */
+void* lu_hash_frozen_find(const lu_hash_frozen_t* frozen, int key)
+{
+	if (frozen->element_count == 0) {
+		return NULL;
+	}
+
+	unsigned long long hash = lu_hash_seeded_mix((unsigned int)key, frozen->seed);
+	unsigned int pilot = frozen->pilots[lu_hash_frozen_bucket(hash, frozen->bucket_count)];
+	size_t slot = lu_hash_frozen_slot(hash, pilot, frozen->element_count);
+
+	return frozen->keys[slot] == key ? frozen->values[slot] : NULL;
+}
+
+/**
+ * @brief Returns the number of bytes allocated for a frozen table.
+ */
+size_t lu_hash_frozen_memory_usage(const lu_hash_frozen_t* frozen)
+{
+	return sizeof(lu_hash_frozen_t)
+		+ frozen->bucket_count * sizeof(unsigned int)
+		+ frozen->element_count * (sizeof(int) + sizeof(void*));
+}
+
+/**
+ * @brief Destroys a frozen table. The values it points to are not freed.
+ *
+ * @param frozen A pointer to the frozen table. If NULL, the function does nothing.
+ */
+void lu_hash_frozen_destroy(lu_hash_frozen_t* frozen)
+{
+	if (frozen == NULL) {
+		return;
+	}
+	LU_MM_FREE(frozen->pilots);
+	LU_MM_FREE(frozen->keys);
+	LU_MM_FREE(frozen->values);
+	LU_MM_FREE(frozen);
+}
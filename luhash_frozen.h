@@ -0,0 +1,60 @@
+#ifndef LU_LU_HASH_FROZEN_INCLUDE_H_
+#define LU_LU_HASH_FROZEN_INCLUDE_H_
+
+/**
+ * @file luhash_frozen.h
+ * @brief Immutable, read-only snapshot of a hash table built around a minimal perfect hash.
+ *
+ * lu_hash_table_freeze turns a table that is loaded once and only read afterwards into a compact
+ * structure: a minimal perfect hash function in the hash-and-displace family (CHD / PTHash style)
+ * over the keys, plus packed key and value arrays indexed by it. Keys are grouped into small
+ * buckets by their hash, and every bucket stores one 32-bit pilot that displaces all of its keys
+ * into distinct free slots. A lookup hashes the key, reads the pilot of its bucket and probes
+ * exactly one slot: there are no chains, trees or empty slots.
+ *
+ * The hashing overhead is about 1 byte per key (one pilot per `LU_HASH_FROZEN_BUCKET_LOAD` keys)
+ * on top of the 4-byte key and the 8-byte value, compared with 24-48 byte nodes plus bucket headers
+ * in lu_hash_table_t.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_FROZEN_BUCKET_LOAD		4		// Average number of keys sharing one pilot
+#define LU_HASH_FROZEN_MAX_ATTEMPTS		16		// Seeds tried before giving up on building the perfect hash
+
+	/**
+	 * Structure representing a frozen, read-only hash table.
+	 */
+	typedef struct lu_hash_frozen_s {
+		unsigned int*	   pilots;			// One displacement value per bucket
+		int*			   keys;			// keys[slot], one slot per element
+		void**			   values;			// values[slot], parallel to keys
+		size_t			   bucket_count;	// Number of pilot buckets
+		size_t			   element_count;	// Number of elements, equal to the number of slots
+		unsigned long long seed;			// Seed of the perfect hash function
+	}lu_hash_frozen_t;
+
+	/**Function definition*/
+	lu_hash_frozen_t* lu_hash_table_freeze(const lu_hash_table_t* table);
+	void* lu_hash_frozen_find(const lu_hash_frozen_t* frozen, int key);
+	size_t lu_hash_frozen_memory_usage(const lu_hash_frozen_t* frozen);
+	void lu_hash_frozen_destroy(lu_hash_frozen_t* frozen);
+
+#define LU_HASH_TABLE_FREEZE(table)				lu_hash_table_freeze(table)
+#define LU_HASH_FROZEN_FIND(frozen,key)			lu_hash_frozen_find(frozen,key)
+#define LU_HASH_FROZEN_DESTROY(frozen)			lu_hash_frozen_destroy(frozen)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_FROZEN_INCLUDE_H_*/
@@ -0,0 +1,216 @@
+#include "luhash_intrusive.h"
+
+/**
+ * @file luhash_intrusive.c
+ * @brief Intrusive hash table over caller-embedded hooks.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+static void lu_hash_intrusive_rehash(lu_hash_intrusive_t* table, size_t new_table_size, unsigned long long new_seed);
+
+/** @brief Returns the head of the bucket a key belongs to. */
+static inline lu_hash_hook_t** lu_hash_intrusive_bucket(const lu_hash_intrusive_t* table, int key)
+{
+	return &table->buckets[lu_hash_seeded_mix((unsigned int)key, table->seed) & (table->table_size - 1)];
+}
+
+/**
+ * Initializes an intrusive hash table.
+ *
+ * @param table_size The initial number of buckets, rounded up to a power of two. If 0, `LU_HASH_TABLE_DEFAULT_SIZE` is used.
+ * @return A pointer to the newly initialized table, or exits the program if memory allocation fails.
+ */
+lu_hash_intrusive_t* lu_hash_intrusive_init(size_t table_size)
+{
+	if (table_size == 0) {
+		table_size = LU_HASH_TABLE_DEFAULT_SIZE;
+	}
+	size_t size = 1;
+	while (size < table_size) {
+		size <<= 1;
+	}
+
+	lu_hash_intrusive_t* table = (lu_hash_intrusive_t*)LU_MM_MALLOC(sizeof(lu_hash_intrusive_t));
+	table->buckets = (lu_hash_hook_t**)LU_MM_CALLOC(size, sizeof(lu_hash_hook_t*));
+	table->table_size = size;
+	table->element_count = 0;
+	table->seed = lu_hash_random_seed();
+	table->reseed_count = 0;
+	return table;
+}
+
+/**
+ * Sets up a hook that has never been linked, so that the table can tell it from a linked one.
+ *
+ * Call it once for every hook, typically where its object is created, before the first
+ * lu_hash_intrusive_insert. A hook that has been removed from a table needs no new call.
+ *
+ * @param hook The hook embedded in the object.
+ */
+void lu_hash_hook_init(lu_hash_hook_t* hook)
+{
+	hook->next = NULL;
+	hook->key = LU_HASH_HOOK_NO_KEY;
+}
+
+/**
+ * Links a hook into the table under a key.
+ *
+ * Nothing is allocated, except a larger bucket array when the load factor exceeds
+ * `LU_HASH_TABLE_MAX_LOAD_FACTOR`. If another hook is linked under the same key, it is unlinked
+ * and returned, so that the caller can release its object.
+ *
+ * @param table The intrusive table.
+ * @param key The key of the object.
+ * @param hook The hook embedded in the object, set up with lu_hash_hook_init; it must not be
+ *        linked into any table, except under `key` in this one, which leaves the table unchanged.
+ *        With `LU_HASH_DEBUG`, a hook still linked in this table under another key is reported
+ *        and rejected.
+ * @return The hook previously linked under `key`, or NULL if there was none.
+ */
+lu_hash_hook_t* lu_hash_intrusive_insert(lu_hash_intrusive_t* table, int key, lu_hash_hook_t* hook)
+{
+#ifdef LU_HASH_DEBUG
+	// Linking a hook that is still linked under another key would cut off the chain behind it
+	if (hook->key != key && lu_hash_intrusive_find(table, hook->key) == hook) {
+		printf("Error: hook of key %d inserted under key %d while still linked\n", hook->key, key);
+		lu_hash_erron_global_ = LU_ERROR_INVALID_ARGUMENT;
+		return NULL;
+	}
+#endif // LU_HASH_DEBUG
+	hook->key = key;
+
+	lu_hash_hook_t** link = lu_hash_intrusive_bucket(table, key);
+	size_t length = 0;
+	for (lu_hash_hook_t** cur = link; *cur != NULL; cur = &(*cur)->next, length++) {
+		if ((*cur)->key == key) {
+			lu_hash_hook_t* replaced = *cur;
+			if (replaced == hook) {
+				return NULL;	// Already linked under this key, relinking it would loop the chain
+			}
+			hook->next = replaced->next;
+			*cur = hook;
+			replaced->next = NULL;
+			return replaced;
+		}
+	}
+
+	hook->next = *link;
+	*link = hook;
+	table->element_count++;
+
+	if (lu_hash_reseed_chain_suspect(length)) {
+		table->reseed_count++;
+		lu_hash_intrusive_rehash(table, table->table_size, lu_hash_random_seed());
+	}
+	else if ((double)table->element_count / table->table_size > LU_HASH_TABLE_MAX_LOAD_FACTOR) {
+		lu_hash_intrusive_rehash(table, table->table_size * 2, table->seed);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Searches for the hook linked under a key.
+ *
+ * @param table The intrusive table.
+ * @param key The key to search for.
+ * @return The hook, to be turned into its object with LU_HASH_CONTAINER_OF, or NULL if the key
+ *         does not exist.
+ */
+lu_hash_hook_t* lu_hash_intrusive_find(const lu_hash_intrusive_t* table, int key)
+{
+	lu_hash_hook_t* hook = *lu_hash_intrusive_bucket(table, key);
+	while (hook != NULL && hook->key != key) {
+		hook = hook->next;
+	}
+	return hook;
+}
+
+/**
+ * @brief Unlinks the hook of a key. The object itself is left alone.
+ *
+ * @param table The intrusive table.
+ * @param key The key to remove.
+ * @return The unlinked hook, or NULL if the key does not exist.
+ */
+lu_hash_hook_t* lu_hash_intrusive_remove(lu_hash_intrusive_t* table, int key)
+{
+	for (lu_hash_hook_t** link = lu_hash_intrusive_bucket(table, key); *link != NULL; link = &(*link)->next) {
+		if ((*link)->key == key) {
+			lu_hash_hook_t* hook = *link;
+			*link = hook->next;
+			hook->next = NULL;
+			table->element_count--;
+			return hook;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Calls `visit` for every linked hook, in bucket order.
+ *
+ * The visitor must not insert or remove.
+ *
+ * @param table The intrusive table.
+ * @param visit The callback.
+ * @param ctx Passed to every call of `visit`.
+ */
+void lu_hash_intrusive_foreach(const lu_hash_intrusive_t* table, lu_hash_hook_visit_func_t visit, void* ctx)
+{
+	for (size_t i = 0; i < table->table_size; i++) {
+		for (lu_hash_hook_t* hook = table->buckets[i]; hook != NULL; hook = hook->next) {
+			visit(hook, ctx);
+		}
+	}
+}
+
+/**
+ * @brief Returns the number of linked hooks.
+ */
+size_t lu_hash_intrusive_count(const lu_hash_intrusive_t* table)
+{
+	return table->element_count;
+}
+
+/**
+ * @brief Destroys an intrusive table. The objects whose hooks are still linked are not touched.
+ *
+ * @param table A pointer to the table to be destroyed. If the pointer is NULL, the function does nothing.
+ */
+void lu_hash_intrusive_destroy(lu_hash_intrusive_t* table)
+{
+	if (table == NULL) {
+		return;
+	}
+	LU_MM_FREE(table->buckets);
+	LU_MM_FREE(table);
+}
+
+/**
+ * @brief Relinks every hook into a new bucket array of `new_table_size` buckets hashed with `new_seed`.
+ */
+static void lu_hash_intrusive_rehash(lu_hash_intrusive_t* table, size_t new_table_size, unsigned long long new_seed)
+{
+	lu_hash_hook_t** old_buckets = table->buckets;
+	size_t old_table_size = table->table_size;
+
+	table->buckets = (lu_hash_hook_t**)LU_MM_CALLOC(new_table_size, sizeof(lu_hash_hook_t*));
+	table->table_size = new_table_size;
+	table->seed = new_seed;
+	for (size_t i = 0; i < old_table_size; i++) {
+		lu_hash_hook_t* hook = old_buckets[i];
+		while (hook != NULL) {
+			lu_hash_hook_t* next = hook->next;
+			lu_hash_hook_t** bucket = lu_hash_intrusive_bucket(table, hook->key);
+			hook->next = *bucket;
+			*bucket = hook;
+			hook = next;
+		}
+	}
+	LU_MM_FREE(old_buckets);
+}
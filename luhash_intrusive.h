@@ -0,0 +1,95 @@
+#ifndef LU_LU_HASH_INTRUSIVE_INCLUDE_H_
+#define LU_LU_HASH_INTRUSIVE_INCLUDE_H_
+
+/**
+ * @file luhash_intrusive.h
+ * @brief Intrusive hash table that links hooks embedded in the caller's own structures.
+ *
+ * lu_hash_table_t allocates a node per entry that points back at the caller's object, so an insert
+ * costs an allocation and a find follows one more pointer than necessary. An intrusive table
+ * instead links `lu_hash_hook_t` members that the caller embeds in its structures, in the manner
+ * of the Linux kernel's hlist or Boost.Intrusive: insert and find never allocate, the key is
+ * compared in the object itself, and LU_HASH_CONTAINER_OF turns a hook back into its object.
+ *
+ * The table owns only its bucket array, which is reallocated when the table grows; the objects
+ * belong to the caller, who must keep them alive and their hooks untouched while they are linked.
+ * A hook is linked into at most one table at a time, and must be set up with lu_hash_hook_init
+ * before its first insert. Buckets are lists hashed with a random seed;
+ * an insert that finds more than `LU_HASH_RESEED_CHAIN_LENGTH` entries in its bucket rehashes
+ * under a new seed.
+ *
+ * Usage example:
+ *     typedef struct {
+ *         char name[50];
+ *         lu_hash_hook_t by_id;
+ *     } Person;
+ *
+ *     lu_hash_hook_init(&person->by_id);
+ *     lu_hash_intrusive_insert(people, 1001, &person->by_id);
+ *     lu_hash_hook_t* hook = lu_hash_intrusive_find(people, 1001);
+ *     Person* found = hook ? LU_HASH_CONTAINER_OF(hook, Person, by_id) : NULL;
+ *
+ * Not thread-safe: one thread at a time.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include <limits.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/** Returns the structure of type `type` whose member `member` is at `ptr` */
+#define LU_HASH_CONTAINER_OF(ptr, type, member)	((type*)((char*)(ptr) - offsetof(type, member)))
+
+#define LU_HASH_HOOK_NO_KEY		INT_MIN		// Key of a hook that lu_hash_hook_init has set up
+
+	/**
+	 * Hook embedded in the caller's structure, linked into a bucket by the table.
+	 */
+	typedef struct lu_hash_hook_s {
+		struct lu_hash_hook_s* next;	// Next hook of the bucket
+		int					   key;		// Key of the object, set by lu_hash_intrusive_insert
+	}lu_hash_hook_t;
+
+	/**
+	 * Structure representing an intrusive hash table.
+	 */
+	typedef struct lu_hash_intrusive_s {
+		lu_hash_hook_t**   buckets;
+		size_t			   table_size;		// Number of buckets, a power of two
+		size_t			   element_count;	// Number of linked hooks
+		unsigned long long seed;			// Random seed mixed into every hash
+		size_t			   reseed_count;	// Number of rehashes under a new seed
+	}lu_hash_intrusive_t;
+
+	/** Callback invoked for every linked hook by lu_hash_intrusive_foreach */
+	typedef void (*lu_hash_hook_visit_func_t)(lu_hash_hook_t* hook, void* ctx);
+
+	/**Function definition*/
+	lu_hash_intrusive_t* lu_hash_intrusive_init(size_t table_size);
+	void lu_hash_hook_init(lu_hash_hook_t* hook);
+	lu_hash_hook_t* lu_hash_intrusive_insert(lu_hash_intrusive_t* table, int key, lu_hash_hook_t* hook);
+	lu_hash_hook_t* lu_hash_intrusive_find(const lu_hash_intrusive_t* table, int key);
+	lu_hash_hook_t* lu_hash_intrusive_remove(lu_hash_intrusive_t* table, int key);
+	void lu_hash_intrusive_foreach(const lu_hash_intrusive_t* table, lu_hash_hook_visit_func_t visit, void* ctx);
+	size_t lu_hash_intrusive_count(const lu_hash_intrusive_t* table);
+	void lu_hash_intrusive_destroy(lu_hash_intrusive_t* table);
+
+#define LU_HASH_INTRUSIVE_INIT(size)				lu_hash_intrusive_init(size)
+#define LU_HASH_INTRUSIVE_INSERT(table,key,hook)	lu_hash_intrusive_insert(table,key,hook)
+#define LU_HASH_INTRUSIVE_FIND(table,key)			lu_hash_intrusive_find(table,key)
+#define LU_HASH_INTRUSIVE_REMOVE(table,key)			lu_hash_intrusive_remove(table,key)
+#define LU_HASH_INTRUSIVE_DESTROY(table)			lu_hash_intrusive_destroy(table)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_INTRUSIVE_INCLUDE_H_*/
@@ -0,0 +1,712 @@
+#include "luhash_lockfree.h"
+
+/**
+ * @file luhash_lockfree.c
+ * @brief Split-ordered list hash table with lazy bucket initialization and epoch-based reclamation.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#define LU_LF_MARK(ptr)			((lu_hash_lockfree_node_t*)((size_t)(ptr) | (size_t)1))
+#define LU_LF_UNMARK(ptr)		((lu_hash_lockfree_node_t*)((size_t)(ptr) & ~(size_t)1))
+#define LU_LF_IS_MARKED(ptr)	(((size_t)(ptr) & (size_t)1) != 0)
+
+#define LU_LF_LOAD(ptr)					((lu_hash_lockfree_node_t*)lu_atomic_load_ptr((void* volatile*)(ptr)))
+#define LU_LF_CAS(ptr, expected, desired)	lu_atomic_cas_ptr((void* volatile*)(ptr), (void*)(expected), (void*)(desired))
+
+/** Address of this variable identifies the calling thread */
+static LU_THREAD_LOCAL char lu_hash_lockfree_thread_tag_;
+/** Last table used by this thread and the matching reclamation record */
+static LU_THREAD_LOCAL size_t lu_hash_lockfree_cached_id_ = 0;
+static LU_THREAD_LOCAL lu_hash_lockfree_thread_t* lu_hash_lockfree_cached_record_ = NULL;
+
+/** Source of unique table ids, 0 is never handed out */
+static volatile size_t lu_hash_lockfree_next_id_ = 0;
+
+static unsigned int lu_hash_lockfree_mix(int key);
+static unsigned int lu_hash_lockfree_reverse(unsigned int bits);
+static unsigned int lu_hash_lockfree_log2(size_t value);
+
+static lu_hash_lockfree_thread_t* lu_hash_lockfree_enter(lu_hash_lockfree_t* table);
+static void lu_hash_lockfree_exit(lu_hash_lockfree_thread_t* record);
+static void lu_hash_lockfree_retire(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, lu_hash_lockfree_node_t* node);
+static void lu_hash_lockfree_try_advance(lu_hash_lockfree_t* table);
+static void lu_hash_lockfree_free_list(lu_hash_lockfree_node_t* node);
+
+static lu_hash_lockfree_node_t* volatile* lu_hash_lockfree_bucket_slot(lu_hash_lockfree_t* table, size_t index);
+static lu_hash_lockfree_node_t* lu_hash_lockfree_get_bucket(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, size_t index);
+static lu_hash_lockfree_node_t* lu_hash_lockfree_init_bucket(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, size_t index);
+static int lu_hash_lockfree_list_find(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, lu_hash_lockfree_node_t* head,
+	unsigned int so_key, int key, lu_hash_lockfree_node_t* volatile** out_prev, lu_hash_lockfree_node_t** out_cur);
+static lu_hash_lockfree_node_t* lu_hash_lockfree_lookup(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, int key);
+static void lu_hash_lockfree_count_insert(lu_hash_lockfree_t* table, size_t size);
+
+/**
+ * @brief Mixes a key into a 32-bit hash (MurmurHash3 finalizer).
+ *
+ * The mix is a bijection, so two different keys never share a hash and the split-order keys of
+ * two regular nodes can only collide in the bit that is overwritten by the regular-node flag.
+ *
+ * @param key The key to mix.
+ * @return The mixed hash.
+ */
+static unsigned int lu_hash_lockfree_mix(int key)
+{
+	unsigned int h = (unsigned int)key;
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h;
+}
+
+/**
+ * @brief Reverses the bit order of a 32-bit value.
+ */
+static unsigned int lu_hash_lockfree_reverse(unsigned int bits)
+{
+	bits = ((bits >> 1) & 0x55555555U) | ((bits & 0x55555555U) << 1);
+	bits = ((bits >> 2) & 0x33333333U) | ((bits & 0x33333333U) << 2);
+	bits = ((bits >> 4) & 0x0F0F0F0FU) | ((bits & 0x0F0F0F0FU) << 4);
+	bits = ((bits >> 8) & 0x00FF00FFU) | ((bits & 0x00FF00FFU) << 8);
+	return (bits >> 16) | (bits << 16);
+}
+
+/**
+ * @brief Returns the index of the highest set bit of a non-zero value.
+ */
+static unsigned int lu_hash_lockfree_log2(size_t value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+	unsigned long bit;
+	_BitScanReverse64(&bit, (unsigned long long)value);
+	return (unsigned int)bit;
+#elif defined(__GNUC__)
+	return (unsigned int)(sizeof(unsigned long long) * 8 - 1) - (unsigned int)__builtin_clzll((unsigned long long)value);
+#else
+	unsigned int bit = 0;
+	while (value >>= 1) {
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+/**
+ * Initializes a lock-free hash table.
+ *
+ * Only bucket 0 is created eagerly; every other bucket is initialized on first use.
+ *
+ * @param table_size The initial number of buckets, rounded up to a power of two. If 0, `LU_HASH_TABLE_DEFAULT_SIZE` is used.
+ * @return A pointer to the newly initialized table, or exits the program if memory allocation fails.
+ */
+lu_hash_lockfree_t* lu_hash_lockfree_init(size_t table_size)
+{
+	if (table_size == 0) {
+		table_size = LU_HASH_TABLE_DEFAULT_SIZE;
+	}
+	size_t size = 2;
+	while (size < table_size && size < ((size_t)1 << (LU_HASH_LOCKFREE_SEGMENTS - 1))) {
+		size <<= 1;
+	}
+
+	lu_hash_lockfree_t* table = (lu_hash_lockfree_t*)LU_MM_CALLOC(1, sizeof(lu_hash_lockfree_t));
+	table->table_size = size;
+	table->element_count = 0;
+	table->epoch = 0;
+	table->threads = NULL;
+	table->id = lu_atomic_fetch_add_size(&lu_hash_lockfree_next_id_, 1) + 1;
+
+	// Segment 0 holds buckets 0 and 1, bucket 0 anchors the whole list
+	table->segments[0] = (lu_hash_lockfree_node_t* volatile*)LU_MM_CALLOC(2, sizeof(lu_hash_lockfree_node_t*));
+	lu_hash_lockfree_node_t* head = (lu_hash_lockfree_node_t*)LU_MM_CALLOC(1, sizeof(lu_hash_lockfree_node_t));
+	head->so_key = 0;
+	table->segments[0][0] = head;
+
+	return table;
+}
+
+/**
+ * @brief Enters an epoch critical section for the calling thread.
+ *
+ * The thread record is looked up once per table and cached in thread-local storage. Entering
+ * publishes the current global epoch, and any retire list that is at least two epochs old is
+ * freed at this point because no thread can still hold a reference into it.
+ *
+ * @param table A pointer to the lock-free table.
+ * @return The reclamation record of the calling thread.
+ */
+static lu_hash_lockfree_thread_t* lu_hash_lockfree_enter(lu_hash_lockfree_t* table)
+{
+	lu_hash_lockfree_thread_t* record = lu_hash_lockfree_cached_record_;
+	if (lu_hash_lockfree_cached_id_ != table->id) {
+		// Slow path: find the record of this thread or publish a new one
+		record = (lu_hash_lockfree_thread_t*)lu_atomic_load_ptr((void* volatile*)&table->threads);
+		while (record != NULL && record->owner != &lu_hash_lockfree_thread_tag_) {
+			record = record->next;
+		}
+		if (record == NULL) {
+			record = (lu_hash_lockfree_thread_t*)LU_MM_CALLOC(1, sizeof(lu_hash_lockfree_thread_t));
+			record->owner = &lu_hash_lockfree_thread_tag_;
+			do {
+				record->next = (lu_hash_lockfree_thread_t*)lu_atomic_load_ptr((void* volatile*)&table->threads);
+			} while (!lu_atomic_cas_ptr((void* volatile*)&table->threads, record->next, record));
+		}
+		lu_hash_lockfree_cached_id_ = table->id;
+		lu_hash_lockfree_cached_record_ = record;
+	}
+
+	// Publish the epoch with a full barrier before any shared pointer is read
+	size_t epoch = lu_atomic_load_size(&table->epoch);
+	lu_atomic_exchange_size(&record->epoch, (epoch << 1) | 1);
+
+	for (int i = 0; i < 3; i++) {
+		if (record->retired[i] != NULL && record->retired_epoch[i] + 2 <= epoch) {
+			lu_hash_lockfree_free_list(record->retired[i]);
+			record->retired[i] = NULL;
+		}
+	}
+	return record;
+}
+
+/**
+ * @brief Leaves the epoch critical section entered with lu_hash_lockfree_enter.
+ */
+static void lu_hash_lockfree_exit(lu_hash_lockfree_thread_t* record)
+{
+	lu_atomic_store_size(&record->epoch, 0);
+}
+
+/**
+ * @brief Hands an unlinked node over to the reclamation scheme.
+ *
+ * The node is tagged with the global epoch read after it was unlinked: any thread that could still
+ * hold a reference to it entered in that epoch or earlier. It is freed by the owning thread once
+ * the global epoch has advanced twice past the tag, which requires all of those threads to have
+ * left their critical sections.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param record The reclamation record of the calling thread.
+ * @param node The node that was just unlinked from the list.
+ */
+static void lu_hash_lockfree_retire(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, lu_hash_lockfree_node_t* node)
+{
+	size_t epoch = lu_atomic_load_size(&table->epoch);
+	int slot = (int)(epoch % 3);
+
+	// A list with an older epoch in this slot is at least three epochs old and therefore safe
+	if (record->retired[slot] != NULL && record->retired_epoch[slot] != epoch) {
+		lu_hash_lockfree_free_list(record->retired[slot]);
+		record->retired[slot] = NULL;
+	}
+
+	node->retired_next = record->retired[slot];
+	record->retired[slot] = node;
+	record->retired_epoch[slot] = epoch;
+
+	if (++record->retired_count >= LU_HASH_LOCKFREE_RETIRE_BATCH) {
+		record->retired_count = 0;
+		lu_hash_lockfree_try_advance(table);
+	}
+}
+
+/**
+ * @brief Advances the global epoch if every active thread has observed the current one.
+ */
+static void lu_hash_lockfree_try_advance(lu_hash_lockfree_t* table)
+{
+	size_t epoch = lu_atomic_load_size(&table->epoch);
+	lu_hash_lockfree_thread_t* record = (lu_hash_lockfree_thread_t*)lu_atomic_load_ptr((void* volatile*)&table->threads);
+	while (record != NULL) {
+		size_t state = lu_atomic_load_size(&record->epoch);
+		if ((state & 1) && (state >> 1) != epoch) {
+			return; // A thread is still running in an older epoch
+		}
+		record = record->next;
+	}
+	lu_atomic_cas_size(&table->epoch, epoch, epoch + 1);
+}
+
+/**
+ * @brief Frees a retire list.
+ */
+static void lu_hash_lockfree_free_list(lu_hash_lockfree_node_t* node)
+{
+	while (node != NULL) {
+		lu_hash_lockfree_node_t* next = node->retired_next;
+		LU_MM_FREE(node);
+		node = next;
+	}
+}
+
+/**
+ * @brief Returns the address of a bucket slot, allocating its segment on first use.
+ *
+ * Segment 0 holds buckets 0 and 1, segment j (j >= 1) holds buckets [2^j, 2^(j+1)). Competing
+ * threads race to install a new segment with CAS and the losers free their copy.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param index The bucket index.
+ * @return The address of the bucket slot.
+ */
+static lu_hash_lockfree_node_t* volatile* lu_hash_lockfree_bucket_slot(lu_hash_lockfree_t* table, size_t index)
+{
+	unsigned int segment = index < 2 ? 0 : lu_hash_lockfree_log2(index);
+	size_t offset = segment == 0 ? index : index - ((size_t)1 << segment);
+
+	lu_hash_lockfree_node_t* volatile* buckets =
+		(lu_hash_lockfree_node_t* volatile*)lu_atomic_load_ptr((void* volatile*)&table->segments[segment]);
+	if (buckets == NULL) {
+		lu_hash_lockfree_node_t* volatile* fresh =
+			(lu_hash_lockfree_node_t* volatile*)LU_MM_CALLOC((size_t)1 << segment, sizeof(lu_hash_lockfree_node_t*));
+		if (lu_atomic_cas_ptr((void* volatile*)&table->segments[segment], NULL, (void*)fresh)) {
+			buckets = fresh;
+		}
+		else {
+			LU_MM_FREE((void*)fresh);
+			buckets = (lu_hash_lockfree_node_t* volatile*)lu_atomic_load_ptr((void* volatile*)&table->segments[segment]);
+		}
+	}
+	return &buckets[offset];
+}
+
+/**
+ * @brief Returns the dummy node of a bucket, initializing the bucket if needed.
+ */
+static lu_hash_lockfree_node_t* lu_hash_lockfree_get_bucket(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, size_t index)
+{
+	lu_hash_lockfree_node_t* dummy = LU_LF_LOAD(lu_hash_lockfree_bucket_slot(table, index));
+	if (dummy == NULL) {
+		dummy = lu_hash_lockfree_init_bucket(table, record, index);
+	}
+	return dummy;
+}
+
+/**
+ * @brief Initializes a bucket by splitting it off its parent bucket.
+ *
+ * The parent is the bucket index with its highest set bit cleared. Its dummy node precedes every
+ * element of the new bucket in split order, so the new dummy node is inserted into the list
+ * starting from there. If another thread inserted the same dummy first, that node is reused.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param record The reclamation record of the calling thread.
+ * @param index The index of the bucket to initialize (never 0).
+ * @return The dummy node of the bucket.
+ */
+static lu_hash_lockfree_node_t* lu_hash_lockfree_init_bucket(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, size_t index)
+{
+	size_t parent = index & ~((size_t)1 << lu_hash_lockfree_log2(index));
+	lu_hash_lockfree_node_t* parent_dummy = lu_hash_lockfree_get_bucket(table, record, parent);
+
+	lu_hash_lockfree_node_t* dummy = (lu_hash_lockfree_node_t*)LU_MM_CALLOC(1, sizeof(lu_hash_lockfree_node_t));
+	dummy->so_key = lu_hash_lockfree_reverse((unsigned int)index);
+
+	for (;;) {
+		lu_hash_lockfree_node_t* volatile* prev;
+		lu_hash_lockfree_node_t* cur;
+		if (lu_hash_lockfree_list_find(table, record, parent_dummy, dummy->so_key, 0, &prev, &cur)) {
+			// Another thread initialized the bucket first, our dummy was never published
+			LU_MM_FREE(dummy);
+			dummy = cur;
+			break;
+		}
+		dummy->next = cur;
+		if (LU_LF_CAS(prev, cur, dummy)) {
+			break;
+		}
+	}
+
+	LU_LF_CAS(lu_hash_lockfree_bucket_slot(table, index), NULL, dummy);
+	return dummy;
+}
+
+/**
+ * @brief Searches the split-ordered list for a node, unlinking deleted nodes on the way.
+ *
+ * On return, *out_prev is the link that points to *out_cur, and *out_cur is either the matching
+ * node or the first node that sorts after the searched one (NULL at the end of the list). A new
+ * node can be inserted between them with a single CAS on *out_prev.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param record The reclamation record of the calling thread.
+ * @param head The dummy node to start from.
+ * @param so_key The split-order key to search for.
+ * @param key The key to search for, only compared for regular (odd) split-order keys.
+ * @param out_prev Receives the link preceding the position.
+ * @param out_cur Receives the node at the position.
+ * @return 1 if a matching node was found, 0 otherwise.
+ */
+static int lu_hash_lockfree_list_find(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, lu_hash_lockfree_node_t* head,
+	unsigned int so_key, int key, lu_hash_lockfree_node_t* volatile** out_prev, lu_hash_lockfree_node_t** out_cur)
+{
+	lu_hash_lockfree_node_t* volatile* prev;
+	lu_hash_lockfree_node_t* cur;
+
+retry:
+	prev = &head->next;
+	cur = LU_LF_UNMARK(LU_LF_LOAD(prev));
+	while (cur != NULL) {
+		lu_hash_lockfree_node_t* next = LU_LF_LOAD(&cur->next);
+		if (LU_LF_IS_MARKED(next)) {
+			// cur is logically deleted, unlink it before moving on
+			if (!LU_LF_CAS(prev, cur, LU_LF_UNMARK(next))) {
+				goto retry;
+			}
+			lu_hash_lockfree_retire(table, record, cur);
+			cur = LU_LF_UNMARK(next);
+			continue;
+		}
+		if (cur->so_key > so_key) {
+			break;
+		}
+		if (cur->so_key == so_key && ((so_key & 1) == 0 || cur->key == key)) {
+			*out_prev = prev;
+			*out_cur = cur;
+			return 1;
+		}
+		prev = &cur->next;
+		cur = next;
+	}
+
+	*out_prev = prev;
+	*out_cur = cur;
+	return 0;
+}
+
+/**
+ * Inserts a key-value pair into the lock-free table.
+ *
+ * If the key already exists its value is replaced. After a successful insert the logical bucket
+ * count is doubled with a single CAS once the average load exceeds `LU_HASH_LOCKFREE_MAX_LOAD`;
+ * the new buckets are split off lazily by later operations.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param key   The key to be inserted or updated.
+ * @param value A pointer to the value associated with the key.
+ */
+void lu_hash_lockfree_insert(lu_hash_lockfree_t* table, int key, void* value)
+{
+	lu_hash_lockfree_thread_t* record = lu_hash_lockfree_enter(table);
+
+	unsigned int hash = lu_hash_lockfree_mix(key);
+	size_t size = lu_atomic_load_size(&table->table_size);
+	lu_hash_lockfree_node_t* head = lu_hash_lockfree_get_bucket(table, record, hash & (size - 1));
+
+	unsigned int so_key = lu_hash_lockfree_reverse(hash) | 1;
+	lu_hash_lockfree_node_t* node = NULL;
+
+	for (;;) {
+		lu_hash_lockfree_node_t* volatile* prev;
+		lu_hash_lockfree_node_t* cur;
+		if (lu_hash_lockfree_list_find(table, record, head, so_key, key, &prev, &cur)) {
+			// Key already present: update the value in place
+			lu_atomic_store_ptr(&cur->value, value);
+			LU_MM_FREE(node);
+			lu_hash_lockfree_exit(record);
+			return;
+		}
+
+		// Allocate the node only once we know the key is new, and keep it across retries
+		if (node == NULL) {
+			node = (lu_hash_lockfree_node_t*)LU_MM_MALLOC(sizeof(lu_hash_lockfree_node_t));
+			node->so_key = so_key;
+			node->key = key;
+			node->value = value;
+			node->counter = 0;
+			node->retired_next = NULL;
+		}
+		node->next = cur;
+		if (LU_LF_CAS(prev, cur, node)) {
+			break;
+		}
+	}
+
+	lu_hash_lockfree_count_insert(table, size);
+	lu_hash_lockfree_exit(record);
+}
+
+/**
+ * @brief Counts a newly linked node and doubles the logical bucket count if the load is exceeded.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param size The bucket count that the inserting operation read.
+ */
+static void lu_hash_lockfree_count_insert(lu_hash_lockfree_t* table, size_t size)
+{
+	size_t count = lu_atomic_fetch_add_size(&table->element_count, 1) + 1;
+	if (count > size * LU_HASH_LOCKFREE_MAX_LOAD && size < ((size_t)1 << (LU_HASH_LOCKFREE_SEGMENTS - 1))) {
+		lu_atomic_cas_size(&table->table_size, size, size * 2);
+	}
+}
+
+/**
+ * @brief Searches for a key in the lock-free table.
+ *
+ * The lookup never writes to shared memory apart from the thread's own epoch record: it skips
+ * logically deleted nodes instead of unlinking them.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param key The key to search for.
+ * @return A pointer to the value associated with the key if found, or NULL if the key does not exist.
+ */
+void* lu_hash_lockfree_find(lu_hash_lockfree_t* table, int key)
+{
+	lu_hash_lockfree_thread_t* record = lu_hash_lockfree_enter(table);
+	lu_hash_lockfree_node_t* node = lu_hash_lockfree_lookup(table, record, key);
+	void* value = node != NULL ? lu_atomic_load_ptr(&node->value) : NULL;
+	lu_hash_lockfree_exit(record);
+	return value;
+}
+
+/**
+ * @brief Returns the live node of a key without writing to shared memory.
+ *
+ * Logically deleted nodes are skipped instead of unlinked. Must be called inside an epoch critical
+ * section, which keeps the returned node allocated until lu_hash_lockfree_exit.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param record The reclamation record of the calling thread.
+ * @param key The key to search for.
+ * @return The node of the key, or NULL if the key does not exist.
+ */
+static lu_hash_lockfree_node_t* lu_hash_lockfree_lookup(lu_hash_lockfree_t* table, lu_hash_lockfree_thread_t* record, int key)
+{
+	unsigned int hash = lu_hash_lockfree_mix(key);
+	unsigned int so_key = lu_hash_lockfree_reverse(hash) | 1;
+	size_t size = lu_atomic_load_size(&table->table_size);
+	lu_hash_lockfree_node_t* head = lu_hash_lockfree_get_bucket(table, record, hash & (size - 1));
+
+	lu_hash_lockfree_node_t* cur = LU_LF_UNMARK(LU_LF_LOAD(&head->next));
+	while (cur != NULL && cur->so_key <= so_key) {
+		lu_hash_lockfree_node_t* next = LU_LF_LOAD(&cur->next);
+		if (cur->so_key == so_key && cur->key == key && !LU_LF_IS_MARKED(next)) {
+			return cur;
+		}
+		cur = LU_LF_UNMARK(next);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Deletes a key from the lock-free table.
+ *
+ * The node is first marked as deleted with a CAS on its own next pointer, which is the
+ * linearization point, and then unlinked. If the unlink CAS loses a race, a search is run to
+ * finish the unlink; whichever thread unlinks the node retires it.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param key The key to delete.
+ */
+void lu_hash_lockfree_delete(lu_hash_lockfree_t* table, int key)
+{
+	lu_hash_lockfree_thread_t* record = lu_hash_lockfree_enter(table);
+
+	unsigned int hash = lu_hash_lockfree_mix(key);
+	unsigned int so_key = lu_hash_lockfree_reverse(hash) | 1;
+	size_t size = lu_atomic_load_size(&table->table_size);
+	lu_hash_lockfree_node_t* head = lu_hash_lockfree_get_bucket(table, record, hash & (size - 1));
+
+	for (;;) {
+		lu_hash_lockfree_node_t* volatile* prev;
+		lu_hash_lockfree_node_t* cur;
+		if (!lu_hash_lockfree_list_find(table, record, head, so_key, key, &prev, &cur)) {
+			break; // Key not found
+		}
+
+		lu_hash_lockfree_node_t* next = LU_LF_LOAD(&cur->next);
+		if (LU_LF_IS_MARKED(next) || !LU_LF_CAS(&cur->next, next, LU_LF_MARK(next))) {
+			continue; // Lost the race against another writer, search again
+		}
+
+		lu_atomic_fetch_add_size(&table->element_count, (size_t)-1);
+		if (LU_LF_CAS(prev, cur, next)) {
+			lu_hash_lockfree_retire(table, record, cur);
+		}
+		else {
+			lu_hash_lockfree_list_find(table, record, head, so_key, key, &prev, &cur);
+		}
+		break;
+	}
+
+	lu_hash_lockfree_exit(record);
+}
+
+/**
+ * @brief Reads the counter of a key.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param key The key to read.
+ * @param counter Receives the counter if the key exists.
+ * @return 1 if the key exists, 0 otherwise.
+ */
+int lu_hash_lockfree_get_counter(lu_hash_lockfree_t* table, int key, long long* counter)
+{
+	lu_hash_lockfree_thread_t* record = lu_hash_lockfree_enter(table);
+	lu_hash_lockfree_node_t* node = lu_hash_lockfree_lookup(table, record, key);
+	if (node != NULL) {
+		*counter = lu_atomic_load_i64(&node->counter);
+	}
+	lu_hash_lockfree_exit(record);
+	return node != NULL;
+}
+
+/**
+ * @brief Atomically adds to the counter of an existing key.
+ *
+ * The key is looked up without writing to shared memory and the counter is updated with a single
+ * atomic add, so threads counting different or even the same keys never wait for each other.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param key The key whose counter is updated.
+ * @param delta The amount to add, may be negative.
+ * @param previous If not NULL, receives the counter before the addition.
+ * @return 1 if the key exists, 0 if it does not and nothing was added.
+ */
+int lu_hash_lockfree_fetch_add(lu_hash_lockfree_t* table, int key, long long delta, long long* previous)
+{
+	lu_hash_lockfree_thread_t* record = lu_hash_lockfree_enter(table);
+	lu_hash_lockfree_node_t* node = lu_hash_lockfree_lookup(table, record, key);
+	if (node != NULL) {
+		long long old = lu_atomic_fetch_add_i64(&node->counter, delta);
+		if (previous != NULL) {
+			*previous = old;
+		}
+	}
+	lu_hash_lockfree_exit(record);
+	return node != NULL;
+}
+
+/**
+ * @brief Atomically replaces the counter of an existing key if it holds an expected value.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param key The key whose counter is updated.
+ * @param expected The value the counter must hold.
+ * @param desired The value to store.
+ * @return 1 if the counter was replaced, 0 if the key does not exist or its counter differs.
+ */
+int lu_hash_lockfree_compare_exchange(lu_hash_lockfree_t* table, int key, long long expected, long long desired)
+{
+	lu_hash_lockfree_thread_t* record = lu_hash_lockfree_enter(table);
+	lu_hash_lockfree_node_t* node = lu_hash_lockfree_lookup(table, record, key);
+	int swapped = node != NULL && lu_atomic_cas_i64(&node->counter, expected, desired);
+	lu_hash_lockfree_exit(record);
+	return swapped;
+}
+
+/**
+ * Adds to the counter of a key, inserting the key with a counter of 0 first if it is missing.
+ *
+ * An existing key costs the same as lu_hash_lockfree_fetch_add. A missing key is linked into the
+ * list with a CAS that already carries `delta` and a NULL value pointer; if another thread inserts
+ * the key first, the addition goes to that thread's node instead.
+ *
+ * @param table A pointer to the lock-free table.
+ * @param key The key whose counter is updated.
+ * @param delta The amount to add, may be negative.
+ * @return The counter after the addition.
+ *
+ * Usage example:
+ *     for (size_t i = 0; i < event_count; i++) {
+ *         lu_hash_lockfree_add(counts, events[i].user_id, 1);   // From any number of threads
+ *     }
+ */
+long long lu_hash_lockfree_add(lu_hash_lockfree_t* table, int key, long long delta)
+{
+	lu_hash_lockfree_thread_t* record = lu_hash_lockfree_enter(table);
+	lu_hash_lockfree_node_t* node = lu_hash_lockfree_lookup(table, record, key);
+	if (node != NULL) {
+		long long counter = lu_atomic_fetch_add_i64(&node->counter, delta) + delta;
+		lu_hash_lockfree_exit(record);
+		return counter;
+	}
+
+	unsigned int hash = lu_hash_lockfree_mix(key);
+	size_t size = lu_atomic_load_size(&table->table_size);
+	lu_hash_lockfree_node_t* head = lu_hash_lockfree_get_bucket(table, record, hash & (size - 1));
+	unsigned int so_key = lu_hash_lockfree_reverse(hash) | 1;
+
+	for (;;) {
+		lu_hash_lockfree_node_t* volatile* prev;
+		lu_hash_lockfree_node_t* cur;
+		if (lu_hash_lockfree_list_find(table, record, head, so_key, key, &prev, &cur)) {
+			// Inserted by another thread since the lookup
+			LU_MM_FREE(node);
+			long long counter = lu_atomic_fetch_add_i64(&cur->counter, delta) + delta;
+			lu_hash_lockfree_exit(record);
+			return counter;
+		}
+
+		if (node == NULL) {
+			node = (lu_hash_lockfree_node_t*)LU_MM_MALLOC(sizeof(lu_hash_lockfree_node_t));
+			node->so_key = so_key;
+			node->key = key;
+			node->value = NULL;
+			node->counter = delta;
+			node->retired_next = NULL;
+		}
+		node->next = cur;
+		if (LU_LF_CAS(prev, cur, node)) {
+			break;
+		}
+	}
+
+	lu_hash_lockfree_count_insert(table, size);
+	lu_hash_lockfree_exit(record);
+	return delta;
+}
+
+/**
+ * @brief Returns the current number of elements.
+ */
+size_t lu_hash_lockfree_count(lu_hash_lockfree_t* table)
+{
+	return lu_atomic_load_size(&table->element_count);
+}
+
+/**
+ * @brief Destroys a lock-free table and frees all memory, including nodes still awaiting reclamation.
+ *
+ * Must not be called while other threads are still using the table.
+ *
+ * @param table A pointer to the table to be destroyed. If the pointer is NULL, the function does nothing.
+ */
+void lu_hash_lockfree_destroy(lu_hash_lockfree_t* table)
+{
+	if (table == NULL) {
+		return;
+	}
+
+	// Every live node, dummy or regular, is reachable from the dummy node of bucket 0
+	lu_hash_lockfree_node_t* node = table->segments[0][0];
+	while (node != NULL) {
+		lu_hash_lockfree_node_t* next = LU_LF_UNMARK(node->next);
+		LU_MM_FREE(node);
+		node = next;
+	}
+
+	lu_hash_lockfree_thread_t* record = table->threads;
+	while (record != NULL) {
+		lu_hash_lockfree_thread_t* next = record->next;
+		for (int i = 0; i < 3; i++) {
+			lu_hash_lockfree_free_list(record->retired[i]);
+		}
+		LU_MM_FREE(record);
+		record = next;
+	}
+
+	for (int i = 0; i < LU_HASH_LOCKFREE_SEGMENTS; i++) {
+		LU_MM_FREE((void*)table->segments[i]);
+	}
+
+	if (lu_hash_lockfree_cached_id_ == table->id) {
+		lu_hash_lockfree_cached_id_ = 0;
+		lu_hash_lockfree_cached_record_ = NULL;
+	}
+	LU_MM_FREE(table);
+}
@@ -0,0 +1,107 @@
+#ifndef LU_LU_HASH_LOCKFREE_INCLUDE_H_
+#define LU_LU_HASH_LOCKFREE_INCLUDE_H_
+
+/**
+ * @file luhash_lockfree.h
+ * @brief Non-blocking hash table based on split-ordered lists (Shalev and Shavit).
+ *
+ * All elements live in a single lock-free linked list (Harris/Michael style, deletion marks the low
+ * bit of the next pointer) sorted by the bit-reversed hash of the key. A bucket is only a shortcut
+ * into that list: a pointer to a dummy node that is inserted lazily, the first time the bucket is
+ * used, by splitting the bucket of its parent. Growing the table therefore just doubles the logical
+ * bucket count with one CAS; no element is ever moved and there is no global rehash pause like
+ * lu_hash_table_resize.
+ *
+ * The bucket index is a segmented array, so doubling never copies or reallocates existing buckets.
+ * Unlinked nodes are reclaimed with epoch-based reclamation: every operation runs inside an epoch
+ * critical section, and retired nodes are freed once every active thread has moved two epochs on.
+ *
+ * Insert, find and delete have the same semantics as lu_hash_table_insert/find/delete and may be
+ * called from any number of threads concurrently. Init and destroy must not race with other calls.
+ *
+ * Besides its value pointer, every element has an inline 64-bit counter for counting workloads.
+ * lu_hash_lockfree_fetch_add and lu_hash_lockfree_compare_exchange update the counter of an
+ * existing key with one atomic instruction after a read-only lookup, and lu_hash_lockfree_add
+ * inserts a missing key with a CAS on the list link where it belongs, so that concurrent counting
+ * needs no lock at all. An update that races with the deletion of its key may be applied to the
+ * entry being deleted and is then lost with it.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include "luhash_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_LOCKFREE_SEGMENTS		32		// Segments of the bucket index, segment j holds 2^j buckets
+#define LU_HASH_LOCKFREE_MAX_LOAD		2		// Average number of elements per bucket before doubling
+#define LU_HASH_LOCKFREE_RETIRE_BATCH	64		// Retired nodes per thread before trying to advance the epoch
+
+	/**
+	 * Structure representing a node of the split-ordered list. Dummy (bucket) nodes have an even
+	 * split-order key, regular nodes an odd one.
+	 */
+	typedef struct lu_hash_lockfree_node_s {
+		struct lu_hash_lockfree_node_s* volatile next;	// Next node, low bit set when this node is logically deleted
+		struct lu_hash_lockfree_node_s* retired_next;	// Link in the retire list once the node is unlinked
+		void* volatile	value;							// Pointer to the value associated with the key
+		volatile long long counter;						// Inline 64-bit value updated by the atomic counter operations
+		unsigned int	so_key;							// Split-order key: bit-reversed hash
+		int				key;							// Key of the node
+	}lu_hash_lockfree_node_t;
+
+	/**
+	 * Structure representing the reclamation state of one thread.
+	 */
+	typedef struct lu_hash_lockfree_thread_s {
+		volatile size_t epoch;							// (epoch << 1) | 1 while inside an operation, 0 otherwise
+		const void* owner;								// Identifies the owning thread
+		lu_hash_lockfree_node_t* retired[3];			// Retired nodes, one list per epoch modulo 3
+		size_t retired_epoch[3];						// Epoch in which each retire list was filled
+		size_t retired_count;							// Nodes retired since the last epoch advance attempt
+		struct lu_hash_lockfree_thread_s* volatile next;
+		char pad[LU_CACHE_LINE_SIZE];
+	}lu_hash_lockfree_thread_t;
+
+	/**
+	 * Structure representing a lock-free hash table.
+	 */
+	typedef struct lu_hash_lockfree_s {
+		lu_hash_lockfree_node_t* volatile* volatile segments[LU_HASH_LOCKFREE_SEGMENTS];
+		volatile size_t table_size;						// Logical number of buckets, always a power of two
+		volatile size_t element_count;					// Current number of elements
+		volatile size_t epoch;							// Global reclamation epoch
+		lu_hash_lockfree_thread_t* volatile threads;	// Reclamation records of all threads that used the table
+		size_t id;										// Unique id used to cache the thread record
+	}lu_hash_lockfree_t;
+
+	/**Function definition*/
+	lu_hash_lockfree_t* lu_hash_lockfree_init(size_t table_size);
+	void lu_hash_lockfree_insert(lu_hash_lockfree_t* table, int key, void* value);
+	void* lu_hash_lockfree_find(lu_hash_lockfree_t* table, int key);
+	void lu_hash_lockfree_delete(lu_hash_lockfree_t* table, int key);
+	void lu_hash_lockfree_destroy(lu_hash_lockfree_t* table);
+	size_t lu_hash_lockfree_count(lu_hash_lockfree_t* table);
+	int lu_hash_lockfree_get_counter(lu_hash_lockfree_t* table, int key, long long* counter);
+	int lu_hash_lockfree_fetch_add(lu_hash_lockfree_t* table, int key, long long delta, long long* previous);
+	int lu_hash_lockfree_compare_exchange(lu_hash_lockfree_t* table, int key, long long expected, long long desired);
+	long long lu_hash_lockfree_add(lu_hash_lockfree_t* table, int key, long long delta);
+
+#define LU_HASH_LOCKFREE_INIT(size)					lu_hash_lockfree_init(size)
+#define LU_HASH_LOCKFREE_INSERT(table,key,value)	lu_hash_lockfree_insert(table,key,value)
+#define LU_HASH_LOCKFREE_FIND(table,key)			lu_hash_lockfree_find(table,key)
+#define LU_HASH_LOCKFREE_DELETE(table,key)			lu_hash_lockfree_delete(table,key)
+#define LU_HASH_LOCKFREE_DESTROY(table)				lu_hash_lockfree_destroy(table)
+#define LU_HASH_LOCKFREE_ADD(table,key,delta)		lu_hash_lockfree_add(table,key,delta)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_LOCKFREE_INCLUDE_H_*/
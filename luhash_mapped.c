@@ -0,0 +1,896 @@
+#include "luhash_mapped.h"
+
+#include <stddef.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @file luhash_mapped.c
+ * @brief Mapped table: file layout, offset-linked lists and red-black trees, growth of the file.
+ *
+ * File layout: the header (lu_hash_mapped_header_t), then a heap that holds the bucket array and
+ * the nodes. Offsets count bytes from the start of the file; 0 is the null offset of lists and the
+ * offset of the `nil` node in the header is the sentinel of every tree, as `tree->nil` is in
+ * luhash.c. Nodes come from the free list, then from the space of the last bucket array given up
+ * by a resize, then from the top of the heap; the file doubles when the heap reaches its end.
+ *
+ * Allocation is the only step that can move the mapping, so every operation allocates before it
+ * takes pointers into the mapping that it keeps using.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#define LU_HASH_MAPPED_MAGIC		"LUHMAP01"
+#define LU_HASH_MAPPED_NIL			((lu_hash_offset_t)offsetof(lu_hash_mapped_header_t, nil))
+#define LU_HASH_MAPPED_MAX_VALUE	0x40000000u
+
+/** Node at an offset of the file */
+#define LU_HASH_MAPPED_AT(map,offset)	((lu_hash_mapped_node_t*)((map)->base + (offset)))
+
+static int lu_hash_mapped_open_file(lu_hash_mapped_t* map, const char* path, size_t* file_bytes);
+static int lu_hash_mapped_remap(lu_hash_mapped_t* map, size_t bytes);
+static void lu_hash_mapped_release(lu_hash_mapped_t* map);
+static int lu_hash_mapped_reserve(lu_hash_mapped_t* map, size_t bytes);
+static lu_hash_offset_t lu_hash_mapped_alloc_node(lu_hash_mapped_t* map);
+static lu_hash_offset_t lu_hash_mapped_alloc_buckets(lu_hash_mapped_t* map, size_t table_size);
+static lu_hash_mapped_node_t* lu_hash_mapped_find_node(lu_hash_mapped_t* map, const lu_hash_mapped_bucket_t* bucket, int key);
+static void lu_hash_mapped_rehash(lu_hash_mapped_t* map, size_t new_table_size, unsigned long long new_seed);
+static void lu_hash_mapped_treeify(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket);
+static size_t lu_hash_mapped_tree_link(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket, lu_hash_offset_t z);
+static void lu_hash_mapped_tree_unlink(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket, lu_hash_offset_t z);
+static lu_hash_offset_t lu_hash_mapped_tree_minimum(lu_hash_mapped_t* map, lu_hash_offset_t x);
+static lu_hash_offset_t lu_hash_mapped_tree_successor(lu_hash_mapped_t* map, lu_hash_offset_t x);
+
+static inline size_t lu_hash_mapped_index(int key, unsigned long long seed, size_t table_size)
+{
+	unsigned long long hash = lu_hash_seeded_mix((unsigned int)key, seed);
+	if ((table_size & (table_size - 1)) == 0) {
+		return (size_t)(hash & (table_size - 1));
+	}
+	return (size_t)(hash % table_size);
+}
+
+/** @brief Returns the bucket a key belongs to. */
+static inline lu_hash_mapped_bucket_t* lu_hash_mapped_bucket(lu_hash_mapped_t* map, int key)
+{
+	lu_hash_mapped_header_t* header = map->header;
+	lu_hash_mapped_bucket_t* buckets = (lu_hash_mapped_bucket_t*)(map->base + header->buckets);
+	return &buckets[lu_hash_mapped_index(key, header->seed, (size_t)header->table_size)];
+}
+
+/** @brief Returns the value bytes that follow a node. */
+static inline void* lu_hash_mapped_value(lu_hash_mapped_node_t* node)
+{
+	return node + 1;
+}
+
+/**
+ * Opens a mapped table, creating the file if it does not exist.
+ *
+ * An existing file is mapped and ready for use without reading its contents. It must have been
+ * created with the same `value_size`.
+ *
+ * @param path The file holding the table.
+ * @param value_size The number of bytes of every value.
+ * @param table_size The initial number of buckets of a new file, 0 for the default. Ignored when
+ *        the file exists.
+ * @return A pointer to the open table, or NULL if the file could not be opened, created or mapped
+ *         or is not a mapped table (lu_hash_erron_global_ is set to LU_ERROR_IO), or if it was
+ *         created with another value size (LU_ERROR_INVALID_ARGUMENT).
+ *
+ * Usage example:
+ *     lu_hash_mapped_t* map = lu_hash_mapped_open("sessions.map", sizeof(session_t), 0);
+ *     session_t* session = (session_t*)lu_hash_mapped_find(map, 42);
+ *     lu_hash_mapped_close(map);
+ */
+lu_hash_mapped_t* lu_hash_mapped_open(const char* path, size_t value_size, size_t table_size)
+{
+	if (value_size > LU_HASH_MAPPED_MAX_VALUE) {
+		lu_hash_erron_global_ = LU_ERROR_INVALID_ARGUMENT;
+		return NULL;
+	}
+	if (table_size == 0) {
+		table_size = LU_HASH_TABLE_DEFAULT_SIZE;
+	}
+	size_t node_bytes = sizeof(lu_hash_mapped_node_t) + ((value_size + 7) & ~(size_t)7);
+
+	lu_hash_mapped_t* map = (lu_hash_mapped_t*)LU_MM_CALLOC(1, sizeof(lu_hash_mapped_t));
+	size_t file_bytes = 0;
+	if (lu_hash_mapped_open_file(map, path, &file_bytes) != LU_OK) {
+		LU_MM_FREE(map);
+		lu_hash_erron_global_ = LU_ERROR_IO;
+		return NULL;
+	}
+
+	if (file_bytes == 0) {
+		size_t bytes = sizeof(lu_hash_mapped_header_t) + table_size * sizeof(lu_hash_mapped_bucket_t);
+		if (lu_hash_mapped_remap(map, bytes < LU_HASH_MAPPED_MIN_FILE_BYTES ? LU_HASH_MAPPED_MIN_FILE_BYTES : bytes) != LU_OK) {
+			lu_hash_mapped_release(map);
+			lu_hash_erron_global_ = LU_ERROR_IO;
+			return NULL;
+		}
+
+		lu_hash_mapped_header_t* header = map->header;
+		memset(header, 0, sizeof(lu_hash_mapped_header_t));
+		memcpy(header->magic, LU_HASH_MAPPED_MAGIC, sizeof(header->magic));
+		header->value_size = (unsigned int)value_size;
+		header->node_bytes = (unsigned int)node_bytes;
+		header->file_bytes = map->mapped_bytes;
+		header->heap_top = sizeof(lu_hash_mapped_header_t);
+		header->seed = lu_hash_random_seed();
+		header->nil.left = LU_HASH_MAPPED_NIL;
+		header->nil.right = LU_HASH_MAPPED_NIL;
+		header->nil.parent = LU_HASH_MAPPED_NIL;
+		header->nil.color = BLACK;
+		header->buckets = lu_hash_mapped_alloc_buckets(map, table_size);
+		header->table_size = table_size;
+		map->was_clean = 1;
+	}
+	else {
+		lu_hash_mapped_header_t* header = NULL;
+		int status = LU_ERROR_IO;
+		if (file_bytes >= sizeof(lu_hash_mapped_header_t) && lu_hash_mapped_remap(map, file_bytes) == LU_OK) {
+			header = map->header;
+			if (memcmp(header->magic, LU_HASH_MAPPED_MAGIC, sizeof(header->magic)) == 0
+				&& header->node_bytes == sizeof(lu_hash_mapped_node_t) + ((header->value_size + 7) & ~7u)
+				&& header->file_bytes <= file_bytes && header->heap_top <= header->file_bytes
+				&& header->table_size != 0 && header->buckets >= sizeof(lu_hash_mapped_header_t)
+				&& header->buckets + header->table_size * sizeof(lu_hash_mapped_bucket_t) <= header->heap_top) {
+				status = header->value_size == value_size ? LU_OK : LU_ERROR_INVALID_ARGUMENT;
+			}
+		}
+		if (status != LU_OK) {
+#ifdef LU_HASH_DEBUG
+			printf("%s is not a mapped table with %zu-byte values\n", path, value_size);
+#endif // LU_HASH_DEBUG
+			lu_hash_mapped_release(map);
+			lu_hash_erron_global_ = status;
+			return NULL;
+		}
+		map->was_clean = header->clean == 1;
+	}
+
+	// Mark the file open on disk before anything else changes, so a crash is recognizable
+	map->header->clean = 0;
+	lu_hash_mapped_sync(map);
+	return map;
+}
+
+/**
+ * Inserts a key with a copy of its value, or overwrites the value of an existing key.
+ *
+ * May grow the file, which invalidates value pointers returned by lu_hash_mapped_find.
+ *
+ * @param map The mapped table.
+ * @param key The key to insert or update.
+ * @param value Points to `value_size` bytes that are copied into the table, may be NULL if `value_size` is 0.
+ * @return LU_OK, or LU_ERROR_IO if the file could not be grown (the table is unchanged).
+ */
+int lu_hash_mapped_insert(lu_hash_mapped_t* map, int key, const void* value)
+{
+	lu_hash_mapped_header_t* header = map->header;
+	if ((double)header->element_count / header->table_size > LU_HASH_TABLE_MAX_LOAD_FACTOR) {
+		// If the file cannot grow for the new buckets, the table just runs at a higher load
+		lu_hash_mapped_rehash(map, (size_t)header->table_size * 2, header->seed);
+	}
+
+	lu_hash_mapped_node_t* node = lu_hash_mapped_find_node(map, lu_hash_mapped_bucket(map, key), key);
+	if (node != NULL) {
+		if (map->header->value_size != 0) {
+			memcpy(lu_hash_mapped_value(node), value, map->header->value_size);
+		}
+		return LU_OK;
+	}
+
+	lu_hash_offset_t offset = lu_hash_mapped_alloc_node(map);
+	if (offset == 0) {
+		lu_hash_erron_global_ = LU_ERROR_IO;
+		return LU_ERROR_IO;
+	}
+	header = map->header;
+	node = LU_HASH_MAPPED_AT(map, offset);
+	node->key = key;
+	if (header->value_size != 0) {
+		memcpy(lu_hash_mapped_value(node), value, header->value_size);
+	}
+
+	lu_hash_mapped_bucket_t* bucket = lu_hash_mapped_bucket(map, key);
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		node->next = bucket->head;
+		bucket->head = offset;
+		bucket->esize_bucket++;
+		header->element_count++;
+		if (bucket->esize_bucket > LU_HASH_BUCKET_LIST_THRESHOLD) {
+			lu_hash_mapped_treeify(map, bucket);
+			header->treeify_count++;
+			if (header->treeify_count > lu_hash_reseed_treeify_limit((size_t)header->table_size, LU_HASH_TABLE_MAX_LOAD_FACTOR, LU_HASH_BUCKET_LIST_THRESHOLD)) {
+				header->reseed_count++;
+				lu_hash_mapped_rehash(map, (size_t)header->table_size, lu_hash_random_seed());
+			}
+		}
+	}
+	else {
+		size_t depth = lu_hash_mapped_tree_link(map, bucket, offset);
+		bucket->esize_bucket++;
+		header->element_count++;
+		if (depth > LU_HASH_RESEED_TREE_HEIGHT) {
+			header->reseed_count++;
+			lu_hash_mapped_rehash(map, (size_t)header->table_size, lu_hash_random_seed());
+		}
+	}
+	return LU_OK;
+}
+
+/**
+ * Searches for a key.
+ *
+ * @param map The mapped table.
+ * @param key The key to search for.
+ * @return A pointer to the `value_size` bytes of the value inside the mapping, which may be read
+ *         and written in place until the next insert, or NULL if the key is absent.
+ */
+void* lu_hash_mapped_find(lu_hash_mapped_t* map, int key)
+{
+	lu_hash_mapped_node_t* node = lu_hash_mapped_find_node(map, lu_hash_mapped_bucket(map, key), key);
+	return node != NULL ? lu_hash_mapped_value(node) : NULL;
+}
+
+/**
+ * Removes a key. Its node is kept for reuse by later inserts; the file does not shrink.
+ *
+ * @param map The mapped table.
+ * @param key The key to remove.
+ */
+void lu_hash_mapped_delete(lu_hash_mapped_t* map, int key)
+{
+	lu_hash_mapped_header_t* header = map->header;
+	lu_hash_mapped_bucket_t* bucket = lu_hash_mapped_bucket(map, key);
+	lu_hash_offset_t removed = 0;
+
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		lu_hash_offset_t* link = &bucket->head;
+		while (*link != 0) {
+			lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, *link);
+			if (node->key == key) {
+				removed = *link;
+				*link = node->next;
+				break;
+			}
+			link = &node->next;
+		}
+	}
+	else {
+		lu_hash_mapped_node_t* node = lu_hash_mapped_find_node(map, bucket, key);
+		if (node != NULL) {
+			removed = (lu_hash_offset_t)((unsigned char*)node - map->base);
+			lu_hash_mapped_tree_unlink(map, bucket, removed);
+		}
+	}
+
+	if (removed != 0) {
+		LU_HASH_MAPPED_AT(map, removed)->next = header->free_nodes;
+		header->free_nodes = removed;
+		bucket->esize_bucket--;
+		header->element_count--;
+	}
+}
+
+/**
+ * Calls a function for every entry, with a pointer to its value inside the mapping.
+ *
+ * The function must not insert into or delete from the table.
+ *
+ * @param map The mapped table.
+ * @param visit The function called for every entry.
+ * @param ctx Context pointer passed to `visit`.
+ */
+void lu_hash_mapped_foreach(lu_hash_mapped_t* map, lu_hash_visit_func_t visit, void* ctx)
+{
+	lu_hash_mapped_header_t* header = map->header;
+	lu_hash_mapped_bucket_t* buckets = (lu_hash_mapped_bucket_t*)(map->base + header->buckets);
+	for (size_t i = 0; i < header->table_size; i++) {
+		if (buckets[i].type == LU_HASH_BUCKET_LIST) {
+			for (lu_hash_offset_t offset = buckets[i].head; offset != 0; offset = LU_HASH_MAPPED_AT(map, offset)->next) {
+				lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, offset);
+				visit(node->key, lu_hash_mapped_value(node), ctx);
+			}
+		}
+		else if (buckets[i].head != LU_HASH_MAPPED_NIL) {
+			for (lu_hash_offset_t offset = lu_hash_mapped_tree_minimum(map, buckets[i].head); offset != LU_HASH_MAPPED_NIL; offset = lu_hash_mapped_tree_successor(map, offset)) {
+				lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, offset);
+				visit(node->key, lu_hash_mapped_value(node), ctx);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Returns the number of entries in a mapped table.
+ */
+size_t lu_hash_mapped_count(const lu_hash_mapped_t* map)
+{
+	return (size_t)map->header->element_count;
+}
+
+/**
+ * Writes all changes to the file and waits until they are on stable storage.
+ *
+ * @param map The mapped table.
+ * @return LU_OK, or LU_ERROR_IO if the flush failed.
+ */
+int lu_hash_mapped_sync(lu_hash_mapped_t* map)
+{
+#if defined(_WIN32)
+	int ok = FlushViewOfFile(map->base, 0) && FlushFileBuffers(map->file);
+#else
+	int ok = msync(map->base, map->mapped_bytes, MS_SYNC) == 0 && fsync(map->fd) == 0;
+#endif
+	if (!ok) {
+		lu_hash_erron_global_ = LU_ERROR_IO;
+		return LU_ERROR_IO;
+	}
+	return LU_OK;
+}
+
+/**
+ * Marks the file as cleanly closed, syncs it and releases the mapping.
+ *
+ * @param map The mapped table, freed by this call.
+ * @return LU_OK, or LU_ERROR_IO if the final sync failed.
+ */
+int lu_hash_mapped_close(lu_hash_mapped_t* map)
+{
+	if (map == NULL) {
+		return LU_OK;
+	}
+	map->header->clean = 1;
+	int status = lu_hash_mapped_sync(map);
+	lu_hash_mapped_release(map);
+	return status;
+}
+
+/**
+ * @brief Opens or creates the file of a mapped table and returns its size.
+ */
+static int lu_hash_mapped_open_file(lu_hash_mapped_t* map, const char* path, size_t* file_bytes)
+{
+#if defined(_WIN32)
+	map->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if (map->file == INVALID_HANDLE_VALUE) {
+		return LU_ERROR_IO;
+	}
+	if (!GetFileSizeEx(map->file, &size)) {
+		CloseHandle(map->file);
+		return LU_ERROR_IO;
+	}
+	*file_bytes = (size_t)size.QuadPart;
+#else
+	struct stat st;
+	map->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (map->fd < 0) {
+		return LU_ERROR_IO;
+	}
+	if (fstat(map->fd, &st) != 0) {
+		close(map->fd);
+		return LU_ERROR_IO;
+	}
+	*file_bytes = (size_t)st.st_size;
+#endif
+	return LU_OK;
+}
+
+/**
+ * @brief Extends the file to `bytes` if it is shorter and maps all of it.
+ *
+ * The new mapping is created before the old one is released, so a failure leaves the table mapped
+ * as it was.
+ */
+static int lu_hash_mapped_remap(lu_hash_mapped_t* map, size_t bytes)
+{
+#if defined(_WIN32)
+	// A mapping larger than the file extends the file
+	HANDLE mapping = CreateFileMappingA(map->file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)bytes >> 32), (DWORD)bytes, NULL);
+	if (mapping == NULL) {
+		return LU_ERROR_IO;
+	}
+	void* base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+	if (base == NULL) {
+		CloseHandle(mapping);
+		return LU_ERROR_IO;
+	}
+	if (map->base != NULL) {
+		UnmapViewOfFile(map->base);
+		CloseHandle(map->mapping);
+	}
+	map->mapping = mapping;
+#else
+	// Reserve the blocks now: writing to a page of a sparse file on a full disk raises SIGBUS
+#if defined(__linux__)
+	if (bytes > map->mapped_bytes && posix_fallocate(map->fd, 0, (off_t)bytes) != 0) {
+		return LU_ERROR_IO;
+	}
+#else
+	if (bytes > map->mapped_bytes && ftruncate(map->fd, (off_t)bytes) != 0) {
+		return LU_ERROR_IO;
+	}
+#endif
+	void* base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+	if (base == MAP_FAILED) {
+		return LU_ERROR_IO;
+	}
+	if (map->base != NULL) {
+		munmap(map->base, map->mapped_bytes);
+	}
+#endif
+	map->base = (unsigned char*)base;
+	map->header = (lu_hash_mapped_header_t*)base;
+	map->mapped_bytes = bytes;
+	return LU_OK;
+}
+
+/**
+ * @brief Unmaps and closes the file and frees the handle structure.
+ */
+static void lu_hash_mapped_release(lu_hash_mapped_t* map)
+{
+#if defined(_WIN32)
+	if (map->base != NULL) {
+		UnmapViewOfFile(map->base);
+		CloseHandle(map->mapping);
+	}
+	CloseHandle(map->file);
+#else
+	if (map->base != NULL) {
+		munmap(map->base, map->mapped_bytes);
+	}
+	close(map->fd);
+#endif
+	LU_MM_FREE(map);
+}
+
+/**
+ * @brief Makes sure `bytes` more can be taken from the top of the heap, doubling the file if needed.
+ */
+static int lu_hash_mapped_reserve(lu_hash_mapped_t* map, size_t bytes)
+{
+	lu_hash_offset_t needed = map->header->heap_top + bytes;
+	if (needed <= map->mapped_bytes) {
+		return LU_OK;
+	}
+	size_t new_bytes = map->mapped_bytes * 2;
+	while (new_bytes < needed) {
+		new_bytes *= 2;
+	}
+	if (lu_hash_mapped_remap(map, new_bytes) != LU_OK) {
+#ifdef LU_HASH_DEBUG
+		printf("Failed to grow mapped table to %zu bytes\n", new_bytes);
+#endif // LU_HASH_DEBUG
+		return LU_ERROR_IO;
+	}
+	map->header->file_bytes = new_bytes;
+	return LU_OK;
+}
+
+/**
+ * @brief Takes a node from the free list, the spare space or the heap. Returns 0 if the file could
+ * not grow. May move the mapping.
+ */
+static lu_hash_offset_t lu_hash_mapped_alloc_node(lu_hash_mapped_t* map)
+{
+	lu_hash_mapped_header_t* header = map->header;
+	lu_hash_offset_t offset = header->free_nodes;
+	if (offset != 0) {
+		header->free_nodes = LU_HASH_MAPPED_AT(map, offset)->next;
+		return offset;
+	}
+	if (header->spare_end - header->spare_start >= header->node_bytes) {
+		offset = header->spare_start;
+		header->spare_start += header->node_bytes;
+		return offset;
+	}
+	if (lu_hash_mapped_reserve(map, header->node_bytes) != LU_OK) {
+		return 0;
+	}
+	header = map->header;
+	offset = header->heap_top;
+	header->heap_top += header->node_bytes;
+	return offset;
+}
+
+/**
+ * @brief Allocates a bucket array of empty lists from the heap. Returns 0 if the file could not
+ * grow. May move the mapping.
+ */
+static lu_hash_offset_t lu_hash_mapped_alloc_buckets(lu_hash_mapped_t* map, size_t table_size)
+{
+	size_t bytes = table_size * sizeof(lu_hash_mapped_bucket_t);
+	if (lu_hash_mapped_reserve(map, bytes) != LU_OK) {
+		return 0;
+	}
+	lu_hash_offset_t offset = map->header->heap_top;
+	map->header->heap_top += bytes;
+
+	lu_hash_mapped_bucket_t* buckets = (lu_hash_mapped_bucket_t*)(map->base + offset);
+	for (size_t i = 0; i < table_size; i++) {
+		buckets[i].type = LU_HASH_BUCKET_LIST;
+		buckets[i].esize_bucket = 0;
+		buckets[i].head = 0;
+	}
+	return offset;
+}
+
+/**
+ * @brief Searches a bucket for a key. Returns the node or NULL.
+ */
+static lu_hash_mapped_node_t* lu_hash_mapped_find_node(lu_hash_mapped_t* map, const lu_hash_mapped_bucket_t* bucket, int key)
+{
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		for (lu_hash_offset_t offset = bucket->head; offset != 0;) {
+			lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, offset);
+			if (node->key == key) {
+				return node;
+			}
+			offset = node->next;
+		}
+		return NULL;
+	}
+
+	lu_hash_offset_t offset = bucket->head;
+	while (offset != LU_HASH_MAPPED_NIL) {
+		lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, offset);
+		if (node->key == key) {
+			return node;
+		}
+		offset = key < node->key ? node->left : node->right;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Moves every node into a new bucket array of `new_table_size` buckets hashed with `new_seed`.
+ *
+ * Nodes are relinked, never copied: list nodes keep their place in the file and tree nodes become
+ * list nodes again. Buckets that end up above `LU_HASH_BUCKET_LIST_THRESHOLD` are turned into
+ * trees afterwards. The old bucket array becomes spare space for nodes. If the file cannot grow
+ * for the new array, nothing changes.
+ */
+static void lu_hash_mapped_rehash(lu_hash_mapped_t* map, size_t new_table_size, unsigned long long new_seed)
+{
+	lu_hash_offset_t new_offset = lu_hash_mapped_alloc_buckets(map, new_table_size);
+	if (new_offset == 0) {
+		return;
+	}
+
+	lu_hash_mapped_header_t* header = map->header;
+	lu_hash_mapped_bucket_t* old_buckets = (lu_hash_mapped_bucket_t*)(map->base + header->buckets);
+	lu_hash_mapped_bucket_t* new_buckets = (lu_hash_mapped_bucket_t*)(map->base + new_offset);
+	for (size_t i = 0; i < header->table_size; i++) {
+		if (old_buckets[i].type == LU_HASH_BUCKET_LIST) {
+			lu_hash_offset_t offset = old_buckets[i].head;
+			while (offset != 0) {
+				lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, offset);
+				lu_hash_offset_t next = node->next;
+				lu_hash_mapped_bucket_t* bucket = &new_buckets[lu_hash_mapped_index(node->key, new_seed, new_table_size)];
+				node->next = bucket->head;
+				bucket->head = offset;
+				bucket->esize_bucket++;
+				offset = next;
+			}
+		}
+		else if (old_buckets[i].head != LU_HASH_MAPPED_NIL) {
+			// The walk reads only the tree links, relinking writes only `next`
+			for (lu_hash_offset_t offset = lu_hash_mapped_tree_minimum(map, old_buckets[i].head); offset != LU_HASH_MAPPED_NIL; offset = lu_hash_mapped_tree_successor(map, offset)) {
+				lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, offset);
+				lu_hash_mapped_bucket_t* bucket = &new_buckets[lu_hash_mapped_index(node->key, new_seed, new_table_size)];
+				node->next = bucket->head;
+				bucket->head = offset;
+				bucket->esize_bucket++;
+			}
+		}
+	}
+
+	header->treeify_count = 0;
+	for (size_t i = 0; i < new_table_size; i++) {
+		if (new_buckets[i].esize_bucket > LU_HASH_BUCKET_LIST_THRESHOLD) {
+			lu_hash_mapped_treeify(map, &new_buckets[i]);
+			header->treeify_count++;
+		}
+	}
+
+	// Keep the larger of the old array and what is left of the previous spare space
+	lu_hash_offset_t old_bytes = header->table_size * sizeof(lu_hash_mapped_bucket_t);
+	if (old_bytes > header->spare_end - header->spare_start) {
+		header->spare_start = header->buckets;
+		header->spare_end = header->buckets + old_bytes;
+	}
+	header->buckets = new_offset;
+	header->table_size = new_table_size;
+	header->seed = new_seed;
+}
+
+/**
+ * @brief Relinks the nodes of a list bucket into a red-black tree.
+ */
+static void lu_hash_mapped_treeify(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket)
+{
+	lu_hash_offset_t offset = bucket->head;
+	bucket->type = LU_HASH_BUCKET_RBTREE;
+	bucket->head = LU_HASH_MAPPED_NIL;
+	while (offset != 0) {
+		lu_hash_offset_t next = LU_HASH_MAPPED_AT(map, offset)->next;
+		lu_hash_mapped_tree_link(map, bucket, offset);
+		offset = next;
+	}
+}
+
+static void lu_hash_mapped_rotate_left(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket, lu_hash_offset_t x)
+{
+	lu_hash_mapped_node_t* xn = LU_HASH_MAPPED_AT(map, x);
+	lu_hash_offset_t y = xn->right;
+	lu_hash_mapped_node_t* yn = LU_HASH_MAPPED_AT(map, y);
+	xn->right = yn->left;
+	if (yn->left != LU_HASH_MAPPED_NIL) {
+		LU_HASH_MAPPED_AT(map, yn->left)->parent = x;
+	}
+	yn->parent = xn->parent;
+	if (xn->parent == LU_HASH_MAPPED_NIL) {
+		bucket->head = y;
+	}
+	else if (x == LU_HASH_MAPPED_AT(map, xn->parent)->left) {
+		LU_HASH_MAPPED_AT(map, xn->parent)->left = y;
+	}
+	else {
+		LU_HASH_MAPPED_AT(map, xn->parent)->right = y;
+	}
+	yn->left = x;
+	xn->parent = y;
+}
+
+static void lu_hash_mapped_rotate_right(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket, lu_hash_offset_t x)
+{
+	lu_hash_mapped_node_t* xn = LU_HASH_MAPPED_AT(map, x);
+	lu_hash_offset_t y = xn->left;
+	lu_hash_mapped_node_t* yn = LU_HASH_MAPPED_AT(map, y);
+	xn->left = yn->right;
+	if (yn->right != LU_HASH_MAPPED_NIL) {
+		LU_HASH_MAPPED_AT(map, yn->right)->parent = x;
+	}
+	yn->parent = xn->parent;
+	if (xn->parent == LU_HASH_MAPPED_NIL) {
+		bucket->head = y;
+	}
+	else if (x == LU_HASH_MAPPED_AT(map, xn->parent)->right) {
+		LU_HASH_MAPPED_AT(map, xn->parent)->right = y;
+	}
+	else {
+		LU_HASH_MAPPED_AT(map, xn->parent)->left = y;
+	}
+	yn->right = x;
+	xn->parent = y;
+}
+
+/**
+ * @brief Links node `z` (whose key is not in the tree yet) into a tree bucket and rebalances.
+ * Returns the depth at which it was attached.
+ */
+static size_t lu_hash_mapped_tree_link(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket, lu_hash_offset_t z)
+{
+	lu_hash_mapped_node_t* zn = LU_HASH_MAPPED_AT(map, z);
+	lu_hash_offset_t parent = LU_HASH_MAPPED_NIL;
+	lu_hash_offset_t current = bucket->head;
+	size_t depth = 0;
+	while (current != LU_HASH_MAPPED_NIL) {
+		parent = current;
+		depth++;
+		lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, current);
+		current = zn->key < node->key ? node->left : node->right;
+	}
+	zn->parent = parent;
+	zn->left = LU_HASH_MAPPED_NIL;
+	zn->right = LU_HASH_MAPPED_NIL;
+	zn->color = RED;
+	if (parent == LU_HASH_MAPPED_NIL) {
+		bucket->head = z;
+	}
+	else if (zn->key < LU_HASH_MAPPED_AT(map, parent)->key) {
+		LU_HASH_MAPPED_AT(map, parent)->left = z;
+	}
+	else {
+		LU_HASH_MAPPED_AT(map, parent)->right = z;
+	}
+
+	while (LU_HASH_MAPPED_AT(map, LU_HASH_MAPPED_AT(map, z)->parent)->color == RED) {
+		lu_hash_offset_t p = LU_HASH_MAPPED_AT(map, z)->parent;
+		lu_hash_offset_t g = LU_HASH_MAPPED_AT(map, p)->parent;
+		lu_hash_mapped_node_t* gn = LU_HASH_MAPPED_AT(map, g);
+		if (p == gn->left) {
+			lu_hash_offset_t uncle = gn->right;
+			if (LU_HASH_MAPPED_AT(map, uncle)->color == RED) {
+				LU_HASH_MAPPED_AT(map, p)->color = BLACK;
+				LU_HASH_MAPPED_AT(map, uncle)->color = BLACK;
+				gn->color = RED;
+				z = g;
+			}
+			else {
+				if (z == LU_HASH_MAPPED_AT(map, p)->right) {
+					z = p;
+					lu_hash_mapped_rotate_left(map, bucket, z);
+				}
+				p = LU_HASH_MAPPED_AT(map, z)->parent;
+				LU_HASH_MAPPED_AT(map, p)->color = BLACK;
+				LU_HASH_MAPPED_AT(map, LU_HASH_MAPPED_AT(map, p)->parent)->color = RED;
+				lu_hash_mapped_rotate_right(map, bucket, LU_HASH_MAPPED_AT(map, p)->parent);
+			}
+		}
+		else {
+			lu_hash_offset_t uncle = gn->left;
+			if (LU_HASH_MAPPED_AT(map, uncle)->color == RED) {
+				LU_HASH_MAPPED_AT(map, p)->color = BLACK;
+				LU_HASH_MAPPED_AT(map, uncle)->color = BLACK;
+				gn->color = RED;
+				z = g;
+			}
+			else {
+				if (z == LU_HASH_MAPPED_AT(map, p)->left) {
+					z = p;
+					lu_hash_mapped_rotate_right(map, bucket, z);
+				}
+				p = LU_HASH_MAPPED_AT(map, z)->parent;
+				LU_HASH_MAPPED_AT(map, p)->color = BLACK;
+				LU_HASH_MAPPED_AT(map, LU_HASH_MAPPED_AT(map, p)->parent)->color = RED;
+				lu_hash_mapped_rotate_left(map, bucket, LU_HASH_MAPPED_AT(map, p)->parent);
+			}
+		}
+	}
+	LU_HASH_MAPPED_AT(map, bucket->head)->color = BLACK;
+	return depth;
+}
+
+static void lu_hash_mapped_transplant(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket, lu_hash_offset_t u, lu_hash_offset_t v)
+{
+	lu_hash_offset_t parent = LU_HASH_MAPPED_AT(map, u)->parent;
+	if (parent == LU_HASH_MAPPED_NIL) {
+		bucket->head = v;
+	}
+	else if (u == LU_HASH_MAPPED_AT(map, parent)->left) {
+		LU_HASH_MAPPED_AT(map, parent)->left = v;
+	}
+	else {
+		LU_HASH_MAPPED_AT(map, parent)->right = v;
+	}
+	LU_HASH_MAPPED_AT(map, v)->parent = parent;
+}
+
+/**
+ * @brief Unlinks node `z` from a tree bucket and rebalances. The node itself is left to the caller.
+ */
+static void lu_hash_mapped_tree_unlink(lu_hash_mapped_t* map, lu_hash_mapped_bucket_t* bucket, lu_hash_offset_t z)
+{
+	lu_hash_mapped_node_t* zn = LU_HASH_MAPPED_AT(map, z);
+	lu_hash_offset_t y = z;
+	lu_hash_offset_t x;
+	unsigned int original_color = zn->color;
+
+	if (zn->left == LU_HASH_MAPPED_NIL) {
+		x = zn->right;
+		lu_hash_mapped_transplant(map, bucket, z, zn->right);
+	}
+	else if (zn->right == LU_HASH_MAPPED_NIL) {
+		x = zn->left;
+		lu_hash_mapped_transplant(map, bucket, z, zn->left);
+	}
+	else {
+		y = lu_hash_mapped_tree_minimum(map, zn->right);
+		lu_hash_mapped_node_t* yn = LU_HASH_MAPPED_AT(map, y);
+		original_color = yn->color;
+		x = yn->right;
+		if (yn->parent == z) {
+			LU_HASH_MAPPED_AT(map, x)->parent = y; // x may be the sentinel, make its parent valid for the fixup
+		}
+		else {
+			lu_hash_mapped_transplant(map, bucket, y, yn->right);
+			yn->right = zn->right;
+			LU_HASH_MAPPED_AT(map, yn->right)->parent = y;
+		}
+		lu_hash_mapped_transplant(map, bucket, z, y);
+		yn->left = zn->left;
+		LU_HASH_MAPPED_AT(map, yn->left)->parent = y;
+		yn->color = zn->color;
+	}
+
+	if (original_color != BLACK) {
+		return;
+	}
+	while (x != bucket->head && LU_HASH_MAPPED_AT(map, x)->color == BLACK) {
+		lu_hash_offset_t p = LU_HASH_MAPPED_AT(map, x)->parent;
+		lu_hash_mapped_node_t* pn = LU_HASH_MAPPED_AT(map, p);
+		if (x == pn->left) {
+			lu_hash_offset_t w = pn->right;
+			if (LU_HASH_MAPPED_AT(map, w)->color == RED) {
+				LU_HASH_MAPPED_AT(map, w)->color = BLACK;
+				pn->color = RED;
+				lu_hash_mapped_rotate_left(map, bucket, p);
+				w = pn->right;
+			}
+			lu_hash_mapped_node_t* wn = LU_HASH_MAPPED_AT(map, w);
+			if (LU_HASH_MAPPED_AT(map, wn->left)->color == BLACK && LU_HASH_MAPPED_AT(map, wn->right)->color == BLACK) {
+				wn->color = RED;
+				x = p;
+			}
+			else {
+				if (LU_HASH_MAPPED_AT(map, wn->right)->color == BLACK) {
+					LU_HASH_MAPPED_AT(map, wn->left)->color = BLACK;
+					wn->color = RED;
+					lu_hash_mapped_rotate_right(map, bucket, w);
+					w = pn->right;
+					wn = LU_HASH_MAPPED_AT(map, w);
+				}
+				wn->color = pn->color;
+				pn->color = BLACK;
+				LU_HASH_MAPPED_AT(map, wn->right)->color = BLACK;
+				lu_hash_mapped_rotate_left(map, bucket, p);
+				x = bucket->head;
+			}
+		}
+		else {
+			lu_hash_offset_t w = pn->left;
+			if (LU_HASH_MAPPED_AT(map, w)->color == RED) {
+				LU_HASH_MAPPED_AT(map, w)->color = BLACK;
+				pn->color = RED;
+				lu_hash_mapped_rotate_right(map, bucket, p);
+				w = pn->left;
+			}
+			lu_hash_mapped_node_t* wn = LU_HASH_MAPPED_AT(map, w);
+			if (LU_HASH_MAPPED_AT(map, wn->right)->color == BLACK && LU_HASH_MAPPED_AT(map, wn->left)->color == BLACK) {
+				wn->color = RED;
+				x = p;
+			}
+			else {
+				if (LU_HASH_MAPPED_AT(map, wn->left)->color == BLACK) {
+					LU_HASH_MAPPED_AT(map, wn->right)->color = BLACK;
+					wn->color = RED;
+					lu_hash_mapped_rotate_left(map, bucket, w);
+					w = pn->left;
+					wn = LU_HASH_MAPPED_AT(map, w);
+				}
+				wn->color = pn->color;
+				pn->color = BLACK;
+				LU_HASH_MAPPED_AT(map, wn->left)->color = BLACK;
+				lu_hash_mapped_rotate_right(map, bucket, p);
+				x = bucket->head;
+			}
+		}
+	}
+	LU_HASH_MAPPED_AT(map, x)->color = BLACK;
+}
+
+static lu_hash_offset_t lu_hash_mapped_tree_minimum(lu_hash_mapped_t* map, lu_hash_offset_t x)
+{
+	while (LU_HASH_MAPPED_AT(map, x)->left != LU_HASH_MAPPED_NIL) {
+		x = LU_HASH_MAPPED_AT(map, x)->left;
+	}
+	return x;
+}
+
+static lu_hash_offset_t lu_hash_mapped_tree_successor(lu_hash_mapped_t* map, lu_hash_offset_t x)
+{
+	lu_hash_mapped_node_t* node = LU_HASH_MAPPED_AT(map, x);
+	if (node->right != LU_HASH_MAPPED_NIL) {
+		return lu_hash_mapped_tree_minimum(map, node->right);
+	}
+	lu_hash_offset_t parent = node->parent;
+	while (parent != LU_HASH_MAPPED_NIL && x == LU_HASH_MAPPED_AT(map, parent)->right) {
+		x = parent;
+		parent = LU_HASH_MAPPED_AT(map, parent)->parent;
+	}
+	return parent;
+}
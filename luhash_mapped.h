@@ -0,0 +1,130 @@
+#ifndef LU_LU_HASH_MAPPED_INCLUDE_H_
+#define LU_LU_HASH_MAPPED_INCLUDE_H_
+
+/**
+ * @file luhash_mapped.h
+ * @brief Hash table that lives in a memory-mapped file and is usable as soon as it is reopened.
+ *
+ * Restoring a lu_hash_table_t from a log or snapshot takes time proportional to its size. A mapped
+ * table keeps its header, bucket array and nodes inside one file that is mapped into memory, and
+ * links them by file-relative offsets instead of pointers, so the file is valid at whatever
+ * address it is mapped. Opening an existing file only validates the header: there is nothing to
+ * load or rebuild, the operating system pages nodes in as lookups reach them, and a table larger
+ * than RAM keeps working at the speed of the page cache.
+ *
+ * The layout follows lu_hash_table_t: a seeded hash, list buckets that turn into red-black trees
+ * above `LU_HASH_BUCKET_LIST_THRESHOLD` entries, growth at `LU_HASH_TABLE_MAX_LOAD_FACTOR` and
+ * reseeding under suspected collision attacks. Pointers cannot be stored in a file, so every
+ * value is a fixed number of bytes chosen when the file is created and copied into its node.
+ *
+ * The file is grown in place as nodes are added; the mapping may then move, which invalidates
+ * value pointers returned by lu_hash_mapped_find. Freed nodes are reused, and the space of a bucket
+ * array left behind by a resize is handed out as nodes. The file uses the byte order and
+ * alignment of the machine that created it.
+ *
+ * Changes reach the file whenever the operating system writes the pages back, and for certain on
+ * lu_hash_mapped_sync and lu_hash_mapped_close. A crash in between may leave the structure
+ * half-updated: `was_clean` tells whether the file was closed properly the last time. Tables that
+ * must survive crashes intact should be kept with a write-ahead log (luhash_wal.h) instead.
+ *
+ * Not thread-safe: one thread at a time, and one process per file.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include "luhash_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_MAPPED_MIN_FILE_BYTES	(64u * 1024)	// Smallest file, and smallest growth step
+
+	/** Position of a structure within the file, 0 for none */
+	typedef unsigned long long lu_hash_offset_t;
+
+	/**
+	 * Node of a mapped table, followed by `value_size` bytes of value padded to 8 bytes.
+	 */
+	typedef struct lu_hash_mapped_node_s {
+		lu_hash_offset_t next;		// Next node of a list bucket or of the free list
+		lu_hash_offset_t left;		// Children and parent in a tree bucket
+		lu_hash_offset_t right;
+		lu_hash_offset_t parent;
+		int				 key;
+		unsigned int	 color;		// lu_node_color_t of a tree node
+	}lu_hash_mapped_node_t;
+
+	/**
+	 * Bucket of a mapped table.
+	 */
+	typedef struct lu_hash_mapped_bucket_s {
+		unsigned int	 type;			// lu_hash_bucket_type_t
+		unsigned int	 esize_bucket;	// Number of elements in the bucket
+		lu_hash_offset_t head;			// First list node, or tree root (the sentinel if empty)
+	}lu_hash_mapped_bucket_t;
+
+	/**
+	 * Header at the start of the file.
+	 */
+	typedef struct lu_hash_mapped_header_s {
+		char			   magic[8];		// "LUHMAP01"
+		unsigned int	   value_size;		// Bytes of value per entry
+		unsigned int	   node_bytes;		// Bytes per node including the padded value
+		unsigned int	   clean;			// 1 while the file is closed, 0 while it is open
+		unsigned int	   reserved;
+		unsigned long long file_bytes;		// Size of the file
+		lu_hash_offset_t   heap_top;		// First byte never handed out
+		lu_hash_offset_t   free_nodes;		// Free list of nodes, linked by `next`
+		lu_hash_offset_t   spare_start;		// Space of an old bucket array, handed out as nodes
+		lu_hash_offset_t   spare_end;
+		lu_hash_offset_t   buckets;			// Bucket array
+		unsigned long long table_size;
+		unsigned long long element_count;
+		unsigned long long seed;
+		unsigned long long treeify_count;	// List-to-tree conversions since the last resize or reseed
+		unsigned long long reseed_count;
+		lu_hash_mapped_node_t nil;			// Sentinel of every tree bucket
+	}lu_hash_mapped_header_t;
+
+	/**
+	 * Structure representing an open mapped table.
+	 */
+	typedef struct lu_hash_mapped_s {
+		unsigned char*			 base;		// Start of the mapping, moves when the file grows
+		lu_hash_mapped_header_t* header;	// Header at `base`
+		size_t					 mapped_bytes;	// Size of the file and of the mapping
+		int						 was_clean;	// Set if the file was new or closed by lu_hash_mapped_close last time
+#if defined(_WIN32)
+		HANDLE					 file;
+		HANDLE					 mapping;
+#else
+		int						 fd;
+#endif
+	}lu_hash_mapped_t;
+
+	/**Function definition*/
+	lu_hash_mapped_t* lu_hash_mapped_open(const char* path, size_t value_size, size_t table_size);
+	int lu_hash_mapped_insert(lu_hash_mapped_t* map, int key, const void* value);
+	void* lu_hash_mapped_find(lu_hash_mapped_t* map, int key);
+	void lu_hash_mapped_delete(lu_hash_mapped_t* map, int key);
+	void lu_hash_mapped_foreach(lu_hash_mapped_t* map, lu_hash_visit_func_t visit, void* ctx);
+	size_t lu_hash_mapped_count(const lu_hash_mapped_t* map);
+	int lu_hash_mapped_sync(lu_hash_mapped_t* map);
+	int lu_hash_mapped_close(lu_hash_mapped_t* map);
+
+#define LU_HASH_MAPPED_OPEN(path,value_size)		lu_hash_mapped_open(path,value_size,0)
+#define LU_HASH_MAPPED_INSERT(map,key,value)		lu_hash_mapped_insert(map,key,value)
+#define LU_HASH_MAPPED_FIND(map,key)				lu_hash_mapped_find(map,key)
+#define LU_HASH_MAPPED_DELETE(map,key)				lu_hash_mapped_delete(map,key)
+#define LU_HASH_MAPPED_CLOSE(map)					lu_hash_mapped_close(map)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_MAPPED_INCLUDE_H_*/
@@ -0,0 +1,445 @@
+// syscall() is a glibc extension, hidden by strict ISO C unless requested
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
+#include "luhash_perf.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @file luhash_perf.c
+ * @brief perf_event_open counters, the phase benchmark and its CSV baselines.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#define LU_HASH_PERF_LINE_BYTES		512		// Longest line read from a CSV file
+
+static void lu_hash_perf_per_op(lu_hash_perf_result_t* result, lu_hash_perf_phase_t phase, const lu_hash_perf_sample_t* sample, size_t ops);
+static const lu_hash_perf_result_t* lu_hash_perf_find_phase(const lu_hash_perf_result_t* results, size_t count, const char* phase);
+static size_t lu_hash_perf_check(const char* phase, const char* metric, double baseline, double current, double tolerance, FILE* report);
+
+#if defined(__linux__)
+/** Event type and config of every lu_hash_perf_counter_t */
+static const struct {
+	unsigned int	   type;
+	unsigned long long config;
+} lu_hash_perf_events_[LU_HASH_PERF_COUNTER_COUNT] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+#endif
+
+/**
+ * Opens the counters for the calling thread, user mode only.
+ *
+ * Every counter is opened on its own, so one the machine lacks does not take the others with it.
+ * When the CPU has fewer counter registers than requested, the kernel multiplexes them and the
+ * counts are scaled up to the whole interval.
+ *
+ * @param perf The counters to open.
+ * @return The number of counters available, 0 when none are (including on systems other than
+ *         Linux); the elapsed time is measured either way.
+ */
+int lu_hash_perf_open(lu_hash_perf_t* perf)
+{
+	int available = 0;
+	for (int i = 0; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+		perf->fds[i] = -1;
+#if defined(__linux__)
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = lu_hash_perf_events_[i].type;
+		attr.config = lu_hash_perf_events_[i].config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		perf->fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		if (perf->fds[i] >= 0) {
+			available++;
+		}
+#ifdef LU_HASH_DEBUG
+		else {
+			printf("Counter %s is not available\n", lu_hash_perf_counter_name((lu_hash_perf_counter_t)i));
+		}
+#endif // LU_HASH_DEBUG
+#endif
+	}
+	perf->start_ns = 0;
+	return available;
+}
+
+/**
+ * @brief Resets the counters and starts counting.
+ */
+void lu_hash_perf_start(lu_hash_perf_t* perf)
+{
+#if defined(__linux__)
+	for (int i = 0; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+		if (perf->fds[i] >= 0) {
+			ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+	perf->start_ns = lu_clock_ns();
+}
+
+/**
+ * @brief Stops counting and returns the counts since lu_hash_perf_start.
+ *
+ * @param perf The counters.
+ * @param sample Receives the elapsed time and the counts, LU_HASH_PERF_UNAVAILABLE for counters
+ *        that are not available or were never scheduled on the CPU.
+ */
+void lu_hash_perf_stop(lu_hash_perf_t* perf, lu_hash_perf_sample_t* sample)
+{
+	sample->ns = (double)(lu_clock_ns() - perf->start_ns);
+	for (int i = 0; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+		sample->counters[i] = LU_HASH_PERF_UNAVAILABLE;
+#if defined(__linux__)
+		if (perf->fds[i] < 0) {
+			continue;
+		}
+		ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+		// Value, time enabled and time running; the last two differ when counters were multiplexed
+		unsigned long long data[3];
+		if (read(perf->fds[i], data, sizeof(data)) == (ssize_t)sizeof(data) && data[2] != 0) {
+			sample->counters[i] = (double)data[0] * ((double)data[1] / (double)data[2]);
+		}
+#endif
+	}
+}
+
+/**
+ * @brief Closes the counters.
+ */
+void lu_hash_perf_close(lu_hash_perf_t* perf)
+{
+	for (int i = 0; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+#if defined(__linux__)
+		if (perf->fds[i] >= 0) {
+			close(perf->fds[i]);
+		}
+#endif
+		perf->fds[i] = -1;
+	}
+}
+
+/**
+ * @brief Returns the name of a counter, as used in CSV headers and reports.
+ */
+const char* lu_hash_perf_counter_name(lu_hash_perf_counter_t counter)
+{
+	switch (counter) {
+	case LU_HASH_PERF_CYCLES:			return "cycles";
+	case LU_HASH_PERF_INSTRUCTIONS:		return "instructions";
+	case LU_HASH_PERF_L1D_MISSES:		return "l1d_misses";
+	case LU_HASH_PERF_LLC_MISSES:		return "llc_misses";
+	case LU_HASH_PERF_DTLB_MISSES:		return "dtlb_misses";
+	case LU_HASH_PERF_BRANCH_MISSES:	return "branch_misses";
+	default:							break;
+	}
+	return "unknown";
+}
+
+/**
+ * @brief Returns the name of a benchmark phase.
+ */
+const char* lu_hash_perf_phase_name(lu_hash_perf_phase_t phase)
+{
+	switch (phase) {
+	case LU_HASH_PERF_INSERT:	return "insert";
+	case LU_HASH_PERF_FIND:		return "find";
+	case LU_HASH_PERF_RESIZE:	return "resize";
+	case LU_HASH_PERF_DELETE:	return "delete";
+	default:					break;
+	}
+	return "unknown";
+}
+
+/**
+ * Measures the phases of a table with the given configuration.
+ *
+ * `key_count` distinct keys are inserted into a table with enough buckets that it does not grow,
+ * looked up in a shuffled order, rehashed once with a new seed and deleted in the shuffled order.
+ * Each phase is measured separately and reported per operation; the resize phase counts one
+ * operation per entry moved. The keys depend only on `seed`, so runs with the same seed are
+ * comparable.
+ *
+ * @param config The configuration of the table under test, e.g. with a different hash function.
+ * @param key_count The number of keys.
+ * @param seed Selects the keys and the lookup order.
+ * @param results Receives `LU_HASH_PERF_PHASE_COUNT` results, in lu_hash_perf_phase_t order.
+ * @return The number of results, 0 if `key_count` is 0.
+ */
+size_t lu_hash_perf_bench(const lu_hash_table_config_t* config, size_t key_count, unsigned int seed, lu_hash_perf_result_t* results)
+{
+	if (key_count == 0) {
+		return 0;
+	}
+
+	// Multiplying by an odd constant permutes 32-bit integers, so the keys are distinct
+	int* keys = (int*)LU_MM_MALLOC(key_count * sizeof(int));
+	int* order = (int*)LU_MM_MALLOC(key_count * sizeof(int));
+	for (size_t i = 0; i < key_count; i++) {
+		keys[i] = (int)(((unsigned int)i * 2654435761u) ^ seed);
+		order[i] = keys[i];
+	}
+	unsigned int state = seed * 1103515245u + 12345u;
+	for (size_t i = key_count - 1; i > 0; i--) {
+		state = state * 1103515245u + 12345u;
+		size_t j = (size_t)(((unsigned long long)state * (i + 1)) >> 32);
+		int key = order[i];
+		order[i] = order[j];
+		order[j] = key;
+	}
+
+	lu_hash_table_t* table = lu_hash_table_init_with_config((size_t)(key_count / config->max_load_factor) + 1, config);
+	lu_hash_perf_t perf;
+	lu_hash_perf_sample_t sample;
+	lu_hash_perf_open(&perf);
+
+	lu_hash_perf_start(&perf);
+	for (size_t i = 0; i < key_count; i++) {
+		lu_hash_table_insert(table, keys[i], &keys[i]);
+	}
+	lu_hash_perf_stop(&perf, &sample);
+	lu_hash_perf_per_op(&results[LU_HASH_PERF_INSERT], LU_HASH_PERF_INSERT, &sample, key_count);
+
+	size_t found = 0;
+	lu_hash_perf_start(&perf);
+	for (size_t i = 0; i < key_count; i++) {
+		found += lu_hash_table_find(table, order[i]) != NULL;
+	}
+	lu_hash_perf_stop(&perf, &sample);
+	lu_hash_perf_per_op(&results[LU_HASH_PERF_FIND], LU_HASH_PERF_FIND, &sample, key_count);
+
+	size_t moved = table->element_count;
+	lu_hash_perf_start(&perf);
+	lu_hash_table_reseed(table);
+	lu_hash_perf_stop(&perf, &sample);
+	lu_hash_perf_per_op(&results[LU_HASH_PERF_RESIZE], LU_HASH_PERF_RESIZE, &sample, moved);
+
+	lu_hash_perf_start(&perf);
+	for (size_t i = 0; i < key_count; i++) {
+		lu_hash_table_delete(table, order[i]);
+	}
+	lu_hash_perf_stop(&perf, &sample);
+	lu_hash_perf_per_op(&results[LU_HASH_PERF_DELETE], LU_HASH_PERF_DELETE, &sample, key_count);
+
+#ifdef LU_HASH_DEBUG
+	printf("Benchmark of %zu keys: %zu found, %zu left after deleting\n", key_count, found, table->element_count);
+#endif // LU_HASH_DEBUG
+	(void)found;
+
+	lu_hash_perf_close(&perf);
+	lu_hash_table_destroy(table);
+	LU_MM_FREE(order);
+	LU_MM_FREE(keys);
+	return LU_HASH_PERF_PHASE_COUNT;
+}
+
+/**
+ * Writes benchmark results as CSV: a header line, then one line per phase with the phase name,
+ * the number of operations, and the time and every counter per operation. Unavailable counters
+ * are written as `na`.
+ *
+ * @param path The file to create or replace.
+ * @param results The results to write.
+ * @param count The number of results.
+ * @return LU_OK, or LU_ERROR_IO if the file could not be written.
+ */
+int lu_hash_perf_write_csv(const char* path, const lu_hash_perf_result_t* results, size_t count)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		lu_hash_erron_global_ = LU_ERROR_IO;
+		return LU_ERROR_IO;
+	}
+
+	fprintf(file, "phase,ops,ns");
+	for (int i = 0; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+		fprintf(file, ",%s", lu_hash_perf_counter_name((lu_hash_perf_counter_t)i));
+	}
+	fprintf(file, "\n");
+	for (size_t r = 0; r < count; r++) {
+		fprintf(file, "%s,%llu,%.4f", results[r].phase, (unsigned long long)results[r].ops, results[r].per_op.ns);
+		for (int i = 0; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+			if (results[r].per_op.counters[i] == LU_HASH_PERF_UNAVAILABLE) {
+				fprintf(file, ",na");
+			}
+			else {
+				fprintf(file, ",%.4f", results[r].per_op.counters[i]);
+			}
+		}
+		fprintf(file, "\n");
+	}
+
+	int status = ferror(file) ? LU_ERROR_IO : LU_OK;
+	if (fclose(file) != 0) {
+		status = LU_ERROR_IO;
+	}
+	if (status != LU_OK) {
+		lu_hash_erron_global_ = status;
+	}
+	return status;
+}
+
+/**
+ * Reads results written by lu_hash_perf_write_csv, typically as the baseline of a comparison.
+ *
+ * The header and lines that do not start with a phase and an operation count are skipped; fields
+ * that are missing or not numbers are read as unavailable.
+ *
+ * @param path The file to read.
+ * @param results Receives the results.
+ * @param max_results The capacity of `results`.
+ * @return The number of results read, 0 with lu_hash_erron_global_ set to LU_ERROR_IO if the file
+ *         could not be opened.
+ */
+size_t lu_hash_perf_read_csv(const char* path, lu_hash_perf_result_t* results, size_t max_results)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL) {
+		lu_hash_erron_global_ = LU_ERROR_IO;
+		return 0;
+	}
+
+	char line[LU_HASH_PERF_LINE_BYTES];
+	size_t count = 0;
+	while (count < max_results && fgets(line, sizeof(line), file) != NULL) {
+		lu_hash_perf_result_t* result = &results[count];
+		char* field = strchr(line, ',');
+		if (field == NULL || field == line || (size_t)(field - line) >= sizeof(result->phase)) {
+			continue;
+		}
+		memcpy(result->phase, line, (size_t)(field - line));
+		result->phase[field - line] = '\0';
+
+		char* end;
+		result->ops = (size_t)strtoull(field + 1, &end, 10);
+		if (end == field + 1) {
+			continue; // The header
+		}
+
+		// Time first, then the counters in lu_hash_perf_counter_t order
+		for (int i = -1; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+			double* value = i < 0 ? &result->per_op.ns : &result->per_op.counters[i];
+			*value = LU_HASH_PERF_UNAVAILABLE;
+			if (end == NULL || *end != ',') {
+				end = NULL;
+				continue;
+			}
+			field = end + 1;
+			double parsed = strtod(field, &end);
+			if (end != field) {
+				*value = parsed;
+			}
+			else {
+				end = strchr(field, ',');
+				if (end == NULL) {
+					end = field + strlen(field);
+				}
+			}
+		}
+		count++;
+	}
+	fclose(file);
+	return count;
+}
+
+/**
+ * Compares results with a baseline and flags every metric that got worse.
+ *
+ * Phases are matched by name. A metric regresses when both runs have it and the current value
+ * exceeds the baseline by more than `tolerance` (0.05 for 5%). Counters of short phases are noisy,
+ * so a tolerance of a few percent and runs of at least a million keys are recommended.
+ *
+ * @param current The results of this run.
+ * @param count The number of results of this run.
+ * @param baseline The results to compare against.
+ * @param baseline_count The number of baseline results.
+ * @param tolerance The relative increase that is still accepted.
+ * @param report If not NULL, receives one line per metric compared, regressions marked.
+ * @return The number of metrics that regressed.
+ */
+size_t lu_hash_perf_compare(const lu_hash_perf_result_t* current, size_t count, const lu_hash_perf_result_t* baseline, size_t baseline_count, double tolerance, FILE* report)
+{
+	size_t regressions = 0;
+	for (size_t r = 0; r < count; r++) {
+		const lu_hash_perf_result_t* base = lu_hash_perf_find_phase(baseline, baseline_count, current[r].phase);
+		if (base == NULL) {
+			continue;
+		}
+		regressions += lu_hash_perf_check(current[r].phase, "ns", base->per_op.ns, current[r].per_op.ns, tolerance, report);
+		for (int i = 0; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+			regressions += lu_hash_perf_check(current[r].phase, lu_hash_perf_counter_name((lu_hash_perf_counter_t)i),
+				base->per_op.counters[i], current[r].per_op.counters[i], tolerance, report);
+		}
+	}
+	return regressions;
+}
+
+/**
+ * @brief Divides a sample by the number of operations it covered.
+ */
+static void lu_hash_perf_per_op(lu_hash_perf_result_t* result, lu_hash_perf_phase_t phase, const lu_hash_perf_sample_t* sample, size_t ops)
+{
+	strncpy(result->phase, lu_hash_perf_phase_name(phase), sizeof(result->phase) - 1);
+	result->phase[sizeof(result->phase) - 1] = '\0';
+	result->ops = ops;
+	double divisor = ops != 0 ? (double)ops : 1.0;
+	result->per_op.ns = sample->ns / divisor;
+	for (int i = 0; i < LU_HASH_PERF_COUNTER_COUNT; i++) {
+		double value = sample->counters[i];
+		result->per_op.counters[i] = value == LU_HASH_PERF_UNAVAILABLE ? value : value / divisor;
+	}
+}
+
+/**
+ * @brief Returns the result of a phase, or NULL if there is none.
+ */
+static const lu_hash_perf_result_t* lu_hash_perf_find_phase(const lu_hash_perf_result_t* results, size_t count, const char* phase)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (strcmp(results[i].phase, phase) == 0) {
+			return &results[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Compares one metric and reports it.
+ *
+ * @return 1 if it regressed, 0 otherwise.
+ */
+static size_t lu_hash_perf_check(const char* phase, const char* metric, double baseline, double current, double tolerance, FILE* report)
+{
+	if (baseline == LU_HASH_PERF_UNAVAILABLE || current == LU_HASH_PERF_UNAVAILABLE) {
+		return 0;
+	}
+	int regressed = current > baseline * (1.0 + tolerance);
+	if (report != NULL) {
+		double change = baseline > 0 ? (current / baseline - 1.0) * 100.0 : 0.0;
+		fprintf(report, "%-8s %-14s %14.3f %14.3f %+8.1f%%%s\n", phase, metric, baseline, current, change, regressed ? "  REGRESSION" : "");
+	}
+	return regressed ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+#ifndef LU_LU_HASH_PERF_INCLUDE_H_
+#define LU_LU_HASH_PERF_INCLUDE_H_
+
+/**
+ * @file luhash_perf.h
+ * @brief Hardware performance counters around the phases of a table benchmark.
+ *
+ * Wall-clock time shows that one hash function, bucket layout or allocation scheme beats another
+ * but not why. lu_hash_perf_t reads the CPU's own counters through Linux `perf_event_open`:
+ * cycles, instructions, L1 data cache misses, last-level cache misses, data TLB misses and branch
+ * mispredictions, for the calling thread in user mode. Counters the CPU, the kernel or a virtual
+ * machine does not provide are reported as unavailable and the others still work. On other
+ * systems only the elapsed time is measured.
+ *
+ * lu_hash_perf_bench runs the insert, find, resize and delete phases of a table with a given
+ * configuration and reports every counter per operation. The results are written to and read
+ * from CSV, so that the output of one run serves as the baseline of the next and
+ * lu_hash_perf_compare can flag the counters that got worse.
+ *
+ * Usage example:
+ *     lu_hash_perf_result_t results[LU_HASH_PERF_PHASE_COUNT], baseline[LU_HASH_PERF_PHASE_COUNT];
+ *     lu_hash_table_config_t config;
+ *     lu_hash_table_config_default(&config);
+ *     size_t count = lu_hash_perf_bench(&config, 1 << 20, 1, results);
+ *     size_t baseline_count = lu_hash_perf_read_csv("baseline.csv", baseline, LU_HASH_PERF_PHASE_COUNT);
+ *     if (lu_hash_perf_compare(results, count, baseline, baseline_count, 0.05, stdout) != 0) {
+ *         // A counter regressed by more than 5%
+ *     }
+ *     lu_hash_perf_write_csv("current.csv", results, count);
+ *
+ * Reading the counters requires `/proc/sys/kernel/perf_event_paranoid` to be 2 or less, or the
+ * CAP_PERFMON capability.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include "luhash_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_PERF_UNAVAILABLE	(-1.0)	// Value of a counter that could not be read
+
+	/**
+	 * Hardware events counted by lu_hash_perf_t.
+	 */
+	typedef enum lu_hash_perf_counter_u {
+		LU_HASH_PERF_CYCLES,
+		LU_HASH_PERF_INSTRUCTIONS,
+		LU_HASH_PERF_L1D_MISSES,		// L1 data cache read misses
+		LU_HASH_PERF_LLC_MISSES,		// Last-level cache misses
+		LU_HASH_PERF_DTLB_MISSES,		// Data TLB read misses
+		LU_HASH_PERF_BRANCH_MISSES,		// Mispredicted branches
+		LU_HASH_PERF_COUNTER_COUNT
+	}lu_hash_perf_counter_t;
+
+	/**
+	 * Phases of lu_hash_perf_bench, in the order they run.
+	 */
+	typedef enum lu_hash_perf_phase_u {
+		LU_HASH_PERF_INSERT,	// Insert every key into a table sized to hold them without growing
+		LU_HASH_PERF_FIND,		// Find every key, in a different order
+		LU_HASH_PERF_RESIZE,	// Rehash the full table (lu_hash_table_reseed), per entry moved
+		LU_HASH_PERF_DELETE,	// Delete every key
+		LU_HASH_PERF_PHASE_COUNT
+	}lu_hash_perf_phase_t;
+
+	/**
+	 * Open counters of the calling thread.
+	 */
+	typedef struct lu_hash_perf_s {
+		int				   fds[LU_HASH_PERF_COUNTER_COUNT];	// Counter file descriptors, -1 where unavailable
+		unsigned long long start_ns;						// Time of the last lu_hash_perf_start
+	}lu_hash_perf_t;
+
+	/**
+	 * Counts of one measured interval.
+	 */
+	typedef struct lu_hash_perf_sample_s {
+		double ns;											// Elapsed time in nanoseconds
+		double counters[LU_HASH_PERF_COUNTER_COUNT];		// LU_HASH_PERF_UNAVAILABLE where unavailable
+	}lu_hash_perf_sample_t;
+
+	/**
+	 * Measurements of one benchmark phase, per operation.
+	 */
+	typedef struct lu_hash_perf_result_s {
+		char				  phase[16];	// Name of the phase, see lu_hash_perf_phase_name
+		size_t				  ops;			// Number of operations measured
+		lu_hash_perf_sample_t per_op;		// Time and counters divided by `ops`
+	}lu_hash_perf_result_t;
+
+	/**Function definition*/
+	int lu_hash_perf_open(lu_hash_perf_t* perf);
+	void lu_hash_perf_start(lu_hash_perf_t* perf);
+	void lu_hash_perf_stop(lu_hash_perf_t* perf, lu_hash_perf_sample_t* sample);
+	void lu_hash_perf_close(lu_hash_perf_t* perf);
+	const char* lu_hash_perf_counter_name(lu_hash_perf_counter_t counter);
+	const char* lu_hash_perf_phase_name(lu_hash_perf_phase_t phase);
+	size_t lu_hash_perf_bench(const lu_hash_table_config_t* config, size_t key_count, unsigned int seed, lu_hash_perf_result_t* results);
+	int lu_hash_perf_write_csv(const char* path, const lu_hash_perf_result_t* results, size_t count);
+	size_t lu_hash_perf_read_csv(const char* path, lu_hash_perf_result_t* results, size_t max_results);
+	size_t lu_hash_perf_compare(const lu_hash_perf_result_t* current, size_t count, const lu_hash_perf_result_t* baseline, size_t baseline_count, double tolerance, FILE* report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_PERF_INCLUDE_H_*/
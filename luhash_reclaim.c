@@ -0,0 +1,167 @@
+#include "luhash_reclaim.h"
+
+/**
+ * @file luhash_reclaim.c
+ * @brief Reclaimer thread that frees queued tables in rate-limited chunks.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+static void lu_hash_reclaimer_run(void* arg);
+
+/**
+ * Starts a reclaimer thread.
+ *
+ * @param chunk The number of nodes freed before each pause, 0 for `LU_HASH_RECLAIM_DEFAULT_CHUNK`.
+ * @param pause_ms The pause between two chunks in milliseconds, 0 to free without pausing.
+ * @return A pointer to the reclaimer, or exits the program if memory allocation fails. If the
+ *         thread cannot be started, the reclaimer still works but frees tables on the calling
+ *         thread.
+ */
+lu_hash_reclaimer_t* lu_hash_reclaimer_start(size_t chunk, unsigned int pause_ms)
+{
+	lu_hash_reclaimer_t* reclaimer = (lu_hash_reclaimer_t*)LU_MM_CALLOC(1, sizeof(lu_hash_reclaimer_t));
+	lu_mutex_init(&reclaimer->lock);
+	lu_cond_init(&reclaimer->wake);
+	lu_cond_init(&reclaimer->idle);
+	reclaimer->chunk = chunk != 0 ? chunk : LU_HASH_RECLAIM_DEFAULT_CHUNK;
+	reclaimer->pause_ms = pause_ms;
+	reclaimer->threaded = lu_thread_create(&reclaimer->thread, lu_hash_reclaimer_run, reclaimer) == 0;
+#ifdef LU_HASH_DEBUG
+	if (!reclaimer->threaded) {
+		printf("Reclaimer thread could not be started, tables are freed synchronously\n");
+	}
+#endif // LU_HASH_DEBUG
+	return reclaimer;
+}
+
+/**
+ * Hands a table over to the reclaimer and returns without freeing anything.
+ *
+ * The table must not be used afterwards. Queuing takes constant time, except that an active
+ * snapshot of the table first gets its own copy of the buckets on the calling thread, as with
+ * lu_hash_table_destroy.
+ *
+ * @param reclaimer The reclaimer.
+ * @param table The table to destroy. If NULL, the function does nothing.
+ */
+void lu_hash_reclaimer_destroy(lu_hash_reclaimer_t* reclaimer, lu_hash_table_t* table)
+{
+	if (table == NULL) {
+		return;
+	}
+	if (!reclaimer->threaded) {
+		lu_hash_table_destroy(table);
+		return;
+	}
+
+	// Detach a snapshot here, the reclaimer thread must not touch anything the caller still uses
+	lu_hash_table_destroy_step(table, 0);
+
+	lu_hash_reclaim_item_t* item = (lu_hash_reclaim_item_t*)LU_MM_MALLOC(sizeof(lu_hash_reclaim_item_t));
+	item->table = table;
+	item->next = NULL;
+
+	lu_mutex_lock(&reclaimer->lock);
+	if (reclaimer->tail != NULL) {
+		reclaimer->tail->next = item;
+	}
+	else {
+		reclaimer->head = item;
+	}
+	reclaimer->tail = item;
+	reclaimer->pending++;
+	lu_cond_signal(&reclaimer->wake);
+	lu_mutex_unlock(&reclaimer->lock);
+}
+
+/**
+ * @brief Blocks until every table queued so far has been freed.
+ */
+void lu_hash_reclaimer_wait(lu_hash_reclaimer_t* reclaimer)
+{
+	lu_mutex_lock(&reclaimer->lock);
+	while (reclaimer->pending != 0) {
+		lu_cond_wait(&reclaimer->idle, &reclaimer->lock);
+	}
+	lu_mutex_unlock(&reclaimer->lock);
+}
+
+/**
+ * @brief Returns the number of tables queued or being freed.
+ */
+size_t lu_hash_reclaimer_pending(lu_hash_reclaimer_t* reclaimer)
+{
+	lu_mutex_lock(&reclaimer->lock);
+	size_t pending = reclaimer->pending;
+	lu_mutex_unlock(&reclaimer->lock);
+	return pending;
+}
+
+/**
+ * @brief Frees every queued table without pausing, stops the thread and frees the reclaimer.
+ *
+ * @param reclaimer The reclaimer. If NULL, the function does nothing.
+ */
+void lu_hash_reclaimer_stop(lu_hash_reclaimer_t* reclaimer)
+{
+	if (reclaimer == NULL) {
+		return;
+	}
+	if (reclaimer->threaded) {
+		lu_mutex_lock(&reclaimer->lock);
+		lu_atomic_store_size(&reclaimer->stopping, 1);
+		lu_cond_signal(&reclaimer->wake);
+		lu_mutex_unlock(&reclaimer->lock);
+		lu_thread_join(reclaimer->thread);
+	}
+
+	lu_cond_destroy(&reclaimer->idle);
+	lu_cond_destroy(&reclaimer->wake);
+	lu_mutex_destroy(&reclaimer->lock);
+	LU_MM_FREE(reclaimer);
+}
+
+/**
+ * @brief Body of the reclaimer thread: frees queued tables in order until stopped.
+ *
+ * The lock is only held to take a table off the queue and to account for it afterwards; the
+ * chunks themselves run without it, so queuing never waits for freeing.
+ */
+static void lu_hash_reclaimer_run(void* arg)
+{
+	lu_hash_reclaimer_t* reclaimer = (lu_hash_reclaimer_t*)arg;
+
+	lu_mutex_lock(&reclaimer->lock);
+	for (;;) {
+		while (reclaimer->head == NULL && !lu_atomic_load_size(&reclaimer->stopping)) {
+			lu_cond_wait(&reclaimer->wake, &reclaimer->lock);
+		}
+		lu_hash_reclaim_item_t* item = reclaimer->head;
+		if (item == NULL) {
+			break; // Stopping and nothing left
+		}
+		reclaimer->head = item->next;
+		if (reclaimer->head == NULL) {
+			reclaimer->tail = NULL;
+		}
+		lu_mutex_unlock(&reclaimer->lock);
+
+		while (!lu_hash_table_destroy_step(item->table, reclaimer->chunk)) {
+			if (reclaimer->pause_ms != 0 && !lu_atomic_load_size(&reclaimer->stopping)) {
+				lu_thread_sleep_ms(reclaimer->pause_ms);
+			}
+		}
+		LU_MM_FREE(item);
+
+		lu_mutex_lock(&reclaimer->lock);
+		reclaimer->reclaimed++;
+		if (--reclaimer->pending == 0) {
+			lu_cond_broadcast(&reclaimer->idle);
+		}
+	}
+	lu_mutex_unlock(&reclaimer->lock);
+}
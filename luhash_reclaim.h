@@ -0,0 +1,81 @@
+#ifndef LU_LU_HASH_RECLAIM_INCLUDE_H_
+#define LU_LU_HASH_RECLAIM_INCLUDE_H_
+
+/**
+ * @file luhash_reclaim.h
+ * @brief Background thread that destroys tables handed to it, a bounded chunk at a time.
+ *
+ * lu_hash_table_destroy frees every node on the calling thread, which stalls a serving thread for
+ * seconds when the table holds tens of millions of entries. lu_hash_reclaimer_destroy instead
+ * queues the table in constant time and returns; the reclaimer thread tears it down with
+ * lu_hash_table_destroy_step in chunks of `chunk` nodes, pausing `pause_ms` between chunks so that
+ * the freeing does not compete with the application for the allocator and memory bandwidth.
+ * lu_hash_reclaimer_wait blocks until everything queued so far has been freed.
+ *
+ * The bucket array is released through the table's configured free function, which is then
+ * called on the reclaimer thread.
+ *
+ * Usage example:
+ *     lu_hash_reclaimer_t* reclaimer = lu_hash_reclaimer_start(LU_HASH_RECLAIM_DEFAULT_CHUNK, 1);
+ *     lu_hash_reclaimer_destroy(reclaimer, old_index);   // Returns immediately
+ *     ...
+ *     lu_hash_reclaimer_stop(reclaimer);                 // Frees what is left, then joins
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include "luhash_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_RECLAIM_DEFAULT_CHUNK	65536	// Nodes freed between two pauses if 0 is passed
+
+	/**
+	 * A table waiting to be freed.
+	 */
+	typedef struct lu_hash_reclaim_item_s {
+		lu_hash_table_t*				table;
+		struct lu_hash_reclaim_item_s*	next;
+	}lu_hash_reclaim_item_t;
+
+	/**
+	 * Structure representing a reclaimer thread and its queue.
+	 */
+	typedef struct lu_hash_reclaimer_s {
+		lu_mutex_t				lock;
+		lu_cond_t				wake;		// Signaled when a table is queued or the reclaimer stops
+		lu_cond_t				idle;		// Broadcast when the last pending table has been freed
+		lu_hash_reclaim_item_t* head;		// Queue of tables, oldest first
+		lu_hash_reclaim_item_t* tail;
+		size_t					pending;	// Tables queued or being freed
+		size_t					chunk;		// Nodes freed per lu_hash_table_destroy_step call
+		unsigned int			pause_ms;	// Pause between chunks, 0 for none
+		volatile size_t			stopping;	// Set by lu_hash_reclaimer_stop, makes the thread finish without pauses
+		size_t					reclaimed;	// Tables freed so far
+		int						threaded;	// 0 if the thread could not be started: tables are then freed on the spot
+		lu_thread_t				thread;
+	}lu_hash_reclaimer_t;
+
+	/**Function definition*/
+	lu_hash_reclaimer_t* lu_hash_reclaimer_start(size_t chunk, unsigned int pause_ms);
+	void lu_hash_reclaimer_destroy(lu_hash_reclaimer_t* reclaimer, lu_hash_table_t* table);
+	void lu_hash_reclaimer_wait(lu_hash_reclaimer_t* reclaimer);
+	size_t lu_hash_reclaimer_pending(lu_hash_reclaimer_t* reclaimer);
+	void lu_hash_reclaimer_stop(lu_hash_reclaimer_t* reclaimer);
+
+#define LU_HASH_RECLAIMER_START()					lu_hash_reclaimer_start(0,0)
+#define LU_HASH_RECLAIMER_DESTROY(reclaimer,table)	lu_hash_reclaimer_destroy(reclaimer,table)
+#define LU_HASH_RECLAIMER_WAIT(reclaimer)			lu_hash_reclaimer_wait(reclaimer)
+#define LU_HASH_RECLAIMER_STOP(reclaimer)			lu_hash_reclaimer_stop(reclaimer)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_RECLAIM_INCLUDE_H_*/
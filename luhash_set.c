@@ -0,0 +1,432 @@
+#include "luhash_set.h"
+#include "luhash_define.h"
+
+/**
+ * @file luhash_set.c
+ * @brief Key-only hash set: list and red-black tree buckets without value pointers.
+ *
+ * The tree buckets use the red-black tree that LU_HASH_DEFINE_TREE generates for the node type
+ * of the set.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+/** Number of keys hashed and prefetched ahead in lu_hash_set_contains_batch */
+#define LU_HASH_SET_BATCH_WINDOW	16
+
+/** Key comparisons of the tree buckets */
+#define lu_hash_set_key_eq(a,b)		((a) == (b))
+#define lu_hash_set_key_less(a,b)	((a) < (b))
+
+static size_t lu_hash_set_index(int key, unsigned long long seed, size_t table_size);
+static void lu_hash_set_rehash(lu_hash_set_t* set, size_t new_table_size);
+static void lu_hash_set_reseed(lu_hash_set_t* set);
+static int lu_hash_set_bucket_contains(const lu_hash_set_bucket_t* bucket, int key);
+static void lu_hash_set_convert_to_tree(lu_hash_set_bucket_t* bucket);
+static void lu_hash_set_convert_to_list(lu_hash_set_bucket_t* bucket);
+static void lu_hash_set_shrink(lu_hash_set_t* set);
+
+LU_HASH_DEFINE_TREE(lu_hash_set, int, lu_hash_set_key_eq, lu_hash_set_key_less)
+
+/**
+ * @brief Computes the bucket of a key, the same seeded MurmurHash3 finalizer as lu_hash_table_t.
+ *
+ * @param key The key to hash.
+ * @param seed The seed of the set.
+ * @param table_size The number of buckets.
+ * @return The bucket index, ranging from 0 to table_size - 1.
+ */
+static size_t lu_hash_set_index(int key, unsigned long long seed, size_t table_size)
+{
+	unsigned long long hash = lu_hash_seeded_mix((unsigned int)key, seed);
+	if ((table_size & (table_size - 1)) == 0) {
+		return (size_t)(hash & (table_size - 1));
+	}
+	return (size_t)(hash % table_size);
+}
+
+/**
+ * Initializes a hash set.
+ *
+ * @param table_size The initial number of buckets. If 0, `LU_HASH_TABLE_DEFAULT_SIZE` is used.
+ * @return A pointer to the newly initialized set, or exits the program if memory allocation fails.
+ *
+ * Usage example:
+ *     lu_hash_set_t* set = lu_hash_set_init(1024);
+ */
+lu_hash_set_t* lu_hash_set_init(size_t table_size)
+{
+	if (table_size == 0) {
+		table_size = LU_HASH_TABLE_DEFAULT_SIZE;
+	}
+
+	lu_hash_set_t* set = (lu_hash_set_t*)LU_MM_MALLOC(sizeof(lu_hash_set_t));
+	set->table_size = table_size;
+	set->initial_size = table_size;
+	set->element_count = 0;
+	set->seed = lu_hash_random_seed();
+	set->treeify_count = 0;
+	set->reseed_count = 0;
+	set->buckets = (lu_hash_set_bucket_t*)LU_MM_CALLOC(table_size, sizeof(lu_hash_set_bucket_t));
+	for (size_t i = 0; i < table_size; i++) {
+		set->buckets[i].type = LU_HASH_BUCKET_LIST;
+		set->buckets[i].data.list_head = NULL;
+		set->buckets[i].esize_bucket = 0;
+	}
+	return set;
+}
+
+/**
+ * Adds a key to the set.
+ *
+ * @param set A pointer to the hash set.
+ * @param key The key to add.
+ * @return 1 if the key was added, 0 if it was already present.
+ */
+int lu_hash_set_add(lu_hash_set_t* set, int key)
+{
+	if ((double)set->element_count / set->table_size > LU_HASH_TABLE_MAX_LOAD_FACTOR) {
+		lu_hash_set_rehash(set, set->table_size * 2);
+	}
+
+	lu_hash_set_bucket_t* bucket = &set->buckets[lu_hash_set_index(key, set->seed, set->table_size)];
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		for (lu_hash_set_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+			if (node->key == key) {
+				return 0;
+			}
+		}
+
+		lu_hash_set_node_t* new_node = (lu_hash_set_node_t*)LU_MM_MALLOC(sizeof(lu_hash_set_node_t));
+		new_node->key = key;
+		new_node->next = bucket->data.list_head;
+		bucket->data.list_head = new_node;
+		bucket->esize_bucket++;
+		set->element_count++;
+
+		if (bucket->esize_bucket > LU_HASH_BUCKET_LIST_THRESHOLD) {
+			lu_hash_set_convert_to_tree(bucket);
+			set->treeify_count++;
+			if (set->treeify_count > lu_hash_reseed_treeify_limit(set->table_size, LU_HASH_TABLE_MAX_LOAD_FACTOR, LU_HASH_BUCKET_LIST_THRESHOLD)) {
+				lu_hash_set_reseed(set);
+			}
+		}
+		return 1;
+	}
+
+	size_t depth = 0;
+	int added;
+	lu_hash_set_tree_insert_key(bucket->data.rb_tree, key, &depth, &added);
+	if (!added) {
+		return 0;
+	}
+	bucket->esize_bucket++;
+	set->element_count++;
+
+	if (depth > LU_HASH_RESEED_TREE_HEIGHT) {
+		lu_hash_set_reseed(set);
+	}
+	return 1;
+}
+
+/**
+ * @brief Checks whether a bucket holds a key.
+ */
+static int lu_hash_set_bucket_contains(const lu_hash_set_bucket_t* bucket, int key)
+{
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		for (const lu_hash_set_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+			if (node->key == key) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+	return lu_hash_set_tree_find(bucket->data.rb_tree, key) != NULL;
+}
+
+/**
+ * @brief Checks whether a key is in the set.
+ *
+ * @param set A pointer to the hash set.
+ * @param key The key to look up.
+ * @return 1 if the key is present, 0 otherwise.
+ */
+int lu_hash_set_contains(const lu_hash_set_t* set, int key)
+{
+	return lu_hash_set_bucket_contains(&set->buckets[lu_hash_set_index(key, set->seed, set->table_size)], key);
+}
+
+/**
+ * Checks many keys at once.
+ *
+ * The keys are processed in windows of `LU_HASH_SET_BATCH_WINDOW`. Within a window all buckets
+ * are located and prefetched first, then the first node of every list bucket, and only then are
+ * the keys compared, so the cache misses of independent lookups overlap instead of being taken
+ * one after another.
+ *
+ * @param set A pointer to the hash set.
+ * @param keys The keys to look up.
+ * @param count The number of keys.
+ * @param results If not NULL, receives 1 or 0 for every key.
+ * @return The number of keys that are present.
+ */
+size_t lu_hash_set_contains_batch(const lu_hash_set_t* set, const int* keys, size_t count, unsigned char* results)
+{
+	const lu_hash_set_bucket_t* window[LU_HASH_SET_BATCH_WINDOW];
+	size_t found = 0;
+
+	for (size_t base = 0; base < count; base += LU_HASH_SET_BATCH_WINDOW) {
+		size_t n = count - base < LU_HASH_SET_BATCH_WINDOW ? count - base : LU_HASH_SET_BATCH_WINDOW;
+
+		for (size_t i = 0; i < n; i++) {
+			window[i] = &set->buckets[lu_hash_set_index(keys[base + i], set->seed, set->table_size)];
+			LU_PREFETCH(window[i]);
+		}
+		for (size_t i = 0; i < n; i++) {
+			if (window[i]->type == LU_HASH_BUCKET_LIST && window[i]->data.list_head != NULL) {
+				LU_PREFETCH(window[i]->data.list_head);
+			}
+		}
+		for (size_t i = 0; i < n; i++) {
+			int hit = lu_hash_set_bucket_contains(window[i], keys[base + i]);
+			if (results != NULL) {
+				results[base + i] = (unsigned char)hit;
+			}
+			found += hit;
+		}
+	}
+	return found;
+}
+
+/**
+ * @brief Removes a key from the set.
+ *
+ * A tree bucket that shrinks to `LU_HASH_SET_UNTREEIFY_THRESHOLD` keys turns back into a list, and
+ * the set shrinks once its load falls below `LU_HASH_TABLE_SHRINK_THRESHOLD`.
+ *
+ * @param set A pointer to the hash set.
+ * @param key The key to remove.
+ * @return 1 if the key was removed, 0 if it was not present.
+ */
+int lu_hash_set_remove(lu_hash_set_t* set, int key)
+{
+	lu_hash_set_bucket_t* bucket = &set->buckets[lu_hash_set_index(key, set->seed, set->table_size)];
+	int removed = 0;
+
+	if (bucket->type == LU_HASH_BUCKET_LIST) {
+		lu_hash_set_node_t** link = &bucket->data.list_head;
+		while (*link != NULL) {
+			lu_hash_set_node_t* node = *link;
+			if (node->key == key) {
+				*link = node->next;
+				LU_MM_FREE(node);
+				removed = 1;
+				break;
+			}
+			link = &node->next;
+		}
+	}
+	else {
+		removed = lu_hash_set_tree_delete(bucket->data.rb_tree, key);
+	}
+
+	if (removed) {
+		bucket->esize_bucket--;
+		set->element_count--;
+		if (bucket->type == LU_HASH_BUCKET_RBTREE && bucket->esize_bucket <= LU_HASH_SET_UNTREEIFY_THRESHOLD) {
+			lu_hash_set_convert_to_list(bucket);
+		}
+		if ((double)set->element_count / set->table_size < LU_HASH_TABLE_SHRINK_THRESHOLD) {
+			lu_hash_set_shrink(set);
+		}
+	}
+	return removed;
+}
+
+/**
+ * @brief Calls a function for every key in the set.
+ *
+ * The callback must not modify the set.
+ *
+ * @param set A pointer to the hash set.
+ * @param visit The callback.
+ * @param ctx Context pointer passed to the callback.
+ */
+void lu_hash_set_foreach(const lu_hash_set_t* set, lu_hash_set_visit_func_t visit, void* ctx)
+{
+	for (size_t i = 0; i < set->table_size; i++) {
+		const lu_hash_set_bucket_t* bucket = &set->buckets[i];
+		if (bucket->type == LU_HASH_BUCKET_LIST) {
+			for (lu_hash_set_node_t* node = bucket->data.list_head; node != NULL; node = node->next) {
+				visit(node->key, ctx);
+			}
+		}
+		else if (bucket->data.rb_tree != NULL) {
+			lu_hash_set_tree_t* tree = bucket->data.rb_tree;
+			if (tree->root == &tree->nil) {
+				continue;
+			}
+			for (lu_hash_set_tree_node_t* node = lu_hash_set_tree_minimum(tree, tree->root); node != &tree->nil; node = lu_hash_set_tree_successor(tree, node)) {
+				visit(node->key, ctx);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Destroys a hash set and frees all of its nodes.
+ *
+ * @param set A pointer to the hash set. If NULL, the function does nothing.
+ */
+void lu_hash_set_destroy(lu_hash_set_t* set)
+{
+	if (set == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < set->table_size; i++) {
+		lu_hash_set_bucket_t* bucket = &set->buckets[i];
+		if (bucket->type == LU_HASH_BUCKET_LIST) {
+			lu_hash_set_node_t* node = bucket->data.list_head;
+			while (node != NULL) {
+				lu_hash_set_node_t* next = node->next;
+				LU_MM_FREE(node);
+				node = next;
+			}
+		}
+		else if (bucket->data.rb_tree != NULL) {
+			lu_hash_set_tree_free(bucket->data.rb_tree);
+		}
+	}
+
+	LU_MM_FREE(set->buckets);
+	LU_MM_FREE(set);
+}
+
+/**
+ * @brief Draws a new seed and rehashes the set at its current size.
+ */
+static void lu_hash_set_reseed(lu_hash_set_t* set)
+{
+	set->seed = lu_hash_random_seed();
+	set->treeify_count = 0;
+	set->reseed_count++;
+	lu_hash_set_rehash(set, set->table_size);
+}
+
+/**
+ * @brief Halves the bucket count as many times as the load stays below
+ * `LU_HASH_TABLE_SHRINK_THRESHOLD`, but never below the bucket count the set was created with.
+ */
+static void lu_hash_set_shrink(lu_hash_set_t* set)
+{
+	size_t new_table_size = set->table_size;
+	while (new_table_size / 2 >= set->initial_size && (double)set->element_count / new_table_size < LU_HASH_TABLE_SHRINK_THRESHOLD) {
+		new_table_size /= 2;
+	}
+	if (new_table_size < set->table_size) {
+		lu_hash_set_rehash(set, new_table_size);
+	}
+}
+
+/**
+ * @brief Moves all keys into a new bucket array of the given size under the current seed.
+ *
+ * List nodes are relinked, tree nodes are replaced by list nodes, and buckets that end up above
+ * the list threshold are converted to trees again.
+ */
+static void lu_hash_set_rehash(lu_hash_set_t* set, size_t new_table_size)
+{
+	lu_hash_set_bucket_t* new_buckets = (lu_hash_set_bucket_t*)LU_MM_CALLOC(new_table_size, sizeof(lu_hash_set_bucket_t));
+	for (size_t i = 0; i < new_table_size; i++) {
+		new_buckets[i].type = LU_HASH_BUCKET_LIST;
+		new_buckets[i].data.list_head = NULL;
+		new_buckets[i].esize_bucket = 0;
+	}
+
+	for (size_t i = 0; i < set->table_size; i++) {
+		lu_hash_set_bucket_t* old_bucket = &set->buckets[i];
+		if (old_bucket->type == LU_HASH_BUCKET_LIST) {
+			lu_hash_set_node_t* node = old_bucket->data.list_head;
+			while (node != NULL) {
+				lu_hash_set_node_t* next = node->next;
+				lu_hash_set_bucket_t* new_bucket = &new_buckets[lu_hash_set_index(node->key, set->seed, new_table_size)];
+				node->next = new_bucket->data.list_head;
+				new_bucket->data.list_head = node;
+				new_bucket->esize_bucket++;
+				node = next;
+			}
+		}
+		else if (old_bucket->data.rb_tree != NULL) {
+			lu_hash_set_tree_t* tree = old_bucket->data.rb_tree;
+			if (tree->root != &tree->nil) {
+				for (lu_hash_set_tree_node_t* node = lu_hash_set_tree_minimum(tree, tree->root); node != &tree->nil; node = lu_hash_set_tree_successor(tree, node)) {
+					lu_hash_set_bucket_t* new_bucket = &new_buckets[lu_hash_set_index(node->key, set->seed, new_table_size)];
+					lu_hash_set_node_t* new_node = (lu_hash_set_node_t*)LU_MM_MALLOC(sizeof(lu_hash_set_node_t));
+					new_node->key = node->key;
+					new_node->next = new_bucket->data.list_head;
+					new_bucket->data.list_head = new_node;
+					new_bucket->esize_bucket++;
+				}
+			}
+			lu_hash_set_tree_free(tree);
+		}
+	}
+
+	set->treeify_count = 0;
+	for (size_t i = 0; i < new_table_size; i++) {
+		if (new_buckets[i].esize_bucket > LU_HASH_BUCKET_LIST_THRESHOLD) {
+			lu_hash_set_convert_to_tree(&new_buckets[i]);
+			set->treeify_count++;
+		}
+	}
+
+	LU_MM_FREE(set->buckets);
+	set->buckets = new_buckets;
+	set->table_size = new_table_size;
+}
+
+/**
+ * @brief Converts a list bucket into a red-black tree bucket.
+ */
+static void lu_hash_set_convert_to_tree(lu_hash_set_bucket_t* bucket)
+{
+	lu_hash_set_tree_t* tree = lu_hash_set_tree_new();
+	lu_hash_set_node_t* node = bucket->data.list_head;
+	while (node != NULL) {
+		lu_hash_set_node_t* next = node->next;
+		size_t depth;
+		int added;
+		lu_hash_set_tree_insert_key(tree, node->key, &depth, &added);
+		LU_MM_FREE(node);
+		node = next;
+	}
+	bucket->type = LU_HASH_BUCKET_RBTREE;
+	bucket->data.rb_tree = tree;
+}
+
+/**
+ * @brief Converts a tree bucket back into a list bucket, keeping the keys in tree order.
+ */
+static void lu_hash_set_convert_to_list(lu_hash_set_bucket_t* bucket)
+{
+	lu_hash_set_tree_t* tree = bucket->data.rb_tree;
+	lu_hash_set_node_t* head = NULL;
+	lu_hash_set_node_t** tail = &head;
+	if (tree->root != &tree->nil) {
+		for (lu_hash_set_tree_node_t* node = lu_hash_set_tree_minimum(tree, tree->root); node != &tree->nil; node = lu_hash_set_tree_successor(tree, node)) {
+			lu_hash_set_node_t* list_node = (lu_hash_set_node_t*)LU_MM_MALLOC(sizeof(lu_hash_set_node_t));
+			list_node->key = node->key;
+			list_node->next = NULL;
+			*tail = list_node;
+			tail = &list_node->next;
+		}
+	}
+	lu_hash_set_tree_free(tree);
+	bucket->type = LU_HASH_BUCKET_LIST;
+	bucket->data.list_head = head;
+}
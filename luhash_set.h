@@ -0,0 +1,111 @@
+#ifndef LU_LU_HASH_SET_INCLUDE_H_
+#define LU_LU_HASH_SET_INCLUDE_H_
+
+/**
+ * @file luhash_set.h
+ * @brief Key-only hash set with the same bucket layout as lu_hash_table_t.
+ *
+ * A membership set does not need the `void* value` that every node of lu_hash_table_t carries.
+ * lu_hash_set_t keeps the bucket design of the table (seeded hash, chaining with linked lists that
+ * turn into red-black trees above `LU_HASH_BUCKET_LIST_THRESHOLD`, resize at
+ * `LU_HASH_TABLE_MAX_LOAD_FACTOR`, reseed on suspected collision attacks) but stores keys only:
+ * a list node shrinks from 24 to 16 bytes and a tree node from 48 to 32 bytes. Removals turn
+ * small tree buckets back into lists and shrink the bucket array once it is mostly empty.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * A tree bucket of a set that shrinks to this many keys turns back into a list. It sits well
+	 * below `LU_HASH_BUCKET_LIST_THRESHOLD`, so a bucket hovering around the threshold is not
+	 * converted back and forth.
+	 */
+#define LU_HASH_SET_UNTREEIFY_THRESHOLD	(LU_HASH_BUCKET_LIST_THRESHOLD / 2)
+
+	/**
+	 * Structure representing a node in a list bucket of a set.
+	 */
+	typedef struct lu_hash_set_node_s {
+		struct lu_hash_set_node_s* next;	// Pointer to the next node in the bucket
+		int		key;						// Key of the node
+	}lu_hash_set_node_t;
+
+	/**
+	 * Structure representing a node in a tree bucket of a set.
+	 */
+	typedef struct lu_hash_set_tree_node_s {
+		struct lu_hash_set_tree_node_s* left;
+		struct lu_hash_set_tree_node_s* right;
+		struct lu_hash_set_tree_node_s* parent;
+		lu_node_color_t				   color;
+		int							   key;
+	}lu_hash_set_tree_node_t;
+
+	/**
+	 * Structure representing the red-black tree of a set bucket, with the sentinel stored inline
+	 * as LU_HASH_DEFINE_TREE expects.
+	 */
+	typedef struct lu_hash_set_tree_s {
+		lu_hash_set_tree_node_t* root;	// Pointer to the root node of the red-black tree
+		lu_hash_set_tree_node_t	 nil;	// Sentinel node representing "null"
+	}lu_hash_set_tree_t;
+
+	/**
+	 * Structure representing a set bucket, a linked list or a red-black tree like lu_hash_bucket_t.
+	 */
+	typedef struct lu_hash_set_bucket_s {
+		lu_hash_bucket_type_t type;
+		union
+		{
+			lu_hash_set_node_t* list_head;	// Head of the linked list (if type is list)
+			lu_hash_set_tree_t* rb_tree;	// Red-black tree (if type is rb_tree)
+		}data;
+
+		size_t esize_bucket; // Number of keys in the bucket
+	}lu_hash_set_bucket_t;
+
+	/**
+	 * Structure representing a hash set.
+	 */
+	typedef struct lu_hash_set_s {
+		lu_hash_set_bucket_t* buckets;
+		size_t			   table_size;
+		size_t			   initial_size;	// Bucket count at creation, the set never shrinks below it
+		size_t			   element_count;	// Current number of keys in the set
+		unsigned long long seed;			// Random seed mixed into every hash
+		size_t			   treeify_count;	// List-to-tree conversions since the last resize or reseed
+		size_t			   reseed_count;	// Number of reseeds
+	}lu_hash_set_t;
+
+	/** Callback invoked for every key by lu_hash_set_foreach */
+	typedef void (*lu_hash_set_visit_func_t)(int key, void* ctx);
+
+	/**Function definition*/
+	lu_hash_set_t* lu_hash_set_init(size_t table_size);
+	int lu_hash_set_add(lu_hash_set_t* set, int key);
+	int lu_hash_set_contains(const lu_hash_set_t* set, int key);
+	size_t lu_hash_set_contains_batch(const lu_hash_set_t* set, const int* keys, size_t count, unsigned char* results);
+	int lu_hash_set_remove(lu_hash_set_t* set, int key);
+	void lu_hash_set_foreach(const lu_hash_set_t* set, lu_hash_set_visit_func_t visit, void* ctx);
+	void lu_hash_set_destroy(lu_hash_set_t* set);
+
+#define LU_HASH_SET_INIT(size)				lu_hash_set_init(size)
+#define LU_HASH_SET_ADD(set,key)			lu_hash_set_add(set,key)
+#define LU_HASH_SET_CONTAINS(set,key)		lu_hash_set_contains(set,key)
+#define LU_HASH_SET_REMOVE(set,key)			lu_hash_set_remove(set,key)
+#define LU_HASH_SET_DESTROY(set)			lu_hash_set_destroy(set)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_SET_INCLUDE_H_*/
@@ -0,0 +1,299 @@
+#include "luhash_sharded.h"
+
+/**
+ * @file luhash_sharded.c
+ * @brief Sharded hash table: key routing, per-shard locking and thread binding.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+/** Shard the calling thread is currently bound to, or NULL when unbound */
+static LU_THREAD_LOCAL lu_hash_shard_t* lu_hash_sharded_owned_shard_ = NULL;
+
+static int lu_hash_sharded_lock(lu_hash_shard_t* shard);
+static lu_hash_shard_t* lu_hash_sharded_acquire(lu_hash_sharded_t* sharded, int key);
+static void lu_hash_sharded_release(lu_hash_shard_t* shard);
+
+/**
+ * Initializes a sharded hash table.
+ *
+ * The shard count is rounded up to the next power of two so that a shard can be selected with
+ * a single shift of the mixed hash.
+ *
+ * @param shard_count Number of shards. If 0, `LU_HASH_SHARDED_DEFAULT_SHARDS` is used.
+ * @param shard_table_size Initial number of buckets of every shard table.
+ * @return A pointer to the newly initialized sharded table, or exits the program if memory allocation fails.
+ *
+ * Usage example:
+ *     lu_hash_sharded_t* sharded = lu_hash_sharded_init(16, 1024); // 16 shards of 1024 buckets each.
+ */
+lu_hash_sharded_t* lu_hash_sharded_init(size_t shard_count, size_t shard_table_size)
+{
+	if (shard_count == 0) {
+		shard_count = LU_HASH_SHARDED_DEFAULT_SHARDS;
+	}
+
+	// Round the shard count up to a power of two
+	unsigned int shard_bits = 0;
+	while (((size_t)1 << shard_bits) < shard_count) {
+		shard_bits++;
+	}
+	shard_count = (size_t)1 << shard_bits;
+
+	lu_hash_sharded_t* sharded = (lu_hash_sharded_t*)LU_MM_MALLOC(sizeof(lu_hash_sharded_t));
+	sharded->shards = (lu_hash_shard_t*)LU_MM_CALLOC(shard_count, sizeof(lu_hash_shard_t));
+	sharded->shard_count = shard_count;
+	sharded->shard_bits = shard_bits;
+	sharded->seed = lu_hash_random_seed();
+
+	for (size_t i = 0; i < shard_count; i++) {
+		lu_mutex_init(&sharded->shards[i].lock);
+		sharded->shards[i].table = lu_hash_table_init(shard_table_size);
+	}
+
+	return sharded;
+}
+
+/**
+ * @brief Returns the index of the shard that owns a key.
+ *
+ * Callers that partition work across pinned threads can use this to hand each thread only the
+ * keys of the shard it is bound to.
+ *
+ * @param sharded A pointer to the sharded table.
+ * @param key The key to route.
+ * @return The shard index, ranging from 0 to shard_count - 1.
+ */
+size_t lu_hash_sharded_shard_of(const lu_hash_sharded_t* sharded, int key)
+{
+	if (sharded->shard_bits == 0) {
+		return 0;
+	}
+	// The high bits of the hash under the routing seed select the shard. The bucket inside a shard
+	// comes from the low bits of a hash under the shard table's own, independent seed, so the two
+	// choices do not correlate and each shard still spreads its keys over all of its buckets.
+	return (size_t)(lu_hash_seeded_mix((unsigned int)key, sharded->seed) >> (64 - sharded->shard_bits));
+}
+
+/**
+ * @brief Takes the lock of a shard for the calling thread.
+ *
+ * The lock is skipped when the calling thread is bound to the shard, because a bound thread
+ * already holds the shard lock for the whole binding. A thread bound to another shard never waits
+ * for a shard that is bound as well: if that owner waited for our shard in turn, neither binding
+ * could end.
+ *
+ * @param shard The shard to lock.
+ * @return LU_OK once the shard is held, or LU_ERROR_BUSY if a bound thread met a shard bound to
+ *         another thread.
+ */
+static int lu_hash_sharded_lock(lu_hash_shard_t* shard)
+{
+	if (shard == lu_hash_sharded_owned_shard_) {
+		return LU_OK;
+	}
+	if (lu_hash_sharded_owned_shard_ == NULL) {
+		lu_mutex_lock(&shard->lock);
+		return LU_OK;
+	}
+
+	// Unbound threads hold a shard for one operation only, so waiting for them cannot deadlock
+	while (!lu_mutex_trylock(&shard->lock)) {
+		if (lu_atomic_load_size(&shard->bound)) {
+			lu_hash_erron_global_ = LU_ERROR_BUSY;
+			return LU_ERROR_BUSY;
+		}
+		lu_thread_yield();
+	}
+	return LU_OK;
+}
+
+/**
+ * @brief Locates and locks the shard that owns a key.
+ *
+ * @param sharded A pointer to the sharded table.
+ * @param key The key to route.
+ * @return The locked shard, or NULL if the calling thread is bound and the shard is bound to
+ *         another thread (see lu_hash_sharded_lock).
+ */
+static lu_hash_shard_t* lu_hash_sharded_acquire(lu_hash_sharded_t* sharded, int key)
+{
+	lu_hash_shard_t* shard = &sharded->shards[lu_hash_sharded_shard_of(sharded, key)];
+	if (lu_hash_sharded_lock(shard) != LU_OK) {
+		return NULL;
+	}
+	return shard;
+}
+
+/**
+ * @brief Releases a shard obtained with lu_hash_sharded_acquire.
+ *
+ * @param shard The shard to release.
+ */
+static void lu_hash_sharded_release(lu_hash_shard_t* shard)
+{
+	if (shard != lu_hash_sharded_owned_shard_) {
+		lu_mutex_unlock(&shard->lock);
+	}
+}
+
+/**
+ * Inserts a key-value pair into the shard that owns the key.
+ *
+ * Only the owning shard is locked, and if the insert makes that shard exceed its load factor
+ * only that shard is resized.
+ *
+ * @param sharded A pointer to the sharded table.
+ * @param key The key to be inserted or updated.
+ * @param value A pointer to the value associated with the key.
+ * @return LU_OK, or LU_ERROR_BUSY if the calling thread is bound and the key belongs to a shard
+ *         bound to another thread. Nothing is inserted then.
+ */
+int lu_hash_sharded_insert(lu_hash_sharded_t* sharded, int key, void* value)
+{
+	lu_hash_shard_t* shard = lu_hash_sharded_acquire(sharded, key);
+	if (shard == NULL) {
+		return LU_ERROR_BUSY;
+	}
+	lu_hash_table_insert(shard->table, key, value);
+	lu_hash_sharded_release(shard);
+	return LU_OK;
+}
+
+/**
+ * @brief Searches for a key in the shard that owns it.
+ *
+ * @param sharded A pointer to the sharded table.
+ * @param key The key to search for.
+ * @return A pointer to the value associated with the key if found, or NULL if the key does not exist.
+ *         NULL is also returned, with lu_hash_erron_global_ set to LU_ERROR_BUSY, if the calling
+ *         thread is bound and the key belongs to a shard bound to another thread.
+ */
+void* lu_hash_sharded_find(lu_hash_sharded_t* sharded, int key)
+{
+	lu_hash_shard_t* shard = lu_hash_sharded_acquire(sharded, key);
+	if (shard == NULL) {
+		return NULL;
+	}
+	void* value = lu_hash_table_find(shard->table, key);
+	lu_hash_sharded_release(shard);
+	return value;
+}
+
+/**
+ * @brief Deletes a key from the shard that owns it.
+ *
+ * @param sharded A pointer to the sharded table.
+ * @param key The key to delete.
+ * @return LU_OK, or LU_ERROR_BUSY if the calling thread is bound and the key belongs to a shard
+ *         bound to another thread. Nothing is deleted then.
+ */
+int lu_hash_sharded_delete(lu_hash_sharded_t* sharded, int key)
+{
+	lu_hash_shard_t* shard = lu_hash_sharded_acquire(sharded, key);
+	if (shard == NULL) {
+		return LU_ERROR_BUSY;
+	}
+	lu_hash_table_delete(shard->table, key);
+	lu_hash_sharded_release(shard);
+	return LU_OK;
+}
+
+/**
+ * @brief Returns the total number of elements over all shards.
+ *
+ * Each shard is locked in turn, so the result is exact for every shard at the moment it was
+ * read but not a global snapshot while writers are running. On a bound thread, shards bound to
+ * other threads are left out of the sum and lu_hash_erron_global_ is set to LU_ERROR_BUSY.
+ *
+ * @param sharded A pointer to the sharded table.
+ * @return The sum of the element counts of all shards.
+ */
+size_t lu_hash_sharded_count(lu_hash_sharded_t* sharded)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < sharded->shard_count; i++) {
+		lu_hash_shard_t* shard = &sharded->shards[i];
+		if (lu_hash_sharded_lock(shard) != LU_OK) {
+			continue;
+		}
+		count += shard->table->element_count;
+		lu_hash_sharded_release(shard);
+	}
+	return count;
+}
+
+/**
+ * @brief Binds the calling thread to one shard.
+ *
+ * The thread takes the shard lock and keeps it until lu_hash_sharded_unbind_thread is called.
+ * While bound, operations of this thread on keys of its shard run without any locking, and
+ * unbound threads that access the shard wait for the binding to end. Threads bound to other
+ * shards do not wait: their operations on this shard fail with LU_ERROR_BUSY. A thread can be
+ * bound to at most one shard at a time.
+ *
+ * @param sharded A pointer to the sharded table.
+ * @param shard_index The index of the shard to bind to.
+ * @return LU_OK on success, LU_ERROR_INVALID_ARGUMENT for a bad index, or LU_ERROR_BUSY if the
+ *         thread is already bound to a shard.
+ */
+int lu_hash_sharded_bind_thread(lu_hash_sharded_t* sharded, size_t shard_index)
+{
+	if (sharded == NULL || shard_index >= sharded->shard_count) {
+		lu_hash_erron_global_ = LU_ERROR_INVALID_ARGUMENT;
+		return LU_ERROR_INVALID_ARGUMENT;
+	}
+	if (lu_hash_sharded_owned_shard_ != NULL) {
+		lu_hash_erron_global_ = LU_ERROR_BUSY;
+		return LU_ERROR_BUSY;
+	}
+
+	lu_hash_shard_t* shard = &sharded->shards[shard_index];
+	lu_mutex_lock(&shard->lock);
+	lu_atomic_store_size(&shard->bound, 1);
+	lu_hash_sharded_owned_shard_ = shard;
+	return LU_OK;
+}
+
+/**
+ * @brief Ends the binding of the calling thread and releases its shard lock.
+ *
+ * Does nothing if the calling thread is not bound to a shard of this table.
+ *
+ * @param sharded A pointer to the sharded table.
+ */
+void lu_hash_sharded_unbind_thread(lu_hash_sharded_t* sharded)
+{
+	lu_hash_shard_t* shard = lu_hash_sharded_owned_shard_;
+	if (shard == NULL || shard < sharded->shards || shard >= sharded->shards + sharded->shard_count) {
+		return;
+	}
+	lu_hash_sharded_owned_shard_ = NULL;
+	lu_atomic_store_size(&shard->bound, 0);
+	lu_mutex_unlock(&shard->lock);
+}
+
+/**
+ * @brief Destroys a sharded table and all of its shards.
+ *
+ * No thread may be bound to any of the shards when the table is destroyed.
+ *
+ * @param sharded A pointer to the sharded table. If NULL, the function does nothing.
+ */
+void lu_hash_sharded_destroy(lu_hash_sharded_t* sharded)
+{
+	if (sharded == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < sharded->shard_count; i++) {
+		lu_hash_table_destroy(sharded->shards[i].table);
+		lu_mutex_destroy(&sharded->shards[i].lock);
+	}
+
+	LU_MM_FREE(sharded->shards);
+	LU_MM_FREE(sharded);
+}
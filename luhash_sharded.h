@@ -0,0 +1,76 @@
+#ifndef LU_LU_HASH_SHARDED_INCLUDE_H_
+#define LU_LU_HASH_SHARDED_INCLUDE_H_
+
+/**
+ * @file luhash_sharded.h
+ * @brief Sharded hash table built from independent lu_hash_table_t shards.
+ *
+ * Keys are routed by the high bits of a mixed hash to one of N shards. Every shard is a complete
+ * lu_hash_table_t with its own lock, element counter and resize, so writers on different shards
+ * never contend and a resize only stalls the 1/N of the keyspace that lives in the growing shard.
+ *
+ * Threads that are pinned to one shard (for example workers that partition their input with
+ * lu_hash_sharded_shard_of) can bind themselves to that shard. A bound thread holds the shard lock
+ * for the whole binding and skips all lock traffic on its own shard; unbound threads that touch the
+ * shard block until the owner unbinds. A bound thread never waits for a shard bound to another
+ * thread, since two owners waiting for each other's shard would deadlock: such an access fails
+ * with LU_ERROR_BUSY instead.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include "luhash_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_SHARDED_DEFAULT_SHARDS	16		// Default number of shards
+
+	/**
+	 * Structure representing one shard. The trailing padding keeps the locks of neighbouring
+	 * shards on different cache lines.
+	 */
+	typedef struct lu_hash_shard_s {
+		lu_mutex_t		 lock;	// Lock protecting the shard table
+		lu_hash_table_t* table;	// Independent hash table holding the keys routed to this shard
+		volatile size_t	 bound;	// Nonzero while a thread is bound to the shard, read without the lock
+		char			 pad[LU_CACHE_LINE_SIZE];
+	}lu_hash_shard_t;
+
+	/**
+	 * Structure representing a sharded hash table.
+	 */
+	typedef struct lu_hash_sharded_s {
+		lu_hash_shard_t* shards;
+		size_t			 shard_count;	// Number of shards, always a power of two
+		unsigned int	 shard_bits;	// log2(shard_count), the number of high hash bits used for routing
+		unsigned long long seed;		// Random seed of the routing hash
+	}lu_hash_sharded_t;
+
+	/**Function definition*/
+	lu_hash_sharded_t* lu_hash_sharded_init(size_t shard_count, size_t shard_table_size);
+	int lu_hash_sharded_insert(lu_hash_sharded_t* sharded, int key, void* value);
+	void* lu_hash_sharded_find(lu_hash_sharded_t* sharded, int key);
+	int lu_hash_sharded_delete(lu_hash_sharded_t* sharded, int key);
+	void lu_hash_sharded_destroy(lu_hash_sharded_t* sharded);
+	size_t lu_hash_sharded_count(lu_hash_sharded_t* sharded);
+	size_t lu_hash_sharded_shard_of(const lu_hash_sharded_t* sharded, int key);
+	int lu_hash_sharded_bind_thread(lu_hash_sharded_t* sharded, size_t shard_index);
+	void lu_hash_sharded_unbind_thread(lu_hash_sharded_t* sharded);
+
+#define LU_HASH_SHARDED_INIT(shards,size)				lu_hash_sharded_init(shards,size)
+#define LU_HASH_SHARDED_INSERT(sharded,key,value)		lu_hash_sharded_insert(sharded,key,value)
+#define LU_HASH_SHARDED_FIND(sharded,key)				lu_hash_sharded_find(sharded,key)
+#define LU_HASH_SHARDED_DELETE(sharded,key)				lu_hash_sharded_delete(sharded,key)
+#define LU_HASH_SHARDED_DESTROY(sharded)				lu_hash_sharded_destroy(sharded)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_SHARDED_INCLUDE_H_*/
@@ -0,0 +1,181 @@
+#ifndef LU_LU_HASH_STATIC_INCLUDE_HPP_
+#define LU_LU_HASH_STATIC_INCLUDE_HPP_
+
+/**
+ * @file luhash_static.hpp
+ * @brief Read-only hash tables laid out at compile time from static data (C++14 constexpr).
+ *
+ * A table whose entries are all known when the program is built, such as a list of records in
+ * an initializer, still costs lu_hash_table_init and one insert per entry at startup. In C++,
+ * lu_hash_static_make builds an open-addressed table from an initializer list as a constant
+ * expression. Declared `constexpr` at namespace scope, the finished table is part of the
+ * executable's read-only data: nothing runs at startup, and processes running the same
+ * executable share its pages through the page cache.
+ *
+ * The table has twice as many slots as entries, rounded up to a power of two, and probes
+ * linearly from the slot of the key's hash. The data is fixed and trusted, so the hash uses a
+ * fixed seed instead of a random one. find has the semantics of lu_hash_table_find: the value of
+ * the key, here as a pointer into the table, or nullptr if the key is absent. A key listed more
+ * than once keeps its last value, as with repeated inserts.
+ *
+ * Usage example:
+ *     struct Person { const char* name; char gender; };
+ *
+ *     static constexpr auto people = lu_hash_static_make<Person>({
+ *         { 1001, { "Zhang San", 'M' } },
+ *         { 1002, { "Li Si", 'F' } },
+ *     });
+ *     static_assert(people.find(1002)->gender == 'F', "resolved by the compiler");
+ *     const Person* person = people.find(id);   // At run time, a probe into .rodata
+ *
+ * The value type must be a literal type that can be default-constructed in a constant
+ * expression, which empty slots hold.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#ifndef __cplusplus
+#error "luhash_static.hpp requires C++14; C code uses lu_hash_frozen_t (luhash_frozen.h) instead"
+#endif
+
+#include <cstddef>
+
+#define LU_HASH_STATIC_SEED		0x9e3779b97f4a7c15ULL	// Seed of the compile-time hash
+
+/**
+ * An entry of the initializer of a static table.
+ */
+template <typename V>
+struct lu_hash_static_entry_t {
+	int key;
+	V	value;
+};
+
+/**
+ * @brief Seeded hash of a key, the same finalizer lu_hash_table_t uses, usable in constant expressions.
+ */
+constexpr unsigned long long lu_hash_static_mix(int key)
+{
+	unsigned long long h = static_cast<unsigned long long>(static_cast<unsigned int>(key)) ^ LU_HASH_STATIC_SEED;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * @brief Returns the number of slots of a table of `count` entries: at least twice `count`, a power of two.
+ */
+constexpr std::size_t lu_hash_static_capacity(std::size_t count)
+{
+	std::size_t capacity = 2;
+	while (capacity < count * 2) {
+		capacity <<= 1;
+	}
+	return capacity;
+}
+
+/**
+ * Read-only open-addressed table of up to `N` entries, built by lu_hash_static_make.
+ */
+template <typename V, std::size_t N>
+class lu_hash_static_table_t {
+public:
+	static constexpr std::size_t capacity = lu_hash_static_capacity(N);
+
+	constexpr lu_hash_static_table_t() : keys_(), values_(), used_(), count_(0)
+	{
+		// Assigned slot by slot as well: GCC does not treat a value-initialized array of structures as constant
+		for (std::size_t i = 0; i < capacity; i++) {
+			values_[i] = V();
+		}
+	}
+
+	/**
+	 * @brief Searches for a key.
+	 *
+	 * @param key The key to search for.
+	 * @return A pointer to the value of the key, or nullptr if the key does not exist.
+	 */
+	constexpr const V* find(int key) const
+	{
+		for (std::size_t i = lu_hash_static_mix(key) & (capacity - 1); used_[i]; i = (i + 1) & (capacity - 1)) {
+			if (keys_[i] == key) {
+				return &values_[i];
+			}
+		}
+		return nullptr;
+	}
+
+	/** @brief Returns whether a key exists. */
+	constexpr bool contains(int key) const { return find(key) != nullptr; }
+
+	/** @brief Returns the number of distinct keys. */
+	constexpr std::size_t size() const { return count_; }
+
+	/**
+	 * @brief Calls `visit(key, value)` for every entry, in slot order.
+	 */
+	template <typename F>
+	void foreach(F visit) const
+	{
+		for (std::size_t i = 0; i < capacity; i++) {
+			if (used_[i]) {
+				visit(keys_[i], values_[i]);
+			}
+		}
+	}
+
+	/**
+	 * @brief Inserts or overwrites an entry while the table is being built.
+	 *
+	 * Always finds a slot: the table has more slots than lu_hash_static_make inserts entries.
+	 */
+	constexpr void insert(int key, const V& value)
+	{
+		std::size_t i = lu_hash_static_mix(key) & (capacity - 1);
+		while (used_[i] && keys_[i] != key) {
+			i = (i + 1) & (capacity - 1);
+		}
+		if (!used_[i]) {
+			used_[i] = true;
+			keys_[i] = key;
+			count_++;
+		}
+		values_[i] = value;
+	}
+
+private:
+	int			keys_[capacity];
+	V			values_[capacity];
+	bool		used_[capacity];
+	std::size_t count_;
+};
+
+template <typename V, std::size_t N>
+constexpr std::size_t lu_hash_static_table_t<V, N>::capacity;
+
+/**
+ * Builds a static table from an initializer list of entries.
+ *
+ * Evaluated at compile time when the result initializes a `constexpr` variable.
+ *
+ * @param entries The entries, e.g. `{ { 1, "one" }, { 2, "two" } }`; the value type is given explicitly.
+ * @return The table.
+ */
+template <typename V, std::size_t N>
+constexpr lu_hash_static_table_t<V, N> lu_hash_static_make(const lu_hash_static_entry_t<V>(&entries)[N])
+{
+	lu_hash_static_table_t<V, N> table;
+	for (std::size_t i = 0; i < N; i++) {
+		table.insert(entries[i].key, entries[i].value);
+	}
+	return table;
+}
+
+#endif /** LU_LU_HASH_STATIC_INCLUDE_HPP_*/
@@ -0,0 +1,59 @@
+#include "luhash_static.hpp"
+
+/**
+ * @file luhash_static_check.cpp
+ * @brief Compile-time checks of luhash_static.hpp.
+ *
+ * Nothing here runs: every check is a static_assert on a table built by lu_hash_static_make, so
+ * building the project fails if the table cannot be laid out as a constant expression or if find
+ * stops matching lu_hash_table_find.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+namespace {
+
+struct lu_hash_static_check_person_t {
+	const char* name;
+	char		gender;
+};
+
+constexpr auto lu_hash_static_check_people = lu_hash_static_make<lu_hash_static_check_person_t>({
+	{ 1001, { "Zhang San", 'M' } },
+	{ 1002, { "Li Si", 'F' } },
+	{ 1003, { "Wang Wu", 'M' } },
+	{ -7, { "Zhao Liu", 'F' } },
+	{ 1002, { "Li Si", 'M' } },		// Listed twice, keeps its last value
+});
+
+static_assert(lu_hash_static_check_people.size() == 4, "a repeated key is counted once");
+static_assert(lu_hash_static_check_people.capacity == 16, "twice the entries, rounded up to a power of two");
+static_assert(lu_hash_static_check_people.find(1001)->gender == 'M', "find returns the value of the key");
+static_assert(lu_hash_static_check_people.find(1002)->gender == 'M', "a repeated key keeps its last value");
+static_assert(lu_hash_static_check_people.find(-7)->gender == 'F', "negative keys are found");
+static_assert(lu_hash_static_check_people.find(1004) == nullptr, "an absent key is nullptr");
+static_assert(!lu_hash_static_check_people.contains(0), "an absent key is not contained");
+
+// Filled to the half the capacity allows, so that lookups probe past occupied slots
+constexpr auto lu_hash_static_check_squares = lu_hash_static_make<int>({
+	{ 0, 0 }, { 1, 1 }, { 2, 4 }, { 3, 9 }, { 4, 16 }, { 5, 25 }, { 6, 36 }, { 7, 49 },
+});
+
+constexpr bool lu_hash_static_check_all_squares()
+{
+	for (int key = 0; key < 8; key++) {
+		const int* value = lu_hash_static_check_squares.find(key);
+		if (value == nullptr || *value != key * key) {
+			return false;
+		}
+	}
+	return lu_hash_static_check_squares.find(8) == nullptr && lu_hash_static_check_squares.find(-1) == nullptr;
+}
+
+static_assert(lu_hash_static_check_squares.capacity == 16, "eight entries fill half of sixteen slots");
+static_assert(lu_hash_static_check_all_squares(), "every key is found after probing, and no other");
+
+}
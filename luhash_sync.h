@@ -0,0 +1,283 @@
+#ifndef LU_LU_HASH_SYNC_INCLUDE_H_
+#define LU_LU_HASH_SYNC_INCLUDE_H_
+
+/**
+ * @file luhash_sync.h
+ * @brief Minimal portable synchronization primitives used by the concurrent hash table variants.
+ *
+ * The core hash table is single-threaded. The concurrent variants built on top of it only need a
+ * mutex, a thread-local storage qualifier, a handful of atomic operations, threads and a monotonic
+ * clock. They are mapped here onto the Win32 API (SRW locks, Interlocked*) on Windows and onto
+ * pthreads and the GCC/Clang __atomic builtins everywhere else, so that the rest of the code does
+ * not need any platform checks.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+// nanosleep and clock_gettime are POSIX, hidden by strict ISO C unless requested
+#if !defined(_WIN32) && defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/** Thread-local storage qualifier */
+#if defined(_MSC_VER)
+#define LU_THREAD_LOCAL __declspec(thread)
+#else
+#define LU_THREAD_LOCAL __thread
+#endif
+
+	/** Size assumed for a cache line when padding shared structures against false sharing */
+#define LU_CACHE_LINE_SIZE 64
+
+	/**
+	 * Portable non-recursive mutex. lu_mutex_trylock returns nonzero if it took the lock.
+	 */
+#if defined(_WIN32)
+	typedef SRWLOCK lu_mutex_t;
+
+	static inline void lu_mutex_init(lu_mutex_t* mutex) { InitializeSRWLock(mutex); }
+	static inline void lu_mutex_lock(lu_mutex_t* mutex) { AcquireSRWLockExclusive(mutex); }
+	static inline int lu_mutex_trylock(lu_mutex_t* mutex) { return TryAcquireSRWLockExclusive(mutex) != 0; }
+	static inline void lu_mutex_unlock(lu_mutex_t* mutex) { ReleaseSRWLockExclusive(mutex); }
+	static inline void lu_mutex_destroy(lu_mutex_t* mutex) { (void)mutex; }
+#else
+	typedef pthread_mutex_t lu_mutex_t;
+
+	static inline void lu_mutex_init(lu_mutex_t* mutex) { pthread_mutex_init(mutex, NULL); }
+	static inline void lu_mutex_lock(lu_mutex_t* mutex) { pthread_mutex_lock(mutex); }
+	static inline int lu_mutex_trylock(lu_mutex_t* mutex) { return pthread_mutex_trylock(mutex) == 0; }
+	static inline void lu_mutex_unlock(lu_mutex_t* mutex) { pthread_mutex_unlock(mutex); }
+	static inline void lu_mutex_destroy(lu_mutex_t* mutex) { pthread_mutex_destroy(mutex); }
+#endif
+
+	/**
+	 * Portable condition variable, waited on together with a locked lu_mutex_t. Waits may wake
+	 * spuriously, so callers re-check their condition in a loop.
+	 */
+#if defined(_WIN32)
+	typedef CONDITION_VARIABLE lu_cond_t;
+
+	static inline void lu_cond_init(lu_cond_t* cond) { InitializeConditionVariable(cond); }
+	static inline void lu_cond_wait(lu_cond_t* cond, lu_mutex_t* mutex) { SleepConditionVariableSRW(cond, mutex, INFINITE, 0); }
+	static inline void lu_cond_signal(lu_cond_t* cond) { WakeConditionVariable(cond); }
+	static inline void lu_cond_broadcast(lu_cond_t* cond) { WakeAllConditionVariable(cond); }
+	static inline void lu_cond_destroy(lu_cond_t* cond) { (void)cond; }
+#else
+	typedef pthread_cond_t lu_cond_t;
+
+	static inline void lu_cond_init(lu_cond_t* cond) { pthread_cond_init(cond, NULL); }
+	static inline void lu_cond_wait(lu_cond_t* cond, lu_mutex_t* mutex) { pthread_cond_wait(cond, mutex); }
+	static inline void lu_cond_signal(lu_cond_t* cond) { pthread_cond_signal(cond); }
+	static inline void lu_cond_broadcast(lu_cond_t* cond) { pthread_cond_broadcast(cond); }
+	static inline void lu_cond_destroy(lu_cond_t* cond) { pthread_cond_destroy(cond); }
+#endif
+
+	/**
+	 * Atomic operations on pointers and size_t values.
+	 *
+	 * Loads have acquire semantics, stores have release semantics, and read-modify-write operations
+	 * are sequentially consistent. On MSVC the loads and stores rely on the /volatile:ms semantics
+	 * that are the default for x86 and x64 targets.
+	 */
+#if defined(_MSC_VER)
+	static inline void* lu_atomic_load_ptr(void* volatile* ptr) { void* value = *ptr; _ReadWriteBarrier(); return value; }
+	static inline void lu_atomic_store_ptr(void* volatile* ptr, void* value) { _ReadWriteBarrier(); *ptr = value; }
+	static inline int lu_atomic_cas_ptr(void* volatile* ptr, void* expected, void* desired) {
+		return InterlockedCompareExchangePointer(ptr, desired, expected) == expected;
+	}
+	static inline size_t lu_atomic_load_size(volatile size_t* ptr) { size_t value = *ptr; _ReadWriteBarrier(); return value; }
+	static inline void lu_atomic_store_size(volatile size_t* ptr, size_t value) { _ReadWriteBarrier(); *ptr = value; }
+#if defined(_WIN64)
+	static inline size_t lu_atomic_fetch_add_size(volatile size_t* ptr, size_t delta) {
+		return (size_t)InterlockedExchangeAdd64((volatile LONG64*)ptr, (LONG64)delta);
+	}
+	static inline size_t lu_atomic_exchange_size(volatile size_t* ptr, size_t value) {
+		return (size_t)InterlockedExchange64((volatile LONG64*)ptr, (LONG64)value);
+	}
+	static inline int lu_atomic_cas_size(volatile size_t* ptr, size_t expected, size_t desired) {
+		return (size_t)InterlockedCompareExchange64((volatile LONG64*)ptr, (LONG64)desired, (LONG64)expected) == expected;
+	}
+#else
+	static inline size_t lu_atomic_fetch_add_size(volatile size_t* ptr, size_t delta) {
+		return (size_t)InterlockedExchangeAdd((volatile LONG*)ptr, (LONG)delta);
+	}
+	static inline size_t lu_atomic_exchange_size(volatile size_t* ptr, size_t value) {
+		return (size_t)InterlockedExchange((volatile LONG*)ptr, (LONG)value);
+	}
+	static inline int lu_atomic_cas_size(volatile size_t* ptr, size_t expected, size_t desired) {
+		return (size_t)InterlockedCompareExchange((volatile LONG*)ptr, (LONG)desired, (LONG)expected) == expected;
+	}
+#endif
+#else
+	static inline void* lu_atomic_load_ptr(void* volatile* ptr) { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+	static inline void lu_atomic_store_ptr(void* volatile* ptr, void* value) { __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+	static inline int lu_atomic_cas_ptr(void* volatile* ptr, void* expected, void* desired) {
+		return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	}
+	static inline size_t lu_atomic_load_size(volatile size_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+	static inline void lu_atomic_store_size(volatile size_t* ptr, size_t value) { __atomic_store_n(ptr, value, __ATOMIC_RELEASE); }
+	static inline size_t lu_atomic_fetch_add_size(volatile size_t* ptr, size_t delta) {
+		return __atomic_fetch_add(ptr, delta, __ATOMIC_SEQ_CST);
+	}
+	static inline size_t lu_atomic_exchange_size(volatile size_t* ptr, size_t value) {
+		return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+	}
+	static inline int lu_atomic_cas_size(volatile size_t* ptr, size_t expected, size_t desired) {
+		return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	}
+#endif
+
+	/** Full memory barrier, orders all loads and stores before it against all after it */
+#if defined(_MSC_VER)
+	static inline void lu_atomic_fence(void) { MemoryBarrier(); }
+#else
+	static inline void lu_atomic_fence(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+#endif
+
+	/**
+	 * Atomic operations on 64-bit integers, with the same ordering as those above. They are 64-bit
+	 * on 32-bit targets as well; there the load is a compare-exchange.
+	 */
+#if defined(_MSC_VER)
+#if defined(_WIN64)
+	static inline long long lu_atomic_load_i64(volatile long long* ptr) { long long value = *ptr; _ReadWriteBarrier(); return value; }
+#else
+	static inline long long lu_atomic_load_i64(volatile long long* ptr) { return InterlockedCompareExchange64(ptr, 0, 0); }
+#endif
+	static inline long long lu_atomic_fetch_add_i64(volatile long long* ptr, long long delta) {
+		return InterlockedExchangeAdd64(ptr, delta);
+	}
+	static inline int lu_atomic_cas_i64(volatile long long* ptr, long long expected, long long desired) {
+		return InterlockedCompareExchange64(ptr, desired, expected) == expected;
+	}
+#else
+	static inline long long lu_atomic_load_i64(volatile long long* ptr) { return __atomic_load_n(ptr, __ATOMIC_ACQUIRE); }
+	static inline long long lu_atomic_fetch_add_i64(volatile long long* ptr, long long delta) {
+		return __atomic_fetch_add(ptr, delta, __ATOMIC_SEQ_CST);
+	}
+	static inline int lu_atomic_cas_i64(volatile long long* ptr, long long expected, long long desired) {
+		return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	}
+#endif
+
+	/**
+	 * Portable threads. The entry point is wrapped so that the same signature works on both platforms.
+	 */
+	typedef void (*lu_thread_func_t)(void* arg);
+
+	typedef struct lu_thread_start_s {
+		lu_thread_func_t func;
+		void* arg;
+	}lu_thread_start_t;
+
+#if defined(_WIN32)
+	typedef HANDLE lu_thread_t;
+
+	static inline DWORD WINAPI lu_thread_trampoline(LPVOID param) {
+		lu_thread_start_t start = *(lu_thread_start_t*)param;
+		free(param);
+		start.func(start.arg);
+		return 0;
+	}
+
+	static inline void lu_thread_yield(void) { SwitchToThread(); }
+#else
+	typedef pthread_t lu_thread_t;
+
+	static inline void* lu_thread_trampoline(void* param) {
+		lu_thread_start_t start = *(lu_thread_start_t*)param;
+		free(param);
+		start.func(start.arg);
+		return NULL;
+	}
+
+	static inline void lu_thread_yield(void) { sched_yield(); }
+#endif
+
+	/**
+	 * @brief Starts a new thread running func(arg).
+	 * @return 0 on success, -1 if the thread could not be created.
+	 */
+	static inline int lu_thread_create(lu_thread_t* thread, lu_thread_func_t func, void* arg) {
+		lu_thread_start_t* start = (lu_thread_start_t*)malloc(sizeof(lu_thread_start_t));
+		if (start == NULL) {
+			return -1;
+		}
+		start->func = func;
+		start->arg = arg;
+#if defined(_WIN32)
+		*thread = CreateThread(NULL, 0, lu_thread_trampoline, start, 0, NULL);
+		if (*thread == NULL) {
+			free(start);
+			return -1;
+		}
+#else
+		if (pthread_create(thread, NULL, lu_thread_trampoline, start) != 0) {
+			free(start);
+			return -1;
+		}
+#endif
+		return 0;
+	}
+
+	/** @brief Waits for a thread started with lu_thread_create to finish. */
+	static inline void lu_thread_join(lu_thread_t thread) {
+#if defined(_WIN32)
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+#else
+		pthread_join(thread, NULL);
+#endif
+	}
+
+	/** @brief Suspends the calling thread for about the given number of milliseconds. */
+	static inline void lu_thread_sleep_ms(unsigned int milliseconds) {
+#if defined(_WIN32)
+		Sleep(milliseconds);
+#else
+		struct timespec ts;
+		ts.tv_sec = milliseconds / 1000;
+		ts.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
+#endif
+	}
+
+	/** @brief Returns a monotonic timestamp in nanoseconds. */
+	static inline unsigned long long lu_clock_ns(void) {
+#if defined(_WIN32)
+		LARGE_INTEGER counter, frequency;
+		QueryPerformanceCounter(&counter);
+		QueryPerformanceFrequency(&frequency);
+		return (unsigned long long)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL
+			+ (unsigned long long)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / (unsigned long long)frequency.QuadPart;
+#else
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+#endif
+	}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_SYNC_INCLUDE_H_*/
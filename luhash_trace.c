@@ -0,0 +1,183 @@
+#include "luhash_trace.h"
+
+/**
+ * @file luhash_trace.c
+ * @brief Sampling, the lock-free event ring and the USDT probe of the tracing hooks.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#ifdef LU_HASH_TRACE
+
+#if defined(LU_HASH_TRACE_USDT) && defined(__linux__)
+#include <sys/sdt.h>
+#endif
+
+/**
+ * Slot of the event ring. `sequence` is the write position of the event plus one once the event
+ * is complete, and `LU_HASH_TRACE_SLOT_BUSY` while a writer is filling the slot, so that a reader
+ * can tell a complete event from one that is being written or has been overwritten.
+ */
+typedef struct lu_hash_trace_slot_s {
+	volatile size_t		  sequence;
+	lu_hash_trace_event_t event;
+}lu_hash_trace_slot_t;
+
+#define LU_HASH_TRACE_SLOT_BUSY ((size_t)-1)
+
+volatile size_t lu_hash_trace_sample_every_ = 0;
+LU_THREAD_LOCAL size_t lu_hash_trace_countdown_ = 0;
+LU_THREAD_LOCAL size_t lu_hash_trace_steps_ = 0;
+
+static unsigned long long lu_hash_trace_min_cycles_ = 0;
+static lu_hash_trace_func_t lu_hash_trace_callback_ = NULL;
+static void* lu_hash_trace_ctx_ = NULL;
+
+static lu_hash_trace_slot_t lu_hash_trace_ring_[LU_HASH_TRACE_RING_SIZE];
+static volatile size_t lu_hash_trace_head_ = 0;		// Next write position, shared by all writers
+static size_t lu_hash_trace_tail_ = 0;				// Next read position of the single reader
+static volatile size_t lu_hash_trace_dropped_ = 0;	// Events overwritten before they were drained
+
+/**
+ * Turns tracing on or off and sets what is recorded.
+ *
+ * Should be called while no traced operation is running, typically once at startup.
+ *
+ * @param sample_every Time one operation in this many per thread, 1 for all of them, 0 to stop tracing.
+ * @param min_cycles Record only sampled operations that took at least this many cycles.
+ * @param callback Called for every recorded event in addition to the ring buffer, may be NULL.
+ * @param ctx Context pointer passed to the callback.
+ *
+ * Usage example:
+ *     lu_hash_trace_configure(1, 20000, NULL, NULL); // Every operation slower than 20000 cycles
+ */
+void lu_hash_trace_configure(size_t sample_every, unsigned long long min_cycles, lu_hash_trace_func_t callback, void* ctx)
+{
+	lu_hash_trace_min_cycles_ = min_cycles;
+	lu_hash_trace_callback_ = callback;
+	lu_hash_trace_ctx_ = ctx;
+	lu_atomic_store_size(&lu_hash_trace_sample_every_, sample_every);
+}
+
+/**
+ * @brief Finishes a sampled operation: records the event if it was slow enough.
+ *
+ * Writers take a position with one atomic increment and never wait; when the reader falls behind,
+ * the oldest events are overwritten. The slot itself is claimed with a compare-and-swap on its
+ * sequence, so that a writer that has lapped another one can never interleave with it: whichever
+ * finds the slot busy, or already holding a newer event, drops its event. The drain counts the
+ * position as dropped once the ring has moved past it.
+ */
+void lu_hash_trace_record(const lu_hash_trace_scope_t* scope, lu_hash_trace_op_t op, const lu_hash_table_t* table, int key, size_t bucket, size_t steps)
+{
+	unsigned long long cycles = lu_hash_trace_cycles() - scope->start;
+	if (cycles < lu_hash_trace_min_cycles_) {
+		return;
+	}
+
+	lu_hash_trace_event_t event;
+	event.cycles = cycles;
+	event.table = table;
+	event.bucket = bucket;
+	event.steps = steps;
+	event.key = key;
+	event.op = op;
+
+	size_t position = lu_atomic_fetch_add_size(&lu_hash_trace_head_, 1);
+	lu_hash_trace_slot_t* slot = &lu_hash_trace_ring_[position & (LU_HASH_TRACE_RING_SIZE - 1)];
+	size_t sequence = lu_atomic_load_size(&slot->sequence);
+	if (sequence != LU_HASH_TRACE_SLOT_BUSY && sequence <= position
+		&& lu_atomic_cas_size(&slot->sequence, sequence, LU_HASH_TRACE_SLOT_BUSY)) {
+		slot->event = event;
+		lu_atomic_store_size(&slot->sequence, position + 1);
+	}
+
+#if defined(LU_HASH_TRACE_USDT) && defined(__linux__)
+	DTRACE_PROBE6(luhash, op, (int)op, table, bucket, steps, cycles, key);
+#endif
+
+	if (lu_hash_trace_callback_) {
+		lu_hash_trace_callback_(&event, lu_hash_trace_ctx_);
+	}
+}
+
+/**
+ * Moves recorded events out of the ring buffer, oldest first.
+ *
+ * Only one thread may drain at a time. Events that were overwritten or dropped before they could
+ * be read are counted by lu_hash_trace_dropped; an event that is still being written stops the
+ * drain early and is returned by the next call. So does a position whose writer dropped its event
+ * because an older writer still held the slot, until the ring has been lapped past it.
+ *
+ * @param events Receives the events.
+ * @param max_events The capacity of `events`.
+ * @return The number of events stored in `events`.
+ */
+size_t lu_hash_trace_drain(lu_hash_trace_event_t* events, size_t max_events)
+{
+	size_t count = 0;
+	while (count < max_events) {
+		size_t head = lu_atomic_load_size(&lu_hash_trace_head_);
+		if (lu_hash_trace_tail_ == head) {
+			break;
+		}
+		// Writers have lapped the reader, skip to the oldest event that can still be in the ring
+		if (head - lu_hash_trace_tail_ > LU_HASH_TRACE_RING_SIZE) {
+			lu_atomic_fetch_add_size(&lu_hash_trace_dropped_, head - lu_hash_trace_tail_ - LU_HASH_TRACE_RING_SIZE);
+			lu_hash_trace_tail_ = head - LU_HASH_TRACE_RING_SIZE;
+		}
+
+		lu_hash_trace_slot_t* slot = &lu_hash_trace_ring_[lu_hash_trace_tail_ & (LU_HASH_TRACE_RING_SIZE - 1)];
+		size_t sequence = lu_atomic_load_size(&slot->sequence);
+		if (sequence == LU_HASH_TRACE_SLOT_BUSY) {
+			break; // Being written
+		}
+		if (sequence != lu_hash_trace_tail_ + 1) {
+			if (sequence > lu_hash_trace_tail_ + 1) {
+				lu_atomic_fetch_add_size(&lu_hash_trace_dropped_, 1); // Overwritten by a later event
+				lu_hash_trace_tail_++;
+				continue;
+			}
+			break; // Claimed but not written yet
+		}
+
+		events[count] = slot->event;
+		lu_atomic_fence();
+		if (lu_atomic_load_size(&slot->sequence) != sequence) {
+			lu_atomic_fetch_add_size(&lu_hash_trace_dropped_, 1); // Overwritten while it was copied
+		}
+		else {
+			count++;
+		}
+		lu_hash_trace_tail_++;
+	}
+	return count;
+}
+
+/**
+ * @brief Returns the number of events overwritten before they were drained.
+ */
+size_t lu_hash_trace_dropped(void)
+{
+	return lu_atomic_load_size(&lu_hash_trace_dropped_);
+}
+
+/**
+ * @brief Returns a printable name of a traced operation.
+ */
+const char* lu_hash_trace_op_name(lu_hash_trace_op_t op)
+{
+	switch (op) {
+	case LU_HASH_TRACE_INSERT:	return "insert";
+	case LU_HASH_TRACE_FIND:	return "find";
+	case LU_HASH_TRACE_DELETE:	return "delete";
+	case LU_HASH_TRACE_RESIZE:	return "resize";
+	case LU_HASH_TRACE_TREEIFY:	return "treeify";
+	}
+	return "unknown";
+}
+
+#endif // LU_HASH_TRACE
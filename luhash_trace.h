@@ -0,0 +1,137 @@
+#ifndef LU_LU_HASH_TRACE_INCLUDE_H_
+#define LU_LU_HASH_TRACE_INCLUDE_H_
+
+/**
+ * @file luhash_trace.h
+ * @brief Optional per-operation tracing of lu_hash_table_t.
+ *
+ * Aggregate counters tell that a table is slow, not which requests and which buckets are. With
+ * `LU_HASH_TRACE` defined, insert, find, delete, resize and the conversion of a bucket to a tree
+ * record one event each: the operation, table, key, bucket index, the number of nodes walked (the
+ * chain length or tree depth) and the elapsed CPU cycles. Events go to a lock-free ring buffer
+ * that a monitoring thread drains with lu_hash_trace_drain and, optionally, to a callback.
+ *
+ * Recording every operation would cost more than the operations, so only one operation in
+ * `sample_every` (counted per thread) is timed, and only those taking at least `min_cycles` are
+ * recorded; a slow-request hunt typically samples every operation and keeps only the outliers.
+ * Tracing is off until lu_hash_trace_configure is called.
+ *
+ * With `LU_HASH_TRACE_USDT` also defined on Linux, every recorded event fires the USDT probe
+ * `luhash:op` (arguments: op, table, bucket, steps, cycles, key) for perf and bpftrace; this
+ * needs <sys/sdt.h> from systemtap.
+ *
+ * Without `LU_HASH_TRACE` the trace points expand to nothing and the table code is unchanged.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+
+#ifdef LU_HASH_TRACE
+
+#include "luhash_sync.h"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_TRACE_RING_SIZE	4096	// Events kept in the ring buffer, a power of two
+
+	/** Traced operations */
+	typedef enum lu_hash_trace_op_u {
+		LU_HASH_TRACE_INSERT,	// lu_hash_table_insert and lu_hash_table_insert_ttl
+		LU_HASH_TRACE_FIND,		// lu_hash_table_find
+		LU_HASH_TRACE_DELETE,	// lu_hash_table_delete
+		LU_HASH_TRACE_RESIZE,	// Resize or reseed; bucket is the new bucket count, steps the entries moved
+		LU_HASH_TRACE_TREEIFY,	// Bucket converted to a red-black tree; steps is its size
+	}lu_hash_trace_op_t;
+
+	/**
+	 * Structure representing one traced operation.
+	 */
+	typedef struct lu_hash_trace_event_s {
+		unsigned long long cycles;	// Elapsed time stamp counter ticks (nanoseconds where there is none)
+		const lu_hash_table_t* table;
+		size_t			   bucket;	// Bucket index the key maps to
+		size_t			   steps;	// Nodes visited: list nodes compared or tree levels descended
+		int				   key;
+		lu_hash_trace_op_t op;
+	}lu_hash_trace_event_t;
+
+	/** Callback invoked for every recorded event, on the thread that ran the operation */
+	typedef void (*lu_hash_trace_func_t)(const lu_hash_trace_event_t* event, void* ctx);
+
+	/**
+	 * State of one traced operation, kept on the stack of the operation.
+	 */
+	typedef struct lu_hash_trace_scope_s {
+		unsigned long long start;		// Counter at the start, 0 if the operation is not sampled
+		size_t			   saved_steps;	// Steps of the enclosing operation, restored at the end
+	}lu_hash_trace_scope_t;
+
+	extern volatile size_t lu_hash_trace_sample_every_;		// 0 while tracing is off
+	extern LU_THREAD_LOCAL size_t lu_hash_trace_countdown_;	// Operations until the next sample
+	extern LU_THREAD_LOCAL size_t lu_hash_trace_steps_;		// Nodes visited by the current operation
+
+	/** @brief Reads the time stamp counter, or the monotonic clock where there is none. */
+	static inline unsigned long long lu_hash_trace_cycles(void) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		return __rdtsc();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		return __builtin_ia32_rdtsc();
+#else
+		return lu_clock_ns();
+#endif
+	}
+
+	/** @brief Starts a traced operation, deciding whether it is sampled. */
+	static inline void lu_hash_trace_begin(lu_hash_trace_scope_t* scope) {
+		scope->saved_steps = lu_hash_trace_steps_;
+		lu_hash_trace_steps_ = 0;
+		scope->start = 0;
+		size_t every = lu_hash_trace_sample_every_;
+		if (every != 0 && ++lu_hash_trace_countdown_ >= every) {
+			lu_hash_trace_countdown_ = 0;
+			scope->start = lu_hash_trace_cycles() | 1;
+		}
+	}
+
+	/**Function definition*/
+	void lu_hash_trace_configure(size_t sample_every, unsigned long long min_cycles, lu_hash_trace_func_t callback, void* ctx);
+	void lu_hash_trace_record(const lu_hash_trace_scope_t* scope, lu_hash_trace_op_t op, const lu_hash_table_t* table, int key, size_t bucket, size_t steps);
+	size_t lu_hash_trace_drain(lu_hash_trace_event_t* events, size_t max_events);
+	size_t lu_hash_trace_dropped(void);
+	const char* lu_hash_trace_op_name(lu_hash_trace_op_t op);
+
+	/** Trace points placed in the table code */
+#define LU_HASH_TRACE_BEGIN()		lu_hash_trace_scope_t lu_hash_trace_scope_; lu_hash_trace_begin(&lu_hash_trace_scope_)
+#define LU_HASH_TRACE_STEP()		(lu_hash_trace_steps_++)
+#define LU_HASH_TRACE_END_STEPS(op,table,key,bucket,steps)										\
+	do {																						\
+		if (lu_hash_trace_scope_.start) {														\
+			lu_hash_trace_record(&lu_hash_trace_scope_, op, table, key, (size_t)(bucket), (size_t)(steps)); \
+		}																						\
+		lu_hash_trace_steps_ = lu_hash_trace_scope_.saved_steps;								\
+	} while (0)
+#define LU_HASH_TRACE_END(op,table,key,bucket)	LU_HASH_TRACE_END_STEPS(op,table,key,bucket,lu_hash_trace_steps_)
+
+#ifdef __cplusplus
+}
+#endif
+
+#else
+
+#define LU_HASH_TRACE_BEGIN()								((void)0)
+#define LU_HASH_TRACE_STEP()								((void)0)
+#define LU_HASH_TRACE_END_STEPS(op,table,key,bucket,steps)	((void)0)
+#define LU_HASH_TRACE_END(op,table,key,bucket)				((void)0)
+
+#endif // LU_HASH_TRACE
+
+#endif /** LU_LU_HASH_TRACE_INCLUDE_H_*/
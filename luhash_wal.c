@@ -0,0 +1,628 @@
+#include "luhash_wal.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @file luhash_wal.c
+ * @brief Write-ahead log: record format, group commit, replay and compaction into snapshots.
+ *
+ * Both files start with an 8-byte magic followed by records. All integers are little-endian.
+ *   insert:   op=1 (1 byte), key (4), expire_at (8), value size (4), value bytes, checksum (4)
+ *   delete:   op=2 (1 byte), key (4), checksum (4)
+ *   end:      op=3 (1 byte), record count (8), checksum (4) -- closes a complete snapshot
+ * The checksum is FNV-1a over the preceding bytes of the record. Replay stops at the first record
+ * that is cut short or fails its checksum, which is where a crash interrupted the last write.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#define LU_HASH_WAL_MAGIC			"LUHWAL01"
+#define LU_HASH_WAL_SNAPSHOT_MAGIC	"LUHSNP01"
+#define LU_HASH_WAL_MAGIC_BYTES		8
+#define LU_HASH_WAL_OP_INSERT		1
+#define LU_HASH_WAL_OP_DELETE		2
+#define LU_HASH_WAL_OP_END			3
+#define LU_HASH_WAL_MAX_VALUE_BYTES	0x40000000u	// Larger sizes can only come from a damaged record
+
+/** State of the snapshot writer passed through lu_hash_table_foreach_entry */
+typedef struct lu_hash_wal_snapshot_writer_s {
+	lu_hash_wal_t* wal;
+	FILE*		   file;
+	size_t		   count;	// Records written so far
+	int			   failed;	// Set once a write failed
+}lu_hash_wal_snapshot_writer_t;
+
+static void lu_hash_wal_record(lu_hash_write_op_t op, int key, void* value, unsigned long long expire_at, void* ctx);
+static size_t lu_hash_wal_encode(lu_hash_wal_t* wal, int op, int key, void* value, unsigned long long expire_at);
+static void lu_hash_wal_snapshot_entry(int key, void* value, unsigned long long expire_at, void* ctx);
+static int lu_hash_wal_replay(lu_hash_wal_t* wal, const char* path, const char* magic, int* torn);
+static void lu_hash_wal_apply(lu_hash_wal_t* wal, int op, int key, void* value, unsigned long long expire_at);
+static void lu_hash_wal_committer(void* arg);
+static void lu_hash_wal_fail(lu_hash_wal_t* wal, const char* what);
+static int lu_hash_wal_fsync(FILE* file);
+static int lu_hash_wal_rename(const char* from, const char* to);
+static char* lu_hash_wal_concat(const char* path, const char* suffix);
+
+/** @brief FNV-1a checksum of a record. */
+static unsigned int lu_hash_wal_checksum(const unsigned char* data, size_t size)
+{
+	unsigned int h = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		h = (h ^ data[i]) * 16777619u;
+	}
+	return h;
+}
+
+static inline void lu_hash_wal_put32(unsigned char* p, unsigned int v)
+{
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+static inline void lu_hash_wal_put64(unsigned char* p, unsigned long long v)
+{
+	lu_hash_wal_put32(p, (unsigned int)v);
+	lu_hash_wal_put32(p + 4, (unsigned int)(v >> 32));
+}
+
+static inline unsigned int lu_hash_wal_get32(const unsigned char* p)
+{
+	return (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static inline unsigned long long lu_hash_wal_get64(const unsigned char* p)
+{
+	return (unsigned long long)lu_hash_wal_get32(p) | (unsigned long long)lu_hash_wal_get32(p + 4) << 32;
+}
+
+/**
+ * Opens the write-ahead log of a table, restores the table from it and starts logging.
+ *
+ * The snapshot `<path>.snap` is loaded first if it exists, then the records of `<path>` are
+ * replayed. Entries whose TTL ran out while the table was down are not restored. If the last
+ * record was cut short by a crash, the log is compacted right away so that new records do not
+ * follow a damaged one. From then on every change of the table is appended to the log until
+ * lu_hash_wal_close.
+ *
+ * The table should be empty, apart from its settings (capacity, clock, callbacks), which are not
+ * logged and have to be set the same way on every start before the log is opened.
+ *
+ * @param table The table to restore and log.
+ * @param path The log file. It is created if it does not exist.
+ * @param options Settings of the log, or NULL for the defaults.
+ * @return A pointer to the log, or NULL if the files could not be read or created
+ *         (lu_hash_erron_global_ is set to LU_ERROR_IO).
+ *
+ * Usage example:
+ *     lu_hash_table_t* table = lu_hash_table_init(1024);
+ *     lu_hash_wal_t* wal = lu_hash_wal_open(table, "table.wal", NULL);
+ *     lu_hash_table_insert(table, 42, value); // Logged
+ *     lu_hash_wal_close(wal);
+ */
+lu_hash_wal_t* lu_hash_wal_open(lu_hash_table_t* table, const char* path, const lu_hash_wal_options_t* options)
+{
+	lu_hash_wal_t* wal = (lu_hash_wal_t*)LU_MM_CALLOC(1, sizeof(lu_hash_wal_t));
+	wal->table = table;
+	if (options != NULL) {
+		wal->options = *options;
+	}
+	else {
+		wal->options.sync = LU_HASH_WAL_SYNC_GROUP;
+		wal->options.group_commit_ms = LU_HASH_WAL_DEFAULT_GROUP_COMMIT_MS;
+		wal->options.compact_bytes = LU_HASH_WAL_DEFAULT_COMPACT_BYTES;
+	}
+	if (wal->options.group_commit_ms == 0) {
+		wal->options.group_commit_ms = LU_HASH_WAL_DEFAULT_GROUP_COMMIT_MS;
+	}
+	wal->path = lu_hash_wal_concat(path, "");
+	wal->snapshot_path = lu_hash_wal_concat(path, ".snap");
+	wal->error = LU_OK;
+	lu_mutex_init(&wal->lock);
+	lu_mutex_init(&wal->sync_lock);
+
+	int torn = 0;
+	int status = lu_hash_wal_replay(wal, wal->snapshot_path, LU_HASH_WAL_SNAPSHOT_MAGIC, &torn);
+	if (status == LU_OK && torn) {
+		// Snapshots are renamed into place only when complete, so this one was damaged later
+		status = LU_ERROR_IO;
+	}
+	if (status == LU_OK) {
+		status = lu_hash_wal_replay(wal, wal->path, LU_HASH_WAL_MAGIC, &torn);
+	}
+
+	if (status == LU_OK) {
+		wal->file = fopen(wal->path, "ab");
+		if (wal->file == NULL) {
+			status = LU_ERROR_IO;
+		}
+	}
+	if (status == LU_OK) {
+		fseek(wal->file, 0, SEEK_END);
+		wal->log_bytes = (size_t)ftell(wal->file);
+		if (torn || wal->log_bytes < LU_HASH_WAL_MAGIC_BYTES) {
+			status = lu_hash_wal_compact(wal);
+		}
+	}
+
+	if (status != LU_OK) {
+#ifdef LU_HASH_DEBUG
+		printf("Error: failed to open the write-ahead log %s\n", path);
+#endif // LU_HASH_DEBUG
+		lu_hash_erron_global_ = LU_ERROR_IO;
+		if (wal->file != NULL) {
+			fclose(wal->file);
+		}
+		lu_mutex_destroy(&wal->lock);
+		lu_mutex_destroy(&wal->sync_lock);
+		LU_MM_FREE(wal->record);
+		LU_MM_FREE(wal->path);
+		LU_MM_FREE(wal->snapshot_path);
+		LU_MM_FREE(wal);
+		return NULL;
+	}
+
+	if (wal->options.sync == LU_HASH_WAL_SYNC_GROUP) {
+		wal->committer_running = lu_thread_create(&wal->committer, lu_hash_wal_committer, wal) == 0;
+		if (!wal->committer_running) {
+			wal->options.sync = LU_HASH_WAL_SYNC_ALWAYS;
+		}
+	}
+	lu_hash_table_set_write_callback(table, lu_hash_wal_record, wal);
+	return wal;
+}
+
+/**
+ * @brief Write callback of the table: appends one record to the log.
+ *
+ * A compaction that is due runs before the record is written, so the snapshot covers everything
+ * up to the previous record and the new log starts with this one.
+ */
+static void lu_hash_wal_record(lu_hash_write_op_t op, int key, void* value, unsigned long long expire_at, void* ctx)
+{
+	lu_hash_wal_t* wal = (lu_hash_wal_t*)ctx;
+	if (wal->error != LU_OK) {
+		return;
+	}
+	if (wal->options.compact_bytes != 0 && wal->log_bytes >= wal->options.compact_bytes) {
+		if (lu_hash_wal_compact(wal) != LU_OK) {
+			return;
+		}
+	}
+
+	size_t size = op == LU_HASH_WRITE_INSERT
+		? lu_hash_wal_encode(wal, LU_HASH_WAL_OP_INSERT, key, value, expire_at)
+		: lu_hash_wal_encode(wal, LU_HASH_WAL_OP_DELETE, key, NULL, 0);
+
+	lu_mutex_lock(&wal->lock);
+	if (fwrite(wal->record, 1, size, wal->file) != size) {
+		lu_hash_wal_fail(wal, "write");
+	}
+	else if (wal->options.sync != LU_HASH_WAL_SYNC_GROUP && fflush(wal->file) != 0) {
+		lu_hash_wal_fail(wal, "flush");
+	}
+	else if (wal->options.sync == LU_HASH_WAL_SYNC_ALWAYS && lu_hash_wal_fsync(wal->file) != LU_OK) {
+		lu_hash_wal_fail(wal, "sync");
+	}
+	wal->log_bytes += size;
+	wal->dirty = wal->options.sync != LU_HASH_WAL_SYNC_ALWAYS;
+	lu_mutex_unlock(&wal->lock);
+}
+
+/**
+ * @brief Encodes a record into wal->record and returns its size.
+ */
+static size_t lu_hash_wal_encode(lu_hash_wal_t* wal, int op, int key, void* value, unsigned long long expire_at)
+{
+	const void* data = NULL;
+	size_t data_size = 0;
+	unsigned char pointer[8];
+	if (op == LU_HASH_WAL_OP_INSERT) {
+		if (wal->options.encode) {
+			data_size = wal->options.encode(value, &data, wal->options.codec_ctx);
+		}
+		else {
+			lu_hash_wal_put64(pointer, (unsigned long long)(size_t)value);
+			data = pointer;
+			data_size = sizeof(pointer);
+		}
+	}
+
+	size_t size = op == LU_HASH_WAL_OP_INSERT ? 1 + 4 + 8 + 4 + data_size + 4 : 1 + 4 + 4;
+	if (size > wal->record_capacity) {
+		LU_MM_FREE(wal->record);
+		wal->record_capacity = size * 2;
+		wal->record = (unsigned char*)LU_MM_MALLOC(wal->record_capacity);
+	}
+
+	unsigned char* p = wal->record;
+	*p++ = (unsigned char)op;
+	lu_hash_wal_put32(p, (unsigned int)key);
+	p += 4;
+	if (op == LU_HASH_WAL_OP_INSERT) {
+		lu_hash_wal_put64(p, expire_at);
+		lu_hash_wal_put32(p + 8, (unsigned int)data_size);
+		p += 12;
+		if (data_size != 0) {
+			memcpy(p, data, data_size);
+			p += data_size;
+		}
+	}
+	lu_hash_wal_put32(p, lu_hash_wal_checksum(wal->record, (size_t)(p - wal->record)));
+	return size;
+}
+
+/**
+ * Forces every record written so far to stable storage.
+ *
+ * Called periodically by the group commit thread; callers can use it to make a particular change
+ * durable without waiting for the next group commit.
+ *
+ * @param wal A pointer to the log.
+ * @return LU_OK, or LU_ERROR_IO if a write or sync of the log has failed.
+ */
+int lu_hash_wal_sync(lu_hash_wal_t* wal)
+{
+	// sync_lock keeps a compaction from swapping the file while it is synced outside `lock`
+	lu_mutex_lock(&wal->sync_lock);
+	lu_mutex_lock(&wal->lock);
+	int dirty = wal->dirty;
+	wal->dirty = 0;
+	if (wal->error == LU_OK && dirty && fflush(wal->file) != 0) {
+		lu_hash_wal_fail(wal, "flush");
+	}
+	int status = wal->error;
+	lu_mutex_unlock(&wal->lock);
+
+	// Appends continue while the disk catches up, they only wait for the flush above
+	if (status == LU_OK && dirty && lu_hash_wal_fsync(wal->file) != LU_OK) {
+		lu_mutex_lock(&wal->lock);
+		lu_hash_wal_fail(wal, "sync");
+		status = wal->error;
+		lu_mutex_unlock(&wal->lock);
+	}
+	lu_mutex_unlock(&wal->sync_lock);
+	return status;
+}
+
+/**
+ * @brief Body of the group commit thread.
+ */
+static void lu_hash_wal_committer(void* arg)
+{
+	lu_hash_wal_t* wal = (lu_hash_wal_t*)arg;
+	while (!lu_atomic_load_size(&wal->stop)) {
+		lu_thread_sleep_ms(wal->options.group_commit_ms);
+		lu_hash_wal_sync(wal);
+	}
+}
+
+/**
+ * Writes the whole table to a new snapshot and empties the log.
+ *
+ * The snapshot is written to `<path>.snap.tmp`, synced and renamed over the previous snapshot,
+ * and only then is the log truncated. A crash at any point leaves either the old snapshot with the
+ * full log, or the new snapshot with a log whose records it already contains; replaying those
+ * again is harmless. Runs on the thread that changes the table and blocks it for the time it
+ * takes to write the table out.
+ *
+ * @param wal A pointer to the log.
+ * @return LU_OK, or LU_ERROR_IO if the snapshot could not be written or the log not truncated.
+ */
+int lu_hash_wal_compact(lu_hash_wal_t* wal)
+{
+	if (wal->error != LU_OK) {
+		return wal->error;
+	}
+
+	char* temp_path = lu_hash_wal_concat(wal->snapshot_path, ".tmp");
+	lu_hash_wal_snapshot_writer_t writer;
+	writer.wal = wal;
+	writer.count = 0;
+	writer.failed = 0;
+	writer.file = fopen(temp_path, "wb");
+	if (writer.file == NULL) {
+		LU_MM_FREE(temp_path);
+		lu_mutex_lock(&wal->lock);
+		lu_hash_wal_fail(wal, "create snapshot");
+		lu_mutex_unlock(&wal->lock);
+		return wal->error;
+	}
+
+	writer.failed = fwrite(LU_HASH_WAL_SNAPSHOT_MAGIC, 1, LU_HASH_WAL_MAGIC_BYTES, writer.file) != LU_HASH_WAL_MAGIC_BYTES;
+	lu_hash_table_foreach_entry(wal->table, lu_hash_wal_snapshot_entry, &writer);
+
+	unsigned char end[1 + 8 + 4];
+	end[0] = LU_HASH_WAL_OP_END;
+	lu_hash_wal_put64(end + 1, writer.count);
+	lu_hash_wal_put32(end + 9, lu_hash_wal_checksum(end, 9));
+	if (fwrite(end, 1, sizeof(end), writer.file) != sizeof(end) || fflush(writer.file) != 0
+		|| lu_hash_wal_fsync(writer.file) != LU_OK) {
+		writer.failed = 1;
+	}
+	if (fclose(writer.file) != 0) {
+		writer.failed = 1;
+	}
+	if (!writer.failed) {
+		writer.failed = lu_hash_wal_rename(temp_path, wal->snapshot_path) != LU_OK;
+	}
+	if (writer.failed) {
+		remove(temp_path);
+	}
+	LU_MM_FREE(temp_path);
+
+	// Start the log over; records written so far are covered by the snapshot
+	lu_mutex_lock(&wal->sync_lock);
+	lu_mutex_lock(&wal->lock);
+	if (writer.failed) {
+		lu_hash_wal_fail(wal, "write snapshot");
+	}
+	else {
+		fclose(wal->file);
+		wal->file = fopen(wal->path, "wb");
+		if (wal->file == NULL) {
+			lu_hash_wal_fail(wal, "truncate");
+		}
+		else if (fwrite(LU_HASH_WAL_MAGIC, 1, LU_HASH_WAL_MAGIC_BYTES, wal->file) != LU_HASH_WAL_MAGIC_BYTES
+			|| fflush(wal->file) != 0 || lu_hash_wal_fsync(wal->file) != LU_OK) {
+			lu_hash_wal_fail(wal, "truncate");
+		}
+		wal->log_bytes = LU_HASH_WAL_MAGIC_BYTES;
+		wal->dirty = 0;
+		wal->compactions++;
+	}
+	int status = wal->error;
+	lu_mutex_unlock(&wal->lock);
+	lu_mutex_unlock(&wal->sync_lock);
+	return status;
+}
+
+/**
+ * @brief lu_hash_table_foreach_entry callback that writes one insert record into a snapshot.
+ */
+static void lu_hash_wal_snapshot_entry(int key, void* value, unsigned long long expire_at, void* ctx)
+{
+	lu_hash_wal_snapshot_writer_t* writer = (lu_hash_wal_snapshot_writer_t*)ctx;
+	if (writer->failed) {
+		return;
+	}
+	size_t size = lu_hash_wal_encode(writer->wal, LU_HASH_WAL_OP_INSERT, key, value, expire_at);
+	if (fwrite(writer->wal->record, 1, size, writer->file) != size) {
+		writer->failed = 1;
+	}
+	writer->count++;
+}
+
+/**
+ * @brief Applies the records of a log or snapshot file to the table.
+ *
+ * @param wal The log whose table is restored.
+ * @param path The file to read. A missing file counts as empty.
+ * @param magic The magic the file has to start with.
+ * @param torn Receives 1 if the file ends in a record that is incomplete or damaged, or (for a
+ *        snapshot) lacks its end record.
+ * @return LU_OK, or LU_ERROR_IO if the file exists but is not a log of this kind.
+ */
+static int lu_hash_wal_replay(lu_hash_wal_t* wal, const char* path, const char* magic, int* torn)
+{
+	*torn = 0;
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		return LU_OK;
+	}
+
+	char header[LU_HASH_WAL_MAGIC_BYTES];
+	size_t header_size = fread(header, 1, LU_HASH_WAL_MAGIC_BYTES, file);
+	if (header_size < LU_HASH_WAL_MAGIC_BYTES) {
+		// A crash while the log was being started over; its records are in the snapshot
+		fclose(file);
+		*torn = header_size != 0;
+		return LU_OK;
+	}
+	if (memcmp(header, magic, LU_HASH_WAL_MAGIC_BYTES) != 0) {
+		fclose(file);
+		return LU_ERROR_IO;
+	}
+
+	int is_snapshot = strcmp(magic, LU_HASH_WAL_SNAPSHOT_MAGIC) == 0;
+	int ended = 0;
+	unsigned char fixed[1 + 4 + 8 + 4];
+	unsigned char* data = NULL;
+	size_t data_capacity = 0;
+
+	while (!ended) {
+		if (fread(fixed, 1, 1, file) != 1) {
+			*torn = is_snapshot; // End of file, regular for a log
+			break;
+		}
+		int op = fixed[0];
+		size_t fixed_size = op == LU_HASH_WAL_OP_INSERT ? 17 : op == LU_HASH_WAL_OP_DELETE ? 5 : op == LU_HASH_WAL_OP_END ? 9 : 0;
+		if (fixed_size == 0 || fread(fixed + 1, 1, fixed_size - 1, file) != fixed_size - 1) {
+			*torn = 1;
+			break;
+		}
+
+		size_t data_size = op == LU_HASH_WAL_OP_INSERT ? lu_hash_wal_get32(fixed + 13) : 0;
+		if (data_size > LU_HASH_WAL_MAX_VALUE_BYTES) {
+			*torn = 1;
+			break;
+		}
+		// The checksum covers the fixed part and the value, so both are kept in one buffer
+		if (fixed_size + data_size + 4 > data_capacity) {
+			LU_MM_FREE(data);
+			data_capacity = (fixed_size + data_size + 4) * 2;
+			data = (unsigned char*)LU_MM_MALLOC(data_capacity);
+		}
+		memcpy(data, fixed, fixed_size);
+		if (fread(data + fixed_size, 1, data_size + 4, file) != data_size + 4
+			|| lu_hash_wal_get32(data + fixed_size + data_size) != lu_hash_wal_checksum(data, fixed_size + data_size)) {
+			*torn = 1;
+			break;
+		}
+
+		int key = (int)lu_hash_wal_get32(data + 1);
+		if (op == LU_HASH_WAL_OP_INSERT) {
+			void* value;
+			if (wal->options.decode) {
+				value = wal->options.decode(data + fixed_size, data_size, wal->options.codec_ctx);
+			}
+			else {
+				value = data_size == 8 ? (void*)(size_t)lu_hash_wal_get64(data + fixed_size) : NULL;
+			}
+			lu_hash_wal_apply(wal, op, key, value, lu_hash_wal_get64(data + 5));
+			wal->replayed++;
+		}
+		else if (op == LU_HASH_WAL_OP_DELETE) {
+			lu_hash_wal_apply(wal, op, key, NULL, 0);
+			wal->replayed++;
+		}
+		else {
+			ended = 1;
+		}
+	}
+
+	LU_MM_FREE(data);
+	fclose(file);
+	return LU_OK;
+}
+
+/**
+ * @brief Applies one replayed insert or delete to the table.
+ */
+static void lu_hash_wal_apply(lu_hash_wal_t* wal, int op, int key, void* value, unsigned long long expire_at)
+{
+	lu_hash_table_t* table = wal->table;
+	if (wal->options.release) {
+		void* old_value = lu_hash_table_find(table, key);
+		if (old_value != NULL) {
+			wal->options.release(old_value, wal->options.codec_ctx);
+		}
+	}
+
+	unsigned long long now = expire_at != 0 ? table->clock() : 0;
+	if (op == LU_HASH_WAL_OP_DELETE || (expire_at != 0 && expire_at <= now)) {
+		lu_hash_table_delete(table, key);
+		if (op == LU_HASH_WAL_OP_INSERT && wal->options.release && value != NULL) {
+			wal->options.release(value, wal->options.codec_ctx); // Expired while the table was down
+		}
+	}
+	else if (expire_at != 0) {
+		unsigned long long ttl = expire_at - now;
+		lu_hash_table_insert_ttl(table, key, value, ttl > LU_HASH_EXPIRE_MAX ? LU_HASH_EXPIRE_MAX : (unsigned int)ttl);
+	}
+	else {
+		lu_hash_table_insert(table, key, value);
+	}
+}
+
+/**
+ * Syncs and closes the log and detaches it from its table.
+ *
+ * Stops the group commit thread, so every record written before the call is durable when it
+ * returns. The table itself is not touched apart from its write callback.
+ *
+ * @param wal A pointer to the log. If NULL, the function does nothing.
+ * @return LU_OK, or LU_ERROR_IO if a write or sync of the log has failed.
+ */
+int lu_hash_wal_close(lu_hash_wal_t* wal)
+{
+	if (wal == NULL) {
+		return LU_OK;
+	}
+	if (wal->committer_running) {
+		lu_atomic_store_size(&wal->stop, 1);
+		lu_thread_join(wal->committer);
+	}
+	if (wal->table->on_write == lu_hash_wal_record && wal->table->write_ctx == wal) {
+		lu_hash_table_set_write_callback(wal->table, NULL, NULL);
+	}
+
+	wal->dirty = 1;
+	int status = lu_hash_wal_sync(wal);
+	if (fclose(wal->file) != 0 && status == LU_OK) {
+		status = LU_ERROR_IO;
+	}
+
+	lu_mutex_destroy(&wal->lock);
+	lu_mutex_destroy(&wal->sync_lock);
+	LU_MM_FREE(wal->record);
+	LU_MM_FREE(wal->path);
+	LU_MM_FREE(wal->snapshot_path);
+	LU_MM_FREE(wal);
+	return status;
+}
+
+/**
+ * @brief Records the first I/O error of the log. The caller holds wal->lock.
+ */
+static void lu_hash_wal_fail(lu_hash_wal_t* wal, const char* what)
+{
+#ifdef LU_HASH_DEBUG
+	printf("Error: write-ahead log %s failed (%s)\n", what, wal->path);
+#else
+	(void)what;
+#endif // LU_HASH_DEBUG
+	if (wal->error == LU_OK) {
+		wal->error = LU_ERROR_IO;
+	}
+	lu_hash_erron_global_ = LU_ERROR_IO;
+}
+
+/**
+ * @brief Forces the written contents of a flushed file to stable storage.
+ */
+static int lu_hash_wal_fsync(FILE* file)
+{
+#if defined(_WIN32)
+	return _commit(_fileno(file)) == 0 ? LU_OK : LU_ERROR_IO;
+#else
+	return fsync(fileno(file)) == 0 ? LU_OK : LU_ERROR_IO;
+#endif
+}
+
+/**
+ * @brief Atomically replaces `to` with `from` and makes the rename durable.
+ */
+static int lu_hash_wal_rename(const char* from, const char* to)
+{
+#if defined(_WIN32)
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? LU_OK : LU_ERROR_IO;
+#else
+	if (rename(from, to) != 0) {
+		return LU_ERROR_IO;
+	}
+	// The new directory entry is only durable once the directory itself is synced
+	const char* slash = strrchr(to, '/');
+	char* directory = slash ? lu_hash_wal_concat(to, "") : lu_hash_wal_concat(".", "");
+	if (slash) {
+		directory[slash - to + (slash == to)] = '\0';
+	}
+	int fd = open(directory, O_RDONLY);
+	LU_MM_FREE(directory);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+	return LU_OK;
+#endif
+}
+
+/** @brief Returns a newly allocated copy of `path` followed by `suffix`. */
+static char* lu_hash_wal_concat(const char* path, const char* suffix)
+{
+	size_t path_length = strlen(path);
+	size_t suffix_length = strlen(suffix);
+	char* result = (char*)LU_MM_MALLOC(path_length + suffix_length + 1);
+	memcpy(result, path, path_length);
+	memcpy(result + path_length, suffix, suffix_length + 1);
+	return result;
+}
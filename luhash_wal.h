@@ -0,0 +1,111 @@
+#ifndef LU_LU_HASH_WAL_INCLUDE_H_
+#define LU_LU_HASH_WAL_INCLUDE_H_
+
+/**
+ * @file luhash_wal.h
+ * @brief Append-only write-ahead log that makes a lu_hash_table_t survive restarts and crashes.
+ *
+ * A log attaches to a table as its write callback and appends one record per insert, update and
+ * removal. Opening the log on an empty table first loads the last snapshot and replays the records
+ * written after it. Once the log outgrows a threshold it is compacted: the whole table is written
+ * to a new snapshot file, which replaces the old one atomically, and the log starts over.
+ *
+ * How often the log is forced to disk is a trade-off between throughput and the window of changes
+ * a crash may lose:
+ *   - LU_HASH_WAL_SYNC_ALWAYS flushes and fsyncs after every record, nothing is lost;
+ *   - LU_HASH_WAL_SYNC_GROUP buffers records and lets a background thread fsync them every
+ *     `group_commit_ms`, so a crash loses at most the last few milliseconds of changes;
+ *   - LU_HASH_WAL_SYNC_OS hands every record to the operating system without fsync, so it
+ *     survives a crash of the process but not of the machine.
+ *
+ * Values are opaque pointers, so the log stores them through an encode/decode pair supplied by
+ * the caller. Without one the pointer itself is stored, which is only meaningful for values that
+ * are integers cast to pointers.
+ *
+ * @author [hesphoros]
+ * @contact [hesphoros@gmail.com]
+ * @date 2026-10-18
+ * @version 1.0
+ */
+
+#include "luhash.h"
+#include "luhash_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LU_HASH_WAL_DEFAULT_GROUP_COMMIT_MS	10					// Default interval of group commits
+#define LU_HASH_WAL_DEFAULT_COMPACT_BYTES	(64u * 1024 * 1024)	// Default log size that triggers compaction
+
+	/**
+	 * When appended records are forced to stable storage.
+	 */
+	typedef enum lu_hash_wal_sync_u {
+		LU_HASH_WAL_SYNC_ALWAYS,	// fsync after every record
+		LU_HASH_WAL_SYNC_GROUP,		// fsync from a background thread every group_commit_ms
+		LU_HASH_WAL_SYNC_OS,		// write every record, leave flushing to the operating system
+	}lu_hash_wal_sync_t;
+
+	/**
+	 * Serializes a value. Points `data` at the bytes that represent `value` and returns their
+	 * count; the bytes must stay valid until the next call.
+	 */
+	typedef size_t (*lu_hash_wal_encode_func_t)(const void* value, const void** data, void* ctx);
+
+	/** Rebuilds a value from the bytes produced by the encode function */
+	typedef void* (*lu_hash_wal_decode_func_t)(const void* data, size_t size, void* ctx);
+
+	/**
+	 * Settings of a write-ahead log. lu_hash_wal_open with NULL options uses group commit every
+	 * LU_HASH_WAL_DEFAULT_GROUP_COMMIT_MS, compaction at LU_HASH_WAL_DEFAULT_COMPACT_BYTES and the
+	 * pointer-storing codec.
+	 */
+	typedef struct lu_hash_wal_options_s {
+		lu_hash_wal_sync_t sync;
+		unsigned int	   group_commit_ms;	// Interval of background fsyncs for LU_HASH_WAL_SYNC_GROUP
+		size_t			   compact_bytes;	// Log size that triggers a compaction, 0 to compact only on request
+		lu_hash_wal_encode_func_t encode;	// Value serializer, NULL to store the pointer itself
+		lu_hash_wal_decode_func_t decode;	// Value deserializer, NULL to restore the pointer itself
+		void			   (*release)(void* value, void* ctx); // Releases values replaced or removed during replay, may be NULL
+		void*			   codec_ctx;		// Context passed to encode, decode and release
+	}lu_hash_wal_options_t;
+
+	/**
+	 * Structure representing a write-ahead log attached to a table.
+	 */
+	typedef struct lu_hash_wal_s {
+		lu_hash_table_t*	  table;		// Table whose changes are logged
+		lu_hash_wal_options_t options;
+		char*				  path;			// Log file
+		char*				  snapshot_path;// Snapshot file, the log path with ".snap" appended
+		FILE*				  file;			// Log file opened for appending
+		size_t				  log_bytes;	// Current size of the log file including unsynced records
+		int					  dirty;		// Set when records were written since the last fsync
+		unsigned char*		  record;		// Buffer a record is encoded into before it is written
+		size_t				  record_capacity;
+		int					  error;		// LU_OK, or the first I/O error; the log stops writing after one
+		size_t				  replayed;		// Records applied when the log was opened
+		size_t				  compactions;	// Number of compactions since the log was opened
+		lu_mutex_t			  lock;			// Serializes writes to `file` with the group commit thread
+		lu_mutex_t			  sync_lock;	// Keeps `file` open while the group commit thread syncs it
+		lu_thread_t			  committer;	// Group commit thread
+		int					  committer_running;
+		volatile size_t		  stop;			// Asks the group commit thread to exit
+	}lu_hash_wal_t;
+
+	/**Function definition*/
+	lu_hash_wal_t* lu_hash_wal_open(lu_hash_table_t* table, const char* path, const lu_hash_wal_options_t* options);
+	int lu_hash_wal_sync(lu_hash_wal_t* wal);
+	int lu_hash_wal_compact(lu_hash_wal_t* wal);
+	int lu_hash_wal_close(lu_hash_wal_t* wal);
+
+#define LU_HASH_WAL_OPEN(table,path)		lu_hash_wal_open(table,path,NULL)
+#define LU_HASH_WAL_SYNC(wal)				lu_hash_wal_sync(wal)
+#define LU_HASH_WAL_CLOSE(wal)				lu_hash_wal_close(wal)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** LU_LU_HASH_WAL_INCLUDE_H_*/
@@ -3,7 +3,22 @@
 #include <string.h>
 #include <assert.h>
 #include "luhash.h"
+#include "luhash_lockfree.h"
+#include "luhash_perf.h"
+#include "luhash_intrusive.h"
+#include "luhash_sharded.h"
+#include "luhash_frozen.h"
+#include "luhash_set.h"
+#include "luhash_wal.h"
+#include "luhash_define.h"
+#include "luhash_mapped.h"
+#include "luhash_agg.h"
+#include "luhash_fixed.h"
+#include "luhash_reclaim.h"
+#include "luhash_trace.h"
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 #define LU_HASH_DEBUG
 
@@ -120,9 +135,1563 @@ void test_hash() {
 	destroy_person_db(&db);
 }
 
-int main() {
+#define LF_TEST_THREADS		8
+#define LF_TEST_KEYS		4096
+#define LF_TEST_OPS			400000
+
+typedef struct {
+	lu_hash_lockfree_t* table;
+	int id;
+	size_t live;      // Keys of this thread still present at the end
+	int failures;
+} LockFreeWorker;
+
+// Every thread owns the keys k with k % LF_TEST_THREADS == id, so it can check its own results
+// exactly while the keys of all threads interleave in the same buckets and lists.
+static void lockfree_stress_worker(void* arg) {
+	LockFreeWorker* worker = (LockFreeWorker*)arg;
+	char* present = (char*)calloc(LF_TEST_KEYS, 1);
+	unsigned int seed = (unsigned int)worker->id * 7919u + 1u;
+
+	for (int i = 0; i < LF_TEST_OPS; ++i) {
+		seed = seed * 1103515245u + 12345u;
+		int slot = (int)((seed >> 8) % LF_TEST_KEYS);
+		int key = slot * LF_TEST_THREADS + worker->id;
+		void* value = (void*)(size_t)(key + 1);
+
+		switch ((seed >> 4) % 3) {
+		case 0:
+			lu_hash_lockfree_insert(worker->table, key, value);
+			present[slot] = 1;
+			break;
+		case 1: {
+			void* found = lu_hash_lockfree_find(worker->table, key);
+			if (found != (present[slot] ? value : NULL)) {
+				worker->failures++;
+			}
+			break;
+		}
+		default:
+			lu_hash_lockfree_delete(worker->table, key);
+			present[slot] = 0;
+			break;
+		}
+	}
+
+	for (int slot = 0; slot < LF_TEST_KEYS; ++slot) {
+		worker->live += present[slot];
+	}
+	free(present);
+}
+
+void test_lockfree_stress() {
+	lu_hash_lockfree_t* table = lu_hash_lockfree_init(2);
+	LockFreeWorker workers[LF_TEST_THREADS];
+	lu_thread_t threads[LF_TEST_THREADS];
+
+	for (int i = 0; i < LF_TEST_THREADS; ++i) {
+		workers[i].table = table;
+		workers[i].id = i;
+		workers[i].live = 0;
+		workers[i].failures = 0;
+		lu_thread_create(&threads[i], lockfree_stress_worker, &workers[i]);
+	}
+
+	size_t expected = 0;
+	int failures = 0;
+	for (int i = 0; i < LF_TEST_THREADS; ++i) {
+		lu_thread_join(threads[i]);
+		expected += workers[i].live;
+		failures += workers[i].failures;
+	}
+
+	printf("Lock-free stress: %d wrong lookups, count %zu (expected %zu), %zu buckets\n",
+		failures, lu_hash_lockfree_count(table), expected, (size_t)table->table_size);
+	assert(failures == 0);
+	assert(lu_hash_lockfree_count(table) == expected);
+	lu_hash_lockfree_destroy(table);
+}
+
+#define LF_COUNTER_KEYS		256
+#define LF_COUNTER_ROUNDS	64
+
+typedef struct {
+	lu_hash_lockfree_t* table;
+	int id;
+	volatile size_t* start;   // Set once every thread has been created
+} CounterWorker;
+
+// Every thread adds 1 + 2 + 3 to every key per round: through lu_hash_lockfree_add, which inserts
+// the key on first use, then lu_hash_lockfree_fetch_add, then a compare-and-swap loop. Thread 0 also
+// inserts each key with a value, racing the first increments of the other threads.
+static void lockfree_counter_worker(void* arg) {
+	CounterWorker* worker = (CounterWorker*)arg;
+	while (!lu_atomic_load_size(worker->start)) {
+		lu_thread_yield();
+	}
+	for (int round = 0; round < LF_COUNTER_ROUNDS; ++round) {
+		for (int key = 0; key < LF_COUNTER_KEYS; ++key) {
+			if (worker->id == 0 && round == 0) {
+				lu_hash_lockfree_insert(worker->table, key, (void*)(size_t)(key + 1));
+			}
+			lu_hash_lockfree_add(worker->table, key, 1);
+			assert(lu_hash_lockfree_fetch_add(worker->table, key, 2, NULL) == 1);
+			long long counter;
+			do {
+				assert(lu_hash_lockfree_get_counter(worker->table, key, &counter) == 1);
+			} while (!lu_hash_lockfree_compare_exchange(worker->table, key, counter, counter + 3));
+		}
+	}
+}
+
+// Concurrent atomic updates of shared counters lose no increment
+void test_lockfree_counters() {
+	lu_hash_lockfree_t* table = lu_hash_lockfree_init(2);
+	CounterWorker workers[LF_TEST_THREADS];
+	lu_thread_t threads[LF_TEST_THREADS];
+	volatile size_t start = 0;
+
+	for (int i = 0; i < LF_TEST_THREADS; ++i) {
+		workers[i].table = table;
+		workers[i].id = i;
+		workers[i].start = &start;
+		assert(lu_thread_create(&threads[i], lockfree_counter_worker, &workers[i]) == 0);
+	}
+	lu_atomic_store_size(&start, 1);
+	for (int i = 0; i < LF_TEST_THREADS; ++i) {
+		lu_thread_join(threads[i]);
+	}
+
+	long long expected = (long long)LF_TEST_THREADS * LF_COUNTER_ROUNDS * (1 + 2 + 3);
+	for (int key = 0; key < LF_COUNTER_KEYS; ++key) {
+		long long counter = 0;
+		assert(lu_hash_lockfree_get_counter(table, key, &counter) == 1);
+		assert(counter == expected);
+		assert(lu_hash_lockfree_find(table, key) == (void*)(size_t)(key + 1));
+	}
+	printf("Lock-free counters: %d keys at %lld after %d threads\n", LF_COUNTER_KEYS, expected, LF_TEST_THREADS);
+	assert(lu_hash_lockfree_count(table) == LF_COUNTER_KEYS);
+	assert(lu_hash_lockfree_fetch_add(table, LF_COUNTER_KEYS, 1, NULL) == 0);
+	assert(lu_hash_lockfree_compare_exchange(table, LF_COUNTER_KEYS, 0, 1) == 0);
+	lu_hash_lockfree_destroy(table);
+}
+
+#define LF_BENCH_KEYS		(1 << 16)
+#define LF_BENCH_OPS		500000
+
+// Reference for the scaling benchmark: the regular table behind one global mutex
+typedef struct {
+	lu_mutex_t lock;
+	lu_hash_table_t* table;
+} MutexTable;
+
+typedef struct {
+	void* table;
+	int lockfree;
+	unsigned int seed;
+} BenchWorker;
+
+// 50% finds, 25% inserts, 25% deletes on a key range that stays about half full
+static void bench_worker(void* arg) {
+	BenchWorker* worker = (BenchWorker*)arg;
+	unsigned int seed = worker->seed;
+
+	for (int i = 0; i < LF_BENCH_OPS; ++i) {
+		seed = seed * 1103515245u + 12345u;
+		int key = (int)((seed >> 8) % LF_BENCH_KEYS);
+		unsigned int op = (seed >> 4) & 3;
+
+		if (worker->lockfree) {
+			lu_hash_lockfree_t* table = (lu_hash_lockfree_t*)worker->table;
+			if (op < 2) lu_hash_lockfree_find(table, key);
+			else if (op == 2) lu_hash_lockfree_insert(table, key, worker);
+			else lu_hash_lockfree_delete(table, key);
+		}
+		else {
+			MutexTable* locked = (MutexTable*)worker->table;
+			lu_mutex_lock(&locked->lock);
+			if (op < 2) lu_hash_table_find(locked->table, key);
+			else if (op == 2) lu_hash_table_insert(locked->table, key, worker);
+			else lu_hash_table_delete(locked->table, key);
+			lu_mutex_unlock(&locked->lock);
+		}
+	}
+}
+
+static double bench_run(void* table, int lockfree, int thread_count) {
+	BenchWorker workers[LF_TEST_THREADS];
+	lu_thread_t threads[LF_TEST_THREADS];
+
+	unsigned long long start = lu_clock_ns();
+	for (int i = 0; i < thread_count; ++i) {
+		workers[i].table = table;
+		workers[i].lockfree = lockfree;
+		workers[i].seed = (unsigned int)i * 2654435761u + 1u;
+		lu_thread_create(&threads[i], bench_worker, &workers[i]);
+	}
+	for (int i = 0; i < thread_count; ++i) {
+		lu_thread_join(threads[i]);
+	}
+	unsigned long long elapsed = lu_clock_ns() - start;
+
+	return (double)thread_count * LF_BENCH_OPS / ((double)elapsed / 1e9);
+}
+
+void bench_lockfree_scaling() {
+	printf("threads   mutex table (Mops/s)   lock-free table (Mops/s)\n");
+	for (int threads = 1; threads <= LF_TEST_THREADS; threads *= 2) {
+		MutexTable locked;
+		lu_mutex_init(&locked.lock);
+		locked.table = lu_hash_table_init(LF_BENCH_KEYS);
+		double mutex_rate = bench_run(&locked, 0, threads);
+		lu_hash_table_destroy(locked.table);
+		lu_mutex_destroy(&locked.lock);
+
+		lu_hash_lockfree_t* lockfree = lu_hash_lockfree_init(LF_BENCH_KEYS);
+		double lockfree_rate = bench_run(lockfree, 1, threads);
+		lu_hash_lockfree_destroy(lockfree);
+
+		printf("%7d   %20.2f   %24.2f\n", threads, mutex_rate / 1e6, lockfree_rate / 1e6);
+	}
+}
+
+#define PERF_BENCH_KEYS (1 << 20)
+
+void bench_perf_counters(const char* baseline_path, const char* csv_path) {
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	lu_hash_perf_result_t results[LU_HASH_PERF_PHASE_COUNT];
+	size_t count = lu_hash_perf_bench(&config, PERF_BENCH_KEYS, 1, results);
+
+	printf("phase          ns/op   cycles/op    instr/op  l1d miss/op  llc miss/op dtlb miss/op  br miss/op\n");
+	for (size_t i = 0; i < count; i++) {
+		printf("%-8s %10.2f", results[i].phase, results[i].per_op.ns);
+		for (int c = 0; c < LU_HASH_PERF_COUNTER_COUNT; c++) {
+			if (results[i].per_op.counters[c] == LU_HASH_PERF_UNAVAILABLE) {
+				printf(" %11s", "n/a");
+			}
+			else {
+				printf(" %11.3f", results[i].per_op.counters[c]);
+			}
+		}
+		printf("\n");
+	}
+
+	if (baseline_path != NULL) {
+		lu_hash_perf_result_t baseline[LU_HASH_PERF_PHASE_COUNT];
+		size_t baseline_count = lu_hash_perf_read_csv(baseline_path, baseline, LU_HASH_PERF_PHASE_COUNT);
+		size_t regressions = lu_hash_perf_compare(results, count, baseline, baseline_count, 0.05, stdout);
+		printf("%zu metrics regressed against %s\n", regressions, baseline_path);
+	}
+	if (csv_path != NULL) {
+		lu_hash_perf_write_csv(csv_path, results, count);
+		printf("Results written to %s\n", csv_path);
+	}
+}
+
+typedef struct {
+	char name[50];
+	char gender;
+	lu_hash_hook_t by_id;	// Linked into the table directly, the key is the ID
+} IntrusivePerson;
+
+void test_intrusive() {
+	IntrusivePerson people[] = {
+		{"Zhang San", 'M', {0}}, {"Li Si", 'F', {0}}, {"Wang Wu", 'M', {0}}, {"Zhao Liu", 'F', {0}}, {"Sun Qi", 'M', {0}},
+	};
+	int count = (int)(sizeof(people) / sizeof(people[0]));
+	lu_hash_intrusive_t* table = lu_hash_intrusive_init(0);
+	for (int i = 0; i < count; i++) {
+		lu_hash_hook_init(&people[i].by_id);
+		lu_hash_intrusive_insert(table, 1001 + i, &people[i].by_id);
+	}
+
+	// Linking a hook again under its own key changes nothing
+	assert(lu_hash_intrusive_insert(table, 1002, &people[1].by_id) == NULL);
+	assert(lu_hash_intrusive_count(table) == (size_t)count);
+
+	assert(lu_hash_intrusive_remove(table, 1004) == &people[3].by_id && people[3].by_id.next == NULL);
+	assert(lu_hash_intrusive_count(table) == (size_t)count - 1);
+	for (int id = 1001; id < 1001 + count; id++) {
+		lu_hash_hook_t* hook = lu_hash_intrusive_find(table, id);
+		if (hook) {
+			IntrusivePerson* person = LU_HASH_CONTAINER_OF(hook, IntrusivePerson, by_id);
+			printf("Found person: Name: %s, ID: %d, Gender: %c\n", person->name, hook->key, person->gender);
+		}
+		else {
+			printf("Person with ID %d not found\n", id);
+		}
+		assert((hook == NULL) == (id == 1004));
+	}
+	lu_hash_intrusive_destroy(table);
+}
+
+#define SHARDED_TEST_KEYS 10000
+
+// A thread that looks a key up, or binds to a shard until it is released. The flags are shared
+// with the test thread, so they go through the atomics of luhash_sync.h.
+typedef struct {
+	lu_hash_sharded_t* sharded;
+	int key;
+	size_t shard;
+	volatile size_t started;
+	volatile size_t done;
+	volatile size_t release;
+	void* found;
+} ShardWorker;
+
+static void shard_reader(void* arg) {
+	ShardWorker* worker = (ShardWorker*)arg;
+	lu_atomic_store_size(&worker->started, 1);
+	worker->found = lu_hash_sharded_find(worker->sharded, worker->key);
+	lu_atomic_store_size(&worker->done, 1);
+}
+
+static void shard_owner(void* arg) {
+	ShardWorker* worker = (ShardWorker*)arg;
+	assert(lu_hash_sharded_bind_thread(worker->sharded, worker->shard) == LU_OK);
+	lu_atomic_store_size(&worker->started, 1);
+	while (!lu_atomic_load_size(&worker->release)) {
+		lu_thread_yield();
+	}
+	lu_hash_sharded_unbind_thread(worker->sharded);
+	lu_atomic_store_size(&worker->done, 1);
+}
+
+// Every key lands in the shard lu_hash_sharded_shard_of names. A bound thread keeps unbound
+// threads out of its shard until it unbinds, and a thread bound elsewhere is turned away instead
+// of waiting.
+void test_sharded() {
+	lu_hash_sharded_t* sharded = lu_hash_sharded_init(5, 0);
+	assert(sharded->shard_count == 8);
+	for (int i = 0; i < SHARDED_TEST_KEYS; i++) {
+		lu_hash_sharded_insert(sharded, i, (void*)(size_t)(i + 1));
+	}
+	assert(lu_hash_sharded_count(sharded) == SHARDED_TEST_KEYS);
+	for (int i = 0; i < SHARDED_TEST_KEYS; i++) {
+		size_t shard = lu_hash_sharded_shard_of(sharded, i);
+		assert(shard < sharded->shard_count);
+		assert(lu_hash_table_find(sharded->shards[shard].table, i) == (void*)(size_t)(i + 1));
+		assert(lu_hash_sharded_find(sharded, i) == (void*)(size_t)(i + 1));
+	}
+	for (size_t shard = 0; shard < sharded->shard_count; shard++) {
+		assert(sharded->shards[shard].table->element_count > 0);
+	}
+
+	int key = 0;
+	size_t bound = lu_hash_sharded_shard_of(sharded, key);
+	assert(lu_hash_sharded_bind_thread(sharded, sharded->shard_count) == LU_ERROR_INVALID_ARGUMENT);
+	assert(lu_hash_sharded_bind_thread(sharded, bound) == LU_OK);
+	assert(lu_hash_sharded_bind_thread(sharded, bound) == LU_ERROR_BUSY);
+
+	// The owner works on its shard without locking
+	assert(lu_hash_sharded_insert(sharded, key, (void*)(size_t)42) == LU_OK);
+	assert(lu_hash_sharded_find(sharded, key) == (void*)(size_t)42);
+
+	// An unbound reader waits for the binding to end
+	ShardWorker reader = { sharded, key, 0, 0, 0, 0, NULL };
+	lu_thread_t reader_thread;
+	assert(lu_thread_create(&reader_thread, shard_reader, &reader) == 0);
+	while (!lu_atomic_load_size(&reader.started)) {
+		lu_thread_yield();
+	}
+	for (int i = 0; i < 1000; i++) {
+		lu_thread_yield();
+	}
+	assert(!lu_atomic_load_size(&reader.done));
+
+	// Another bound thread's shard is refused rather than waited for
+	int other = 1;
+	while (lu_hash_sharded_shard_of(sharded, other) == bound) {
+		other++;
+	}
+	ShardWorker owner = { sharded, other, lu_hash_sharded_shard_of(sharded, other), 0, 0, 0, NULL };
+	lu_thread_t owner_thread;
+	assert(lu_thread_create(&owner_thread, shard_owner, &owner) == 0);
+	while (!lu_atomic_load_size(&owner.started)) {
+		lu_thread_yield();
+	}
+	assert(lu_hash_sharded_find(sharded, other) == NULL);
+	assert(lu_hash_sharded_insert(sharded, other, NULL) == LU_ERROR_BUSY);
+	assert(lu_hash_sharded_delete(sharded, other) == LU_ERROR_BUSY);
+	assert(lu_hash_sharded_count(sharded) < SHARDED_TEST_KEYS);
+	lu_atomic_store_size(&owner.release, 1);
+	lu_thread_join(owner_thread);
+	assert(lu_hash_sharded_find(sharded, other) == (void*)(size_t)(other + 1));
+
+	lu_hash_sharded_unbind_thread(sharded);
+	lu_thread_join(reader_thread);
+	printf("Sharded: %zu keys over %zu shards, reader waited for the bound shard\n", lu_hash_sharded_count(sharded), sharded->shard_count);
+	assert(lu_atomic_load_size(&reader.done) && reader.found == (void*)(size_t)42);
+	assert(lu_hash_sharded_find(sharded, key) == (void*)(size_t)42);
+
+	lu_hash_sharded_destroy(sharded);
+}
+
+#define FROZEN_TEST_KEYS 50000
+
+// A frozen copy finds every key of the table it was built from, misses everything else, and does
+// not follow later changes of the table.
+void test_frozen() {
+	lu_hash_table_t* table = lu_hash_table_init(0);
+	for (int i = 0; i < FROZEN_TEST_KEYS; i++) {
+		int key = i * 7919 - FROZEN_TEST_KEYS;
+		lu_hash_table_insert(table, key, (void*)(size_t)(i + 1));
+	}
+	lu_hash_frozen_t* frozen = lu_hash_table_freeze(table);
+	assert(frozen != NULL && frozen->element_count == FROZEN_TEST_KEYS);
+	lu_hash_table_delete(table, -FROZEN_TEST_KEYS);
+
+	for (int i = 0; i < FROZEN_TEST_KEYS; i++) {
+		int key = i * 7919 - FROZEN_TEST_KEYS;
+		assert(lu_hash_frozen_find(frozen, key) == (void*)(size_t)(i + 1));
+		assert(lu_hash_frozen_find(frozen, key + 1) == NULL);
+	}
+	printf("Frozen: %zu keys in %zu bytes\n", frozen->element_count, lu_hash_frozen_memory_usage(frozen));
+	lu_hash_frozen_destroy(frozen);
+	lu_hash_table_destroy(table);
+
+	table = lu_hash_table_init(0);
+	frozen = lu_hash_table_freeze(table);
+	assert(frozen != NULL && lu_hash_frozen_find(frozen, 0) == NULL);
+	lu_hash_frozen_destroy(frozen);
+	lu_hash_table_destroy(table);
+}
+
+// Clock the TTL tests move by hand, in seconds
+static unsigned long long test_clock_now = 1000;
+
+static unsigned long long test_clock() {
+	return test_clock_now;
+}
+
+#define TTL_TEST_KEYS 16
+
+// Sends every key to the same bucket, so that a handful of keys builds a tree
+static unsigned long long colliding_hash(int key, unsigned long long seed) {
+	(void)key;
+	(void)seed;
+	return 0;
+}
+
+// The bucket holding the keys of a table built on colliding_hash
+static lu_hash_bucket_t* colliding_bucket(lu_hash_table_t* table) {
+	for (size_t i = 0; i < table->table_size; i++) {
+		if (table->buckets[i].esize_bucket != 0) {
+			return &table->buckets[i];
+		}
+	}
+	return NULL;
+}
+
+// Entries expire on the injected clock, through lu_hash_table_expire as well as lazily on lookup,
+// and a tree bucket that expiry shrinks turns back into a list.
+void test_ttl_expiry() {
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.hash = colliding_hash;
+	config.untreeify_threshold = 2;
+	lu_hash_table_t* table = lu_hash_table_init_with_config(0, &config);
+	lu_hash_table_set_clock(table, test_clock);
+
+	for (int i = 0; i < TTL_TEST_KEYS; i++) {
+		if (i < TTL_TEST_KEYS - 2) {
+			lu_hash_table_insert_ttl(table, i, (void*)(size_t)(i + 1), 5);
+		}
+		else {
+			lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+		}
+	}
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_RBTREE);
+
+	test_clock_now += 4;
+	assert(lu_hash_table_expire(table, table->table_size) == 0);
+	for (int i = 0; i < TTL_TEST_KEYS; i++) {
+		assert(lu_hash_table_find(table, i) == (void*)(size_t)(i + 1));
+	}
+
+	test_clock_now += 2;
+	assert(lu_hash_table_expire(table, table->table_size) == TTL_TEST_KEYS - 2);
+	assert(table->element_count == 2);
+	assert(table->expired_count == TTL_TEST_KEYS - 2);
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_LIST);
+	assert(lu_hash_table_find(table, 0) == NULL);
+	assert(lu_hash_table_find(table, TTL_TEST_KEYS - 1) == (void*)(size_t)TTL_TEST_KEYS);
+
+	// Lazy expiry: nothing sweeps, the lookups remove the entries
+	for (int i = 0; i < TTL_TEST_KEYS - 2; i++) {
+		lu_hash_table_insert_ttl(table, i, (void*)(size_t)(i + 1), 5);
+	}
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_RBTREE);
+	test_clock_now += 6;
+	for (int i = 0; i < TTL_TEST_KEYS - 2; i++) {
+		assert(lu_hash_table_find(table, i) == NULL);
+	}
+	printf("TTL: %zu entries expired, %zu left\n", table->expired_count, table->element_count);
+	assert(table->element_count == 2);
+	assert(table->expired_count == 2 * (TTL_TEST_KEYS - 2));
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_LIST);
+
+	lu_hash_table_destroy(table);
+	test_clock_now = 1000;
+}
+
+#define CACHE_TEST_CAPACITY 100
+
+// Collects the keys a table evicts
+typedef struct {
+	int keys[CACHE_TEST_CAPACITY];
+	size_t count;
+} EvictLog;
+
+static void log_evict(int key, void* value, void* ctx) {
+	EvictLog* log = (EvictLog*)ctx;
+	(void)value;
+	if (log->count < CACHE_TEST_CAPACITY) {
+		log->keys[log->count] = key;
+	}
+	log->count++;
+}
+
+// A bounded table evicts only what it must, passes over entries looked up since the hand last
+// went by, and turns a tree bucket that eviction shrinks back into a list.
+void test_clock_eviction() {
+	EvictLog log = { { 0 }, 0 };
+	lu_hash_table_t* table = lu_hash_table_init(0);
+	lu_hash_table_set_capacity(table, CACHE_TEST_CAPACITY, 0, NULL);
+	lu_hash_table_set_evict_callback(table, log_evict, &log);
+	for (int i = 0; i < CACHE_TEST_CAPACITY; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	assert(log.count == 0);
+
+	// The first half is referenced, so the hand must take its victims from the second half
+	for (int i = 0; i < CACHE_TEST_CAPACITY / 2; i++) {
+		assert(lu_hash_table_find(table, i) == (void*)(size_t)(i + 1));
+	}
+	for (int i = CACHE_TEST_CAPACITY; i < CACHE_TEST_CAPACITY + 10; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+		assert(table->element_count == CACHE_TEST_CAPACITY);
+	}
+	assert(log.count == 10);
+	assert(table->evicted_count == 10);
+	for (size_t k = 0; k < log.count; k++) {
+		assert(log.keys[k] >= CACHE_TEST_CAPACITY / 2);
+		assert(lu_hash_table_find(table, log.keys[k]) == NULL);
+	}
+	for (int i = 0; i < CACHE_TEST_CAPACITY / 2; i++) {
+		assert(lu_hash_table_find(table, i) == (void*)(size_t)(i + 1));
+	}
+
+	// Lowering the capacity evicts down to it at once
+	lu_hash_table_set_capacity(table, CACHE_TEST_CAPACITY / 4, 0, NULL);
+	printf("CLOCK eviction: %zu evicted, %zu entries left\n", table->evicted_count, table->element_count);
+	assert(table->element_count == CACHE_TEST_CAPACITY / 4);
+	assert(table->evicted_count == 10 + CACHE_TEST_CAPACITY * 3 / 4);
+	lu_hash_table_destroy(table);
+
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.hash = colliding_hash;
+	config.untreeify_threshold = 2;
+	table = lu_hash_table_init_with_config(0, &config);
+	for (int i = 0; i < TTL_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_RBTREE);
+	lu_hash_table_set_capacity(table, 2, 0, NULL);
+	assert(table->element_count == 2);
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_LIST);
+	lu_hash_table_destroy(table);
+}
+
+#define SET_TEST_KEYS 20000
+#define SET_TREE_BUCKETS 1024
+#define SET_TREE_KEYS 16
+
+static void count_key(int key, void* ctx) {
+	(void)key;
+	(*(size_t*)ctx)++;
+}
+
+// Membership of a set built from the even keys: single lookups and the prefetching batch agree,
+// and removals shrink the set and untreeify its buckets
+void test_set() {
+	lu_hash_set_t* set = lu_hash_set_init(0);
+	for (int i = 0; i < SET_TEST_KEYS; i += 2) {
+		assert(lu_hash_set_add(set, i) == 1);
+	}
+	assert(lu_hash_set_add(set, 0) == 0);
+	assert(set->element_count == SET_TEST_KEYS / 2);
+
+	int* keys = (int*)malloc(SET_TEST_KEYS * sizeof(int));
+	unsigned char* results = (unsigned char*)malloc(SET_TEST_KEYS);
+	for (int i = 0; i < SET_TEST_KEYS; i++) {
+		keys[i] = i;
+		assert(lu_hash_set_contains(set, i) == !(i % 2));
+	}
+	assert(lu_hash_set_contains(set, -1) == 0);
+	assert(lu_hash_set_contains_batch(set, keys, SET_TEST_KEYS, results) == SET_TEST_KEYS / 2);
+	for (int i = 0; i < SET_TEST_KEYS; i++) {
+		assert(results[i] == !(i % 2));
+	}
+	// An odd count leaves a partial window at the end
+	assert(lu_hash_set_contains_batch(set, keys + 1, 37, NULL) == 18);
+
+	for (int i = 0; i < SET_TEST_KEYS; i += 4) {
+		assert(lu_hash_set_remove(set, i) == 1);
+	}
+	assert(lu_hash_set_remove(set, 0) == 0);
+	size_t visited = 0;
+	lu_hash_set_foreach(set, count_key, &visited);
+	printf("Set: %zu keys left in %zu buckets\n", visited, set->table_size);
+	assert(visited == SET_TEST_KEYS / 4);
+	assert(lu_hash_set_contains_batch(set, keys, SET_TEST_KEYS, NULL) == SET_TEST_KEYS / 4);
+
+	// Emptying the set shrinks it back to the size it was created with
+	for (int i = 2; i < SET_TEST_KEYS; i += 4) {
+		assert(lu_hash_set_remove(set, i) == 1);
+	}
+	assert(set->element_count == 0 && set->table_size == LU_HASH_TABLE_DEFAULT_SIZE);
+	free(keys);
+	free(results);
+	lu_hash_set_destroy(set);
+
+	// Keys picked to share a bucket under the seed of the set build a tree, and removing most of
+	// them turns the bucket back into a list
+	set = lu_hash_set_init(SET_TREE_BUCKETS);
+	int tree_keys[SET_TREE_KEYS];
+	int found = 0;
+	for (int key = 0; found < SET_TREE_KEYS; key++) {
+		if ((lu_hash_seeded_mix((unsigned int)key, set->seed) & (SET_TREE_BUCKETS - 1)) == 0) {
+			tree_keys[found++] = key;
+			assert(lu_hash_set_add(set, key) == 1);
+		}
+	}
+	assert(set->reseed_count == 0 && set->buckets[0].type == LU_HASH_BUCKET_RBTREE);
+	for (int i = 0; i < SET_TREE_KEYS - LU_HASH_SET_UNTREEIFY_THRESHOLD; i++) {
+		assert(set->buckets[0].type == LU_HASH_BUCKET_RBTREE);
+		assert(lu_hash_set_remove(set, tree_keys[i]) == 1);
+	}
+	assert(set->buckets[0].type == LU_HASH_BUCKET_LIST && set->buckets[0].esize_bucket == LU_HASH_SET_UNTREEIFY_THRESHOLD);
+	for (int i = 0; i < SET_TREE_KEYS; i++) {
+		assert(lu_hash_set_contains(set, tree_keys[i]) == (i >= SET_TREE_KEYS - LU_HASH_SET_UNTREEIFY_THRESHOLD));
+	}
+	assert(set->table_size == SET_TREE_BUCKETS);
+	lu_hash_set_destroy(set);
+}
+
+#define FILTER_TEST_KEYS 10000
+
+
+// Absent keys are answered by the filter or counted as false positives, never both; a lookup that
+// finds its entry expired is neither.
+void test_filter_stats() {
+	lu_hash_table_t* table = lu_hash_table_init(FILTER_TEST_KEYS);
+	lu_hash_table_set_clock(table, test_clock);
+	lu_hash_table_set_filter(table, 10);
+	for (int i = 0; i < FILTER_TEST_KEYS; i++) {
+		if (i % 2) {
+			lu_hash_table_insert_ttl(table, i, (void*)(size_t)(i + 1), 10);
+		}
+		else {
+			lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+		}
+	}
+
+	lu_hash_filter_stats_t stats;
+	for (int i = 0; i < FILTER_TEST_KEYS; i++) {
+		assert(lu_hash_table_find(table, i) == (void*)(size_t)(i + 1));
+	}
+	for (int i = FILTER_TEST_KEYS; i < FILTER_TEST_KEYS * 11; i++) {
+		assert(lu_hash_table_find(table, i) == NULL);
+	}
+	lu_hash_table_filter_stats(table, &stats);
+	assert(stats.negatives + stats.false_positives == FILTER_TEST_KEYS * 10);
+	assert(stats.false_positive_rate < 0.05);
+	assert(stats.expired == 0);
+
+	test_clock_now += 11;
+	size_t false_positives = stats.false_positives;
+	for (int i = 1; i < FILTER_TEST_KEYS; i += 2) {
+		assert(lu_hash_table_find(table, i) == NULL);
+	}
+	lu_hash_table_filter_stats(table, &stats);
+	printf("Filter: %zu negatives, %zu false positives (%.4f), %zu expired hits\n", stats.negatives, stats.false_positives, stats.false_positive_rate, stats.expired);
+	assert(stats.expired == FILTER_TEST_KEYS / 2);
+	assert(stats.false_positives == false_positives);
+	assert(lu_hash_table_find(table, 0) == (void*)(size_t)1);
+	lu_hash_table_destroy(table);
+	test_clock_now = 1000;
+}
+
+#define SNAPSHOT_TEST_KEYS 1000
+
+typedef struct {
+	size_t count;
+	size_t value_sum;
+} VisitSum;
+
+static void sum_entry(int key, void* value, void* ctx) {
+	VisitSum* sum = (VisitSum*)ctx;
+	(void)key;
+	sum->count++;
+	sum->value_sum += (size_t)value;
+}
+
+// A snapshot keeps showing the table as it was while the table is updated, shrunk by deletes and
+// grown through several resizes, for list and tree buckets alike.
+void test_snapshot() {
+	lu_hash_table_t* table = lu_hash_table_init(16);
+	for (int i = 0; i < SNAPSHOT_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	lu_hash_snapshot_t* snapshot = lu_hash_table_snapshot(table);
+	assert(snapshot != NULL);
+	assert(lu_hash_table_snapshot(table) == NULL);
+
+	size_t table_size = table->table_size;
+	for (int i = 0; i < SNAPSHOT_TEST_KEYS / 2; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 2));
+	}
+	for (int i = SNAPSHOT_TEST_KEYS / 2; i < SNAPSHOT_TEST_KEYS; i++) {
+		lu_hash_table_delete(table, i);
+	}
+	for (int i = SNAPSHOT_TEST_KEYS; i < SNAPSHOT_TEST_KEYS * 10; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	assert(table->table_size > table_size);
+
+	for (int i = 0; i < SNAPSHOT_TEST_KEYS * 10; i++) {
+		assert(lu_hash_snapshot_find(snapshot, i) == (i < SNAPSHOT_TEST_KEYS ? (void*)(size_t)(i + 1) : NULL));
+	}
+	VisitSum sum = { 0, 0 };
+	lu_hash_snapshot_foreach(snapshot, sum_entry, &sum);
+	assert(sum.count == SNAPSHOT_TEST_KEYS);
+	assert(sum.value_sum == (size_t)SNAPSHOT_TEST_KEYS * (SNAPSHOT_TEST_KEYS + 1) / 2);
+	assert(lu_hash_table_find(table, 0) == (void*)(size_t)2);
+	assert(lu_hash_table_find(table, SNAPSHOT_TEST_KEYS - 1) == NULL);
+	lu_hash_snapshot_release(snapshot);
+	printf("Snapshot: %zu entries seen after the table grew to %zu buckets\n", sum.count, table->table_size);
+	lu_hash_table_destroy(table);
+
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.hash = colliding_hash;
+	table = lu_hash_table_init_with_config(0, &config);
+	for (int i = 0; i < TTL_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_RBTREE);
+	snapshot = lu_hash_table_snapshot(table);
+	for (int i = 0; i < TTL_TEST_KEYS; i += 2) {
+		lu_hash_table_delete(table, i);
+	}
+	lu_hash_table_insert(table, 1, NULL);
+	for (int i = 0; i < TTL_TEST_KEYS; i++) {
+		assert(lu_hash_snapshot_find(snapshot, i) == (void*)(size_t)(i + 1));
+	}
+	lu_hash_snapshot_release(snapshot);
+	assert(lu_hash_table_find(table, 0) == NULL);
+	lu_hash_table_destroy(table);
+}
+
+#define SETOP_TEST_KEYS 30000
+
+static void* sum_values(int key, void* dst_value, void* src_value, void* ctx) {
+	(void)key;
+	(void)ctx;
+	return (void*)((size_t)dst_value + (size_t)src_value);
+}
+
+// Holds the keys below SETOP_TEST_KEYS that are multiples of `modulus`, with value (key + 1) * scale
+static lu_hash_table_t* setop_table(const lu_hash_table_t* like, int modulus, size_t scale) {
+	lu_hash_table_t* table = like ? lu_hash_table_init_like(like) : lu_hash_table_init(0);
+	for (int key = 0; key < SETOP_TEST_KEYS; key += modulus) {
+		lu_hash_table_insert(table, key, (void*)((size_t)(key + 1) * scale));
+	}
+	return table;
+}
+
+// Union, intersection and difference of the multiples of 2 and of 3 against the answer worked out
+// key by key, for tables of the same and of different layouts, on one thread and on several.
+void test_set_operations() {
+	for (int op = 0; op < 3; op++) {
+		for (int same_layout = 0; same_layout < 2; same_layout++) {
+			for (size_t threads = 1; threads <= 4; threads += 3) {
+				lu_hash_table_t* dst = setop_table(NULL, 2, 1);
+				lu_hash_table_t* src = setop_table(same_layout ? dst : NULL, 3, 1000);
+				size_t src_count = src->element_count;
+				if (op == 0) {
+					lu_hash_table_union(dst, src, sum_values, NULL, threads);
+					assert(src->element_count == 0);
+				}
+				else if (op == 1) {
+					lu_hash_table_intersect(dst, src, sum_values, NULL, threads);
+					assert(src->element_count == src_count);
+				}
+				else {
+					lu_hash_table_difference(dst, src, threads);
+					assert(src->element_count == src_count);
+				}
+
+				size_t expected_count = 0;
+				for (int key = 0; key < SETOP_TEST_KEYS; key++) {
+					int in_dst = key % 2 == 0;
+					int in_src = key % 3 == 0;
+					int kept = op == 0 ? (in_dst || in_src) : op == 1 ? (in_dst && in_src) : (in_dst && !in_src);
+					size_t value = 0;
+					if (kept) {
+						expected_count++;
+						value = (in_dst ? (size_t)(key + 1) : 0) + (in_src && op != 2 ? (size_t)(key + 1) * 1000 : 0);
+					}
+					assert(lu_hash_table_find(dst, key) == (void*)value);
+				}
+				assert(dst->element_count == expected_count);
+				lu_hash_table_destroy(dst);
+				lu_hash_table_destroy(src);
+			}
+		}
+	}
+	printf("Set operations: union, intersection and difference match the key-by-key answer\n");
+}
+
+#define WAL_TEST_PATH	"luhash_test.wal"
+#define WAL_TEST_KEYS	100
+
+// Cuts the last `bytes` bytes off a file, as a crash in the middle of a write would
+static void truncate_file(const char* path, long bytes) {
+	FILE* file = fopen(path, "rb");
+	assert(file != NULL);
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	assert(size > bytes);
+	char* data = (char*)malloc((size_t)size);
+	fseek(file, 0, SEEK_SET);
+	assert(fread(data, 1, (size_t)size, file) == (size_t)size);
+	fclose(file);
+	file = fopen(path, "wb");
+	assert(file != NULL);
+	fwrite(data, 1, (size_t)(size - bytes), file);
+	fclose(file);
+	free(data);
+}
+
+// Replaying a log whose last record was cut short restores everything before it, and the log
+// keeps working after the damaged tail.
+void test_wal_replay() {
+	lu_hash_wal_options_t options = { LU_HASH_WAL_SYNC_ALWAYS, 0, 0, NULL, NULL, NULL, NULL };
+	remove(WAL_TEST_PATH);
+	remove(WAL_TEST_PATH ".snap");
+
+	lu_hash_table_t* table = lu_hash_table_init(0);
+	lu_hash_wal_t* wal = lu_hash_wal_open(table, WAL_TEST_PATH, &options);
+	assert(wal != NULL);
+	for (int i = 0; i < WAL_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	for (int i = 0; i < WAL_TEST_KEYS; i += 10) {
+		lu_hash_table_delete(table, i);
+	}
+	lu_hash_table_insert(table, 1, (void*)(size_t)7);
+	lu_hash_table_insert(table, WAL_TEST_KEYS, (void*)(size_t)(WAL_TEST_KEYS + 1));
+	assert(lu_hash_wal_close(wal) == LU_OK);
+	lu_hash_table_destroy(table);
+	truncate_file(WAL_TEST_PATH, 3);
+
+	table = lu_hash_table_init(0);
+	wal = lu_hash_wal_open(table, WAL_TEST_PATH, &options);
+	assert(wal != NULL);
+	printf("WAL: %zu records replayed from a log with a torn tail\n", wal->replayed);
+	assert(wal->replayed == WAL_TEST_KEYS + WAL_TEST_KEYS / 10 + 1);
+	assert(table->element_count == WAL_TEST_KEYS - WAL_TEST_KEYS / 10);
+	for (int i = 0; i < WAL_TEST_KEYS; i++) {
+		void* expected = i % 10 == 0 ? NULL : (void*)(size_t)(i == 1 ? 7 : i + 1);
+		assert(lu_hash_table_find(table, i) == expected);
+	}
+	assert(lu_hash_table_find(table, WAL_TEST_KEYS) == NULL);
+
+	lu_hash_table_insert(table, WAL_TEST_KEYS * 2, (void*)(size_t)1);
+	assert(lu_hash_wal_close(wal) == LU_OK);
+	lu_hash_table_destroy(table);
+
+	table = lu_hash_table_init(0);
+	wal = lu_hash_wal_open(table, WAL_TEST_PATH, &options);
+	assert(wal != NULL);
+	assert(table->element_count == WAL_TEST_KEYS - WAL_TEST_KEYS / 10 + 1);
+	assert(lu_hash_table_find(table, WAL_TEST_KEYS * 2) == (void*)(size_t)1);
+	assert(lu_hash_wal_close(wal) == LU_OK);
+	lu_hash_table_destroy(table);
+	remove(WAL_TEST_PATH);
+	remove(WAL_TEST_PATH ".snap");
+}
+
+#define DEFINE_TEST_KEYS 5000
+
+// Every key of a generated table in one bucket, so that the bucket becomes a tree
+#define colliding_int64_hash(key)	((void)(key), 0ULL)
+LU_HASH_DEFINE(colliding64, long long, int, colliding_int64_hash, lu_hash_int64_eq, lu_hash_int64_less)
+
+static void sum_define_entry(long long key, int* value, void* ctx) {
+	VisitSum* sum = (VisitSum*)ctx;
+	(void)key;
+	sum->count++;
+	sum->value_sum += (size_t)*value;
+}
+
+// A LU_HASH_DEFINE table whose keys all collide: inserts, updates, lookups, deletes and foreach
+// through a tree bucket, with reseeds backing off once they stop scattering the keys.
+void test_define_tree() {
+	colliding64_t* table = colliding64_init(0);
+	for (long long i = 0; i < DEFINE_TEST_KEYS; i++) {
+		assert(colliding64_insert(table, i << 33, (int)i) == 1);
+	}
+	assert(colliding64_insert(table, 0, 1000) == 0);
+
+	colliding64_bucket_t* bucket = NULL;
+	for (size_t i = 0; i < table->table_size; i++) {
+		if (table->buckets[i].esize_bucket != 0) {
+			assert(bucket == NULL);
+			bucket = &table->buckets[i];
+		}
+	}
+	assert(bucket != NULL && bucket->type == LU_HASH_BUCKET_RBTREE);
+	assert(bucket->esize_bucket == DEFINE_TEST_KEYS);
+	assert(table->reseed_count >= 1 && table->reseed_count <= 12);
+
+	for (long long i = 0; i < DEFINE_TEST_KEYS; i++) {
+		int* value = colliding64_find(table, i << 33);
+		assert(value != NULL && *value == (i == 0 ? 1000 : (int)i));
+		assert(colliding64_find(table, (i << 33) + 1) == NULL);
+	}
+	for (long long i = 0; i < DEFINE_TEST_KEYS; i += 2) {
+		assert(colliding64_delete(table, i << 33) == 1);
+	}
+	assert(colliding64_delete(table, 0) == 0);
+
+	VisitSum sum = { 0, 0 };
+	colliding64_foreach(table, sum_define_entry, &sum);
+	printf("LU_HASH_DEFINE tree bucket: %zu entries left, %zu reseeds\n", sum.count, table->reseed_count);
+	assert(sum.count == DEFINE_TEST_KEYS / 2 && table->element_count == DEFINE_TEST_KEYS / 2);
+	assert(sum.value_sum == (size_t)(DEFINE_TEST_KEYS / 2) * (DEFINE_TEST_KEYS / 2));
+	colliding64_destroy(table);
+}
+
+#define DENSE_TEST_KEYS 1000000
+
+// At a high load factor ordinary buckets overflow into trees on their own; that must not be taken
+// for a collision attack, nor may the adaptive load factor climb into that range.
+void test_dense_load_factor() {
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.max_load_factor = 4.0;
+	lu_hash_table_t* table = lu_hash_table_init_with_config(0, &config);
+	for (int i = 0; i < DENSE_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	printf("Load factor 4: %zu entries in %zu buckets, %zu reseeds\n", table->element_count, table->table_size, table->reseed_count);
+	assert(table->element_count == DENSE_TEST_KEYS);
+	assert(table->reseed_count <= 1);
+	assert(lu_hash_table_find(table, DENSE_TEST_KEYS / 2) == (void*)(size_t)(DENSE_TEST_KEYS / 2 + 1));
+	lu_hash_table_destroy(table);
+
+	lu_hash_table_config_default(&config);
+	config.adaptive_chain_length = 8;
+	table = lu_hash_table_init_with_config(0, &config);
+	for (int i = 0; i < DENSE_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+		lu_hash_table_find(table, i);
+	}
+	printf("Adaptive load factor: settled at %.2f, %zu reseeds\n", table->config.max_load_factor, table->reseed_count);
+	assert(table->config.max_load_factor < 2.0);
+	assert(table->reseed_count <= 1);
+	lu_hash_table_destroy(table);
+}
+
+#define RESEED_TEST_KEYS 5000
+
+// Honours the seed, yet sends every key to the same bucket under any seed
+static unsigned long long seed_only_hash(int key, unsigned long long seed) {
+	(void)key;
+	return seed;
+}
+
+// Keys that no seed scatters still trip the collision checks after every reseed; the table must
+// back off instead of rehashing on nearly every insert, and never reseed on a hash that ignores the
+// seed.
+void test_reseed_backoff() {
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.hash = seed_only_hash;
+	lu_hash_table_t* table = lu_hash_table_init_with_config(0, &config);
+	for (int i = 0; i < RESEED_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	printf("Reseed back-off: %d colliding keys, %zu reseeds\n", RESEED_TEST_KEYS, table->reseed_count);
+	assert(table->element_count == RESEED_TEST_KEYS);
+	assert(table->reseed_count >= 1 && table->reseed_count <= 12);
+	for (int i = 0; i < RESEED_TEST_KEYS; i++) {
+		assert(lu_hash_table_find(table, i) == (void*)(size_t)(i + 1));
+	}
+
+	// A manual reseed is never held off
+	size_t reseeds = table->reseed_count;
+	lu_hash_table_reseed(table);
+	assert(table->reseed_count == reseeds + 1);
+	lu_hash_table_destroy(table);
+
+	config.hash = colliding_hash;
+	table = lu_hash_table_init_with_config(0, &config);
+	for (int i = 0; i < RESEED_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	assert(table->element_count == RESEED_TEST_KEYS && table->reseed_count == 0);
+	assert(lu_hash_table_find(table, RESEED_TEST_KEYS - 1) == (void*)(size_t)RESEED_TEST_KEYS);
+	lu_hash_table_destroy(table);
+}
+
+#define MAPPED_TEST_PATH	"luhash_test.map"
+#define MAPPED_TEST_KEYS	5000
+
+// Checks the contents of a mapped table holding the keys below `keys` except the multiples of 7
+static void check_mapped(lu_hash_mapped_t* map, int keys) {
+	assert(lu_hash_mapped_count(map) == (size_t)(keys - (keys + 6) / 7));
+	for (int i = 0; i < keys; i++) {
+		long long* value = (long long*)lu_hash_mapped_find(map, i);
+		if (i % 7 == 0) {
+			assert(value == NULL);
+		}
+		else {
+			assert(value != NULL && *value == (long long)i * 3);
+		}
+	}
+	assert(lu_hash_mapped_find(map, keys) == NULL);
+}
+
+// A mapped table reopened from its file has the same contents, keeps growing, and refuses a
+// different value size.
+void test_mapped_reopen() {
+	remove(MAPPED_TEST_PATH);
+	lu_hash_mapped_t* map = lu_hash_mapped_open(MAPPED_TEST_PATH, sizeof(long long), 16);
+	assert(map != NULL && map->was_clean);
+	for (int i = 0; i < MAPPED_TEST_KEYS; i++) {
+		long long value = (long long)i * 3;
+		lu_hash_mapped_insert(map, i, &value);
+	}
+	for (int i = 0; i < MAPPED_TEST_KEYS; i += 7) {
+		lu_hash_mapped_delete(map, i);
+	}
+	check_mapped(map, MAPPED_TEST_KEYS);
+	assert(lu_hash_mapped_close(map) == LU_OK);
+
+	assert(lu_hash_mapped_open(MAPPED_TEST_PATH, sizeof(int), 0) == NULL);
+	map = lu_hash_mapped_open(MAPPED_TEST_PATH, sizeof(long long), 0);
+	assert(map != NULL && map->was_clean);
+	check_mapped(map, MAPPED_TEST_KEYS);
+
+	// Grow the reopened file, reusing the nodes freed above
+	for (int i = MAPPED_TEST_KEYS; i < MAPPED_TEST_KEYS * 4; i++) {
+		long long value = (long long)i * 3;
+		if (i % 7 != 0) {
+			lu_hash_mapped_insert(map, i, &value);
+		}
+	}
+	assert(lu_hash_mapped_close(map) == LU_OK);
+
+	map = lu_hash_mapped_open(MAPPED_TEST_PATH, sizeof(long long), 0);
+	assert(map != NULL);
+	check_mapped(map, MAPPED_TEST_KEYS * 4);
+	printf("Mapped: %zu entries after two reopens\n", lu_hash_mapped_count(map));
+	assert(lu_hash_mapped_close(map) == LU_OK);
+	remove(MAPPED_TEST_PATH);
+}
+
+#define REMOVE_IF_TEST_KEYS 10000
+#define REMOVE_IF_TREE_KEYS 64
+
+// Matches the keys that are multiples of *(int*)ctx
+static int is_multiple(int key, void* value, void* ctx) {
+	(void)value;
+	return key % *(int*)ctx == 0;
+}
+
+// Matches the keys that are not multiples of *(int*)ctx
+static int is_not_multiple(int key, void* value, void* ctx) {
+	(void)value;
+	return key % *(int*)ctx != 0;
+}
+
+// remove_if over list buckets, and over a tree bucket losing a few nodes (deleted one by one),
+// most of its nodes (rebuilt) and nearly all of them (turned back into a list).
+void test_remove_if() {
+	lu_hash_table_t* table = lu_hash_table_init(0);
+	for (int i = 0; i < REMOVE_IF_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	int modulus = 3;
+	assert(lu_hash_table_remove_if(table, is_multiple, &modulus) == (REMOVE_IF_TEST_KEYS + 2) / 3);
+	assert(table->element_count == REMOVE_IF_TEST_KEYS - (REMOVE_IF_TEST_KEYS + 2) / 3);
+	for (int i = 0; i < REMOVE_IF_TEST_KEYS; i++) {
+		assert(lu_hash_table_find(table, i) == (i % 3 ? (void*)(size_t)(i + 1) : NULL));
+	}
+	assert(lu_hash_table_remove_if(table, is_multiple, &modulus) == 0);
+	lu_hash_table_destroy(table);
+
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.hash = colliding_hash;
+	config.untreeify_threshold = 4;
+	table = lu_hash_table_init_with_config(0, &config);
+	for (int i = 0; i < REMOVE_IF_TREE_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_RBTREE);
+
+	modulus = 32;
+	assert(lu_hash_table_remove_if(table, is_multiple, &modulus) == 2);
+	modulus = 2;
+	assert(lu_hash_table_remove_if(table, is_not_multiple, &modulus) == REMOVE_IF_TREE_KEYS / 2);
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_RBTREE);
+	assert(table->element_count == REMOVE_IF_TREE_KEYS / 2 - 2);
+	for (int i = 0; i < REMOVE_IF_TREE_KEYS; i++) {
+		assert(lu_hash_table_find(table, i) == (i % 2 == 0 && i % 32 ? (void*)(size_t)(i + 1) : NULL));
+	}
+
+	modulus = 16;
+	assert(lu_hash_table_remove_if(table, is_not_multiple, &modulus) == REMOVE_IF_TREE_KEYS / 2 - 4);
+	printf("remove_if: tree bucket down to %zu entries\n", table->element_count);
+	assert(table->element_count == 2);
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_LIST);
+	assert(lu_hash_table_find(table, 16) == (void*)(size_t)17);
+	assert(lu_hash_table_find(table, 48) == (void*)(size_t)49);
+	lu_hash_table_destroy(table);
+}
+
+#define COMPACT_TEST_KEYS 20000
+
+// Counts what a table allocates through its configured allocator
+typedef struct {
+	size_t live;
+	size_t total;
+} CountingAllocator;
+
+static void* counting_alloc(size_t size, void* ctx) {
+	CountingAllocator* counter = (CountingAllocator*)ctx;
+	counter->live++;
+	counter->total++;
+	return malloc(size);
+}
+
+static void counting_free(void* ptr, void* ctx) {
+	((CountingAllocator*)ctx)->live--;
+	free(ptr);
+}
+
+// Compaction interleaved with deletes: the blocks come from the table's allocator and go back to it
+// as soon as their last node is deleted.
+void test_compact_release() {
+	CountingAllocator counter = { 0, 0 };
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.alloc = counting_alloc;
+	config.free = counting_free;
+	config.alloc_ctx = &counter;
+	config.min_load_factor = 0;	// No shrinking, so that the bucket array stays one allocation
+	lu_hash_table_t* table = lu_hash_table_init_with_config(COMPACT_TEST_KEYS, &config);
+	assert(counter.live == 1);
+
+	for (int i = 0; i < COMPACT_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	size_t moved = lu_hash_table_compact(table, table->table_size);
+	size_t blocks = counter.live - 1;
+	assert(moved == COMPACT_TEST_KEYS);
+	assert(blocks > 1);
+
+	// Delete in key order, compacting a little between deletes as an idle callback would
+	for (int i = 0; i < COMPACT_TEST_KEYS; i++) {
+		lu_hash_table_delete(table, i);
+		if (i % 64 == 0) {
+			lu_hash_table_compact(table, 16);
+		}
+		if (i == COMPACT_TEST_KEYS / 2) {
+			assert(lu_hash_table_find(table, i + 1) == (void*)(size_t)(i + 2));
+		}
+	}
+	printf("Compaction: %zu nodes moved into %zu blocks, %zu allocations live after deleting everything\n", moved, blocks, counter.live);
+	assert(table->element_count == 0);
+	// Only the bucket array and the block the table is still filling may remain
+	assert(counter.live <= 2);
+
+	lu_hash_table_destroy(table);
+	assert(counter.live == 0);
+}
+
+#define BATCH_TEST_PAIRS 20000
+
+// Fills one table key by key and another with the batch calls, from the same pseudo-random keys
+// (with repeats and absent keys), and compares them after the inserts and after the deletes.
+static void compare_batch(const lu_hash_table_config_t* config, int key_range) {
+	lu_hash_table_t* single = lu_hash_table_init_with_config(16, config);
+	lu_hash_table_t* batch = lu_hash_table_init_with_config(16, config);
+	int* keys = (int*)malloc(BATCH_TEST_PAIRS * sizeof(int));
+	void** values = (void**)malloc(BATCH_TEST_PAIRS * sizeof(void*));
+	unsigned int seed = 12345;
+
+	// Both start with the same keys so that the batch also updates existing entries
+	for (int i = 0; i < key_range; i += 5) {
+		lu_hash_table_insert(single, i - key_range / 2, (void*)(size_t)1);
+		lu_hash_table_insert(batch, i - key_range / 2, (void*)(size_t)1);
+	}
+	for (int i = 0; i < BATCH_TEST_PAIRS; i++) {
+		seed = seed * 1103515245u + 12345u;
+		keys[i] = (int)((seed >> 8) % (unsigned int)key_range) - key_range / 2;
+		values[i] = (void*)(size_t)(i + 2);
+		lu_hash_table_insert(single, keys[i], values[i]);
+	}
+	lu_hash_table_insert_batch(batch, keys, values, BATCH_TEST_PAIRS);
+	assert(batch->element_count == single->element_count);
+	for (int key = -key_range / 2 - 1; key <= key_range / 2; key++) {
+		assert(lu_hash_table_find(batch, key) == lu_hash_table_find(single, key));
+	}
+
+	size_t removed = 0;
+	for (int i = 0; i < BATCH_TEST_PAIRS / 4; i++) {
+		seed = seed * 1103515245u + 12345u;
+		keys[i] = (int)((seed >> 8) % (unsigned int)(key_range * 2)) - key_range;
+		if (lu_hash_table_find(single, keys[i]) != NULL) {
+			removed++;
+		}
+		lu_hash_table_delete(single, keys[i]);
+	}
+	assert(lu_hash_table_delete_batch(batch, keys, BATCH_TEST_PAIRS / 4) == removed);
+	assert(batch->element_count == single->element_count);
+	for (int key = -key_range; key < key_range; key++) {
+		assert(lu_hash_table_find(batch, key) == lu_hash_table_find(single, key));
+	}
+
+	free(keys);
+	free(values);
+	lu_hash_table_destroy(single);
+	lu_hash_table_destroy(batch);
+}
+
+// insert_batch and delete_batch leave the same table as the per-key calls, with list buckets and
+// with every key in one tree bucket.
+void test_batch() {
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	compare_batch(&config, 8000);
+	config.hash = colliding_hash;
+	config.untreeify_threshold = 4;
+	compare_batch(&config, 300);
+	printf("Batch: insert_batch and delete_batch match the per-key calls\n");
+}
+
+#define AGG_TEST_ROWS	200000
+#define AGG_TEST_GROUPS	1000
+#define AGG_TEST_TOP	10
+
+// Compares every group of an aggregation with the brute-force accumulators, indexed by key + AGG_TEST_GROUPS / 2
+static void check_agg(const lu_hash_agg_t* agg, const lu_hash_agg_acc_t* expected) {
+	assert(agg->rows == AGG_TEST_ROWS);
+	size_t groups = 0;
+	for (int g = 0; g < AGG_TEST_GROUPS; g++) {
+		const lu_hash_agg_acc_t* acc = lu_hash_agg_find(agg, g - AGG_TEST_GROUPS / 2);
+		if (expected[g].count == 0) {
+			assert(acc == NULL);
+			continue;
+		}
+		groups++;
+		assert(acc != NULL);
+		assert(acc->count == expected[g].count && acc->sum == expected[g].sum);
+		assert(acc->min == expected[g].min && acc->max == expected[g].max);
+	}
+	assert(lu_hash_agg_groups(agg) == groups);
+}
+
+// Sequential, parallel and merged aggregation of pseudo-random rows against a brute-force sum per
+// group, and the top groups by sum against a selection over the same sums.
+void test_aggregation() {
+	int* keys = (int*)malloc(AGG_TEST_ROWS * sizeof(int));
+	long long* values = (long long*)malloc(AGG_TEST_ROWS * sizeof(long long));
+	lu_hash_agg_acc_t expected[AGG_TEST_GROUPS];
+	memset(expected, 0, sizeof(expected));
+	unsigned int seed = 777;
+	for (int i = 0; i < AGG_TEST_ROWS; i++) {
+		seed = seed * 1103515245u + 12345u;
+		// Squaring skews the group sizes, so that a few groups are much larger than the rest
+		unsigned int r = (seed >> 8) % 1000;
+		int g = (int)(r * r / 1000);
+		seed = seed * 1103515245u + 12345u;
+		keys[i] = g - AGG_TEST_GROUPS / 2;
+		values[i] = (long long)((seed >> 8) % 2001) - 1000;
+
+		lu_hash_agg_acc_t* acc = &expected[g];
+		if (acc->count == 0 || values[i] < acc->min) {
+			acc->min = values[i];
+		}
+		if (acc->count == 0 || values[i] > acc->max) {
+			acc->max = values[i];
+		}
+		acc->count++;
+		acc->sum += values[i];
+	}
+
+	lu_hash_agg_t* agg = lu_hash_agg_init(0);
+	lu_hash_agg_update(agg, keys, values, AGG_TEST_ROWS / 3);
+	lu_hash_agg_update(agg, keys + AGG_TEST_ROWS / 3, values + AGG_TEST_ROWS / 3, AGG_TEST_ROWS - AGG_TEST_ROWS / 3);
+	check_agg(agg, expected);
+
+	lu_hash_agg_t* parallel = lu_hash_agg_init(0);
+	lu_hash_agg_update_parallel(parallel, keys, values, AGG_TEST_ROWS, 4);
+	check_agg(parallel, expected);
+
+	lu_hash_agg_t* half = lu_hash_agg_init(0);
+	lu_hash_agg_t* merged = lu_hash_agg_init(0);
+	lu_hash_agg_update(half, keys, values, AGG_TEST_ROWS / 2);
+	lu_hash_agg_update_parallel(merged, keys + AGG_TEST_ROWS / 2, values + AGG_TEST_ROWS / 2, AGG_TEST_ROWS / 2, 3);
+	lu_hash_agg_merge(merged, half);
+	check_agg(merged, expected);
+
+	// Brute-force top groups by sum, ties broken by ascending key
+	lu_hash_agg_entry_t top[AGG_TEST_TOP];
+	unsigned char chosen[AGG_TEST_GROUPS] = { 0 };
+	size_t n = lu_hash_agg_top_k(parallel, LU_HASH_AGG_SUM, AGG_TEST_TOP, top);
+	assert(n == AGG_TEST_TOP);
+	for (size_t rank = 0; rank < AGG_TEST_TOP; rank++) {
+		int best = -1;
+		for (int g = 0; g < AGG_TEST_GROUPS; g++) {
+			if (expected[g].count != 0 && !chosen[g] && (best < 0 || expected[g].sum > expected[best].sum)) {
+				best = g;
+			}
+		}
+		chosen[best] = 1;
+		assert(top[rank].key == best - AGG_TEST_GROUPS / 2);
+		assert(top[rank].acc.sum == expected[best].sum && top[rank].acc.count == expected[best].count);
+	}
+	assert(lu_hash_agg_top_k(agg, LU_HASH_AGG_COUNT, 1, top) == 1);
+	for (int g = 0; g < AGG_TEST_GROUPS; g++) {
+		assert(expected[g].count <= top[0].acc.count);
+	}
+	printf("Aggregation: %zu groups, the largest has %lld rows\n", lu_hash_agg_groups(agg), top[0].acc.count);
+
+	lu_hash_agg_destroy(agg);
+	lu_hash_agg_destroy(parallel);
+	lu_hash_agg_destroy(half);
+	lu_hash_agg_destroy(merged);
+	free(keys);
+	free(values);
+}
+
+#define FIXED_TEST_CAPACITY 100
+
+// A full fixed table refuses new keys with LU_ERROR_FULL and stays unchanged, still accepts
+// updates, and takes new keys again once entries are deleted.
+void test_fixed_full() {
+	static unsigned long long region[LU_HASH_FIXED_BYTES(FIXED_TEST_CAPACITY, sizeof(int)) / 8 + 1];
+	lu_hash_fixed_t* table = lu_hash_fixed_init(region, sizeof(region), FIXED_TEST_CAPACITY, sizeof(int));
+	assert(table != NULL && lu_hash_fixed_capacity(table) == FIXED_TEST_CAPACITY);
+	for (int i = 0; i < FIXED_TEST_CAPACITY; i++) {
+		assert(lu_hash_fixed_insert(table, i, &i) == LU_OK);
+	}
+
+	int value = -1;
+	assert(lu_hash_fixed_insert(table, FIXED_TEST_CAPACITY, &value) == LU_ERROR_FULL);
+	assert(lu_hash_fixed_count(table) == FIXED_TEST_CAPACITY);
+	assert(lu_hash_fixed_find(table, FIXED_TEST_CAPACITY) == NULL);
+	assert(lu_hash_fixed_insert(table, 0, &value) == LU_OK);
+	assert(*(int*)lu_hash_fixed_find(table, 0) == -1);
+	for (int i = 1; i < FIXED_TEST_CAPACITY; i++) {
+		assert(*(int*)lu_hash_fixed_find(table, i) == i);
+	}
+
+	lu_hash_fixed_delete(table, 5);
+	assert(lu_hash_fixed_insert(table, FIXED_TEST_CAPACITY, &value) == LU_OK);
+	assert(lu_hash_fixed_insert(table, FIXED_TEST_CAPACITY + 1, &value) == LU_ERROR_FULL);
+	printf("Fixed table: full at %zu entries\n", lu_hash_fixed_count(table));
+	assert(lu_hash_fixed_count(table) == FIXED_TEST_CAPACITY);
+
+	// A region too small for the capacity is refused up front
+	assert(lu_hash_fixed_init(region, sizeof(region) / 2, FIXED_TEST_CAPACITY, sizeof(int)) == NULL);
+}
+
+#define DESTROY_TEST_KEYS 20000
+#define DESTROY_TEST_BUDGET 64
+
+// A table of plain buckets plus one large tree bucket, through the counting allocator
+static lu_hash_table_t* destroy_test_table(CountingAllocator* counter) {
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.hash = colliding_hash;
+	config.alloc = counting_alloc;
+	config.free = counting_free;
+	config.alloc_ctx = counter;
+	lu_hash_table_t* table = lu_hash_table_init_with_config(1024, &config);
+	for (int i = 0; i < DESTROY_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	assert(table->element_count == DESTROY_TEST_KEYS);
+	assert(colliding_bucket(table)->type == LU_HASH_BUCKET_RBTREE);
+	return table;
+}
+
+// Every call of destroy_step but the last uses its whole budget, one unit per node and per bucket
+static void destroy_in_steps(lu_hash_table_t* table, size_t budget) {
+	size_t work = table->element_count + table->table_size;
+	size_t calls = 0;
+	while (!lu_hash_table_destroy_step(table, budget)) {
+		calls++;
+		assert(calls <= work / budget);
+	}
+}
+
+// destroy_step tears a large tree bucket down in bounded steps, and the reclaimer drains whole
+// tables on its own thread; both hand everything back to the allocator.
+void test_destroy_step() {
+	CountingAllocator counter = { 0, 0 };
+	lu_hash_table_t* table = destroy_test_table(&counter);
+	assert(counter.live > 0);
+
+	// A budget of 0 only prepares the table
+	assert(lu_hash_table_destroy_step(table, 0) == 0);
+	size_t steps = 1;
+	while (!lu_hash_table_destroy_step(table, DESTROY_TEST_BUDGET)) {
+		assert(counter.live > 0);
+		steps++;
+	}
+	printf("Destroy step: %d keys freed in %zu steps of %d\n", DESTROY_TEST_KEYS, steps, DESTROY_TEST_BUDGET);
+	assert(steps > DESTROY_TEST_KEYS / DESTROY_TEST_BUDGET);
+	assert(counter.live == 0);
+
+	// The smallest budgets still free a node or pass a bucket on every call, in lists and trees
+	for (size_t budget = 1; budget <= 2; budget++) {
+		destroy_in_steps(destroy_test_table(&counter), budget);
+		assert(counter.live == 0);
+		lu_hash_table_t* lists = lu_hash_table_init(0);
+		for (int i = 0; i < DESTROY_TEST_KEYS / 10; i++) {
+			lu_hash_table_insert(lists, i, (void*)(size_t)(i + 1));
+		}
+		destroy_in_steps(lists, budget);
+	}
+
+	// Built up front, so that the counter is not touched by both threads at once
+	lu_hash_table_t* tables[3];
+	for (int i = 0; i < 3; i++) {
+		tables[i] = destroy_test_table(&counter);
+	}
+	lu_hash_reclaimer_t* reclaimer = lu_hash_reclaimer_start(DESTROY_TEST_BUDGET, 0);
+	for (int i = 0; i < 3; i++) {
+		lu_hash_reclaimer_destroy(reclaimer, tables[i]);
+	}
+	lu_hash_reclaimer_wait(reclaimer);
+	printf("Reclaimer: %zu tables freed, %s\n", reclaimer->reclaimed, reclaimer->threaded ? "threaded" : "inline");
+	assert(lu_hash_reclaimer_pending(reclaimer) == 0);
+	assert(reclaimer->reclaimed == 3);
+	assert(counter.live == 0);
+	lu_hash_reclaimer_stop(reclaimer);
+}
+
+#ifdef LU_HASH_TRACE
+#define TRACE_TEST_KEYS (LU_HASH_BUCKET_LIST_THRESHOLD + 1)
+
+// With every operation sampled, a known sequence of inserts and finds on one bucket leaves exactly
+// its events in the ring: one per insert, the treeify of the bucket inside the last insert, and
+// one per find.
+void test_trace() {
+	lu_hash_trace_event_t events[LU_HASH_TRACE_RING_SIZE];
+	lu_hash_trace_configure(1, 0, NULL, NULL);
+	lu_hash_trace_drain(events, LU_HASH_TRACE_RING_SIZE);
+
+	lu_hash_table_config_t config;
+	lu_hash_table_config_default(&config);
+	config.hash = colliding_hash;
+	lu_hash_table_t* table = lu_hash_table_init_with_config(0, &config);
+	for (int i = 0; i < TRACE_TEST_KEYS; i++) {
+		lu_hash_table_insert(table, i, (void*)(size_t)(i + 1));
+	}
+	assert(lu_hash_table_find(table, 0) == (void*)(size_t)1);
+	assert(lu_hash_table_find(table, TRACE_TEST_KEYS) == NULL);
+	lu_hash_trace_configure(0, 0, NULL, NULL);
+
+	size_t count = lu_hash_trace_drain(events, LU_HASH_TRACE_RING_SIZE);
+	printf("Trace: %zu events\n", count);
+	assert(count == TRACE_TEST_KEYS + 1 + 2);
+	for (size_t i = 0; i < count; i++) {
+		assert(events[i].table == table && events[i].bucket == 0);
+	}
+	// A list insert compares the new key with every node already in the bucket
+	for (int i = 0; i < TRACE_TEST_KEYS - 1; i++) {
+		assert(events[i].op == LU_HASH_TRACE_INSERT && events[i].key == i && events[i].steps == (size_t)i);
+	}
+	// The last insert records after the treeify it triggered
+	assert(events[TRACE_TEST_KEYS - 1].op == LU_HASH_TRACE_TREEIFY && events[TRACE_TEST_KEYS - 1].steps == TRACE_TEST_KEYS);
+	assert(events[TRACE_TEST_KEYS].op == LU_HASH_TRACE_INSERT && events[TRACE_TEST_KEYS].key == TRACE_TEST_KEYS - 1);
+	assert(events[TRACE_TEST_KEYS + 1].op == LU_HASH_TRACE_FIND && events[TRACE_TEST_KEYS + 1].key == 0);
+	assert(events[TRACE_TEST_KEYS + 2].op == LU_HASH_TRACE_FIND && events[TRACE_TEST_KEYS + 2].key == TRACE_TEST_KEYS);
+	assert(events[TRACE_TEST_KEYS + 1].steps >= 1 && events[TRACE_TEST_KEYS + 1].steps <= LU_HASH_RESEED_TREE_HEIGHT);
+
+	// Tracing is off again: nothing more is recorded
+	lu_hash_table_find(table, 0);
+	assert(lu_hash_trace_drain(events, LU_HASH_TRACE_RING_SIZE) == 0);
+	lu_hash_table_destroy(table);
+}
+#endif // LU_HASH_TRACE
+
+// Usage: luhash [--perf] [--perf-baseline <file.csv>] [--perf-csv <file.csv>]
+// The counter benchmark only runs when asked for, and only writes a CSV when given a path.
+int main(int argc, char** argv) {
 	//system("chcp 65001");
+	int perf = 0;
+	const char* perf_baseline = NULL;
+	const char* perf_csv = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--perf") == 0) {
+			perf = 1;
+		}
+		else if (strcmp(argv[i], "--perf-baseline") == 0 && i + 1 < argc) {
+			perf = 1;
+			perf_baseline = argv[++i];
+		}
+		else if (strcmp(argv[i], "--perf-csv") == 0 && i + 1 < argc) {
+			perf = 1;
+			perf_csv = argv[++i];
+		}
+		else {
+			fprintf(stderr, "usage: %s [--perf] [--perf-baseline <file.csv>] [--perf-csv <file.csv>]\n", argv[0]);
+			return 1;
+		}
+	}
 
 	test_hash();
+	test_intrusive();
+	test_lockfree_stress();
+	test_lockfree_counters();
+	test_sharded();
+	test_frozen();
+	test_ttl_expiry();
+	test_clock_eviction();
+	test_set();
+	test_filter_stats();
+	test_snapshot();
+	test_set_operations();
+	test_wal_replay();
+	test_define_tree();
+	test_dense_load_factor();
+	test_reseed_backoff();
+	test_mapped_reopen();
+	test_remove_if();
+	test_compact_release();
+	test_batch();
+	test_aggregation();
+	test_fixed_full();
+	test_destroy_step();
+#ifdef LU_HASH_TRACE
+	test_trace();
+#endif // LU_HASH_TRACE
+	bench_lockfree_scaling();
+	if (perf) {
+		bench_perf_counters(perf_baseline, perf_csv);
+	}
 	return 0;
 }
\ No newline at end of file